@@ -830,6 +830,10 @@ namespace UserConfigParams
      *  important warnings must always be printed. */
     PARAM_PREFIX int  m_verbosity         PARAM_DEFAULT( 0 );
 
+    /** Number of worker threads of the JobSystem, -1 for one less than the
+     *  number of cores, 0 to run all jobs in the main thread. */
+    PARAM_PREFIX int  m_job_threads       PARAM_DEFAULT( -1 );
+
     PARAM_PREFIX bool m_no_start_screen   PARAM_DEFAULT( false );
 
     PARAM_PREFIX bool m_race_now          PARAM_DEFAULT( false );
@@ -930,6 +934,11 @@ namespace UserConfigParams
         PARAM_DEFAULT(IntUserConfigParam(5, "timer-sync-difference-tolerance",
         &m_network_group, "Max time difference tolerance (in ms) to "
         "synchronize timer with server."));
+    PARAM_PREFIX IntUserConfigParam m_rollback_window
+        PARAM_DEFAULT(IntUserConfigParam(0, "rollback-window",
+        &m_network_group, "Time (in ms) for which states received from the "
+        "server are collected before rewinding once to the latest of them, "
+        "0 rewinds in the frame a state is received."));
     PARAM_PREFIX IntUserConfigParam m_default_ip_type
         PARAM_DEFAULT(IntUserConfigParam(0, "default-ip-type",
         &m_network_group, "Default IP type of this machine, "
@@ -266,6 +266,7 @@ FileManager::FileManager()
     checkAndCreateScreenshotDir();
     checkAndCreateReplayDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCachedPhysicsDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -841,6 +842,15 @@ std::string FileManager::getCachedTexturesDir() const
     return m_cached_textures_dir;
 }   // getCachedTexturesDir
 
+//-----------------------------------------------------------------------------
+/** Returns the directory in which the collision and navigation data of
+ *  tracks is cached, or an empty string if it is not available.
+ */
+std::string FileManager::getCachedPhysicsDir() const
+{
+    return m_cached_physics_dir;
+}   // getCachedPhysicsDir
+
 //-----------------------------------------------------------------------------
 /** Returns the directory in which user-defined grand prix should be stored.
  */
@@ -1209,6 +1219,34 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directory for the cached collision and navigation data of
+*  tracks. This will set m_cached_physics_dir with the appropriate path, or
+*  to an empty string if the directory can't be created (the data is then
+*  not cached).
+*/
+void FileManager::checkAndCreateCachedPhysicsDir()
+{
+#if defined(WIN32) || defined(__HAIKU__)
+    m_cached_physics_dir = m_user_config_dir + "cached-physics/";
+#elif defined(__APPLE__)
+    m_cached_physics_dir = getenv("HOME");
+    m_cached_physics_dir += "/Library/Application Support/SuperTuxKart/CachedPhysics/";
+#else
+    m_cached_physics_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_physics_dir += "cached-physics/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_physics_dir))
+    {
+        Log::warn("FileManager", "Can not create cached physics directory "
+            "'%s', collision and navigation data of tracks won't be cached.",
+            m_cached_physics_dir.c_str());
+        m_cached_physics_dir.clear();
+    }
+
+}   // checkAndCreateCachedPhysicsDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -98,6 +98,10 @@ private:
     /** Directory where resized textures are cached. */
     std::string       m_cached_textures_dir;
 
+    /** Directory where the collision data of tracks is cached, empty if it
+     *  can't be created. */
+    std::string       m_cached_physics_dir;
+
     /** Directory where user-defined grand prix are stored. */
     std::string       m_gp_dir;
 
@@ -128,6 +132,7 @@ private:
     void              checkAndCreateScreenshotDir();
     void              checkAndCreateReplayDir();
     void              checkAndCreateCachedTexturesDir();
+    void              checkAndCreateCachedPhysicsDir();
     void              checkAndCreateGPDir();
     void              discoverPaths();
     void              addAssetsSearchPath();
@@ -154,6 +159,7 @@ public:
     std::string       getScreenshotDir() const;
     std::string       getReplayDir() const;
     std::string       getCachedTexturesDir() const;
+    std::string       getCachedPhysicsDir() const;
     std::string       getGPDir() const;
     std::string       getStdoutDir() const;
     bool              checkAndCreateDirectory(const std::string &path);
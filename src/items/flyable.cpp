@@ -664,41 +664,76 @@ void Flyable::moveToInfinity(bool set_moveable_trans)
 }   // moveToInfinity
 
 // ----------------------------------------------------------------------------
-BareNetworkString* Flyable::saveState(std::vector<std::string>* ru)
+bool Flyable::saveState(BareNetworkString* buffer,
+                        std::vector<uint16_t>* ru)
 {
     if (m_has_hit_something)
-        return NULL;
+        return false;
+
+    ru->push_back(getRewinderID());
 
-    ru->push_back(getUniqueIdentity());
+    if (!NetworkConfig::get()->useBitPackedState())
+    {
+        uint16_t ticks_since_thrown_animation =
+            (m_ticks_since_thrown & 32767) | (hasAnimation() ? 32768 : 0);
+        buffer->addUInt16(ticks_since_thrown_animation);
+        if (m_do_terrain_info)
+            buffer->addUInt32(m_compressed_gravity_vector);
+        if (hasAnimation())
+            m_animation->saveState(buffer);
+        else
+        {
+            CompressNetworkBody::compress(
+                m_body.get(), m_motion_state.get(), buffer);
+        }
+        return true;
+    }
 
-    BareNetworkString* buffer = new BareNetworkString();
-    uint16_t ticks_since_thrown_animation = (m_ticks_since_thrown & 32767) |
-        (hasAnimation() ? 32768 : 0);
-    buffer->addUInt16(ticks_since_thrown_animation);
+    BitWriter bw(buffer);
+    bw.addBool(hasAnimation());
+    bw.addVarUInt(m_ticks_since_thrown & 32767);
     if (m_do_terrain_info)
-        buffer->addUInt32(m_compressed_gravity_vector);
+        bw.addBits(m_compressed_gravity_vector, 32);
 
     if (hasAnimation())
+    {
+        bw.flush();
         m_animation->saveState(buffer);
+    }
     else
     {
         CompressNetworkBody::compress(
-            m_body.get(), m_motion_state.get(), buffer);
+            m_body.get(), m_motion_state.get(), &bw);
     }
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
 void Flyable::restoreState(BareNetworkString *buffer, int count)
 {
-    uint16_t ticks_since_thrown_animation = buffer->getUInt16();
-    bool has_animation_in_state =
-        (ticks_since_thrown_animation >> 15 & 1) == 1;
-    if (m_do_terrain_info)
-        m_compressed_gravity_vector = buffer->getUInt32();
+    const bool bit_packed = NetworkConfig::get()->useBitPackedState();
+    BitReader br(buffer);
+    bool has_animation_in_state;
+    uint16_t ticks_since_thrown;
+    if (bit_packed)
+    {
+        has_animation_in_state = br.getBool();
+        ticks_since_thrown = (uint16_t)br.getVarUInt();
+        if (m_do_terrain_info)
+            m_compressed_gravity_vector = br.getBits(32);
+    }
+    else
+    {
+        uint16_t ticks_since_thrown_animation = buffer->getUInt16();
+        has_animation_in_state = (ticks_since_thrown_animation >> 15 & 1) == 1;
+        ticks_since_thrown = ticks_since_thrown_animation & 32767;
+        if (m_do_terrain_info)
+            m_compressed_gravity_vector = buffer->getUInt32();
+    }
 
     if (has_animation_in_state)
     {
+        br.align();
         // At the moment we only have cannon animation for rubber ball
         if (!m_animation)
         {
@@ -725,11 +760,19 @@ void Flyable::restoreState(BareNetworkString *buffer, int count)
             // will set m_animation to null
             delete m_animation;
         }
-        CompressNetworkBody::decompress(
-            buffer, m_body.get(), m_motion_state.get());
+        if (bit_packed)
+        {
+            CompressNetworkBody::decompress(
+                &br, m_body.get(), m_motion_state.get());
+        }
+        else
+        {
+            CompressNetworkBody::decompress(
+                buffer, m_body.get(), m_motion_state.get());
+        }
         m_transform = m_body->getWorldTransform();
     }
-    m_ticks_since_thrown = ticks_since_thrown_animation & 32767;
+    m_ticks_since_thrown = ticks_since_thrown & 32767;
     m_has_server_state = true;
     m_has_hit_something = false;
 }   // restoreState
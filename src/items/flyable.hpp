@@ -259,11 +259,16 @@ public:
     // ------------------------------------------------------------------------
     virtual void computeError() OVERRIDE;
     // ------------------------------------------------------------------------
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<uint16_t>* ru) OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void restoreState(BareNetworkString *buffer, int count) OVERRIDE;
     // ------------------------------------------------------------------------
+    virtual bool isStateComparable() const OVERRIDE             { return true; }
+    // ------------------------------------------------------------------------
+    virtual const Vec3* getRelevancePosition() const OVERRIDE
+                                                        { return &getXYZ(); }
+    // ------------------------------------------------------------------------
     /* Return true if still in game state, or otherwise can be deleted. */
     bool hasServerState() const                  { return m_has_server_state; }
     // ------------------------------------------------------------------------
@@ -413,6 +413,9 @@ public:
     }   // hitKart
     // ------------------------------------------------------------------------
     bool rotating() const               { return getType() != ITEM_BUBBLEGUM; }
+    // ------------------------------------------------------------------------
+    /** Returns the square of the distance at which the item is collected. */
+    float getDistance2() const                        { return m_distance_2; }
 
 public:
     // ------------------------------------------------------------------------
@@ -18,6 +18,7 @@
 
 #include "items/item_event_info.hpp"
 
+#include "network/bit_packing.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
 #include "network/protocols/game_protocol.hpp"
@@ -61,6 +62,42 @@ ItemEventInfo::ItemEventInfo(BareNetworkString *buffer, int *count)
     }
 }   // ItemEventInfo(BareNetworkString, int *count)
 
+//-----------------------------------------------------------------------------
+/** Loads a bit packed event from a server message.
+ *  \param br A bit reader for the network string with the event data.
+ *  \param state_ticks Ticks of the state, event ticks are stored relative
+ *         to it.
+ */
+ItemEventInfo::ItemEventInfo(BitReader* br, int state_ticks)
+{
+    m_ticks_till_return = 0;
+    m_type  = (EventType)br->getBits(2);
+    m_ticks = br->getTicks(state_ticks);
+    if (m_type != IEI_SWITCH)
+    {
+        m_kart_id = br->getVarInt();
+        m_index = br->getVarUInt();
+        if (m_type == IEI_NEW)
+        {
+            m_item_type = (ItemState::ItemType)br->getBits(4);
+            m_xyz = br->getPosition();
+            float x = br->getFloat();
+            float y = br->getFloat();
+            float z = br->getFloat();
+            m_normal = Vec3(x, y, z);
+        }
+        else   // IEI_COLLECT
+        {
+            m_ticks_till_return = (int16_t)br->getVarInt();
+        }
+    }   // is not switch
+    else   // switch
+    {
+        m_index = -1;
+        m_kart_id = -1;
+    }
+}   // ItemEventInfo(BitReader*, int)
+
 //-----------------------------------------------------------------------------
 /** Stores this event into a network string.
  *  \param buffer The network string to which the data should be appended.
@@ -83,3 +120,31 @@ void ItemEventInfo::saveState(BareNetworkString *buffer)
             buffer->addUInt16(m_ticks_till_return);
     }
 }   // saveState
+
+//-----------------------------------------------------------------------------
+/** Stores this event bit packed into a network string.
+ *  \param bw The bit writer to which the data should be appended.
+ *  \param state_ticks Ticks of the state this event is saved in.
+ */
+void ItemEventInfo::saveState(BitWriter* bw, int state_ticks)
+{
+    assert(NetworkConfig::get()->isServer());
+    bw->addBits(m_type, 2);
+    bw->addTicks(m_ticks, state_ticks);
+    if (m_type != IEI_SWITCH)
+    {
+        // Only new item and collecting items need the index and kart id:
+        bw->addVarInt(m_kart_id);
+        bw->addVarUInt(m_index);
+        if (m_type == IEI_NEW)
+        {
+            bw->addBits(m_item_type, 4);
+            bw->addPosition(m_xyz);
+            bw->addFloat(m_normal.getX());
+            bw->addFloat(m_normal.getY());
+            bw->addFloat(m_normal.getZ());
+        }
+        else if (m_type == IEI_COLLECT)
+            bw->addVarInt(m_ticks_till_return);
+    }
+}   // saveState
@@ -26,6 +26,8 @@
 #include <assert.h>
 
 class BareNetworkString;
+class BitReader;
+class BitWriter;
 
 // ------------------------------------------------------------------------
 /** This class stores a delta, i.e. an item event (either collection of
@@ -98,7 +100,12 @@ public:
 
     // --------------------------------------------------------------------
          ItemEventInfo(BareNetworkString *buffer, int *count);
+    // --------------------------------------------------------------------
+         ItemEventInfo(BitReader* br, int state_ticks);
+    // --------------------------------------------------------------------
     void saveState(BareNetworkString *buffer);
+    // --------------------------------------------------------------------
+    void saveState(BitWriter* bw, int state_ticks);
 
     // --------------------------------------------------------------------
     /** Returns if this event represents a new item. */
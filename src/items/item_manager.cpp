@@ -41,10 +41,25 @@
 #include <IAnimatedMesh.h>
 
 #include <assert.h>
+#include <cmath>
 #include <stdexcept>
 #include <sstream>
 #include <string>
 
+namespace
+{
+    /** Size of the cells of the item grid. Karts are only tested against
+     *  the items in the cells next to them, so it must be at least the
+     *  largest distance at which an item can be collected (see
+     *  Item::hitKart). A power of two makes the division exact. */
+    const float ITEM_CELL_SIZE = 4.0f;
+
+    // ------------------------------------------------------------------------
+    int getCellIndex(float f)
+    {
+        return (int)std::floor(f / ITEM_CELL_SIZE);
+    }   // getCellIndex
+}   // namespace
 
 std::vector<scene::IMesh *>  ItemManager::m_item_mesh;
 std::vector<scene::IMesh *>  ItemManager::m_item_lowres_mesh;
@@ -246,11 +261,21 @@ unsigned int ItemManager::insertItem(Item *item)
     }
     item->setItemId(index);
     insertItemInQuad(item);
+    insertItemInGrid(item);
     // Now insert into the appropriate quad list, if there is a quad list
     // (i.e. race mode has a quad graph).
     return index;
 }   // insertItem
 
+//-----------------------------------------------------------------------------
+/** Returns the key of a cell of the item grid in m_items_in_cells.
+ *  \param x, z Index of the cell in X and Z.
+ */
+uint64_t ItemManager::getCellKey(int x, int z)
+{
+    return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+}   // getCellKey
+
 //-----------------------------------------------------------------------------
 /** Insert into the appropriate quad list, if there is a quad list
  *  (i.e. race mode has a quad graph).
@@ -270,6 +295,25 @@ void ItemManager::insertItemInQuad(Item *item)
     }   // if m_items_in_quads
 }   // insertItemInQuad
 
+//-----------------------------------------------------------------------------
+/** Inserts the item into the cell of the item grid its position is in. This
+ *  must be called again (after deleteItemInGrid) if the position or the id
+ *  of the item is changed.
+ */
+void ItemManager::insertItemInGrid(Item *item)
+{
+    // A collected item is less than 2*sqrt(distance_2) away (the height is
+    // halved in hitKart), so it is always in a cell next to the kart
+    assert(4.0f * item->getDistance2() <= ITEM_CELL_SIZE * ITEM_CELL_SIZE);
+    const unsigned int id = item->getItemId();
+    const uint64_t key = getCellKey(getCellIndex(item->getXYZ().getX()),
+                                    getCellIndex(item->getXYZ().getZ()));
+    m_items_in_cells[key].push_back(id);
+    if (id >= m_item_cell.size())
+        m_item_cell.resize(id + 1);
+    m_item_cell[id] = key;
+}   // insertItemInGrid
+
 //-----------------------------------------------------------------------------
 /** Creates a new item at the location of the kart (e.g. kart drops a
  *  bubblegum).
@@ -388,14 +432,9 @@ void ItemManager::collectedItem(ItemState *item, AbstractKart *kart)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
+    // Only the items in the grid cells next to the kart can be hit. Using
+    // m_items_in_quads instead would need the adjacent quads (and their
+    // adjacent quads for short quads) and the items outside of the track.
 
     /** Disable item collection detection for debug purposes. */
     if(m_disable_item_collection) return;
@@ -403,16 +442,35 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
     // Spare tire karts don't collect items
     if ( dynamic_cast<SpareTireAI*>(kart->getController()) ) return;
 
-    for(AllItemTypes::iterator i =m_all_items.begin();
-                               i!=m_all_items.end();  i++)
+    const int cell_x = getCellIndex(kart->getXYZ().getX());
+    const int cell_z = getCellIndex(kart->getXYZ().getZ());
+    m_items_near_kart.clear();
+    for (int x = cell_x - 1; x <= cell_x + 1; x++)
     {
+        for (int z = cell_z - 1; z <= cell_z + 1; z++)
+        {
+            auto cell = m_items_in_cells.find(getCellKey(x, z));
+            if (cell == m_items_in_cells.end())
+                continue;
+            m_items_near_kart.insert(m_items_near_kart.end(),
+                                     cell->second.begin(), cell->second.end());
+        }
+    }
+    // Test the items in the order of m_all_items, so that several items
+    // hit at the same time are collected in the same order on all
+    // machines, and as when all items were tested
+    std::sort(m_items_near_kart.begin(), m_items_near_kart.end());
+
+    for (unsigned int id : m_items_near_kart)
+    {
+        ItemState* item = m_all_items[id];
         // Ignore items that have been collected or are not available atm
-        if ((!*i) || !(*i)->isAvailable() || (*i)->isUsedUp()) continue;
+        if (!item || !item->isAvailable() || item->isUsedUp()) continue;
 
         // Shielded karts can simply drive over bubble gums without any effect
         if ( kart->isShielded() &&
-             ( (*i)->getType() == ItemState::ITEM_BUBBLEGUM      ||
-               (*i)->getType() == ItemState::ITEM_BUBBLEGUM_NOLOK  ) )
+             ( item->getType() == ItemState::ITEM_BUBBLEGUM      ||
+               item->getType() == ItemState::ITEM_BUBBLEGUM_NOLOK  ) )
         {
             continue;
         }
@@ -420,11 +478,11 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
 
         // To allow inlining and avoid including kart.hpp in item.hpp,
         // we pass the kart and the position separately.
-        if((*i)->hitKart(kart->getXYZ(), kart))
+        if(item->hitKart(kart->getXYZ(), kart))
         {
-            collectedItem(*i, kart);
+            collectedItem(item, kart);
         }   // if hit
-    }   // for m_all_items
+    }   // for m_items_near_kart
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -529,6 +587,7 @@ void ItemManager::deleteItem(ItemState *item)
 {
     // First check if the item needs to be removed from the items-in-quad list
     deleteItemInQuad(item);
+    deleteItemInGrid(item);
     int index = item->getItemId();
     m_all_items[index] = NULL;
     delete item;
@@ -553,6 +612,21 @@ void ItemManager::deleteItemInQuad(ItemState* item)
     }   // if m_items_in_quads
 }   // deleteItemInQuad
 
+//-----------------------------------------------------------------------------
+/** Removes an item from the item grid only.
+ *  \param The item to delete.
+ */
+void ItemManager::deleteItemInGrid(ItemState* item)
+{
+    const unsigned int id = item->getItemId();
+    assert(id < m_item_cell.size());
+    std::vector<unsigned int> &items = m_items_in_cells[m_item_cell[id]];
+    std::vector<unsigned int>::iterator it =
+        std::find(items.begin(), items.end(), id);
+    assert(it != items.end());
+    items.erase(it);
+}   // deleteItemInGrid
+
 //-----------------------------------------------------------------------------
 /** Switches all items: boxes become bananas and vice versa for a certain
  *  amount of time (as defined in stk_config.xml).
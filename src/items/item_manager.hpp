@@ -35,6 +35,7 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Kart;
@@ -113,6 +114,17 @@ private:
      *  field is undefined if no Graph exist, e.g. arena without navmesh. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** The ids of the items in each cell of a uniform grid in X and Z, used
+     *  to only test the items near a kart in checkItemHit. The key contains
+     *  both cell indices, see getCellKey(). */
+    std::unordered_map<uint64_t, std::vector<unsigned int> > m_items_in_cells;
+
+    /** The key of the cell each item is stored in, indexed by item id. */
+    std::vector<uint64_t> m_item_cell;
+
+    /** Used in checkItemHit to collect the ids of the items near a kart. */
+    std::vector<unsigned int> m_items_near_kart;
+
     /** Stores all item models. */
     static std::vector<scene::IMesh *> m_item_mesh;
 
@@ -122,6 +134,8 @@ private:
     /** Stores all item models. */
     static std::vector<std::string> m_icon;
 
+    static uint64_t getCellKey(int x, int z);
+
 protected:
     /** Remaining time that items should remain switched. If the
      *  value is <0, it indicates that the items are not switched atm. */
@@ -132,6 +146,8 @@ protected:
     void setSwitchItems(const std::vector<int> &switch_items);
     void insertItemInQuad(Item *item);
     void deleteItemInQuad(ItemState *item);
+    void insertItemInGrid(Item *item);
+    void deleteItemInGrid(ItemState *item);
 public:
              ItemManager();
     virtual ~ItemManager();
@@ -20,6 +20,7 @@
 
 #include "karts/abstract_kart.hpp"
 #include "modes/world.hpp"
+#include "network/bit_packing.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
 #include "network/protocols/game_protocol.hpp"
@@ -219,29 +220,35 @@ void NetworkItemManager::setItemConfirmationTime(std::weak_ptr<STKPeer> peer,
  *  to save the initial state, which is the first confirmed state by all
  *  clients.
  */
-BareNetworkString* NetworkItemManager::saveState(std::vector<std::string>* ru)
+bool NetworkItemManager::saveState(BareNetworkString* buffer,
+                                   std::vector<uint16_t>* ru)
 {
-    ru->push_back(getUniqueIdentity());
+    ru->push_back(getRewinderID());
     // On the server:
     // ==============
+    // An empty state (no events) takes no space at all, otherwise the
+    // number of events is followed by the bit packed events (if all peers
+    // in game support them).
+    const int state_ticks = World::getWorld()->getTicksSinceStart();
     m_item_events.lock();
-    uint16_t n = (uint16_t)m_item_events.getData().size();
-    if(n==0)
+    if (!NetworkConfig::get()->useBitPackedState())
     {
-        BareNetworkString *s = new BareNetworkString();
-        m_item_events.unlock();
-        return s;
+        for (auto& p : m_item_events.getData())
+        {
+            p.saveState(buffer);
+        }
     }
-
-    BareNetworkString *s =
-        new BareNetworkString(n * (  sizeof(int) + sizeof(uint16_t)
-                                   + sizeof(uint8_t)              ) );
-    for (auto p : m_item_events.getData())
+    else if (!m_item_events.getData().empty())
     {
-        p.saveState(s);
+        BitWriter bw(buffer);
+        bw.addVarUInt((uint32_t)m_item_events.getData().size());
+        for (auto& p : m_item_events.getData())
+        {
+            p.saveState(&bw, state_ticks);
+        }
     }
     m_item_events.unlock();
-    return s;
+    return true;
 }   // saveState
 
 //-----------------------------------------------------------------------------
@@ -353,15 +360,20 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
     int rewind_to_time = world->getTicksSinceStart();   // Save time we rewind to
     world->setTicksForRewind(current_time);
     bool has_state     = count > 0;
+    // Byte aligned events are read until 'count' bytes are used
+    const bool bit_packed = NetworkConfig::get()->useBitPackedState();
+    BitReader br(buffer);
+    unsigned event_count = has_state && bit_packed ? br.getVarUInt() : 0;
 
     // Note that the actual ItemManager states must NOT be changed here, only
     // the confirmed states in the Network manager are allowed to be modified.
     // They will all be copied to the ItemManager states after the loop.
-    while(count > 0)
+    for (unsigned i = 0; bit_packed ? i < event_count : count > 0; i++)
     {
         // 1.1) Decode the event in the message
         // ------------------------------------
-        ItemEventInfo iei(buffer, &count);
+        ItemEventInfo iei = bit_packed ?
+            ItemEventInfo(&br, rewind_to_time) : ItemEventInfo(buffer, &count);
         if(m_network_item_debugging)
             Log::info("NIM", "Rewindto %d current %d iei.index %d iei tick %d iei.coll %d iei.new %d iei.ttr %d confirmed %lx",
                       rewind_to_time, current_time,
@@ -445,7 +457,7 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
                        iei.getTicks());
         }
         current_time = iei.getTicks();
-    }   // while count >0
+    }   // for each event
 
 
     // 2. Update Server 
@@ -484,7 +496,11 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
         // ... will be copied from item state to item
         if (is && item)
         {
+            // The confirmed item can be at another position, e.g. if
+            // another bubble gum was predicted on the client
+            deleteItemInGrid(item);
             *(ItemState*)item = *is;
+            insertItemInGrid(dynamic_cast<Item*>(item));
         }
         else if (is && !item)
         {
@@ -497,10 +513,12 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
             *((ItemState*)item_new) = *is;
             m_all_items[i] = item_new;
             insertItemInQuad(item_new);
+            insertItemInGrid(item_new);
         }
         else if (!is && item)
         {
             deleteItemInQuad(item);
+            deleteItemInGrid(item);
             delete item;
             m_all_items[i] = NULL;
         }
@@ -29,6 +29,8 @@
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
 #include "karts/kart_properties.hpp"
+#include "network/bit_packing.hpp"
+#include "network/network_config.hpp"
 #include "network/network_string.hpp"
 #include "physics/physical_object.hpp"
 #include "physics/physics.hpp"
@@ -254,25 +256,39 @@ void Plunger::hitTrack()
 }   // hitTrack
 
 // ----------------------------------------------------------------------------
-BareNetworkString* Plunger::saveState(std::vector<std::string>* ru)
+bool Plunger::saveState(BareNetworkString* buffer,
+                        std::vector<uint16_t>* ru)
 {
-    BareNetworkString* buffer = Flyable::saveState(ru);
-    if (!buffer)
-        return NULL;
+    if (!Flyable::saveState(buffer, ru))
+        return false;
 
-    buffer->addUInt16(m_keep_alive);
+    if (!NetworkConfig::get()->useBitPackedState())
+    {
+        buffer->addUInt16(m_keep_alive);
+        if (m_rubber_band)
+            buffer->addUInt8(m_rubber_band->get8BitState());
+        else
+            buffer->addUInt8(255);
+        return true;
+    }
+    BitWriter bw(buffer);
+    bw.addVarInt(m_keep_alive);
+    bw.addBool(m_rubber_band != NULL);
     if (m_rubber_band)
-        buffer->addUInt8(m_rubber_band->get8BitState());
-    else
-        buffer->addUInt8(255);
-    return buffer;
+        bw.addBits(m_rubber_band->get8BitState(), 8);
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
 void Plunger::restoreState(BareNetworkString *buffer, int count)
 {
     Flyable::restoreState(buffer, count);
-    m_keep_alive = buffer->getUInt16();
+    const bool bit_packed = NetworkConfig::get()->useBitPackedState();
+    BitReader br(buffer);
+    if (bit_packed)
+        m_keep_alive = (int16_t)br.getVarInt();
+    else
+        m_keep_alive = buffer->getUInt16();
     // Restore position base on m_keep_alive in Plunger::hit
     if (m_keep_alive == -1)
         m_moved_to_infinity = false;
@@ -282,7 +298,11 @@ void Plunger::restoreState(BareNetworkString *buffer, int count)
         m_moved_to_infinity = true;
     }
 
-    uint8_t bit_state = buffer->getUInt8();
+    uint8_t bit_state = 255;
+    if (!bit_packed)
+        bit_state = buffer->getUInt8();
+    else if (br.getBool())
+        bit_state = (uint8_t)br.getBits(8);
     if (bit_state == 255 && m_rubber_band)
     {
         delete m_rubber_band;
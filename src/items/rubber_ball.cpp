@@ -28,6 +28,8 @@
 #include "karts/abstract_kart.hpp"
 #include "karts/kart_properties.hpp"
 #include "modes/linear_world.hpp"
+#include "network/bit_packing.hpp"
+#include "network/network_config.hpp"
 #include "network/network_string.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
@@ -884,30 +886,57 @@ bool RubberBall::hit(AbstractKart* kart, PhysicalObject* object)
 }   // hit
 
 // ----------------------------------------------------------------------------
-BareNetworkString* RubberBall::saveState(std::vector<std::string>* ru)
+bool RubberBall::saveState(BareNetworkString* buffer,
+                           std::vector<uint16_t>* ru)
 {
-    BareNetworkString* buffer = Flyable::saveState(ru);
-    if (!buffer)
-        return NULL;
-
-    buffer->addUInt16((int16_t)m_last_aimed_graph_node);
-    buffer->add(m_control_points[0]);
-    buffer->add(m_control_points[1]);
-    buffer->add(m_control_points[2]);
-    buffer->add(m_control_points[3]);
-    buffer->add(m_previous_xyz);
-    buffer->addFloat(m_previous_height);
-    buffer->addFloat(m_length_cp_1_2);
-    buffer->addFloat(m_length_cp_2_3);
-    buffer->addFloat(m_t);
-    buffer->addFloat(m_t_increase);
-    buffer->addFloat(m_interval);
-    buffer->addFloat(m_height_timer);
-    buffer->addUInt16(m_delete_ticks);
-    buffer->addFloat(m_current_max_height);
-    buffer->addUInt8(m_tunnel_count | (m_aiming_at_target ? (1 << 7) : 0));
-    TrackSector::saveState(buffer);
-    return buffer;
+    if (!Flyable::saveState(buffer, ru))
+        return false;
+
+    if (!NetworkConfig::get()->useBitPackedState())
+    {
+        buffer->addUInt16((int16_t)m_last_aimed_graph_node);
+        buffer->add(m_control_points[0]);
+        buffer->add(m_control_points[1]);
+        buffer->add(m_control_points[2]);
+        buffer->add(m_control_points[3]);
+        buffer->add(m_previous_xyz);
+        buffer->addFloat(m_previous_height);
+        buffer->addFloat(m_length_cp_1_2);
+        buffer->addFloat(m_length_cp_2_3);
+        buffer->addFloat(m_t);
+        buffer->addFloat(m_t_increase);
+        buffer->addFloat(m_interval);
+        buffer->addFloat(m_height_timer);
+        buffer->addUInt16(m_delete_ticks);
+        buffer->addFloat(m_current_max_height);
+        buffer->addUInt8(m_tunnel_count | (m_aiming_at_target ? (1 << 7) : 0));
+        TrackSector::saveState(buffer);
+        return true;
+    }
+
+    // Use the rounded positions locally too, like the physical body
+    for (unsigned i = 0; i < 4; i++)
+        m_control_points[i] = BitWriter::roundPosition(m_control_points[i]);
+    m_previous_xyz = BitWriter::roundPosition(m_previous_xyz);
+
+    BitWriter bw(buffer);
+    bw.addVarInt(m_last_aimed_graph_node);
+    for (unsigned i = 0; i < 4; i++)
+        bw.addPosition(m_control_points[i]);
+    bw.addPosition(m_previous_xyz);
+    bw.addFloat(m_previous_height);
+    bw.addFloat(m_length_cp_1_2);
+    bw.addFloat(m_length_cp_2_3);
+    bw.addFloat(m_t);
+    bw.addFloat(m_t_increase);
+    bw.addFloat(m_interval);
+    bw.addFloat(m_height_timer);
+    bw.addVarInt(m_delete_ticks);
+    bw.addFloat(m_current_max_height);
+    bw.addBits(m_tunnel_count, 7);
+    bw.addBool(m_aiming_at_target);
+    TrackSector::saveState(&bw);
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -915,26 +944,47 @@ void RubberBall::restoreState(BareNetworkString *buffer, int count)
 {
     Flyable::restoreState(buffer, count);
     m_restoring_state = true;
-    int16_t last_aimed_graph_node = buffer->getUInt16();
-    m_last_aimed_graph_node = last_aimed_graph_node;
-    m_control_points[0] = buffer->getVec3();
-    m_control_points[1] = buffer->getVec3();
-    m_control_points[2] = buffer->getVec3();
-    m_control_points[3] = buffer->getVec3();
-    m_previous_xyz = buffer->getVec3();
-    m_previous_height = buffer->getFloat();
-    m_length_cp_1_2 = buffer->getFloat();
-    m_length_cp_2_3 = buffer->getFloat();
-    m_t = buffer->getFloat();
-    m_t_increase = buffer->getFloat();
-    m_interval = buffer->getFloat();
-    m_height_timer = buffer->getFloat();
-    m_delete_ticks = buffer->getUInt16();
-    m_current_max_height = buffer->getFloat();
-    uint8_t tunnel_and_aiming = buffer->getUInt8();
-    m_tunnel_count = tunnel_and_aiming & 127;
-    m_aiming_at_target = ((tunnel_and_aiming >> 7) & 1) == 1;
-    TrackSector::rewindTo(buffer);
+    if (!NetworkConfig::get()->useBitPackedState())
+    {
+        int16_t last_aimed_graph_node = buffer->getUInt16();
+        m_last_aimed_graph_node = last_aimed_graph_node;
+        m_control_points[0] = buffer->getVec3();
+        m_control_points[1] = buffer->getVec3();
+        m_control_points[2] = buffer->getVec3();
+        m_control_points[3] = buffer->getVec3();
+        m_previous_xyz = buffer->getVec3();
+        m_previous_height = buffer->getFloat();
+        m_length_cp_1_2 = buffer->getFloat();
+        m_length_cp_2_3 = buffer->getFloat();
+        m_t = buffer->getFloat();
+        m_t_increase = buffer->getFloat();
+        m_interval = buffer->getFloat();
+        m_height_timer = buffer->getFloat();
+        m_delete_ticks = buffer->getUInt16();
+        m_current_max_height = buffer->getFloat();
+        uint8_t tunnel_and_aiming = buffer->getUInt8();
+        m_tunnel_count = tunnel_and_aiming & 127;
+        m_aiming_at_target = ((tunnel_and_aiming >> 7) & 1) == 1;
+        TrackSector::rewindTo(buffer);
+        return;
+    }
+    BitReader br(buffer);
+    m_last_aimed_graph_node = br.getVarInt();
+    for (unsigned i = 0; i < 4; i++)
+        m_control_points[i] = br.getPosition();
+    m_previous_xyz = br.getPosition();
+    m_previous_height = br.getFloat();
+    m_length_cp_1_2 = br.getFloat();
+    m_length_cp_2_3 = br.getFloat();
+    m_t = br.getFloat();
+    m_t_increase = br.getFloat();
+    m_interval = br.getFloat();
+    m_height_timer = br.getFloat();
+    m_delete_ticks = (int16_t)br.getVarInt();
+    m_current_max_height = br.getFloat();
+    m_tunnel_count = (uint8_t)br.getBits(7);
+    m_aiming_at_target = br.getBool();
+    TrackSector::rewindTo(&br);
 }   // restoreState
 
 // ----------------------------------------------------------------------------
@@ -62,6 +62,12 @@ public:
     virtual      ~Controller         () {};
     virtual void  reset              () = 0;
     virtual void  update             (int ticks) = 0;
+    /** Called for all karts before any kart is updated in a time step, and
+     *  for different karts at the same time in the threads of the JobSystem.
+     *  It can precompute the read-only part of the decisions made in update
+     *  from the state at the start of the time step: it must not change
+     *  anything but the data of this controller. */
+    virtual void  prepareUpdate      (int ticks) {}
     virtual void  handleZipper       (bool play_sound) = 0;
     virtual void  collectedItem      (const ItemState &item,
                                       float previous_energy=0) = 0;
@@ -179,6 +179,9 @@ void SkiddingAI::reset()
     m_skid_probability_state     = SKID_PROBAB_NOT_YET;
     m_last_item_random           = NULL;
     m_burster                    = false;
+    m_update_prepared            = false;
+    m_aim_point                  = Vec3(0,0,0);
+    m_aim_last_node              = Graph::UNKNOWN_SECTOR;
 
     AIBaseLapController::reset();
     m_track_node               = Graph::UNKNOWN_SECTOR;
@@ -217,6 +220,43 @@ unsigned int SkiddingAI::getNextSector(unsigned int index)
     return m_successor_index[index];
 }   // getNextSector
 
+//-----------------------------------------------------------------------------
+/** Computes the data update() bases its decisions on, which only depends on
+ *  the current state of the world: the nearest karts, the crashes ahead,
+ *  the direction of the track and the point to aim at. It only changes
+ *  members of this AI, so it can run in parallel for all AIs.
+ */
+void SkiddingAI::computeDecisionData()
+{
+    computeNearestKarts();
+    //Detect if we are going to crash with the track and/or kart
+    checkCrashes(m_kart->getXYZ());
+    determineTrackDirection();
+
+    m_aim_last_node = Graph::UNKNOWN_SECTOR;
+    switch(m_point_selection_algorithm)
+    {
+    case PSA_NEW:    findNonCrashingPointNew(&m_aim_point, &m_aim_last_node);
+                     break;
+    case PSA_DEFAULT:findNonCrashingPoint(&m_aim_point, &m_aim_last_node);
+                     break;
+    }
+}   // computeDecisionData
+
+//-----------------------------------------------------------------------------
+/** Computes the decision data of the next update from the state at the
+ *  start of the time step (see Controller::prepareUpdate). Nothing is
+ *  computed if update will not use it.
+ */
+void SkiddingAI::prepareUpdate(int ticks)
+{
+    m_update_prepared = false;
+    if (m_kart->getKartAnimation() || isStuck() || m_world->isStartPhase())
+        return;
+    computeDecisionData();
+    m_update_prepared = true;
+}   // prepareUpdate
+
 //-----------------------------------------------------------------------------
 /** This is the main entry point for the AI.
  *  It is called once per frame for each AI and determines the behaviour of
@@ -225,6 +265,9 @@ unsigned int SkiddingAI::getNextSector(unsigned int index)
 void SkiddingAI::update(int ticks)
 {
     float dt = stk_config->ticks2Time(ticks);
+    // Only use data prepared for this time step
+    const bool prepared = m_update_prepared;
+    m_update_prepared = false;
 
     // Clear stored items if they were deleted (for example a switched nitro)
     if (m_item_to_collect &&
@@ -324,8 +367,10 @@ void SkiddingAI::update(int ticks)
         return;
     }
 
-    // Get information that is needed by more than 1 of the handling funcs
-    computeNearestKarts();
+    // Get information that is needed by more than 1 of the handling funcs,
+    // unless it was already computed in prepareUpdate
+    if (!prepared)
+        computeDecisionData();
 
     if (!m_enabled_network_ai)
     {
@@ -340,10 +385,6 @@ void SkiddingAI::update(int ticks)
             speed_cap, /*fade_in_time*/0);
     }
 
-    //Detect if we are going to crash with the track and/or kart
-    checkCrashes(m_kart->getXYZ());
-    determineTrackDirection();
-
     /*Response handling functions*/
     handleAccelerationAndBraking(ticks);
     handleSteering(dt);
@@ -466,16 +507,9 @@ void SkiddingAI::handleSteering(float dt)
     else
     {
         m_start_kart_crash_direction = 0;
-        Vec3 aim_point;
-        int last_node = Graph::UNKNOWN_SECTOR;
-
-        switch(m_point_selection_algorithm)
-        {
-        case PSA_NEW:    findNonCrashingPointNew(&aim_point, &last_node);
-                         break;
-        case PSA_DEFAULT:findNonCrashingPoint(&aim_point, &last_node);
-                         break;
-        }
+        // Found in computeDecisionData
+        Vec3 aim_point = m_aim_point;
+        int last_node = m_aim_last_node;
 #ifdef AI_DEBUG
         m_debug_sphere[m_point_selection_algorithm]->setPosition(aim_point.toIrrVector());
 #endif
@@ -68,7 +68,9 @@ namespace irr
 
 The main entry point, called once per frame for each AI, is update().
 After handling some standard cases (race start, AI being rescued)
-the AI does the following steps:
+the AI does the following steps (the computations which only read the
+world, up to finding the point to aim at, are done in prepareUpdate()
+before the karts are updated if it's called, see computeDecisionData()):
 - compute nearest karts (one ahead and one behind)
 - check if the kart is about to crash with another kart or the
   track. This is done by simply testing a certain number of timesteps
@@ -236,6 +238,15 @@ private:
           m_point_selection_algorithm;
 
     ItemManager* m_item_manager;
+
+    /** True if prepareUpdate computed the nearest karts, the crashes, the
+     *  track direction and the point to aim at for the next update. */
+    bool m_update_prepared;
+
+    /** The point to aim at found by findNonCrashingPoint, and the graph
+     *  node it is on. */
+    Vec3 m_aim_point;
+    int  m_aim_last_node;
 #ifdef AI_DEBUG
     /** For skidding debugging: shows the estimated turn shape. */
     ShowCurve **m_curve;
@@ -291,6 +302,7 @@ private:
     void  findNonCrashingPoint(Vec3 *result, int *last_node);
 
     void  determineTrackDirection();
+    void  computeDecisionData();
     virtual bool canSkid(float steer_fraction);
     virtual void setSteering(float angle, float dt);
     void handleCurve();
@@ -302,6 +314,7 @@ public:
                  SkiddingAI(AbstractKart *kart);
                 ~SkiddingAI();
     virtual void update      (int ticks);
+    virtual void prepareUpdate(int ticks);
     virtual void reset       ();
     virtual const irr::core::stringw& getNamePostfix() const;
 };
@@ -31,7 +31,9 @@
 #include "karts/max_speed.hpp"
 #include "karts/skidding.hpp"
 #include "modes/world.hpp"
+#include "network/bit_packing.hpp"
 #include "network/compress_network_body.hpp"
+#include "network/network_config.hpp"
 #include "network/protocols/client_lobby.hpp"
 #include "network/rewind_manager.hpp"
 #include "network/network_string.hpp"
@@ -162,15 +164,13 @@ void KartRewinder::computeError()
  *  \param[out] ru The unique identity of rewinder writing to.
  *  \return The address of the memory buffer with the state.
  */
-BareNetworkString* KartRewinder::saveState(std::vector<std::string>* ru)
+bool KartRewinder::saveState(BareNetworkString* buffer,
+                             std::vector<uint16_t>* ru)
 {
     if (m_eliminated)
-        return nullptr;
-
-    ru->push_back(getUniqueIdentity());
-    const int MEMSIZE = 17*sizeof(float) + 9+3;
+        return false;
 
-    BareNetworkString *buffer = new BareNetworkString(MEMSIZE);
+    ru->push_back(getRewinderID());
 
     // 1) Steering and other player controls
     // -------------------------------------
@@ -178,73 +178,106 @@ BareNetworkString* KartRewinder::saveState(std::vector<std::string>* ru)
     bool sign_neg = getController()->saveState(buffer);
 
     // 2) Boolean handling to determine if need saving
+    // -----------
+    // Sections 2) and 3) are bit packed if all peers in game support it,
+    // the rest uses the byte aligned saveState functions of the kart
+    // components.
     const bool has_animation = m_kart_animation != NULL;
-    uint8_t bool_for_each_data = 0;
-    if (m_fire_clicked)
-        bool_for_each_data |= 1;
-    if (m_bubblegum_ticks > 0)
-        bool_for_each_data |= (1 << 1);
-    if (m_view_blocked_by_plunger > 0)
-        bool_for_each_data |= (1 << 2);
-    if (m_invulnerable_ticks > 0)
-        bool_for_each_data |= (1 << 3);
-    if (getEnergy() > 0.0f)
-        bool_for_each_data |= (1 << 4);
-    if (has_animation)
-        bool_for_each_data |= (1 << 5);
-    if (m_vehicle->getTimedRotationTicks() > 0)
-        bool_for_each_data |= (1 << 6);
-    if (m_vehicle->getCentralImpulseTicks() > 0)
-        bool_for_each_data |= (1 << 7);
-    buffer->addUInt8(bool_for_each_data);
-
-    uint8_t bool_for_each_data_2 = 0;
-    if (sign_neg)
-        bool_for_each_data_2 |= 1;
-    if (m_bounce_back_ticks > 0)
-        bool_for_each_data_2 |= (1 << 1);
-    if (getAttachment()->getType() != Attachment::ATTACH_NOTHING)
-        bool_for_each_data_2 |= (1 << 2);
-    if (getPowerup()->getType() != PowerupManager::POWERUP_NOTHING)
-        bool_for_each_data_2 |= (1 << 3);
-    if (m_bubblegum_torque_sign)
-        bool_for_each_data_2 |= (1 << 4);
-    buffer->addUInt8(bool_for_each_data_2);
-
-    if (m_bubblegum_ticks > 0)
-        buffer->addUInt16(m_bubblegum_ticks);
-    if (m_view_blocked_by_plunger > 0)
-        buffer->addUInt16(m_view_blocked_by_plunger);
-    if (m_invulnerable_ticks > 0)
-        buffer->addUInt16(m_invulnerable_ticks);
-    if (getEnergy() > 0.0f)
-        buffer->addFloat(getEnergy());
-
-    // 3) Kart animation status or physics values (transform and velocities)
-    // -------------------------------------------
-    if (has_animation)
+    BitWriter bw(buffer);
+    bw.addBool(m_fire_clicked);
+    bw.addBool(m_bubblegum_ticks > 0);
+    bw.addBool(m_view_blocked_by_plunger > 0);
+    bw.addBool(m_invulnerable_ticks > 0);
+    bw.addBool(getEnergy() > 0.0f);
+    bw.addBool(has_animation);
+    bw.addBool(m_vehicle->getTimedRotationTicks() > 0);
+    bw.addBool(m_vehicle->getCentralImpulseTicks() > 0);
+    bw.addBool(sign_neg);
+    bw.addBool(m_bounce_back_ticks > 0);
+    bw.addBool(getAttachment()->getType() != Attachment::ATTACH_NOTHING);
+    bw.addBool(getPowerup()->getType() != PowerupManager::POWERUP_NOTHING);
+    bw.addBool(m_bubblegum_torque_sign);
+
+    if (!NetworkConfig::get()->useBitPackedState())
     {
-        buffer->addUInt8(m_kart_animation->getAnimationType());
-        m_kart_animation->saveState(buffer);
+        // Byte aligned format for old clients, in which the flags fill two
+        // bytes
+        bw.flush();
+        if (m_bubblegum_ticks > 0)
+            buffer->addUInt16(m_bubblegum_ticks);
+        if (m_view_blocked_by_plunger > 0)
+            buffer->addUInt16(m_view_blocked_by_plunger);
+        if (m_invulnerable_ticks > 0)
+            buffer->addUInt16(m_invulnerable_ticks);
+        if (getEnergy() > 0.0f)
+            buffer->addFloat(getEnergy());
+
+        if (has_animation)
+        {
+            buffer->addUInt8(m_kart_animation->getAnimationType());
+            m_kart_animation->saveState(buffer);
+        }
+        else
+        {
+            CompressNetworkBody::compress(
+                m_body.get(), m_motion_state.get(), buffer);
+            if (m_vehicle->getTimedRotationTicks() > 0)
+            {
+                buffer->addUInt16(m_vehicle->getTimedRotationTicks());
+                buffer->addFloat(m_vehicle->getTimedRotation());
+            }
+            if (m_bounce_back_ticks > 0)
+                buffer->addUInt8(m_bounce_back_ticks);
+            if (m_vehicle->getCentralImpulseTicks() > 0)
+            {
+                buffer->addUInt16(m_vehicle->getCentralImpulseTicks());
+                buffer->add(m_vehicle->getAdditionalImpulse());
+            }
+        }
     }
     else
     {
-        CompressNetworkBody::compress(
-            m_body.get(), m_motion_state.get(), buffer);
-
-        if (m_vehicle->getTimedRotationTicks() > 0)
+        if (m_bubblegum_ticks > 0)
+            bw.addVarUInt(m_bubblegum_ticks);
+        if (m_view_blocked_by_plunger > 0)
+            bw.addVarUInt(m_view_blocked_by_plunger);
+        if (m_invulnerable_ticks > 0)
+            bw.addVarUInt(m_invulnerable_ticks);
+        if (getEnergy() > 0.0f)
+            bw.addFloat(getEnergy());
+
+        // 3) Kart animation status or physics values (transform and
+        //    velocities)
+        // -------------------------------------------
+        if (has_animation)
         {
-            buffer->addUInt16(m_vehicle->getTimedRotationTicks());
-            buffer->addFloat(m_vehicle->getTimedRotation());
+            bw.addBits(m_kart_animation->getAnimationType(), 2);
+            bw.flush();
+            m_kart_animation->saveState(buffer);
         }
-
-        // For collision rewind
-        if (m_bounce_back_ticks > 0)
-            buffer->addUInt8(m_bounce_back_ticks);
-        if (m_vehicle->getCentralImpulseTicks() > 0)
+        else
         {
-            buffer->addUInt16(m_vehicle->getCentralImpulseTicks());
-            buffer->add(m_vehicle->getAdditionalImpulse());
+            CompressNetworkBody::compress(
+                m_body.get(), m_motion_state.get(), &bw);
+
+            if (m_vehicle->getTimedRotationTicks() > 0)
+            {
+                bw.addVarUInt(m_vehicle->getTimedRotationTicks());
+                bw.addFloat(m_vehicle->getTimedRotation());
+            }
+
+            // For collision rewind
+            if (m_bounce_back_ticks > 0)
+                bw.addVarUInt(m_bounce_back_ticks);
+            if (m_vehicle->getCentralImpulseTicks() > 0)
+            {
+                bw.addVarUInt(m_vehicle->getCentralImpulseTicks());
+                const Vec3& impulse = m_vehicle->getAdditionalImpulse();
+                bw.addFloat(impulse.getX());
+                bw.addFloat(impulse.getY());
+                bw.addFloat(impulse.getZ());
+            }
+            bw.flush();
         }
     }
 
@@ -263,7 +296,7 @@ BareNetworkString* KartRewinder::saveState(std::vector<std::string>* ru)
     // -----------
     m_skidding->saveState(buffer);
 
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -283,47 +316,59 @@ void KartRewinder::restoreState(BareNetworkString *buffer, int count)
 
     // 2) Boolean handling to determine if need saving
     // -----------
-    uint8_t bool_for_each_data = buffer->getUInt8();
-    m_fire_clicked = (bool_for_each_data & 1) == 1;
-    bool read_bubblegum = ((bool_for_each_data >> 1) & 1) == 1;
-    bool read_plunger = ((bool_for_each_data >> 2) & 1) == 1;
-    bool read_invulnerable = ((bool_for_each_data >> 3) & 1) == 1;
-    bool read_energy =  ((bool_for_each_data >> 4) & 1) == 1;
-    bool has_animation_in_state = ((bool_for_each_data >> 5) & 1) == 1;
-    bool read_timed_rotation =  ((bool_for_each_data >> 6) & 1) == 1;
-    bool read_impulse = ((bool_for_each_data >> 7) & 1) == 1;
-
-    uint8_t bool_for_each_data_2 = buffer->getUInt8();
-    bool controller_steer_sign = (bool_for_each_data_2 & 1) == 1;
+    // The flags are the same bits in both formats, the byte aligned format
+    // pads them to two bytes
+    const bool bit_packed = NetworkConfig::get()->useBitPackedState();
+    BitReader br(buffer);
+    m_fire_clicked = br.getBool();
+    bool read_bubblegum = br.getBool();
+    bool read_plunger = br.getBool();
+    bool read_invulnerable = br.getBool();
+    bool read_energy = br.getBool();
+    bool has_animation_in_state = br.getBool();
+    bool read_timed_rotation = br.getBool();
+    bool read_impulse = br.getBool();
+    bool controller_steer_sign = br.getBool();
     if (controller_steer_sign)
     {
         PlayerController* pc = dynamic_cast<PlayerController*>(m_controller);
         if (pc)
             pc->m_steer_val = pc->m_steer_val * -1;
     }
-    bool read_bounce_back = ((bool_for_each_data_2 >> 1) & 1) == 1;
-    bool read_attachment = ((bool_for_each_data_2 >> 2) & 1) == 1;
-    bool read_powerup = ((bool_for_each_data_2 >> 3) & 1) == 1;
-    m_bubblegum_torque_sign = ((bool_for_each_data_2 >> 4) & 1) == 1;
+    bool read_bounce_back = br.getBool();
+    bool read_attachment = br.getBool();
+    bool read_powerup = br.getBool();
+    m_bubblegum_torque_sign = br.getBool();
+    if (!bit_packed)
+        br.align();
 
     if (read_bubblegum)
-        m_bubblegum_ticks = buffer->getUInt16();
+    {
+        m_bubblegum_ticks = bit_packed ?
+            (int16_t)br.getVarUInt() : buffer->getUInt16();
+    }
     else
         m_bubblegum_ticks = 0;
 
     if (read_plunger)
-        m_view_blocked_by_plunger = buffer->getUInt16();
+    {
+        m_view_blocked_by_plunger = bit_packed ?
+            (int16_t)br.getVarUInt() : buffer->getUInt16();
+    }
     else
         m_view_blocked_by_plunger = 0;
 
     if (read_invulnerable)
-        m_invulnerable_ticks = buffer->getUInt16();
+    {
+        m_invulnerable_ticks = bit_packed ?
+            (int16_t)br.getVarUInt() : buffer->getUInt16();
+    }
     else
         m_invulnerable_ticks = 0;
 
     if (read_energy)
     {
-        float nitro = buffer->getFloat();
+        float nitro = bit_packed ? br.getFloat() : buffer->getFloat();
         setEnergy(nitro);
     }
     else
@@ -333,7 +378,9 @@ void KartRewinder::restoreState(BareNetworkString *buffer, int count)
     // -----------
     if (has_animation_in_state)
     {
-        KartAnimationType kat = (KartAnimationType)(buffer->getUInt8());
+        KartAnimationType kat = (KartAnimationType)(bit_packed ?
+            br.getBits(2) : buffer->getUInt8());
+        br.align();
         if (!m_kart_animation ||
             m_kart_animation->getAnimationType() != kat)
         {
@@ -376,16 +423,26 @@ void KartRewinder::restoreState(BareNetworkString *buffer, int count)
 
         // Clear any forces applied (like by plunger or bubble gum torque)
         m_body->clearForces();
-        CompressNetworkBody::decompress(
-            buffer, m_body.get(), m_motion_state.get());
+        if (bit_packed)
+        {
+            CompressNetworkBody::decompress(
+                &br, m_body.get(), m_motion_state.get());
+        }
+        else
+        {
+            CompressNetworkBody::decompress(
+                buffer, m_body.get(), m_motion_state.get());
+        }
         // Update kart transform in case that there are access to its value
         // before Moveable::update() is called (which updates the transform)
         m_transform = m_body->getWorldTransform();
 
         if (read_timed_rotation)
         {
-            uint16_t time_rot = buffer->getUInt16();
-            float timed_rotation_y = buffer->getFloat();
+            uint16_t time_rot = bit_packed ?
+                (uint16_t)br.getVarUInt() : buffer->getUInt16();
+            float timed_rotation_y = bit_packed ?
+                br.getFloat() : buffer->getFloat();
             // Set timed rotation divides by time_rot
             m_vehicle->setTimedRotation(time_rot,
                 stk_config->ticks2Time(time_rot) * timed_rotation_y);
@@ -395,13 +452,26 @@ void KartRewinder::restoreState(BareNetworkString *buffer, int count)
 
         // Collision rewind
         if (read_bounce_back)
-            m_bounce_back_ticks = buffer->getUInt8();
+        {
+            m_bounce_back_ticks = bit_packed ?
+                (uint8_t)br.getVarUInt() : buffer->getUInt8();
+        }
         else
             m_bounce_back_ticks = 0;
         if (read_impulse)
         {
-            uint16_t central_impulse_ticks = buffer->getUInt16();
-            Vec3 additional_impulse = buffer->getVec3();
+            uint16_t central_impulse_ticks = bit_packed ?
+                (uint16_t)br.getVarUInt() : buffer->getUInt16();
+            Vec3 additional_impulse;
+            if (bit_packed)
+            {
+                float x = br.getFloat();
+                float y = br.getFloat();
+                float z = br.getFloat();
+                additional_impulse = Vec3(x, y, z);
+            }
+            else
+                additional_impulse = buffer->getVec3();
             m_vehicle->setTimedCentralImpulse(central_impulse_ticks,
                 additional_impulse, true/*rewind*/);
         }
@@ -414,6 +484,7 @@ void KartRewinder::restoreState(BareNetworkString *buffer, int count)
         // would still point at the kart position at the previous rewind
         // (i.e. different terrain --> different slowdown).
         m_vehicle->updateAllWheelTransformsWS();
+        br.align();
     }
 
     // 4) Attachment, powerup, nitro
@@ -40,8 +40,8 @@ public:
     ~KartRewinder() {}
     virtual void saveTransform() OVERRIDE;
     virtual void computeError() OVERRIDE;
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<uint16_t>* ru) OVERRIDE;
     void reset() OVERRIDE;
     virtual void restoreState(BareNetworkString *p, int count) OVERRIDE;
     virtual void rewindToEvent(BareNetworkString *p) OVERRIDE {}
@@ -73,7 +73,14 @@ public:
     virtual void undoEvent(BareNetworkString *p) OVERRIDE {}
     // ------------------------------------------------------------------------
     virtual std::function<void()> getLocalStateRestoreFunction() OVERRIDE;
-
+    // ------------------------------------------------------------------------
+    virtual bool isStateComparable() const OVERRIDE             { return true; }
+    // ------------------------------------------------------------------------
+    virtual const Vec3* getRelevancePosition() const OVERRIDE
+                                                        { return &getXYZ(); }
+    // ------------------------------------------------------------------------
+    /** The kart is still in the game, it just keeps its current values. */
+    virtual void restoreSkippedState() OVERRIDE  { m_has_server_state = true; }
 
 };   // Rewinder
 #endif
@@ -247,12 +247,17 @@ extern "C" {
 #include "network/protocols/connect_to_server.hpp"
 #include "network/protocols/client_lobby.hpp"
 #include "network/protocols/server_lobby.hpp"
+#include "network/bit_packing.hpp"
+#include "network/database_connector.hpp"
+#include "network/ip_interval_index.hpp"
 #include "network/network.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
+#include "network/peer_registry.hpp"
 #include "network/protocols/connect_to_server.hpp"
 #include "network/protocols/client_lobby.hpp"
 #include "network/protocols/server_lobby.hpp"
+#include "network/protocols/game_protocol.hpp"
 #include "network/race_event_manager.hpp"
 #include "network/rewind_manager.hpp"
 #include "network/rewind_queue.hpp"
@@ -264,6 +269,8 @@ extern "C" {
 #include "network/stk_peer.hpp"
 #include "online/profile_manager.hpp"
 #include "online/request_manager.hpp"
+#include "physics/bvh_cache.hpp"
+#include "physics/ray_packet.hpp"
 #include "race/grand_prix_manager.hpp"
 #include "race/highscore_manager.hpp"
 #include "race/history.hpp"
@@ -279,17 +286,21 @@ extern "C" {
 #include "states_screens/dialogs/message_dialog.hpp"
 #include "tips/tips_manager.hpp"
 #include "tracks/arena_graph.hpp"
+#include "tracks/quad_grid.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
 #include "utils/constants.hpp"
 #include "utils/crash_reporting.hpp"
+#include "utils/job_system.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/log.hpp"
 #include "mini_glm.hpp"
 #include "utils/profiler.hpp"
+#include "utils/spsc_queue.hpp"
 #include "utils/stk_process.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/tick_scheduler.hpp"
 #include "utils/translation.hpp"
 #include "io/rich_presence.hpp"
 
@@ -616,6 +627,8 @@ void cmdLineHelp()
     "       --trackdir=DIR     A directory from which additional tracks are "
                               "loaded.\n"
     "       --seed=n           Seed for random number generation to provide reproducible behavior.\n"
+    "       --job-threads=n    Number of worker threads updating the AI in parallel, 0 updates\n"
+    "                          everything in the main thread (default: one less than the cores).\n"
     "       --profile-laps=n   Enable automatic driven profile mode for n "
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
@@ -1033,6 +1046,9 @@ int handleCmdLinePreliminary()
         Log::info("main", "STK using random seed (%d)", n);
     }
 
+    if (CommandLine::has("--job-threads", &n))
+        UserConfigParams::m_job_threads = n;
+
     if (CommandLine::has("--disable-addon-karts"))
         UserConfigParams::m_disable_addon_karts = true;
     if (CommandLine::has("--disable-addon-tracks"))
@@ -2244,6 +2260,7 @@ int main(int argc, char *argv[])
         CommandLine::addArgsFromUserConfig();
 
         handleCmdLinePreliminary();
+        JobSystem::create(UserConfigParams::m_job_threads);
 
         // ServerConfig will use stk_config for server version testing
         stk_config->load(file_manager->getAsset("stk_config.xml"));
@@ -2759,6 +2776,7 @@ static void cleanSuperTuxKart()
     if(track_manager)           delete track_manager;
     if(material_manager)        delete material_manager;
     if(history)                 delete history;
+    JobSystem::destroy();
     ReplayPlay::destroy();
     ReplayRecorder::destroy();
     delete ParticleKindManager::get();
@@ -2848,10 +2866,26 @@ void runUnitTests()
     GraphicsRestrictions::unitTesting();
     Log::info("UnitTest", "NetworkString");
     NetworkString::unitTesting();
+    Log::info("UnitTest", "BitWriter");
+    BitWriter::unitTesting();
     Log::info("UnitTest", "SocketAddress");
     SocketAddress::unitTesting();
     Log::info("UnitTest", "StringUtils::versionToInt");
     StringUtils::unitTesting();
+    Log::info("UnitTest", "SPSCQueue");
+    SPSCQueueTest::unitTesting();
+    Log::info("UnitTest", "JobSystem");
+    JobSystemTest::unitTesting();
+    Log::info("UnitTest", "TickScheduler");
+    TickSchedulerTest::unitTesting();
+    Log::info("UnitTest", "IPIntervalIndex");
+    IPIntervalIndexTest::unitTesting();
+    Log::info("UnitTest", "PeerRegistry");
+    PeerRegistryTest::unitTesting();
+#ifdef ENABLE_SQLITE3
+    Log::info("UnitTest", "DatabaseConnector");
+    DatabaseConnector::unitTesting();
+#endif
 
     Log::info("UnitTest", "Easter detection");
     // Test easter mode: in 2015 Easter is 5th of April - check with 0 days
@@ -2893,12 +2927,27 @@ void runUnitTests()
     Log::info("UnitTest", "Arena Graph");
     ArenaGraph::unitTesting();
 
+    Log::info("UnitTest", "QuadGrid");
+    QuadGrid::unitTesting();
+
     Log::info("UnitTest", "Fonts for translation");
     font_manager->unitTesting();
 
+    Log::info("UnitTest", "BvhCache");
+    BvhCache::unitTesting();
+
+    Log::info("UnitTest", "RayPacket");
+    RayPacket::unitTesting();
+
     Log::info("UnitTest", "RewindQueue");
     RewindQueue::unitTesting();
 
+    Log::info("UnitTest", "GameProtocol state delta");
+    GameProtocol::unitTesting();
+
+    Log::info("UnitTest", "History replay with and without job threads");
+    History::unitTesting();
+
     Log::info("UnitTest", "=====================");
     Log::info("UnitTest", "Testing successful   ");
     Log::info("UnitTest", "=====================");
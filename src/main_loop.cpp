@@ -45,6 +45,7 @@
 #include "network/race_event_manager.hpp"
 #include "network/rewind_manager.hpp"
 #include "network/server.hpp"
+#include "network/server_config.hpp"
 #include "network/stk_host.hpp"
 #include "online/request_manager.hpp"
 #include "race/history.hpp"
@@ -55,6 +56,7 @@
 #include "states_screens/state_manager.hpp"
 #include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/tick_scheduler.hpp"
 #include "utils/time.hpp"
 #include "utils/translation.hpp"
 #include "io/rich_presence.hpp"
@@ -109,6 +111,7 @@ MainLoop::MainLoop(unsigned parent_pid, bool download_assets)
     m_allow_large_dt  = false;
     m_frame_before_loading_world = false;
     m_download_assets = download_assets;
+    m_tick_scheduler  = NULL;
 #ifdef WIN32
     if (parent_pid != 0)
     {
@@ -131,6 +134,7 @@ MainLoop::MainLoop(unsigned parent_pid, bool download_assets)
 //-----------------------------------------------------------------------------
 MainLoop::~MainLoop()
 {
+    delete m_tick_scheduler;
 }   // ~MainLoop
 
 #ifdef MOBILE_STK
@@ -457,10 +461,30 @@ void MainLoop::run()
         PROFILER_PUSH_CPU_MARKER("Main loop", 0xFF, 0x00, 0xF7);
         TimePoint frame_start = std::chrono::steady_clock::now();
 
-        left_over_time += getLimitedDt();
-        int num_steps   = stk_config->time2Ticks(left_over_time);
+        // A server without graphics runs its ticks at fixed deadlines, no
+        // frames need to be rendered in between
+        const bool headless_server = GUIEngine::isNoGraphics() &&
+            NetworkConfig::get()->isNetworking() &&
+            NetworkConfig::get()->isServer() &&
+            !ProfileWorld::isProfileMode();
+        int num_steps = 0;
         float dt = stk_config->ticks2Time(1);
-        left_over_time -= num_steps * dt;
+        if (headless_server)
+        {
+            if (!m_tick_scheduler)
+            {
+                m_tick_scheduler = new TickScheduler("MainLoop",
+                    stk_config->getPhysicsFPS());
+                m_tick_scheduler->setFastMode(ServerConfig::m_fast_simulation);
+            }
+            num_steps = m_tick_scheduler->waitForTicks();
+        }
+        else
+        {
+            left_over_time += getLimitedDt();
+            num_steps = stk_config->time2Ticks(left_over_time);
+            left_over_time -= num_steps * dt;
+        }
 
         // Shutdown next frame if shutdown request is sent while loading the
         // world
@@ -708,7 +732,7 @@ void MainLoop::run()
             }
         }
 
-        if (!UserConfigParams::m_benchmark)
+        if (!UserConfigParams::m_benchmark && !headless_server)
         {
             TimePoint frame_end = std::chrono::steady_clock::now();
             double frame_time = convertToTime(frame_end, frame_start) * 0.001;
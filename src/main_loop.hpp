@@ -25,6 +25,8 @@
 #include <atomic>
 #include <chrono>
 
+class TickScheduler;
+
 /** Management class for the whole gameflow, this is where the
     main-loop is */
 class MainLoop
@@ -50,6 +52,10 @@ private:
 
     Synchronised<int> m_ticks_adjustment;
 
+    /** Paces the ticks of a server without graphics, created when the
+     *  server starts. */
+    TickScheduler* m_tick_scheduler;
+
     TimePoint m_curr_time;
     TimePoint m_prev_time;
     unsigned m_parent_pid;
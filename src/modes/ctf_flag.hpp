@@ -89,7 +89,8 @@ public:
     // ------------------------------------------------------------------------
     virtual void computeError() {}
     // ------------------------------------------------------------------------
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru);
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<uint16_t>* ru);
     // ------------------------------------------------------------------------
     virtual void undoEvent(BareNetworkString* buffer) {}
     // ------------------------------------------------------------------------
@@ -80,9 +80,12 @@
 #include "tracks/track_object.hpp"
 #include "tracks/track_object_manager.hpp"
 #include "utils/constants.hpp"
+#include "utils/job_system.hpp"
 #include "utils/profiler.hpp"
+#include "utils/stk_process.hpp"
 #include "utils/translation.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <IrrlichtDevice.h>
 #include <ISceneManager.h>
@@ -138,7 +141,11 @@ World::World() : WorldStatus()
     m_schedule_exit_race = false;
     m_schedule_tutorial  = false;
     m_is_network_world   = false;
+    m_lobby_track        = false;
     m_restart_camera        = false;
+    m_simulation_only    = GUIEngine::isNoGraphics();
+    m_simulation_us      = 0;
+    m_simulation_ticks   = 0;
 
     m_stop_music_when_dialog_open = true;
 
@@ -177,17 +184,22 @@ void World::init()
     main_loop->renderGUI(1100);
     // Grab the track file
     Track *track = track_manager->getTrack(RaceManager::get()->getTrackName());
+    // The server of the graphical client uses a copy of the main process
+    // track, extra server lobbies load their own copy
+    ChildLoop* child_loop = m_process_type == PT_MAIN ?
+        NULL : STKHost::getByType(PT_MAIN)->getChildLoop();
+    const bool clone_main_track =
+        child_loop && child_loop->getProcessType() == m_process_type;
+    if (!clone_main_track && !track)
+    {
+        std::ostringstream msg;
+        msg << "Track '" << RaceManager::get()->getTrackName()
+            << "' not found.\n";
+        throw std::runtime_error(msg.str());
+    }
     if (m_process_type == PT_MAIN)
     {
         Scripting::ScriptEngine::getInstance<Scripting::ScriptEngine>();
-        if(!track)
-        {
-            std::ostringstream msg;
-            msg << "Track '" << RaceManager::get()->getTrackName()
-                << "' not found.\n";
-            throw std::runtime_error(msg.str());
-        }
-
         std::string script_path = track->getTrackFile("scripting.as");
         Scripting::ScriptEngine::getInstance()->loadScript(script_path, true);
     }
@@ -201,12 +213,22 @@ void World::init()
     // Load the track models - this must be done before the karts so that the
     // karts can be positioned properly on (and not in) the tracks.
     // This also defines the static Track::getCurrentTrack function.
-    if (m_process_type == PT_MAIN)
+    // Tracks loaded while other lobbies of this process are running are
+    // loaded one at a time (the scene manager, search paths and materials
+    // are shared), the lock is kept until the karts are loaded
+    std::unique_lock<std::mutex> load_lock(Track::m_load_mutex,
+        std::defer_lock);
+    if (!clone_main_track && STKHost::getExtraLobbyCount() > 0)
+    {
+        load_lock.lock();
+        track = track->cloneForLobby();
+        m_lobby_track = true;
+    }
+    if (!clone_main_track)
         track->loadTrackModel(RaceManager::get()->getReverseTrack());
     else
     {
         Track* child_track = Track::getCurrentTrack();
-        ChildLoop* child_loop = STKHost::getByType(PT_MAIN)->getChildLoop();
         while (!child_loop->isAborted() && child_track == NULL)
         {
             StkTime::sleep(1);
@@ -271,7 +293,7 @@ void World::init()
     if (m_race_gui)
         m_race_gui->init();
 
-    if (m_process_type == PT_MAIN)
+    if (m_process_type == PT_MAIN || m_lobby_track)
         powerup_manager->computeWeightsForRace(RaceManager::get()->getNumberOfKarts());
     main_loop->renderGUI(7200);
     if (m_process_type == PT_MAIN && UserConfigParams::m_particles_effects > 1)
@@ -403,7 +425,7 @@ void World::reset(bool restart)
     ProjectileManager::get()->cleanup();
     resetAllKarts();
 
-    if (restart)
+    if (restart && !m_simulation_only)
     {
         m_restart_camera = true;
     }
@@ -612,6 +634,20 @@ Controller* World::loadAIController(AbstractKart* kart)
 //-----------------------------------------------------------------------------
 World::~World()
 {
+    if (m_simulation_only && m_simulation_ticks > 0)
+    {
+        Log::info("World", "Simulated %d ticks with %u karts: %.1f us per "
+            "tick, resident memory %u MB.", m_simulation_ticks,
+            (unsigned)m_karts.size(),
+            (double)m_simulation_us / m_simulation_ticks,
+            (unsigned)(STKProcess::getResidentMemoryKB() / 1024));
+    }
+
+    std::unique_lock<std::mutex> load_lock(Track::m_load_mutex,
+        std::defer_lock);
+    if (m_lobby_track)
+        load_lock.lock();
+
     if (m_process_type == PT_MAIN)
     {
         material_manager->unloadAllTextures();
@@ -625,7 +661,9 @@ World::~World()
     ProjectileManager::get()->cleanup();
 
     // In case that a race is aborted (e.g. track not found) track is 0.
-    if (m_process_type == PT_MAIN)
+    if (m_lobby_track)
+        Track::cleanLobbyTrack();
+    else if (m_process_type == PT_MAIN)
     {
         if(Track::getCurrentTrack())
             Track::getCurrentTrack()->cleanup();
@@ -683,7 +721,8 @@ World::~World()
 
     m_world[m_process_type] = NULL;
 
-    if (m_process_type == PT_MAIN)
+    // The scene manager is shared with other lobbies of this process
+    if (m_process_type == PT_MAIN && STKHost::getExtraLobbyCount() == 0)
         irr_driver->getSceneManager()->clear();
 
 #ifdef DEBUG
@@ -1153,6 +1192,8 @@ void World::update(int ticks)
 #endif
 
     PROFILER_PUSH_CPU_MARKER("World::update()", 0x00, 0x7F, 0x00);
+    const uint64_t start_us =
+        m_simulation_only ? StkTime::getMonoTimeUs() : 0;
 
 #if MEASURE_FPS
     static int time = 0.0f;
@@ -1187,16 +1228,38 @@ void World::update(int ticks)
 
     PROFILER_PUSH_CPU_MARKER("World::update (Kart::upate)", 0x40, 0x7F, 0x00);
 
+    // Update all karts that are not eliminated
+    auto update_kart = [](AbstractKart* kart)
+    {
+        if (!kart->isEliminated())
+            return true;
+        SpareTireAI* sta = dynamic_cast<SpareTireAI*>(kart->getController());
+        return sta && sta->isMoving();
+    };
+    const int kart_amount = (int)m_karts.size();
+
+    // The controllers compute the read-only part of their decisions from the
+    // state at the start of the time step, in parallel. The result is the
+    // same whatever the number of threads, since the karts are only changed
+    // afterwards in the same order as before.
+    m_updated_controllers.clear();
+    for (int i = 0 ; i < kart_amount; ++i)
+    {
+        if (update_kart(m_karts[i].get()))
+            m_updated_controllers.push_back(m_karts[i]->getController());
+    }
+    JobSystem::run((unsigned)m_updated_controllers.size(),
+        [this, ticks](unsigned i)
+        {
+            m_updated_controllers[i]->prepareUpdate(ticks);
+        }, "Controller::prepareUpdate");
+
     // Update all the karts. This in turn will also update the controller,
     // which causes all AI steering commands set. So in the following
     // physics update the new steering is taken into account.
-    const int kart_amount = (int)m_karts.size();
     for (int i = 0 ; i < kart_amount; ++i)
     {
-        SpareTireAI* sta =
-            dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
-        // Update all karts that are not eliminated
-        if(!m_karts[i]->isEliminated() || (sta && sta->isMoving()))
+        if (update_kart(m_karts[i].get()))
             m_karts[i]->update(ticks);
         if (isStartPhase())
             m_karts[i]->makeKartRest();
@@ -1213,7 +1276,13 @@ void World::update(int ticks)
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_POP_CPU_MARKER();
-    updateTimeTargetSound();
+    if (m_simulation_only)
+    {
+        m_simulation_us += StkTime::getMonoTimeUs() - start_us;
+        m_simulation_ticks += ticks;
+    }
+    else
+        updateTimeTargetSound();
 
 #ifdef DEBUG
     assert(m_magic_number == 0xB01D6543);
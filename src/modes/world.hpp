@@ -176,6 +176,20 @@ protected:
 
     bool m_restart_camera;
 
+    /** True if only the simulation runs (no graphics, e.g. a headless
+     *  server), so camera and sound state is not updated. */
+    bool m_simulation_only;
+
+    /** Time spent in update() in simulation only mode, and the number of
+     *  ticks updated, logged when the world is deleted. */
+    uint64_t m_simulation_us;
+
+    int m_simulation_ticks;
+
+    /** The controllers of the karts updated in the current time step, their
+     *  prepareUpdate runs in parallel before the karts are updated. */
+    std::vector<Controller*> m_updated_controllers;
+
     /** Set when the world needs to be deleted but you can't do it immediately
      * because you are e.g. within World::update()
      */
@@ -186,6 +200,10 @@ protected:
 
     bool m_ended_early;
 
+    /** True if this world loaded its own copy of the track, because other
+     *  server lobbies are running in this process. */
+    bool m_lobby_track;
+
     virtual void  onGo() OVERRIDE;
     /** Returns true if the race is over. Must be defined by all modes. */
     virtual bool  isRaceOver() = 0;
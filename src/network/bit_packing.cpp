@@ -0,0 +1,226 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/bit_packing.hpp"
+#include "tracks/track.hpp"
+
+#include <limits>
+
+namespace
+{
+    /** Space around the track bounding box in which positions are still
+     *  quantized (e.g. a kart flying over the edge of the track). The box is
+     *  also rounded to multiples of this value, so that tiny differences in
+     *  the computed bounding box can't change the encoding. */
+    const float POSITION_MARGIN = 64.0f;
+
+    /** Tracks which would need more bits per axis use full floats. */
+    const unsigned MAX_POSITION_BITS = 24;
+
+    // ------------------------------------------------------------------------
+    /** Computes the origin and the number of bits per axis of the quantized
+     *  positions for the current track. Returns false if there is no track
+     *  or it is too large.
+     */
+    bool getPositionBox(float origin[3], unsigned bits[3])
+    {
+        Track* track = Track::getCurrentTrack();
+        if (!track)
+            return false;
+        const Vec3 *min, *max;
+        track->getAABB(&min, &max);
+        for (unsigned i = 0; i < 3; i++)
+        {
+            origin[i] = floorf(((*min)[i] - POSITION_MARGIN) /
+                POSITION_MARGIN) * POSITION_MARGIN;
+            const float top = ceilf(((*max)[i] + POSITION_MARGIN) /
+                POSITION_MARGIN) * POSITION_MARGIN;
+            const float steps = (top - origin[i]) * BitWriter::POSITION_STEPS;
+            bits[i] = 1;
+            while (bits[i] < MAX_POSITION_BITS &&
+                   (float)(1u << bits[i]) <= steps)
+                bits[i]++;
+            if ((float)(1u << bits[i]) <= steps)
+                return false;
+        }
+        return true;
+    }   // getPositionBox
+
+    // ------------------------------------------------------------------------
+    /** Converts a position to its quantized values. Returns false if the
+     *  position can't be quantized.
+     */
+    bool quantizePosition(const Vec3& xyz, float origin[3], uint32_t q[3],
+                          unsigned bits[3])
+    {
+        if (!getPositionBox(origin, bits))
+            return false;
+        for (unsigned i = 0; i < 3; i++)
+        {
+            const float v = (xyz[i] - origin[i]) * BitWriter::POSITION_STEPS;
+            // Written this way so that NaN is out of range too
+            if (!(v >= 0.0f && v <= (float)((1u << bits[i]) - 1)))
+                return false;
+            q[i] = (uint32_t)lrintf(v);
+        }
+        return true;
+    }   // quantizePosition
+
+    // ------------------------------------------------------------------------
+    Vec3 dequantizePosition(const float origin[3], const uint32_t q[3])
+    {
+        return Vec3(origin[0] + (float)q[0] / BitWriter::POSITION_STEPS,
+                    origin[1] + (float)q[1] / BitWriter::POSITION_STEPS,
+                    origin[2] + (float)q[2] / BitWriter::POSITION_STEPS);
+    }   // dequantizePosition
+
+}   // namespace
+
+// ----------------------------------------------------------------------------
+void BitWriter::addPosition(const Vec3& xyz)
+{
+    float origin[3];
+    uint32_t q[3];
+    unsigned bits[3];
+    if (quantizePosition(xyz, origin, q, bits))
+    {
+        addBool(true);
+        for (unsigned i = 0; i < 3; i++)
+            addBits(q[i], bits[i]);
+    }
+    else
+    {
+        addBool(false);
+        addFloat(xyz.getX());
+        addFloat(xyz.getY());
+        addFloat(xyz.getZ());
+    }
+}   // addPosition
+
+// ----------------------------------------------------------------------------
+/** Returns the position the receiver will get for xyz written with
+ *  addPosition, so the sender can use the same value in its simulation.
+ */
+Vec3 BitWriter::roundPosition(const Vec3& xyz)
+{
+    float origin[3];
+    uint32_t q[3];
+    unsigned bits[3];
+    if (quantizePosition(xyz, origin, q, bits))
+        return dequantizePosition(origin, q);
+    return xyz;
+}   // roundPosition
+
+// ----------------------------------------------------------------------------
+Vec3 BitReader::getPosition()
+{
+    if (!getBool())
+    {
+        float x = getFloat();
+        float y = getFloat();
+        float z = getFloat();
+        return Vec3(x, y, z);
+    }
+
+    float origin[3];
+    uint32_t q[3];
+    unsigned bits[3];
+    if (!getPositionBox(origin, bits))
+        throw std::out_of_range("Quantized position without track.");
+    for (unsigned i = 0; i < 3; i++)
+        q[i] = getBits(bits[i]);
+    return dequantizePosition(origin, q);
+}   // getPosition
+
+// ----------------------------------------------------------------------------
+void BitWriter::unitTesting()
+{
+    BareNetworkString s;
+    {
+        BitWriter w(&s);
+        w.addBool(true);
+        w.addBits(5, 3);
+        w.addVarUInt(0);
+        w.addVarUInt(15);
+        w.addVarUInt(16);
+        w.addVarUInt(std::numeric_limits<uint32_t>::max());
+        w.addVarInt(-1);
+        w.addVarInt(std::numeric_limits<int32_t>::min());
+        w.addTicks(1000, 1010);
+        w.addFloat(-1.5f);
+        w.addQuantizedFloat(0.25f, -1.0f, 1.0f, 10);
+        // No track is loaded, so a full float position is written
+        w.addPosition(Vec3(1.0f, 2.0f, 3.0f));
+        w.flush();
+        s.addUInt8(0xab);
+        w.addBits(0x3, 2);
+    }
+    // The first section is padded to a byte, the byte aligned value must
+    // follow directly
+    BitReader r(&s);
+    bool b = r.getBool();
+    assert(b);
+    uint32_t u = r.getBits(3);
+    assert(u == 5);
+    u = r.getVarUInt();
+    assert(u == 0);
+    u = r.getVarUInt();
+    assert(u == 15);
+    u = r.getVarUInt();
+    assert(u == 16);
+    u = r.getVarUInt();
+    assert(u == std::numeric_limits<uint32_t>::max());
+    int32_t i = r.getVarInt();
+    assert(i == -1);
+    i = r.getVarInt();
+    assert(i == std::numeric_limits<int32_t>::min());
+    i = r.getTicks(1010);
+    assert(i == 1000);
+    float f = r.getFloat();
+    assert(f == -1.5f);
+    f = r.getQuantizedFloat(-1.0f, 1.0f, 10);
+    assert(f == roundQuantizedFloat(0.25f, -1.0f, 1.0f, 10));
+    assert(fabsf(f - 0.25f) < 0.001f);
+    Vec3 p = r.getPosition();
+    assert(p == Vec3(1.0f, 2.0f, 3.0f));
+    r.align();
+    uint8_t c = s.getUInt8();
+    assert(c == 0xab);
+    u = r.getBits(2);
+    assert(u == 0x3);
+    (void)b;
+    (void)u;
+    (void)i;
+    (void)f;
+    (void)p;
+    (void)c;
+    assert(s.size() == 0);
+
+    // Small values must take less space than the byte aligned versions
+    BareNetworkString packed;
+    {
+        BitWriter w(&packed);
+        w.addVarUInt(3);
+        w.addTicks(5, 0);
+    }
+    assert(packed.size() == 2);
+
+    // Quantized floats are clamped to the range
+    assert(roundQuantizedFloat(5.0f, -1.0f, 1.0f, 8) == 1.0f);
+    assert(roundQuantizedFloat(-5.0f, -1.0f, 1.0f, 8) == -1.0f);
+}   // unitTesting
@@ -0,0 +1,265 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file bit_packing.hpp
+ *  \brief Bit level writer and reader on top of BareNetworkString, used to
+ *  pack game states.
+ */
+
+#ifndef HEADER_BIT_PACKING_HPP
+#define HEADER_BIT_PACKING_HPP
+
+#include "network/network_string.hpp"
+#include "utils/types.hpp"
+#include "utils/vec3.hpp"
+
+#include <assert.h>
+#include <cmath>
+#include <string.h>
+
+/** \class BitWriter
+ *  \brief Appends values with an arbitrary number of bits to a
+ *  BareNetworkString. Bits are collected in a small accumulator and written
+ *  to the string one byte at a time, the last byte is padded with zeros
+ *  when flush() is called (or the writer is destroyed). Data written with
+ *  the normal BareNetworkString functions in between must be preceded by a
+ *  flush(), so that a state can mix bit packed and byte aligned sections.
+ *  States are only bit packed if all peers in game support it (see
+ *  NetworkConfig::useBitPackedState).
+ */
+class BitWriter
+{
+private:
+    BareNetworkString* m_buffer;
+
+    /** Bits not yet written to m_buffer, oldest bit in the lowest bit. */
+    uint64_t m_bits;
+
+    /** Number of valid bits in m_bits, always less than 8 between calls. */
+    unsigned m_bit_count;
+
+public:
+    /** Steps per meter for positions written with addPosition. */
+    static const int POSITION_STEPS = 1024;
+
+    // ------------------------------------------------------------------------
+    BitWriter(BareNetworkString* buffer)
+        : m_buffer(buffer), m_bits(0), m_bit_count(0)         {}
+    // ------------------------------------------------------------------------
+    ~BitWriter()                                              { flush(); }
+    // ------------------------------------------------------------------------
+    /** Adds the lowest \p bits bits (at most 32) of \p value. */
+    void addBits(uint32_t value, unsigned bits)
+    {
+        assert(bits <= 32);
+        if (bits < 32)
+            value &= (1u << bits) - 1;
+        m_bits |= (uint64_t)value << m_bit_count;
+        m_bit_count += bits;
+        while (m_bit_count >= 8)
+        {
+            m_buffer->addUInt8((uint8_t)(m_bits & 0xff));
+            m_bits >>= 8;
+            m_bit_count -= 8;
+        }
+    }   // addBits
+    // ------------------------------------------------------------------------
+    void addBool(bool value)                    { addBits(value ? 1 : 0, 1); }
+    // ------------------------------------------------------------------------
+    /** Adds an unsigned value in groups of 4 bits, each followed by a
+     *  continuation bit, so values below 16 take 5 bits, below 256 10 bits
+     *  and so on. */
+    void addVarUInt(uint32_t value)
+    {
+        while (value >= 16)
+        {
+            addBits((value & 15) | 16, 5);
+            value >>= 4;
+        }
+        addBits(value, 5);
+    }   // addVarUInt
+    // ------------------------------------------------------------------------
+    /** Adds a signed value using zig-zag encoding, so small negative
+     *  values are as cheap as small positive ones. */
+    void addVarInt(int32_t value)
+    {
+        addVarUInt(((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+    }   // addVarInt
+    // ------------------------------------------------------------------------
+    /** Adds a time ticks value relative to \p base_ticks (usually the ticks
+     *  of the state being saved), which is much smaller than the absolute
+     *  value in most cases. */
+    void addTicks(int ticks, int base_ticks)  { addVarInt(ticks - base_ticks); }
+    // ------------------------------------------------------------------------
+    /** Adds a full 32 bit floating point value. */
+    void addFloat(float value)
+    {
+        uint32_t u;
+        memcpy(&u, &value, sizeof(float));
+        addBits(u, 32);
+    }   // addFloat
+    // ------------------------------------------------------------------------
+    /** Adds a float in range [min, max] with \p bits bits, values outside
+     *  are clamped. Use roundQuantizedFloat to get the value the receiver
+     *  will see. */
+    void addQuantizedFloat(float value, float min, float max, unsigned bits)
+    {
+        addBits(quantizeFloat(value, min, max, bits), bits);
+    }   // addQuantizedFloat
+    // ------------------------------------------------------------------------
+    /** Adds a position relative to the bounding box of the current track
+     *  with a precision of 1 / POSITION_STEPS meter, positions outside the
+     *  (enlarged) bounding box are stored as full floats. */
+    void addPosition(const Vec3& xyz);
+    // ------------------------------------------------------------------------
+    /** Writes the remaining bits (if any) padded to a full byte. */
+    void flush()
+    {
+        if (m_bit_count > 0)
+        {
+            m_buffer->addUInt8((uint8_t)(m_bits & 0xff));
+            m_bits = 0;
+            m_bit_count = 0;
+        }
+    }   // flush
+    // ------------------------------------------------------------------------
+    static uint32_t quantizeFloat(float value, float min, float max,
+                                  unsigned bits)
+    {
+        assert(bits > 0 && bits < 32 && max > min);
+        const uint32_t steps = (1u << bits) - 1;
+        if (value <= min)
+            return 0;
+        if (value >= max)
+            return steps;
+        return (uint32_t)lrintf((value - min) / (max - min) * (float)steps);
+    }   // quantizeFloat
+    // ------------------------------------------------------------------------
+    static float dequantizeFloat(uint32_t q, float min, float max,
+                                 unsigned bits)
+    {
+        const uint32_t steps = (1u << bits) - 1;
+        return min + (max - min) * ((float)q / (float)steps);
+    }   // dequantizeFloat
+    // ------------------------------------------------------------------------
+    /** Returns the value that will be read for \p value written with
+     *  addQuantizedFloat. */
+    static float roundQuantizedFloat(float value, float min, float max,
+                                     unsigned bits)
+    {
+        return dequantizeFloat(quantizeFloat(value, min, max, bits), min, max,
+            bits);
+    }   // roundQuantizedFloat
+    // ------------------------------------------------------------------------
+    static Vec3 roundPosition(const Vec3& xyz);
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+
+};   // class BitWriter
+
+// ============================================================================
+/** \class BitReader
+ *  \brief Reads values written by BitWriter. Bytes are only taken from the
+ *  string when needed, so after align() (or when the reader is destroyed)
+ *  exactly the bytes written by the corresponding BitWriter are consumed,
+ *  and the normal BareNetworkString get functions can be used again.
+ */
+class BitReader
+{
+private:
+    const BareNetworkString* m_buffer;
+
+    /** Bits taken from m_buffer but not returned yet. */
+    uint64_t m_bits;
+
+    /** Number of valid bits in m_bits. */
+    unsigned m_bit_count;
+
+public:
+    // ------------------------------------------------------------------------
+    BitReader(const BareNetworkString* buffer)
+        : m_buffer(buffer), m_bits(0), m_bit_count(0)         {}
+    // ------------------------------------------------------------------------
+    /** Returns the next \p bits bits (at most 32), throws std::out_of_range
+     *  if the string has not enough data left. */
+    uint32_t getBits(unsigned bits)
+    {
+        assert(bits <= 32);
+        while (m_bit_count < bits)
+        {
+            m_bits |= (uint64_t)m_buffer->getUInt8() << m_bit_count;
+            m_bit_count += 8;
+        }
+        uint32_t value = (uint32_t)(m_bits & ((1ull << bits) - 1));
+        m_bits >>= bits;
+        m_bit_count -= bits;
+        return value;
+    }   // getBits
+    // ------------------------------------------------------------------------
+    bool getBool()                                { return getBits(1) == 1; }
+    // ------------------------------------------------------------------------
+    uint32_t getVarUInt()
+    {
+        uint32_t value = 0;
+        unsigned shift = 0;
+        while (true)
+        {
+            uint32_t group = getBits(5);
+            value |= (group & 15) << shift;
+            if ((group & 16) == 0)
+                break;
+            shift += 4;
+            if (shift >= 32)
+                throw std::out_of_range("getVarUInt too long.");
+        }
+        return value;
+    }   // getVarUInt
+    // ------------------------------------------------------------------------
+    int32_t getVarInt()
+    {
+        uint32_t value = getVarUInt();
+        return (int32_t)((value >> 1) ^ (0u - (value & 1)));
+    }   // getVarInt
+    // ------------------------------------------------------------------------
+    int getTicks(int base_ticks)         { return base_ticks + getVarInt(); }
+    // ------------------------------------------------------------------------
+    float getFloat()
+    {
+        uint32_t u = getBits(32);
+        float f;
+        memcpy(&f, &u, sizeof(float));
+        return f;
+    }   // getFloat
+    // ------------------------------------------------------------------------
+    float getQuantizedFloat(float min, float max, unsigned bits)
+    {
+        return BitWriter::dequantizeFloat(getBits(bits), min, max, bits);
+    }   // getQuantizedFloat
+    // ------------------------------------------------------------------------
+    Vec3 getPosition();
+    // ------------------------------------------------------------------------
+    /** Discards the padding bits of the current byte. */
+    void align()
+    {
+        m_bits = 0;
+        m_bit_count = 0;
+    }   // align
+
+};   // class BitReader
+
+#endif // HEADER_BIT_PACKING_HPP
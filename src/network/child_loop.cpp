@@ -26,60 +26,23 @@
 #include "network/race_event_manager.hpp"
 #include "network/server_config.hpp"
 #include "network/stk_host.hpp"
+#include "config/stk_config.hpp"
 #include "race/race_manager.hpp"
 #include "states_screens/state_manager.hpp"
 #include "utils/log.hpp"
 #include "utils/stk_process.hpp"
-#include "utils/time.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/tick_scheduler.hpp"
 #include "utils/vs.hpp"
 
-// ----------------------------------------------------------------------------
-float ChildLoop::getLimitedDt()
-{
-    m_prev_time = m_curr_time;
-
-    float dt = 0;
-    while (1)
-    {
-        m_curr_time = StkTime::getMonoTimeMs();
-        if (m_prev_time > m_curr_time)
-        {
-            m_prev_time = m_curr_time;
-        }
-        dt = (float)(m_curr_time - m_prev_time);
-        while (dt == 0)
-        {
-            StkTime::sleep(1);
-            m_curr_time = StkTime::getMonoTimeMs();
-            if (m_prev_time > m_curr_time)
-            {
-                Log::error("MainLopp", "System clock keeps backwards!");
-                m_prev_time = m_curr_time;
-            }
-            dt = (float)(m_curr_time - m_prev_time);
-        }
-        if (UserConfigParams::m_benchmark)
-            break;
-
-        const int current_fps = (int)(1000.0f / dt);
-        const int max_fps = UserConfigParams::m_max_fps;
-        if (current_fps <= max_fps)
-            break;
-
-        int wait_time = 1000 / max_fps - 1000 / current_fps;
-        if (wait_time < 1) wait_time = 1;
-
-        StkTime::sleep(wait_time);
-    }   // while(1)
-    dt *= 0.001f;
-    return dt;
-}   // getLimitedDt
-
 // ----------------------------------------------------------------------------
 void ChildLoop::run()
 {
-    VS::setThreadName("ChildLoop");
-    STKProcess::init(PT_CHILD);
+    std::string thread_name = "ChildLoop";
+    if (m_process_type != PT_CHILD)
+        thread_name += StringUtils::toString(m_process_type);
+    VS::setThreadName(thread_name.c_str());
+    STKProcess::init(m_process_type);
 
     GUIEngine::disableGraphics();
     RaceManager::create();
@@ -104,6 +67,7 @@ void ChildLoop::run()
     NetworkConfig::get()->setCurrentUserId(m_cl_config->m_login_id);
     NetworkConfig::get()->setCurrentUserToken(m_cl_config->m_token);
     NetworkConfig::get()->setNumFixedAI(m_cl_config->m_server_ai);
+    NetworkConfig::get()->setServerPortOffset(m_cl_config->m_port_offset);
     // Unused afterwards
     delete m_cl_config;
     m_cl_config = NULL;
@@ -111,8 +75,8 @@ void ChildLoop::run()
     ServerConfig::loadServerLobbyFromConfig();
     StateManager::get()->enterMenuState();
 
-    m_curr_time = StkTime::getMonoTimeMs();
-    float left_over_time = 0;
+    TickScheduler scheduler(thread_name, stk_config->getPhysicsFPS());
+    scheduler.setFastMode(ServerConfig::m_fast_simulation);
     while (!m_abort)
     {
         if (STKHost::existHost() && STKHost::get()->requestedShutdown())
@@ -130,11 +94,7 @@ void ChildLoop::run()
             }
         }
 
-        left_over_time += getLimitedDt();
-        int num_steps = stk_config->time2Ticks(left_over_time);
-        float dt = stk_config->ticks2Time(1);
-        left_over_time -= num_steps * dt;
-
+        int num_steps = scheduler.waitForTicks();
         for (int i = 0; i < num_steps; i++)
         {
             if (auto pm = ProtocolManager::lock())
@@ -18,6 +18,7 @@
 #ifndef HEADER_SERVER_LOOP_HPP
 #define HEADER_SERVER_LOOP_HPP
 
+#include "utils/stk_process.hpp"
 #include "utils/types.hpp"
 #include <atomic>
 #include <string>
@@ -28,6 +29,11 @@ struct ChildLoopConfig
     uint32_t m_login_id;
     std::string m_token;
     unsigned m_server_ai;
+    /** Process type of the child, PT_CHILD for the server of the graphical
+     *  client, PT_CHILD + 1 + n for extra server lobbies. */
+    ProcessType m_process_type;
+    /** Added to the server port (0 for the graphical client server). */
+    uint16_t m_port_offset;
 };
 
 class ChildLoop
@@ -35,21 +41,20 @@ class ChildLoop
 private:
     const ChildLoopConfig* m_cl_config;
 
+    const ProcessType m_process_type;
+
     std::atomic_bool m_abort;
 
     std::atomic<uint16_t> m_port;
 
     std::atomic<uint32_t> m_server_online_id;
 
-    uint64_t m_curr_time;
-    uint64_t m_prev_time;
-    float getLimitedDt();
 public:
     ChildLoop(const ChildLoopConfig& clc)
-        : m_cl_config(new ChildLoopConfig(clc))
+        : m_cl_config(new ChildLoopConfig(clc)),
+          m_process_type(clc.m_process_type)
     {
         m_abort = false;
-        m_prev_time = m_curr_time = 0;
         m_port = 0;
         m_server_online_id = 0;
     }
@@ -59,6 +64,7 @@ public:
     bool isAborted() const { return m_abort; }
     uint16_t getPort() const { return m_port; }
     uint32_t getServerOnlineId() const { return m_server_online_id; }
+    ProcessType getProcessType() const { return m_process_type; }
 };   // ChildLoop
 
 #endif
@@ -19,7 +19,7 @@
 #ifndef HEADER_COMPRESS_NETWORK_BODY_HPP
 #define HEADER_COMPRESS_NETWORK_BODY_HPP
 
-#include "network/network_string.hpp"
+#include "network/bit_packing.hpp"
 #include "mini_glm.hpp"
 
 #include "LinearMath/btMotionState.h"
@@ -57,10 +57,45 @@ namespace CompressNetworkBody
      *  transformation and convert linear and angular velocities to half floats
      *  it can be used by client to locally round values to make sure client
      *  and server have similar state when saving state if you don't provoide
-     *  bns.
+     *  bw. The position is only quantized (see BitWriter::addPosition) when
+     *  it is written to a state, rounding it every frame would stop slowly
+     *  moving objects.
      */
     inline void compress(btRigidBody* body, btMotionState* ms,
-                         BareNetworkString* bns = NULL)
+                         BitWriter* bw = NULL)
+    {
+        Vec3 xyz = body->getWorldTransform().getOrigin();
+        if (bw)
+            xyz = BitWriter::roundPosition(xyz);
+        uint32_t compressed_q =
+            compressQuaternion(body->getWorldTransform().getRotation());
+        short lvx = toFloat16(body->getLinearVelocity().x());
+        short lvy = toFloat16(body->getLinearVelocity().y());
+        short lvz = toFloat16(body->getLinearVelocity().z());
+        short avx = toFloat16(body->getAngularVelocity().x());
+        short avy = toFloat16(body->getAngularVelocity().y());
+        short avz = toFloat16(body->getAngularVelocity().z());
+        setCompressedValues(xyz.getX(), xyz.getY(), xyz.getZ(), compressed_q,
+            lvx, lvy, lvz, avx, avy, avz, body, ms);
+        // if bw is null, it's locally compress (for rounding values)
+        if (!bw)
+            return;
+
+        bw->addPosition(xyz);
+        bw->addBits(compressed_q, 32);
+        bw->addBits((uint16_t)lvx, 16);
+        bw->addBits((uint16_t)lvy, 16);
+        bw->addBits((uint16_t)lvz, 16);
+        bw->addBits((uint16_t)avx, 16);
+        bw->addBits((uint16_t)avy, 16);
+        bw->addBits((uint16_t)avz, 16);
+    }   // compress
+    // ------------------------------------------------------------------------
+    /** Compress with the byte aligned state format with full float
+     *  positions, used if not all peers in game support bit packed states
+     *  (see NetworkConfig::useBitPackedState). */
+    inline void compress(btRigidBody* body, btMotionState* ms,
+                         BareNetworkString* bns)
     {
         float x = body->getWorldTransform().getOrigin().x();
         float y = body->getWorldTransform().getOrigin().y();
@@ -75,16 +110,27 @@ namespace CompressNetworkBody
         short avz = toFloat16(body->getAngularVelocity().z());
         setCompressedValues(x, y, z, compressed_q, lvx, lvy, lvz, avx, avy,
             avz, body, ms);
-        // if bns is null, it's locally compress (for rounding values)
-        if (!bns)
-            return;
-
         bns->addFloat(x).addFloat(y).addFloat(z).addUInt32(compressed_q);
         bns->addUInt16(lvx).addUInt16(lvy).addUInt16(lvz)
             .addUInt16(avx).addUInt16(avy).addUInt16(avz);
     }   // compress
     // ------------------------------------------------------------------------
     /* Called during rewind when restoring data from game state. */
+    inline void decompress(BitReader* br, btRigidBody* body, btMotionState* ms)
+    {
+        Vec3 xyz = br->getPosition();
+        uint32_t compressed_q = br->getBits(32);
+        short lvx = (short)br->getBits(16);
+        short lvy = (short)br->getBits(16);
+        short lvz = (short)br->getBits(16);
+        short avx = (short)br->getBits(16);
+        short avy = (short)br->getBits(16);
+        short avz = (short)br->getBits(16);
+        setCompressedValues(xyz.getX(), xyz.getY(), xyz.getZ(), compressed_q,
+            lvx, lvy, lvz, avx, avy, avz, body, ms);
+    }   // decompress
+    // ------------------------------------------------------------------------
+    /* Restores a body saved with the byte aligned state format. */
     inline void decompress(const BareNetworkString* bns,
                            btRigidBody* body, btMotionState* ms)
     {
@@ -73,6 +73,8 @@ std::string Crypto::m_client_iv;
 // ============================================================================
 bool Crypto::encryptConnectionRequest(BareNetworkString& ns)
 {
+    // The data of a received string is in the packet, not in m_buffer
+    ns.buffer();
     std::vector<uint8_t> cipher(ns.m_buffer.size() + 4, 0);
     if (mbedtls_gcm_crypt_and_tag(&m_aes_encrypt_context, MBEDTLS_GCM_ENCRYPT,
         ns.m_buffer.size(), m_iv.data(), m_iv.size(), NULL, 0,
@@ -87,6 +89,8 @@ bool Crypto::encryptConnectionRequest(BareNetworkString& ns)
 // ----------------------------------------------------------------------------
 bool Crypto::decryptConnectionRequest(BareNetworkString& ns)
 {
+    // The data of a received string is in the packet, not in m_buffer
+    ns.buffer();
     std::vector<uint8_t> pt(ns.m_buffer.size() - 4, 0);
     uint8_t* tag = ns.m_buffer.data();
     if (mbedtls_gcm_auth_decrypt(&m_aes_decrypt_context, pt.size(),
@@ -102,6 +106,8 @@ bool Crypto::decryptConnectionRequest(BareNetworkString& ns)
 // ----------------------------------------------------------------------------
 ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 {
+    // The data of a received string is in the packet, not in m_buffer
+    ns.buffer();
     // 4 bytes counter and 4 bytes tag
     ENetPacket* p = enet_packet_create(NULL, ns.m_buffer.size() + 8,
         (reliable ? ENET_PACKET_FLAG_RELIABLE :
@@ -147,10 +153,12 @@ ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 }   // encryptSend
 
 // ----------------------------------------------------------------------------
-NetworkString* Crypto::decryptRecieve(ENetPacket* p)
+/** Decrypts a received packet in place, and returns a string which is a
+ *  view of the decrypted data in the packet.
+ */
+NetworkString* Crypto::decryptRecieve(std::shared_ptr<ENetPacket> p)
 {
     int clen = (int)(p->dataLength - 8);
-    auto ns = std::unique_ptr<NetworkString>(new NetworkString(p->data, clen));
 
     std::array<uint8_t, 12> iv = {};
     if (NetworkConfig::get()->isClient())
@@ -161,14 +169,12 @@ NetworkString* Crypto::decryptRecieve(ENetPacket* p)
     uint8_t* packet_start = p->data + 8;
     uint8_t* tag = p->data + 4;
     if (mbedtls_gcm_auth_decrypt(&m_aes_decrypt_context, clen, iv.data(),
-        iv.size(), NULL, 0, tag, 4, packet_start, ns->m_buffer.data()) != 0)
+        iv.size(), NULL, 0, tag, 4, packet_start, packet_start) != 0)
     {
         throw std::runtime_error("Failed authentication.");
     }
 
-    NetworkString* result = ns.get();
-    ns.release();
-    return result;
+    return new NetworkString(p, packet_start, clen);
 }   // decryptRecieve
 
 #endif
@@ -73,7 +73,9 @@ public:
         return c;
     }
     // ------------------------------------------------------------------------
-    static void initClientAES()
+    /** Generates a random 16 bytes key and 12 bytes IV for AES-GCM. */
+    static void generateKeyIV(std::vector<uint8_t>* key,
+                              std::vector<uint8_t>* iv)
     {
         mbedtls_entropy_context entropy;
         mbedtls_entropy_init(&entropy);
@@ -93,8 +95,16 @@ public:
                 key_iv.size()) != 0)
                 key_iv = seed;
         }
-        m_client_key = base64({ key_iv.begin(), key_iv.begin() + 16 });
-        m_client_iv = base64({ key_iv.begin() + 16, key_iv.end() });
+        key->assign(key_iv.begin(), key_iv.begin() + 16);
+        iv->assign(key_iv.begin() + 16, key_iv.end());
+    }
+    // ------------------------------------------------------------------------
+    static void initClientAES()
+    {
+        std::vector<uint8_t> key, iv;
+        generateKeyIV(&key, &iv);
+        m_client_key = base64(key);
+        m_client_iv = base64(iv);
     }
     // ------------------------------------------------------------------------
     static void resetClientAES()
@@ -134,7 +144,7 @@ public:
     // ------------------------------------------------------------------------
     ENetPacket* encryptSend(BareNetworkString& ns, bool reliable);
     // ------------------------------------------------------------------------
-    NetworkString* decryptRecieve(ENetPacket* p);
+    NetworkString* decryptRecieve(std::shared_ptr<ENetPacket> p);
 
 };
 
@@ -96,6 +96,8 @@ std::string Crypto::m_client_iv;
 // ============================================================================
 bool Crypto::encryptConnectionRequest(BareNetworkString& ns)
 {
+    // The data of a received string is in the packet, not in m_buffer
+    ns.buffer();
     std::vector<uint8_t> cipher(ns.m_buffer.size() + 4, 0);
 
     int elen;
@@ -117,6 +119,8 @@ bool Crypto::encryptConnectionRequest(BareNetworkString& ns)
 // ----------------------------------------------------------------------------
 bool Crypto::decryptConnectionRequest(BareNetworkString& ns)
 {
+    // The data of a received string is in the packet, not in m_buffer
+    ns.buffer();
     std::vector<uint8_t> pt(ns.m_buffer.size() - 4, 0);
 
     if (EVP_DecryptInit_ex(m_decrypt, NULL, NULL, NULL, NULL) != 1)
@@ -144,6 +148,8 @@ bool Crypto::decryptConnectionRequest(BareNetworkString& ns)
 // ----------------------------------------------------------------------------
 ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 {
+    // The data of a received string is in the packet, not in m_buffer
+    ns.buffer();
     // 4 bytes counter and 4 bytes tag
     ENetPacket* p = enet_packet_create(NULL, ns.m_buffer.size() + 8,
         (reliable ? ENET_PACKET_FLAG_RELIABLE :
@@ -207,10 +213,12 @@ ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 }   // encryptSend
 
 // ----------------------------------------------------------------------------
-NetworkString* Crypto::decryptRecieve(ENetPacket* p)
+/** Decrypts a received packet in place, and returns a string which is a
+ *  view of the decrypted data in the packet.
+ */
+NetworkString* Crypto::decryptRecieve(std::shared_ptr<ENetPacket> p)
 {
     int clen = (int)(p->dataLength - 8);
-    auto ns = std::unique_ptr<NetworkString>(new NetworkString(p->data, clen));
 
     std::array<uint8_t, 12> iv = {};
     if (NetworkConfig::get()->isClient())
@@ -230,7 +238,7 @@ NetworkString* Crypto::decryptRecieve(ENetPacket* p)
     }
 
     int dlen;
-    if (EVP_DecryptUpdate(m_decrypt, ns->m_buffer.data(), &dlen,
+    if (EVP_DecryptUpdate(m_decrypt, packet_start, &dlen,
         packet_start, clen) != 1)
     {
         throw std::runtime_error("Failed to decrypt.");
@@ -238,9 +246,7 @@ NetworkString* Crypto::decryptRecieve(ENetPacket* p)
     if (EVP_DecryptFinal_ex(m_decrypt, unused_16_blocks.data(), &dlen) > 0)
     {
         assert(dlen == 0);
-        NetworkString* result = ns.get();
-        ns.release();
-        return result;
+        return new NetworkString(p, packet_start, clen);
     }
     throw std::runtime_error("Failed to finalize decryption.");
 }   // decryptRecieve
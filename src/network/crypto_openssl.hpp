@@ -94,23 +94,31 @@ public:
         return c;
     }
     // ------------------------------------------------------------------------
-    static void initClientAES()
+    /** Generates a random 16 bytes key and 12 bytes IV for AES-GCM. */
+    static void generateKeyIV(std::vector<uint8_t>* key,
+                              std::vector<uint8_t>* iv)
     {
         std::random_device rd;
         std::mt19937 g(rd());
 
         // Default key and if RAND_bytes failed
-        std::vector<uint8_t> key;
+        key->clear();
         for (int i = 0; i < 16; i++)
-            key.push_back((uint8_t)(g() % 255));
-        std::vector<uint8_t> iv;
+            key->push_back((uint8_t)(g() % 255));
+        iv->clear();
         for (int i = 0; i < 12; i++)
-            iv.push_back((uint8_t)(g() % 255));
-        if (!RAND_bytes(key.data(), 16))
+            iv->push_back((uint8_t)(g() % 255));
+        if (!RAND_bytes(key->data(), 16))
         {
             Log::warn("Crypto",
                 "Failed to generate cryptographically strong key");
         }
+    }
+    // ------------------------------------------------------------------------
+    static void initClientAES()
+    {
+        std::vector<uint8_t> key, iv;
+        generateKeyIV(&key, &iv);
         m_client_key = base64(key);
         m_client_iv = base64(iv);
     }
@@ -154,7 +162,7 @@ public:
     // ------------------------------------------------------------------------
     ENetPacket* encryptSend(BareNetworkString& ns, bool reliable);
     // ------------------------------------------------------------------------
-    NetworkString* decryptRecieve(ENetPacket* p);
+    NetworkString* decryptRecieve(std::shared_ptr<ENetPacket> p);
 
 };
 
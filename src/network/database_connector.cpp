@@ -20,6 +20,7 @@
 
 #include "network/database_connector.hpp"
 
+#include "io/file_manager.hpp"
 #include "network/network_player_profile.hpp"
 #include "network/server_config.hpp"
 #include "network/socket_address.hpp"
@@ -27,6 +28,10 @@
 #include "network/stk_ipv6.hpp"
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
+#include "utils/vs.hpp"
+
+#include <future>
+#include <limits>
 
 //-----------------------------------------------------------------------------
 /** Prints "?" to the output stream and saves the Binder object to the
@@ -59,7 +64,18 @@ std::function<void(sqlite3_stmt* stmt)> BinderCollection::getBindFunction() cons
             if (binder)
             {
                 // SQLITE_TRANSIENT to copy string
-                if (binder->m_use_null_if_empty && binder->m_value.empty())
+                if (binder->m_is_integer)
+                {
+                    if (sqlite3_bind_int64(stmt, idx, binder->m_integer)
+                        != SQLITE_OK)
+                    {
+                        Log::error("easySQLQuery", "Failed to bind %s as %s.",
+                            StringUtils::toString(binder->m_integer).c_str(),
+                            binder->m_name.c_str());
+                    }
+                }
+                else if (binder->m_use_null_if_empty &&
+                    binder->m_value.empty())
                 {
                     if (sqlite3_bind_null(stmt, idx) != SQLITE_OK)
                     {
@@ -83,21 +99,44 @@ std::function<void(sqlite3_stmt* stmt)> BinderCollection::getBindFunction() cons
 }   // BinderCollection::getBindFunction
 
 //-----------------------------------------------------------------------------
-/** Opens the database, sets its busy handler and variables related to it. */
-void DatabaseConnector::initDatabase()
+DatabaseConnector::DatabaseConnector()
 {
-    m_last_poll_db_time = StkTime::getMonoTimeMs();
     m_db = NULL;
+    m_stop_thread = false;
+    m_process_type = STKProcess::getType();
     m_ip_ban_table_exists = false;
     m_ipv6_ban_table_exists = false;
     m_online_id_ban_table_exists = false;
     m_ip_geolocation_table_exists = false;
     m_ipv6_geolocation_table_exists = false;
     m_player_reports_table_exists = false;
+    m_last_poll_db_time = StkTime::getMonoTimeMs();
+    m_ban_data_version = -1;
+    m_geolocation_data_version = -1;
+    m_ban_tables_changed = true;
+}   // DatabaseConnector
+
+//-----------------------------------------------------------------------------
+/** Opens the database from the server config if sql management is
+ *   enabled. */
+void DatabaseConnector::initDatabase()
+{
+    m_last_poll_db_time = StkTime::getMonoTimeMs();
     if (!ServerConfig::m_sql_management)
         return;
     const std::string& path = ServerConfig::getConfigDirectory() + "/" +
         ServerConfig::m_database_file.c_str();
+    openDatabase(path);
+}   // initDatabase
+
+//-----------------------------------------------------------------------------
+/** Opens the database, sets its busy handler and variables related to it,
+ *   and starts the thread running the queries.
+ *  \param path Path of an existing database file.
+ *  \return True if the database was opened.
+ */
+bool DatabaseConnector::openDatabase(const std::string& path)
+{
     int ret = sqlite3_open_v2(path.c_str(), &m_db,
         SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_FULLMUTEX |
         SQLITE_OPEN_READWRITE, NULL);
@@ -107,7 +146,7 @@ void DatabaseConnector::initDatabase()
             sqlite3_errmsg(m_db));
         sqlite3_close(m_db);
         m_db = NULL;
-        return;
+        return false;
     }
     sqlite3_busy_handler(m_db, [](void* data, int retry)
         {
@@ -135,22 +174,134 @@ void DatabaseConnector::initDatabase()
         m_ip_geolocation_table_exists);
     checkTableExists(ServerConfig::m_ipv6_geolocation_table,
         m_ipv6_geolocation_table_exists);
-}   // initDatabase
+    m_ban_data_version = -1;
+    m_geolocation_data_version = -1;
+    m_ban_tables_changed = true;
+    m_ip_geolocation_fingerprint.clear();
+    m_ipv6_geolocation_fingerprint.clear();
+    m_thread = std::thread(&DatabaseConnector::runQueries, this);
+    addQuery([this]() { refreshTables(true/*geolocation*/); });
+    return true;
+}   // openDatabase
 
 //-----------------------------------------------------------------------------
-/** Closes the database. */
+/** Runs all remaining queries and closes the database. Callbacks of queries
+ *   which were not handled yet are discarded. */
 void DatabaseConnector::destroyDatabase()
 {
     auto peers = STKHost::get()->getPeers();
     for (auto& peer : peers)
         writeDisconnectInfoTable(peer.get());
+    closeDatabase();
+}   // destroyDatabase
+
+//-----------------------------------------------------------------------------
+void DatabaseConnector::closeDatabase()
+{
+    if (m_thread.joinable())
+    {
+        std::unique_lock<std::mutex> ul(m_queries_mutex);
+        m_stop_thread = true;
+        ul.unlock();
+        m_queries_cv.notify_one();
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_callbacks_mutex);
+    m_callbacks.clear();
     if (m_db != NULL)
+    {
+        finalizeStatements();
         sqlite3_close(m_db);
-}   // destroyDatabase
+        m_db = NULL;
+    }
+}   // closeDatabase
+
+//-----------------------------------------------------------------------------
+/** Queues a query for the database thread.
+ *  \param query Function running the query (usually using easySQLQuery).
+ *  \param callback Optional function called by the lobby thread in
+ *                  handleCallbacks after the query was run, usually with
+ *                  its result captured in a shared pointer.
+ */
+void DatabaseConnector::addQuery(std::function<void()> query,
+                                 std::function<void()> callback)
+{
+    if (!m_db)
+        return;
+    std::unique_lock<std::mutex> ul(m_queries_mutex);
+    DatabaseQuery dq;
+    dq.m_query = query;
+    dq.m_callback = callback;
+    m_queries.push_back(dq);
+    ul.unlock();
+    m_queries_cv.notify_one();
+}   // addQuery
+
+//-----------------------------------------------------------------------------
+/** Called by the lobby thread to call the callbacks of finished queries. */
+void DatabaseConnector::handleCallbacks()
+{
+    std::vector<std::function<void()> > callbacks;
+    std::unique_lock<std::mutex> ul(m_callbacks_mutex);
+    std::swap(callbacks, m_callbacks);
+    ul.unlock();
+    for (auto& callback : callbacks)
+        callback();
+}   // handleCallbacks
+
+//-----------------------------------------------------------------------------
+/** The main loop of the database thread. All queries queued while the
+ *   previous ones were running are run together in a single transaction, so
+ *   the database file is only synced once for them.
+ */
+void DatabaseConnector::runQueries()
+{
+    VS::setThreadName("DatabaseConnector");
+    STKProcess::init(m_process_type);
+    std::vector<DatabaseQuery> queries;
+    while (true)
+    {
+        std::unique_lock<std::mutex> ul(m_queries_mutex);
+        m_queries_cv.wait(ul, [this]()
+            { return m_stop_thread || !m_queries.empty(); });
+        // Leave only after the remaining queries are written
+        if (m_queries.empty())
+            break;
+        std::swap(queries, m_queries);
+        ul.unlock();
+
+        const bool transaction = queries.size() > 1;
+        if (transaction)
+            easySQLQuery("BEGIN TRANSACTION;");
+        for (DatabaseQuery& dq : queries)
+            dq.m_query();
+        if (transaction)
+            easySQLQuery("COMMIT;");
+
+        std::unique_lock<std::mutex> callbacks_lock(m_callbacks_mutex);
+        for (DatabaseQuery& dq : queries)
+        {
+            if (dq.m_callback)
+                m_callbacks.push_back(dq.m_callback);
+        }
+        callbacks_lock.unlock();
+        queries.clear();
+    }
+}   // runQueries
+
+//-----------------------------------------------------------------------------
+void DatabaseConnector::finalizeStatements()
+{
+    for (auto& statement : m_statements)
+        sqlite3_finalize(statement.second);
+    m_statements.clear();
+}   // finalizeStatements
 
 //-----------------------------------------------------------------------------
 /** Runs simple query with optional bind function. If output vector pointer is
- *   not (default) nullptr, then the output is written there.
+ *   not (default) nullptr, then the output is written there. Queries with
+ *   '?'-placeholders are prepared only once and kept for later calls, so
+ *   values which change between calls should always be bound.
  *  \param query The SQL query with '?'-placeholders for values to bind.
  *  \param output The 2D vector for output rows. If nullptr, the query output
  *                is ignored.
@@ -164,8 +315,28 @@ bool DatabaseConnector::easySQLQuery(
 {
     if (!m_db)
         return false;
+    // Limit the number of kept statements in case some query is formed with
+    // placeholders and varying text
+    const unsigned MAX_STATEMENTS = 64;
     sqlite3_stmt* stmt = NULL;
-    int ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
+    bool cached = false;
+    int ret = SQLITE_OK;
+    auto it = m_statements.find(query);
+    if (it != m_statements.end())
+    {
+        stmt = it->second;
+        cached = true;
+    }
+    else
+    {
+        ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
+        if (ret == SQLITE_OK && query.find('?') != std::string::npos &&
+            m_statements.size() < MAX_STATEMENTS)
+        {
+            m_statements[query] = stmt;
+            cached = true;
+        }
+    }
     if (ret == SQLITE_OK)
     {
         if (bind_function)
@@ -189,7 +360,13 @@ bool DatabaseConnector::easySQLQuery(
                 ret = sqlite3_step(stmt);
             }
         }
-        ret = sqlite3_finalize(stmt);
+        if (cached)
+        {
+            ret = sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        else
+            ret = sqlite3_finalize(stmt);
         if (ret != SQLITE_OK)
         {
             Log::error("DatabaseConnector",
@@ -208,6 +385,286 @@ bool DatabaseConnector::easySQLQuery(
     return true;
 }   // easySQLQuery
 
+//-----------------------------------------------------------------------------
+/** Runs a query without parameters and calls a function for each row, so
+ *   that large tables are read without copying them to strings first.
+ *  \param query The SQL query.
+ *  \param row_function Called with the statement for each row.
+ *  
+eturn True if no error occurs.
+ */
+bool DatabaseConnector::readRows(const std::string& query,
+                   std::function<void(sqlite3_stmt* stmt)> row_function) const
+{
+    if (!m_db)
+        return false;
+    sqlite3_stmt* stmt = NULL;
+    int ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
+    if (ret != SQLITE_OK)
+    {
+        Log::error("DatabaseConnector",
+            "Error preparing database for query %s: %s",
+            query.c_str(), sqlite3_errmsg(m_db));
+        return false;
+    }
+    while ((ret = sqlite3_step(stmt)) == SQLITE_ROW)
+        row_function(stmt);
+    if (ret != SQLITE_DONE)
+    {
+        Log::error("DatabaseConnector", "Error reading rows of %s: %s",
+            query.c_str(), sqlite3_errmsg(m_db));
+    }
+    sqlite3_finalize(stmt);
+    return ret == SQLITE_DONE;
+}   // readRows
+
+//-----------------------------------------------------------------------------
+/** Reloads the tables kept in memory if the database was changed. Run by the
+ *   database thread.
+ *  \param geolocation Also check the IP geolocation tables, which is only
+ *                     done when polling as they are large.
+ */
+void DatabaseConnector::refreshTables(bool geolocation)
+{
+    // data_version changes when another connection (e.g. the sqlite3
+    // command line or another server) commits a change to the database
+    int64_t data_version = -1;
+    readRows("PRAGMA data_version;", [&data_version](sqlite3_stmt* stmt)
+        { data_version = sqlite3_column_int64(stmt, 0); });
+    if (data_version != m_ban_data_version || m_ban_tables_changed)
+    {
+        loadBanTables();
+        m_ban_data_version = data_version;
+    }
+    if (geolocation && data_version != m_geolocation_data_version)
+    {
+        loadGeolocationTables();
+        m_geolocation_data_version = data_version;
+    }
+}   // refreshTables
+
+//-----------------------------------------------------------------------------
+/** The columns read for the time of a ban: its start, whether it has no
+ *   expired_days and its end, as unix times. */
+static const std::string g_ban_time_columns =
+    "CAST(strftime('%s', starting_time) AS INTEGER), "
+    "expired_days IS NULL, "
+    "CAST(strftime('%s', starting_time, '+'||expired_days||' days') "
+    "AS INTEGER)";
+
+// ----------------------------------------------------------------------------
+/** Reads the columns of g_ban_time_columns starting at column. A ban with an
+ *   invalid starting time is never active. */
+static void readBanTime(sqlite3_stmt* stmt, int column, int64_t* starting_time,
+                        int64_t* expired_time)
+{
+    *starting_time = sqlite3_column_type(stmt, column) == SQLITE_NULL ?
+        std::numeric_limits<int64_t>::max() :
+        sqlite3_column_int64(stmt, column);
+    if (sqlite3_column_int(stmt, column + 1) != 0)
+        *expired_time = -1;
+    else
+        *expired_time = sqlite3_column_int64(stmt, column + 2);
+}   // readBanTime
+
+// ----------------------------------------------------------------------------
+/** Returns true if a ban is active now, the same as the condition
+ *   datetime('now') > datetime(starting_time) AND (expired_days is NULL OR
+ *   datetime(starting_time, '+'||expired_days||' days') > datetime('now')).
+ */
+template<typename BAN>
+static bool isBanActive(const BAN& ban, int64_t now)
+{
+    return now > ban.starting_time &&
+        (ban.expired_time == -1 || ban.expired_time > now);
+}   // isBanActive
+
+//-----------------------------------------------------------------------------
+/** Loads all rows of the ban tables and sorts them into the ban indexes. The
+ *   ban time is checked for each peer, so bans which start or expire later
+ *   are loaded too. Run by the database thread.
+ */
+void DatabaseConnector::loadBanTables()
+{
+    m_ban_tables_changed = false;
+    m_ip_bans.clear();
+    m_ip_ban_index.clear();
+    if (m_ip_ban_table_exists)
+    {
+        std::string query = "SELECT rowid, ip_start, ip_end, reason, "
+            "description, " + g_ban_time_columns + " FROM " +
+            ServerConfig::m_ip_ban_table.c_str() + ";";
+        readRows(query, [this](sqlite3_stmt* stmt)
+            {
+                IpBanTableData ban;
+                ban.row_id = sqlite3_column_int(stmt, 0);
+                ban.ip_start = (uint32_t)sqlite3_column_int64(stmt, 1);
+                ban.ip_end = (uint32_t)sqlite3_column_int64(stmt, 2);
+                const char* text = (const char*)sqlite3_column_text(stmt, 3);
+                ban.reason = text ? text : "";
+                text = (const char*)sqlite3_column_text(stmt, 4);
+                ban.description = text ? text : "";
+                readBanTime(stmt, 5, &ban.starting_time, &ban.expired_time);
+                m_ip_ban_index.add(ban.ip_start, ban.ip_end,
+                    (uint32_t)m_ip_bans.size());
+                m_ip_bans.push_back(ban);
+            });
+        m_ip_ban_index.finish();
+    }
+
+    m_ipv6_bans.clear();
+    m_ipv6_ban_index.clear();
+    if (m_ipv6_ban_table_exists)
+    {
+        std::string query = "SELECT rowid, ipv6_cidr, reason, description, " +
+            g_ban_time_columns + " FROM " +
+            ServerConfig::m_ipv6_ban_table.c_str() + ";";
+        readRows(query, [this](sqlite3_stmt* stmt)
+            {
+                Ipv6BanTableData ban;
+                ban.row_id = sqlite3_column_int(stmt, 0);
+                const char* text = (const char*)sqlite3_column_text(stmt, 1);
+                ban.ipv6_cidr = text ? text : "";
+                text = (const char*)sqlite3_column_text(stmt, 2);
+                ban.reason = text ? text : "";
+                text = (const char*)sqlite3_column_text(stmt, 3);
+                ban.description = text ? text : "";
+                readBanTime(stmt, 4, &ban.starting_time, &ban.expired_time);
+                // Invalid blocks never matched insideIPv6CIDR either
+                IPv6Key first, last;
+                if (!IPv6Key::fromCIDR(ban.ipv6_cidr, &first, &last))
+                    return;
+                m_ipv6_ban_index.add(first, last,
+                    (uint32_t)m_ipv6_bans.size());
+                m_ipv6_bans.push_back(ban);
+            });
+        m_ipv6_ban_index.finish();
+    }
+
+    m_online_id_bans.clear();
+    m_online_id_ban_index.clear();
+    if (m_online_id_ban_table_exists)
+    {
+        std::string query = "SELECT rowid, online_id, reason, description, " +
+            g_ban_time_columns + " FROM " +
+            ServerConfig::m_online_id_ban_table.c_str() + ";";
+        readRows(query, [this](sqlite3_stmt* stmt)
+            {
+                OnlineIdBanTableData ban;
+                ban.row_id = sqlite3_column_int(stmt, 0);
+                ban.online_id = (uint32_t)sqlite3_column_int64(stmt, 1);
+                const char* text = (const char*)sqlite3_column_text(stmt, 2);
+                ban.reason = text ? text : "";
+                text = (const char*)sqlite3_column_text(stmt, 3);
+                ban.description = text ? text : "";
+                readBanTime(stmt, 4, &ban.starting_time, &ban.expired_time);
+                m_online_id_ban_index.add(ban.online_id, ban.online_id,
+                    (uint32_t)m_online_id_bans.size());
+                m_online_id_bans.push_back(ban);
+            });
+        m_online_id_ban_index.finish();
+    }
+}   // loadBanTables
+
+//-----------------------------------------------------------------------------
+/** Returns the index of a country code in m_country_codes, adding it if
+ *   needed. */
+uint16_t DatabaseConnector::getCountryCodeId(const std::string& country_code)
+{
+    auto it = m_country_code_ids.find(country_code);
+    if (it != m_country_code_ids.end())
+        return it->second;
+    // Only about 250 country codes exist, keep the last index for any more
+    if (m_country_codes.size() == 65535)
+        return 65534;
+    uint16_t id = (uint16_t)m_country_codes.size();
+    m_country_codes.push_back(country_code);
+    m_country_code_ids[country_code] = id;
+    return id;
+}   // getCountryCodeId
+
+//-----------------------------------------------------------------------------
+/** Reloads the IP geolocation tables whose row count, sums of ranges or
+ *   sum of country codes (weighted by the start of their range, so that
+ *   swapped codes are noticed too) changed since they were loaded, which is
+ *   much faster than reading all rows of a table with all ranges of the
+ *   internet. Run by the database thread.
+ */
+void DatabaseConnector::loadGeolocationTables()
+{
+    const std::string fingerprint_query =
+        "SELECT COUNT(*), TOTAL(ip_start), TOTAL(ip_end), "
+        "TOTAL((ABS(ip_start % 65521) + 1) * "
+        "(IFNULL(unicode(country_code), 0) * 256 + "
+        "IFNULL(unicode(substr(country_code, 2, 1)), 0))) FROM ";
+    if (m_ip_geolocation_table_exists)
+    {
+        const std::string table = ServerConfig::m_ip_geolocation_table;
+        std::vector<std::vector<std::string> > output;
+        easySQLQuery(fingerprint_query + table + ";", &output);
+        std::string fingerprint = output.empty() ? "" :
+            output[0][0] + " " + output[0][1] + " " + output[0][2] + " " +
+            output[0][3];
+        if (fingerprint != m_ip_geolocation_fingerprint)
+        {
+            m_ip_geolocation_fingerprint = fingerprint;
+            m_ip_geolocation_index.clear();
+            if (!output.empty())
+            {
+                unsigned rows = 0;
+                StringUtils::fromString(output[0][0], rows);
+                m_ip_geolocation_index.reserve(rows);
+            }
+            readRows("SELECT ip_start, ip_end, country_code FROM " + table +
+                ";", [this](sqlite3_stmt* stmt)
+                {
+                    const char* text =
+                        (const char*)sqlite3_column_text(stmt, 2);
+                    m_ip_geolocation_index.add(
+                        (uint32_t)sqlite3_column_int64(stmt, 0),
+                        (uint32_t)sqlite3_column_int64(stmt, 1),
+                        getCountryCodeId(text ? text : ""));
+                });
+            m_ip_geolocation_index.finish();
+            Log::info("DatabaseConnector", "Loaded %d ranges of %s.",
+                (int)m_ip_geolocation_index.size(), table.c_str());
+        }
+    }
+    if (m_ipv6_geolocation_table_exists)
+    {
+        const std::string table = ServerConfig::m_ipv6_geolocation_table;
+        std::vector<std::vector<std::string> > output;
+        easySQLQuery(fingerprint_query + table + ";", &output);
+        std::string fingerprint = output.empty() ? "" :
+            output[0][0] + " " + output[0][1] + " " + output[0][2] + " " +
+            output[0][3];
+        if (fingerprint != m_ipv6_geolocation_fingerprint)
+        {
+            m_ipv6_geolocation_fingerprint = fingerprint;
+            m_ipv6_geolocation_index.clear();
+            if (!output.empty())
+            {
+                unsigned rows = 0;
+                StringUtils::fromString(output[0][0], rows);
+                m_ipv6_geolocation_index.reserve(rows);
+            }
+            readRows("SELECT ip_start, ip_end, country_code FROM " + table +
+                ";", [this](sqlite3_stmt* stmt)
+                {
+                    const char* text =
+                        (const char*)sqlite3_column_text(stmt, 2);
+                    m_ipv6_geolocation_index.add(
+                        sqlite3_column_int64(stmt, 0),
+                        sqlite3_column_int64(stmt, 1),
+                        getCountryCodeId(text ? text : ""));
+                });
+            m_ipv6_geolocation_index.finish();
+            Log::info("DatabaseConnector", "Loaded %d ranges of %s.",
+                (int)m_ipv6_geolocation_index.size(), table.c_str());
+        }
+    }
+}   // loadGeolocationTables
+
 //-----------------------------------------------------------------------------
 /** Performs a query to determine if a certain table exists.
  *  \param table The searched name.
@@ -244,8 +701,8 @@ void DatabaseConnector::checkTableExists(const std::string& table, bool& result)
 }   // checkTableExists
 
 //-----------------------------------------------------------------------------
-/** Queries the database's IP mapping to determine the country code for an
- *   address.
+/** Uses the database's IP mapping to determine the country code for an
+ *   address. Only called by the database thread.
  *  \param addr Queried address.
  *  \return A country code string if the address is found in the mapping,
  *          and an empty string otherwise.
@@ -254,26 +711,13 @@ std::string DatabaseConnector::ip2Country(const SocketAddress& addr) const
 {
     if (!m_db || !m_ip_geolocation_table_exists || addr.isLAN())
         return "";
-
-    std::string cc_code;
-    std::string query = StringUtils::insertValues(
-        "SELECT country_code FROM %s "
-        "WHERE `ip_start` <= %d AND `ip_end` >= %d "
-        "ORDER BY `ip_start` DESC LIMIT 1;",
-        ServerConfig::m_ip_geolocation_table.c_str(), addr.getIP(),
-        addr.getIP());
-
-    std::vector<std::vector<std::string>> output;
-    if (easySQLQuery(query, &output) && !output.empty())
-    {
-        cc_code = output[0][0];
-    }
-    return cc_code;
+    const uint16_t* id = m_ip_geolocation_index.find(addr.getIP());
+    return id ? m_country_codes[*id] : "";
 }   // ip2Country
 
 //-----------------------------------------------------------------------------
-/** Queries the database's IPv6 mapping to determine the country code for an
- *   address.
+/** Uses the database's IPv6 mapping to determine the country code for an
+ *   address. Only called by the database thread.
  *  \param addr Queried address.
  *  \return A country code string if the address is found in the mapping,
  *          and an empty string otherwise.
@@ -282,22 +726,10 @@ std::string DatabaseConnector::ipv62Country(const SocketAddress& addr) const
 {
     if (!m_db || !m_ipv6_geolocation_table_exists)
         return "";
-
-    std::string cc_code;
     const std::string& ipv6 = addr.toString(false/*show_port*/);
-    std::string query = StringUtils::insertValues(
-        "SELECT country_code FROM %s "
-        "WHERE `ip_start` <= upperIPv6(\"%s\") AND `ip_end` >= upperIPv6(\"%s\") "
-        "ORDER BY `ip_start` DESC LIMIT 1;",
-        ServerConfig::m_ipv6_geolocation_table.c_str(), ipv6.c_str(),
-        ipv6.c_str());
-
-    std::vector<std::vector<std::string>> output;
-    if (easySQLQuery(query, &output) && !output.empty())
-    {
-        cc_code = output[0][0];
-    }
-    return cc_code;
+    const uint16_t* id =
+        m_ipv6_geolocation_index.find(upperIPv6(ipv6.c_str()));
+    return id ? m_country_codes[*id] : "";
 }   // ipv62Country
 
 // ----------------------------------------------------------------------------
@@ -369,28 +801,53 @@ sqlite3_extension_init(sqlite3* db, char** pzErrMsg,
  *  \param peer Disconnecting peer.
  */
 void DatabaseConnector::writeDisconnectInfoTable(STKPeer* peer)
+{
+    writeDisconnectInfo(peer->getHostId(), peer->getAveragePing(),
+        peer->getPacketLoss());
+}   // writeDisconnectInfoTable
+
+//-----------------------------------------------------------------------------
+void DatabaseConnector::writeDisconnectInfo(uint32_t host_id, int ping,
+                                            int packet_loss)
 {
     if (m_server_stats_table.empty())
         return;
+    std::shared_ptr<BinderCollection> coll = std::make_shared<BinderCollection>();
     std::string query = StringUtils::insertValues(
         "UPDATE %s SET disconnected_time = datetime('now'), "
-        "ping = %d, packet_loss = %d "
-        "WHERE host_id = %u;", m_server_stats_table.c_str(),
-        peer->getAveragePing(), peer->getPacketLoss(),
-        peer->getHostId());
-    easySQLQuery(query);
-}   // writeDisconnectInfoTable
+        "ping = %s, packet_loss = %s "
+        "WHERE host_id = %s;", m_server_stats_table.c_str(),
+        Binder(coll, (int64_t)ping, "ping"),
+        Binder(coll, (int64_t)packet_loss, "packet_loss"),
+        Binder(coll, (int64_t)host_id, "host_id"));
+    auto bind_function = coll->getBindFunction();
+    addQuery([this, query, bind_function]()
+        { easySQLQuery(query, nullptr, bind_function); });
+}   // writeDisconnectInfo
 
 //-----------------------------------------------------------------------------
 /** Creates necessary tables and views if they don't exist yet in the database.
  *   As the function is invoked during the server launch, it also updates rows
  *   related to players whose disconnection time wasn't written, and loads
- *   last used host id.
+ *   last used host id. The lobby waits for the database thread here, as the
+ *   host id is needed before any peer connects.
  */
 void DatabaseConnector::initServerStatsTable()
 {
     if (!ServerConfig::m_sql_management || !m_db)
         return;
+    std::promise<uint32_t> last_host_id;
+    addQuery([this, &last_host_id]()
+        { last_host_id.set_value(createServerStatsTable()); });
+    STKHost::get()->setNextHostId(last_host_id.get_future().get());
+}   // initServerStatsTable
+
+//-----------------------------------------------------------------------------
+/** Run by the database thread for initServerStatsTable.
+ *  \return The last used host id.
+ */
+uint32_t DatabaseConnector::createServerStatsTable()
+{
     std::string table_name = std::string("v") +
         StringUtils::toString(ServerConfig::m_server_db_version) + "_" +
         ServerConfig::m_server_uid + "_stats";
@@ -419,7 +876,7 @@ void DatabaseConnector::initServerStatsTable()
         m_server_stats_table = table_name;
 
     if (m_server_stats_table.empty())
-        return;
+        return 0;
 
     // Extra default table _countries:
     // Server owner need to initialise this table himself, check NETWORKING.md
@@ -559,15 +1016,14 @@ void DatabaseConnector::initServerStatsTable()
         m_server_stats_table = "";
     }
 
-    STKHost::get()->setNextHostId(last_host_id);
-
     // Update disconnected time (if stk crashed it will not be written)
     query = StringUtils::insertValues(
         "UPDATE %s SET disconnected_time = datetime('now') "
         "WHERE connected_time = disconnected_time;",
         m_server_stats_table.c_str());
     easySQLQuery(query);
-}   // initServerStatsTable
+    return last_host_id;
+}   // createServerStatsTable
 
 //-----------------------------------------------------------------------------
 /** Writes a report of one player about another player.
@@ -576,12 +1032,13 @@ void DatabaseConnector::initServerStatsTable()
  *  \param reporting Peer that is reported.
  *  \param reporting_npp Player profile that is reported.
  *  \param info The report message.
- *  \return True if the database query succeeded.
+ *  \param callback Called by the lobby thread with true if the database
+ *                  query succeeded.
  */
-bool DatabaseConnector::writeReport(
+void DatabaseConnector::writeReport(
        STKPeer* reporter, std::shared_ptr<NetworkPlayerProfile> reporter_npp,
        STKPeer* reporting, std::shared_ptr<NetworkPlayerProfile> reporting_npp,
-       irr::core::stringw& info)
+       irr::core::stringw& info, std::function<void(bool)> callback)
 {
     std::string query;
 
@@ -624,58 +1081,13 @@ bool DatabaseConnector::writeReport(
             Binder(coll, StringUtils::wideToUtf8(reporting_npp->getName()), "reporting_name")
         );
     }
-    return easySQLQuery(query, nullptr, coll->getBindFunction());
+    auto bind_function = coll->getBindFunction();
+    std::shared_ptr<bool> written = std::make_shared<bool>(false);
+    addQuery([this, query, bind_function, written]()
+        { *written = easySQLQuery(query, nullptr, bind_function); },
+        [callback, written]() { callback(*written); });
 }   // writeReport
 
-//-----------------------------------------------------------------------------
-/** Gets the rows from IPv4 ban table, either all of them (for polling
- *   purposes), or those describing a certain address (if only one peer has to
- *   be checked).
- *  \param ip The IP address to check the database for. If zero, all rows
- *            will be given.
- *  \return A vector of rows in the form of IpBanTableData structures.
- */
-std::vector<DatabaseConnector::IpBanTableData>
-DatabaseConnector::getIpBanTableData(uint32_t ip) const
-{
-    std::vector<IpBanTableData> result;
-    if (!m_ip_ban_table_exists)
-    {
-        return result;
-    }
-    bool single_ip = (ip != 0);
-    std::ostringstream oss;
-    oss << "SELECT rowid, ip_start, ip_end, reason, description FROM ";
-    oss << (std::string)ServerConfig::m_ip_ban_table << " WHERE ";
-    if (single_ip)
-        oss << "ip_start <= " << ip << " AND ip_end >= " << ip << " AND ";
-    oss << "datetime('now') > datetime(starting_time) AND "
-        "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now'))";
-    if (single_ip)
-        oss << " LIMIT 1";
-    oss << ";";
-    std::string query = oss.str();
-
-    std::vector<std::vector<std::string>> output;
-    easySQLQuery(query, &output);
-
-    for (std::vector<std::string>& row: output)
-    {
-        IpBanTableData element;
-        if (!StringUtils::fromString(row[0], element.row_id))
-            continue;
-        if (!StringUtils::fromString(row[1], element.ip_start))
-            continue;
-        if (!StringUtils::fromString(row[2], element.ip_end))
-            continue;
-        element.reason = row[3];
-        element.description = row[4];
-        result.push_back(element);
-    }
-    return result;
-}   // getIpBanTableData
-
 //-----------------------------------------------------------------------------
 /** For a peer that turned out to be banned by IPv4, this function increases
  *   the trigger count.
@@ -684,66 +1096,16 @@ DatabaseConnector::getIpBanTableData(uint32_t ip) const
  */
 void DatabaseConnector::increaseIpBanTriggerCount(uint32_t ip_start, uint32_t ip_end) const
 {
+    std::shared_ptr<BinderCollection> coll = std::make_shared<BinderCollection>();
     std::string query = StringUtils::insertValues(
         "UPDATE %s SET trigger_count = trigger_count + 1, "
         "last_trigger = datetime('now') "
-        "WHERE ip_start = %u AND ip_end = %u;",
-        ServerConfig::m_ip_ban_table.c_str(), ip_start, ip_end);
-    easySQLQuery(query);
-}   // getIpBanTableData
-
-//-----------------------------------------------------------------------------
-/** Gets the rows from IPv6 ban table, either all of them (for polling
- *   purposes), or those describing a certain address (if only one peer has to
- *   be checked).
- *  \param ip The IPv6 address to check the database for. If empty, all rows
- *            will be given.
- *  \return A vector of rows in the form of Ipv6BanTableData structures.
- */
-std::vector<DatabaseConnector::Ipv6BanTableData>
-DatabaseConnector::getIpv6BanTableData(std::string ipv6) const
-{
-    std::vector<Ipv6BanTableData> result;
-    if (!m_ipv6_ban_table_exists)
-    {
-        return result;
-    }
-    bool single_ip = !ipv6.empty();
-    std::string query;
-    std::shared_ptr<BinderCollection> coll = std::make_shared<BinderCollection>();
-
-    query = StringUtils::insertValues(
-        "SELECT rowid, ipv6_cidr, reason, description FROM %s WHERE ",
-        ServerConfig::m_ipv6_ban_table.c_str()
-    );
-    if (single_ip)
-        query += StringUtils::insertValues(
-            "insideIPv6CIDR(ipv6_cidr, %s) = 1 AND ",
-            Binder(coll, ipv6, "ipv6")
-        );
-
-    query += "datetime('now') > datetime(starting_time) AND "
-        "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now'))";
-
-    if (single_ip)
-        query += " LIMIT 1;";
-
-    std::vector<std::vector<std::string>> output;
-    easySQLQuery(query, &output, coll->getBindFunction());
-
-    for (std::vector<std::string>& row: output)
-    {
-        Ipv6BanTableData element;
-        if (!StringUtils::fromString(row[0], element.row_id))
-            continue;
-        element.ipv6_cidr = row[1];
-        element.reason = row[2];
-        element.description = row[3];
-        result.push_back(element);
-    }
-    return result;
-}   // getIpv6BanTableData
+        "WHERE ip_start = %s AND ip_end = %s;",
+        ServerConfig::m_ip_ban_table.c_str(),
+        Binder(coll, (int64_t)ip_start, "ip_start"),
+        Binder(coll, (int64_t)ip_end, "ip_end"));
+    easySQLQuery(query, nullptr, coll->getBindFunction());
+}   // increaseIpBanTriggerCount
 
 //-----------------------------------------------------------------------------
 /** For a peer that turned out to be banned by IPv6, this function increases
@@ -763,53 +1125,6 @@ void DatabaseConnector::increaseIpv6BanTriggerCount(const std::string& ipv6_cidr
     easySQLQuery(query, nullptr, coll->getBindFunction());
 }   // increaseIpv6BanTriggerCount
 
-//-----------------------------------------------------------------------------
-/** Gets the rows from online id ban table, either all of them (for polling
- *   purposes), or those describing a certain online id (if only one peer has
- *   to be checked).
- *  \param online_id The online id to check the database for. If empty, all
- *                   rows will be given.
- *  \return A vector of rows in the form of OnlineIdBanTableData structures.
- */
-std::vector<DatabaseConnector::OnlineIdBanTableData>
-DatabaseConnector::getOnlineIdBanTableData(uint32_t online_id) const
-{
-    std::vector<OnlineIdBanTableData> result;
-    if (!m_online_id_ban_table_exists)
-    {
-        return result;
-    }
-    bool single_id = (online_id != 0);
-    std::ostringstream oss;
-    oss << "SELECT rowid, online_id, reason, description FROM ";
-    oss << (std::string)ServerConfig::m_online_id_ban_table;
-    oss << " WHERE ";
-    if (single_id)
-        oss << "online_id = " << online_id << " AND ";
-    oss << "datetime('now') > datetime(starting_time) AND "
-        "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now'))";
-    if (single_id)
-        oss << " LIMIT 1";
-    oss << ";";
-    std::string query = oss.str();
-    sqlite3_exec(m_db, query.c_str(),
-        [](void* ptr, int count, char** data, char** columns)
-        {
-            std::vector<OnlineIdBanTableData>* vec = (std::vector<OnlineIdBanTableData>*)ptr;
-            OnlineIdBanTableData element;
-            if (!StringUtils::fromString(data[0], element.row_id))
-                return 0;
-            if (!StringUtils::fromString(data[1], element.online_id))
-                return 0;
-            element.reason = std::string(data[2]);
-            element.description = std::string(data[3]);
-            vec->push_back(element);
-            return 0;
-        }, &result, NULL);
-    return result;
-}   // getOnlineIdBanTableData
-
 //-----------------------------------------------------------------------------
 /** For a peer that turned out to be banned by online id, this function
  *   increases the trigger count.
@@ -817,14 +1132,172 @@ DatabaseConnector::getOnlineIdBanTableData(uint32_t online_id) const
  */
 void DatabaseConnector::increaseOnlineIdBanTriggerCount(uint32_t online_id) const
 {
+    std::shared_ptr<BinderCollection> coll = std::make_shared<BinderCollection>();
     std::string query = StringUtils::insertValues(
         "UPDATE %s SET trigger_count = trigger_count + 1, "
         "last_trigger = datetime('now') "
-        "WHERE online_id = %u;",
-        ServerConfig::m_online_id_ban_table.c_str(), online_id);
-    easySQLQuery(query);
+        "WHERE online_id = %s;",
+        ServerConfig::m_online_id_ban_table.c_str(),
+        Binder(coll, (int64_t)online_id, "online_id"));
+    easySQLQuery(query, nullptr, coll->getBindFunction());
 }   // increaseOnlineIdBanTriggerCount
 
+//-----------------------------------------------------------------------------
+/** Finds an active ban of a peer in the ban indexes. Run by the database
+ *   thread.
+ *  \param addr Address of the peer.
+ *  \param check_online_id If the online id ban table should be checked.
+ *  \param online_id Online id of the peer.
+ *  \param result The ban found (if any) is written here.
+ *  \param increase_trigger_count Increase the trigger count of the ban.
+ *  \return True if the peer is banned.
+ */
+bool DatabaseConnector::findBan(const SocketAddress& addr,
+    bool check_online_id, uint32_t online_id, ConnectionCheck* result,
+    bool increase_trigger_count)
+{
+    const int64_t now = (int64_t)time(NULL);
+    if (!addr.isIPv6() && m_ip_ban_table_exists)
+    {
+        const uint32_t* row = m_ip_ban_index.find(addr.getIP(),
+            [this, now](uint32_t i) { return isBanActive(m_ip_bans[i], now); });
+        if (row)
+        {
+            const IpBanTableData& ban = m_ip_bans[*row];
+            result->m_banned_by = "IP";
+            result->m_row_id = ban.row_id;
+            result->m_reason = ban.reason;
+            result->m_description = ban.description;
+            if (increase_trigger_count)
+                increaseIpBanTriggerCount(ban.ip_start, ban.ip_end);
+            return true;
+        }
+    }
+    IPv6Key key;
+    if (addr.isIPv6() && m_ipv6_ban_table_exists &&
+        IPv6Key::fromString(addr.toString(false), &key))
+    {
+        const uint32_t* row = m_ipv6_ban_index.find(key,
+            [this, now](uint32_t i)
+            { return isBanActive(m_ipv6_bans[i], now); });
+        if (row)
+        {
+            const Ipv6BanTableData& ban = m_ipv6_bans[*row];
+            result->m_banned_by = "IPv6";
+            result->m_row_id = ban.row_id;
+            result->m_reason = ban.reason;
+            result->m_description = ban.description;
+            if (increase_trigger_count)
+                increaseIpv6BanTriggerCount(ban.ipv6_cidr);
+            return true;
+        }
+    }
+    if (check_online_id && m_online_id_ban_table_exists)
+    {
+        const uint32_t* row = m_online_id_ban_index.find(online_id,
+            [this, now](uint32_t i)
+            { return isBanActive(m_online_id_bans[i], now); });
+        if (row)
+        {
+            const OnlineIdBanTableData& ban = m_online_id_bans[*row];
+            result->m_banned_by = "online id";
+            result->m_row_id = ban.row_id;
+            result->m_reason = ban.reason;
+            result->m_description = ban.description;
+            if (increase_trigger_count)
+                increaseOnlineIdBanTriggerCount(online_id);
+            return true;
+        }
+    }
+    return false;
+}   // findBan
+
+//-----------------------------------------------------------------------------
+/** Checks the ban tables for a connecting peer (increasing the trigger count
+ *   of the matching ban), and gets its country code if it is not banned.
+ *  \param addr Address of the peer.
+ *  \param online_id Online id of the peer, 0 if it has none.
+ *  \param callback Called by the lobby thread with the result.
+ */
+void DatabaseConnector::checkConnection(const SocketAddress& addr,
+    uint32_t online_id, std::function<void(const ConnectionCheck&)> callback)
+{
+    std::shared_ptr<ConnectionCheck> result =
+        std::make_shared<ConnectionCheck>();
+    result->m_row_id = -1;
+    if (!m_db)
+    {
+        callback(*result);
+        return;
+    }
+    SocketAddress address = addr;
+    addQuery([this, address, online_id, result]()
+        {
+            refreshTables(false/*geolocation*/);
+            if (findBan(address, online_id != 0, online_id, result.get(),
+                true/*increase_trigger_count*/))
+                return;
+            result->m_country_code = address.isIPv6() ?
+                ipv62Country(address) : ip2Country(address);
+        },
+        [callback, result]() { callback(*result); });
+}   // checkConnection
+
+//-----------------------------------------------------------------------------
+/** Checks all connected peers against the ban tables for polling, which
+ *   also reloads the tables if they were changed.
+ *  \param kick Called by the lobby thread for each banned peer which is
+ *              still connected.
+ */
+void DatabaseConnector::checkBannedPeers(std::function<void(
+    std::shared_ptr<STKPeer>, const ConnectionCheck&)> kick)
+{
+    if (!m_db)
+        return;
+    struct BannedPeerCheck
+    {
+        std::weak_ptr<STKPeer> m_peer;
+        SocketAddress m_address;
+        bool m_has_online_id;
+        uint32_t m_online_id;
+        ConnectionCheck m_result;
+    };
+    std::shared_ptr<std::vector<BannedPeerCheck> > checks =
+        std::make_shared<std::vector<BannedPeerCheck> >();
+    for (std::shared_ptr<STKPeer>& p : STKHost::get()->getPeers())
+    {
+        if (p->isAIPeer())
+            continue;
+        BannedPeerCheck check;
+        check.m_peer = p;
+        check.m_address = p->getAddress();
+        check.m_has_online_id = !p->getPlayerProfiles().empty();
+        check.m_online_id = check.m_has_online_id ?
+            p->getPlayerProfiles()[0]->getOnlineId() : 0;
+        check.m_result.m_row_id = -1;
+        checks->push_back(check);
+    }
+    addQuery([this, checks]()
+        {
+            refreshTables(true/*geolocation*/);
+            for (BannedPeerCheck& check : *checks)
+            {
+                findBan(check.m_address, check.m_has_online_id,
+                    check.m_online_id, &check.m_result,
+                    false/*increase_trigger_count*/);
+            }
+        },
+        [kick, checks]()
+        {
+            for (BannedPeerCheck& check : *checks)
+            {
+                std::shared_ptr<STKPeer> peer = check.m_peer.lock();
+                if (peer && !check.m_result.m_banned_by.empty())
+                    kick(peer, check.m_result);
+            }
+        });
+}   // checkBannedPeers
+
 //-----------------------------------------------------------------------------
 /** Clears reports that are older than a certain number of days
  *   (specified in the server config).
@@ -840,7 +1313,7 @@ void DatabaseConnector::clearOldReports()
             "(reported_time, '+%f days') < datetime('now');",
             ServerConfig::m_player_reports_table.c_str(),
             ServerConfig::m_player_reports_expired_days);
-        easySQLQuery(query);
+        addQuery([this, query]() { easySQLQuery(query); });
     }
 }   // clearOldReports
 
@@ -873,7 +1346,7 @@ void DatabaseConnector::setDisconnectionTimes(std::vector<uint32_t>& present_hos
         oss << ");";
     }
     std::string query = oss.str();
-    easySQLQuery(query);
+    addQuery([this, query]() { easySQLQuery(query); });
 }   // setDisconnectionTimes
 
 //-----------------------------------------------------------------------------
@@ -890,7 +1363,11 @@ void DatabaseConnector::saveAddressToIpBanTable(const SocketAddress& addr)
         "INSERT INTO %s (ip_start, ip_end) "
         "VALUES (%u, %u);",
         ServerConfig::m_ip_ban_table.c_str(), addr.getIP(), addr.getIP());
-    easySQLQuery(query);
+    addQuery([this, query]()
+        {
+            easySQLQuery(query);
+            m_ban_tables_changed = true;
+        });
 }   // saveAddressToIpBanTable
 
 //-----------------------------------------------------------------------------
@@ -905,27 +1382,43 @@ void DatabaseConnector::onPlayerJoinQueries(std::shared_ptr<STKPeer> peer,
 {
     if (m_server_stats_table.empty() || peer->isAIPeer())
         return;
+    auto version_os = StringUtils::extractVersionOS(peer->getUserVersion());
+    writePlayerJoin(peer->getHostId(), peer->getAddress(), online_id,
+        StringUtils::wideToUtf8(peer->getPlayerProfiles()[0]->getName()),
+        player_count, country_code, version_os.first, version_os.second,
+        peer->getAveragePing());
+}   // onPlayerJoinQueries
+
+//-----------------------------------------------------------------------------
+/** Queues the insertion of a joining player for onPlayerJoinQueries, all
+ *   values are bound so the statement is prepared only once. */
+void DatabaseConnector::writePlayerJoin(uint32_t host_id,
+    const SocketAddress& addr, uint32_t online_id, const std::string& name,
+    unsigned player_count, const std::string& country_code,
+    const std::string& version, const std::string& os, int ping)
+{
+    if (m_server_stats_table.empty())
+        return;
     std::string query;
     std::shared_ptr<BinderCollection> coll = std::make_shared<BinderCollection>();
-    auto version_os = StringUtils::extractVersionOS(peer->getUserVersion());
-    if (ServerConfig::m_ipv6_connection && peer->getAddress().isIPv6())
+    if (ServerConfig::m_ipv6_connection && addr.isIPv6())
     {
         query = StringUtils::insertValues(
             "INSERT INTO %s "
             "(host_id, ip, ipv6, port, online_id, username, player_num, "
             "country_code, version, os, ping) "
-            "VALUES (%u, 0, \"%s\", %u, %u, %s, %u, %s, %s, %s, %u);",
+            "VALUES (%s, 0, %s, %s, %s, %s, %s, %s, %s, %s, %s);",
             m_server_stats_table.c_str(),
-            peer->getHostId(),
-            peer->getAddress().toString(false),
-            peer->getAddress().getPort(),
-            online_id,
-            Binder(coll, StringUtils::wideToUtf8(peer->getPlayerProfiles()[0]->getName()), "player_name"),
-            player_count,
+            Binder(coll, (int64_t)host_id, "host_id"),
+            Binder(coll, addr.toString(false), "ipv6"),
+            Binder(coll, (int64_t)addr.getPort(), "port"),
+            Binder(coll, (int64_t)online_id, "online_id"),
+            Binder(coll, name, "player_name"),
+            Binder(coll, (int64_t)player_count, "player_num"),
             Binder(coll, country_code, "country_code", true),
-            Binder(coll, version_os.first, "version"),
-            Binder(coll, version_os.second, "os"),
-            peer->getAveragePing()
+            Binder(coll, version, "version"),
+            Binder(coll, os, "os"),
+            Binder(coll, (int64_t)ping, "ping")
         );
     }
     else
@@ -934,54 +1427,327 @@ void DatabaseConnector::onPlayerJoinQueries(std::shared_ptr<STKPeer> peer,
             "INSERT INTO %s "
             "(host_id, ip, port, online_id, username, player_num, "
             "country_code, version, os, ping) "
-            "VALUES (%u, %u, %u, %u, %s, %u, %s, %s, %s, %u);",
+            "VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s, %s);",
             m_server_stats_table.c_str(),
-            peer->getHostId(),
-            peer->getAddress().getIP(),
-            peer->getAddress().getPort(),
-            online_id,
-            Binder(coll, StringUtils::wideToUtf8(peer->getPlayerProfiles()[0]->getName()), "player_name"),
-            player_count,
+            Binder(coll, (int64_t)host_id, "host_id"),
+            Binder(coll, (int64_t)addr.getIP(), "ip"),
+            Binder(coll, (int64_t)addr.getPort(), "port"),
+            Binder(coll, (int64_t)online_id, "online_id"),
+            Binder(coll, name, "player_name"),
+            Binder(coll, (int64_t)player_count, "player_num"),
             Binder(coll, country_code, "country_code", true),
-            Binder(coll, version_os.first, "version"),
-            Binder(coll, version_os.second, "os"),
-            peer->getAveragePing()
+            Binder(coll, version, "version"),
+            Binder(coll, os, "os"),
+            Binder(coll, (int64_t)ping, "ping")
         );
     }
-    easySQLQuery(query, nullptr, coll->getBindFunction());
-}   // onPlayerJoinQueries
+    auto bind_function = coll->getBindFunction();
+    addQuery([this, query, bind_function]()
+        { easySQLQuery(query, nullptr, bind_function); });
+}   // writePlayerJoin
 
 //-----------------------------------------------------------------------------
-/** Prints all rows of the IPv4 ban table. Called from the network console. */
+/** Prints all rows of the IPv4 ban table. Called from the network console,
+ *   the rows are printed by the database thread. */
 void DatabaseConnector::listBanTable()
 {
     if (!m_db)
         return;
-    auto printer = [](void* data, int argc, char** argv, char** name)
+    addQuery([this]()
+        {
+            auto printer = [](void* data, int argc, char** argv, char** name)
+            {
+                for (int i = 0; i < argc; i++)
+                {
+                    std::cout << name[i] << " = "
+                        << (argv[i] ? argv[i] : "NULL") << "\n";
+                }
+                std::cout << "\n";
+                return 0;
+            };
+            if (m_ip_ban_table_exists)
+            {
+                std::string query = "SELECT * FROM ";
+                query += ServerConfig::m_ip_ban_table;
+                query += ";";
+                std::cout << "IP ban list:\n";
+                sqlite3_exec(m_db, query.c_str(), printer, NULL, NULL);
+            }
+            if (m_online_id_ban_table_exists)
+            {
+                std::string query = "SELECT * FROM ";
+                query += ServerConfig::m_online_id_ban_table;
+                query += ";";
+                std::cout << "Online Id ban list:\n";
+                sqlite3_exec(m_db, query.c_str(), printer, NULL, NULL);
+            }
+        });
+}   // listBanTable
+
+//-----------------------------------------------------------------------------
+/** Replays 1000 connections and disconnections against a database file with
+ *   ban and IP geolocation tables, and logs the time the lobby thread needed
+ *   to queue the queries, compared to waiting for each query like a lobby
+ *   running them itself. Then checks that ban tables changed by another
+ *   connection are reloaded, that country code lookups give the same result
+ *   as range queries, and that changed country codes are reloaded.
+ */
+void DatabaseConnector::unitTesting()
+{
+    const unsigned CONNECTIONS = 1000;
+    const unsigned WAITING_CONNECTIONS = 100;
+    const unsigned BANNED = 10;
+    // A public address range, LAN addresses have no country code
+    const uint32_t FIRST_IP = 0x5d000000;
+
+    const std::string path =
+        file_manager->getUserConfigFile("unit_test_database.db");
+    file_manager->removeFile(path);
+    sqlite3* db = NULL;
+    int ret = sqlite3_open_v2(path.c_str(), &db,
+        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (ret != SQLITE_OK)
     {
-        for (int i = 0; i < argc; i++)
+        Log::error("DatabaseConnector", "Cannot create %s, skipping test.",
+            path.c_str());
+        sqlite3_close(db);
+        return;
+    }
+    std::string tables = StringUtils::insertValues(
+        "CREATE TABLE %s (ip_start INTEGER UNSIGNED NOT NULL UNIQUE, "
+        "ip_end INTEGER UNSIGNED NOT NULL UNIQUE, "
+        "starting_time TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+        "expired_days REAL NULL DEFAULT NULL, "
+        "reason TEXT NOT NULL DEFAULT '', "
+        "description TEXT NOT NULL DEFAULT '', "
+        "trigger_count INTEGER UNSIGNED NOT NULL DEFAULT 0, "
+        "last_trigger TIMESTAMP NULL DEFAULT NULL);"
+        "CREATE TABLE %s (ip_start INTEGER UNSIGNED NOT NULL PRIMARY KEY "
+        "UNIQUE, ip_end INTEGER UNSIGNED NOT NULL UNIQUE, "
+        "latitude REAL NOT NULL, longitude REAL NOT NULL, "
+        "country_code TEXT NOT NULL) WITHOUT ROWID;"
+        "INSERT INTO %s (ip_start, ip_end, starting_time, reason) "
+        "VALUES (%u, %u, datetime('now', '-1 days'), 'test');"
+        "INSERT INTO %s VALUES (%u, %u, 0.0, 0.0, 'XX');",
+        ServerConfig::m_ip_ban_table.c_str(),
+        ServerConfig::m_ip_geolocation_table.c_str(),
+        ServerConfig::m_ip_ban_table.c_str(), FIRST_IP,
+        FIRST_IP + BANNED - 1,
+        ServerConfig::m_ip_geolocation_table.c_str(), FIRST_IP,
+        FIRST_IP + 0xffffff);
+    ret = sqlite3_exec(db, tables.c_str(), NULL, NULL, NULL);
+    sqlite3_close(db);
+    assert(ret == SQLITE_OK);
+
+    DatabaseConnector dc;
+    bool opened = dc.openDatabase(path);
+    assert(opened);
+    assert(dc.hasIpBanTable());
+    std::promise<uint32_t> last_host_id;
+    dc.addQuery([&dc, &last_host_id]()
+        { last_host_id.set_value(dc.createServerStatsTable()); });
+    uint32_t host_id = last_host_id.get_future().get();
+    assert(host_id == 0);
+    assert(dc.hasServerStatsTable());
+
+    unsigned checked = 0;
+    unsigned banned = 0;
+    uint64_t max_call_us = 0;
+    // Connects and disconnects host id i, and returns the time needed
+    auto connect = [&](uint32_t i)
         {
-            std::cout << name[i] << " = " << (argv[i] ? argv[i] : "NULL")
-                << "\n";
-        }
-        std::cout << "\n";
-        return 0;
-    };
-    if (m_ip_ban_table_exists)
+            const uint64_t start = StkTime::getMonoTimeUs();
+            SocketAddress addr(FIRST_IP + i, 2759);
+            dc.checkConnection(addr, 0,
+                [&checked, &banned](const ConnectionCheck& check)
+                {
+                    checked++;
+                    if (!check.m_banned_by.empty())
+                        banned++;
+                    else
+                        assert(check.m_country_code == "XX");
+                });
+            if (i >= BANNED)
+            {
+                dc.writePlayerJoin(i, addr, i, "player", 1, "XX", "1.4",
+                    "Linux", 50);
+                dc.writeDisconnectInfo(i, 50, 0);
+            }
+            dc.handleCallbacks();
+            return StkTime::getMonoTimeUs() - start;
+        };
+    // Waits for all queued queries and handles their callbacks, which are
+    // called in order
+    auto wait = [&dc]()
+        {
+            bool done = false;
+            dc.addQuery([]() {}, [&done]() { done = true; });
+            while (!done)
+            {
+                dc.handleCallbacks();
+                std::this_thread::yield();
+            }
+        };
+
+    uint64_t start = StkTime::getMonoTimeUs();
+    for (uint32_t i = 0; i < CONNECTIONS; i++)
     {
-        std::string query = "SELECT * FROM ";
-        query += ServerConfig::m_ip_ban_table;
-        query += ";";
-        std::cout << "IP ban list:\n";
-        sqlite3_exec(m_db, query.c_str(), printer, NULL, NULL);
+        uint64_t call_us = connect(i);
+        if (call_us > max_call_us)
+            max_call_us = call_us;
     }
-    if (m_online_id_ban_table_exists)
+    const uint64_t queued_us = StkTime::getMonoTimeUs() - start;
+    wait();
+    const uint64_t async_us = StkTime::getMonoTimeUs() - start;
+    assert(checked == CONNECTIONS);
+    assert(banned == BANNED);
+
+    // The same connections waiting for each query, which is what the lobby
+    // did when it ran the queries itself
+    start = StkTime::getMonoTimeUs();
+    for (uint32_t i = CONNECTIONS; i < CONNECTIONS + WAITING_CONNECTIONS; i++)
     {
-        std::string query = "SELECT * FROM ";
-        query += ServerConfig::m_online_id_ban_table;
-        query += ";";
-        std::cout << "Online Id ban list:\n";
-        sqlite3_exec(m_db, query.c_str(), printer, NULL, NULL);
+        connect(i);
+        wait();
     }
-}   // listBanTable
+    const uint64_t waiting_us = StkTime::getMonoTimeUs() - start;
+
+    std::vector<std::vector<std::string> > output;
+    std::string query = StringUtils::insertValues(
+        "SELECT COUNT(*) FROM %s WHERE ping = 50 AND country_code = 'XX';",
+        dc.m_server_stats_table.c_str());
+    dc.addQuery([&dc, &output, query]() { dc.easySQLQuery(query, &output); });
+    wait();
+    assert(output.size() == 1 && output[0].size() == 1);
+    assert(output[0][0] == StringUtils::toString(
+        CONNECTIONS + WAITING_CONNECTIONS - BANNED));
+    query = StringUtils::insertValues("SELECT trigger_count FROM %s;",
+        ServerConfig::m_ip_ban_table.c_str());
+    dc.addQuery([&dc, &output, query]() { dc.easySQLQuery(query, &output); });
+    wait();
+    assert(output.size() == 1 && output[0][0] == StringUtils::toString(BANNED));
+    Log::info("DatabaseConnector", "%u connections: %u us to queue (at most "
+        "%u us per connection), %u us until written. Waiting for each query: "
+        "%u us per connection.", CONNECTIONS, (unsigned)queued_us,
+        (unsigned)max_call_us, (unsigned)async_us,
+        (unsigned)(waiting_us / WAITING_CONNECTIONS));
+
+    // Bans added by another connection are used without polling, and bans
+    // are checked with their time
+    const uint32_t NEW_BAN = FIRST_IP + 0x10000;
+    ret = sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE, NULL);
+    assert(ret == SQLITE_OK);
+    std::string changes = StringUtils::insertValues(
+        "INSERT INTO %s (ip_start, ip_end, starting_time, reason) "
+        "VALUES (%u, %u, datetime('now', '-1 days'), 'new');"
+        "INSERT INTO %s (ip_start, ip_end, starting_time, expired_days) "
+        "VALUES (%u, %u, datetime('now', '-1 days'), 0.5);"
+        "INSERT INTO %s (ip_start, ip_end, starting_time) "
+        "VALUES (%u, %u, datetime('now', '+1 days'));",
+        ServerConfig::m_ip_ban_table.c_str(), NEW_BAN, NEW_BAN,
+        ServerConfig::m_ip_ban_table.c_str(), NEW_BAN + 1, NEW_BAN + 1,
+        ServerConfig::m_ip_ban_table.c_str(), NEW_BAN + 2, NEW_BAN + 2);
+    ret = sqlite3_exec(db, changes.c_str(), NULL, NULL, NULL);
+    assert(ret == SQLITE_OK);
+    std::vector<std::string> banned_by;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        dc.checkConnection(SocketAddress(NEW_BAN + i, 2759), 0,
+            [&banned_by](const ConnectionCheck& check)
+            { banned_by.push_back(check.m_banned_by); });
+    }
+    wait();
+    assert(banned_by.size() == 3 && banned_by[0] == "IP" &&
+        banned_by[1].empty() && banned_by[2].empty());
+
+    // An IP geolocation table covering all addresses, compared with the
+    // range query used before
+    const uint32_t RANGES = 2000;
+    const uint32_t RANGE_SIZE = 2147483;
+    const unsigned LOOKUPS = 2000;
+    std::ostringstream geolocation;
+    geolocation << "DELETE FROM " << ServerConfig::m_ip_geolocation_table.c_str()
+        << ";WITH RECURSIVE r(k) AS (SELECT 0 UNION ALL SELECT k + 1 FROM r "
+        "WHERE k < " << RANGES - 1 << ") INSERT INTO "
+        << ServerConfig::m_ip_geolocation_table.c_str() << " SELECT k * "
+        << RANGE_SIZE << ", k * " << RANGE_SIZE << " + " << RANGE_SIZE - 1
+        << ", 0.0, 0.0, char(65 + k % 26, 65 + k / 26 % 26) FROM r;";
+    changes = geolocation.str();
+    ret = sqlite3_exec(db, changes.c_str(), NULL, NULL, NULL);
+    assert(ret == SQLITE_OK);
+
+    dc.addQuery([&dc]() { dc.refreshTables(true/*geolocation*/); });
+    wait();
+    assert(dc.m_ip_geolocation_index.size() == RANGES);
+
+    std::vector<SocketAddress> addresses;
+    uint32_t random = 12345;
+    while (addresses.size() < LOOKUPS)
+    {
+        random = random * 1664525 + 1013904223;
+        SocketAddress addr(random, 2759);
+        if (!addr.isLAN())
+            addresses.push_back(addr);
+    }
+    std::vector<std::string> index_codes, sql_codes;
+    dc.addQuery([&]()
+        {
+            for (const SocketAddress& addr : addresses)
+                index_codes.push_back(dc.ip2Country(addr));
+
+            std::string range_query = StringUtils::insertValues(
+                "SELECT country_code FROM %s "
+                "WHERE `ip_start` <= ?1 AND `ip_end` >= ?1 "
+                "ORDER BY `ip_start` DESC LIMIT 1;",
+                ServerConfig::m_ip_geolocation_table.c_str());
+            std::vector<std::vector<std::string> > row;
+            for (const SocketAddress& addr : addresses)
+            {
+                const uint32_t ip = addr.getIP();
+                dc.easySQLQuery(range_query, &row, [ip](sqlite3_stmt* stmt)
+                    { sqlite3_bind_int64(stmt, 1, ip); });
+                sql_codes.push_back(row.empty() ? "" : row[0][0]);
+            }
+        });
+    wait();
+    assert(index_codes == sql_codes);
+    assert(index_codes[0].size() == 2);
+
+    // Swapping the country codes of two ranges changes neither the row
+    // count nor the ranges, but must be reloaded too
+    const SocketAddress first_range(FIRST_IP - FIRST_IP % RANGE_SIZE, 2759);
+    const SocketAddress second_range(first_range.getIP() + RANGE_SIZE, 2759);
+    std::string first_code, second_code;
+    dc.addQuery([&]()
+        {
+            first_code = dc.ip2Country(first_range);
+            second_code = dc.ip2Country(second_range);
+        });
+    wait();
+    assert(first_code != second_code);
+    changes = StringUtils::insertValues(
+        "UPDATE %s SET country_code = CASE ip_start WHEN %u THEN '%s' "
+        "ELSE '%s' END WHERE ip_start IN (%u, %u);",
+        ServerConfig::m_ip_geolocation_table.c_str(), first_range.getIP(),
+        second_code.c_str(), first_code.c_str(), first_range.getIP(),
+        second_range.getIP());
+    ret = sqlite3_exec(db, changes.c_str(), NULL, NULL, NULL);
+    sqlite3_close(db);
+    assert(ret == SQLITE_OK);
+    std::string swapped_first, swapped_second;
+    dc.addQuery([&]()
+        {
+            dc.refreshTables(true/*geolocation*/);
+            swapped_first = dc.ip2Country(first_range);
+            swapped_second = dc.ip2Country(second_range);
+        });
+    wait();
+    assert(swapped_first == second_code && swapped_second == first_code);
+
+    dc.closeDatabase();
+    file_manager->removeFile(path);
+
+    (void)opened;
+    (void)host_id;
+}   // unitTesting
 #endif // ENABLE_SQLITE3
@@ -21,14 +21,20 @@
 #ifndef DATABASE_CONNECTOR_HPP
 #define DATABASE_CONNECTOR_HPP
 
+#include "network/ip_interval_index.hpp"
+#include "utils/stk_process.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 
+#include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sqlite3.h>
 #include <string>
+#include <thread>
 #include <vector>
 
 class SocketAddress;
@@ -67,8 +73,8 @@ struct BinderCollection
     std::function<void(sqlite3_stmt* stmt)> getBindFunction() const;
 };
 
-/** Binder is a wrapper for a string to be bound into an SQL query. See above
- *   for its usage in insertValues(). When it's printed to an output stream
+/** Binder is a wrapper for a string (or an integer) to be bound into an SQL
+ *   query. See above for its usage in insertValues(). When it's printed to an output stream
  *   (in particular, this is done in insertValues implementation), this Binder
  *   is added to the query's BinderCollection, and the '?'-placeholder is added
  *   to the query string instead of %s.
@@ -90,11 +96,22 @@ struct Binder
     std::string m_value;
     std::string m_name;
     bool m_use_null_if_empty;
+    bool m_is_integer;
+    int64_t m_integer;
 
     Binder(std::shared_ptr<BinderCollection> collection, std::string value,
            std::string name = "", bool use_null_if_empty = false):
         m_collection(collection), m_value(value),
-        m_name(name), m_use_null_if_empty(use_null_if_empty) {}
+        m_name(name), m_use_null_if_empty(use_null_if_empty),
+        m_is_integer(false), m_integer(0) {}
+
+    /** Binds an integer, so that queries which only differ in numbers (e.g.
+     *   host ids) have the same text and can use the same prepared
+     *   statement. */
+    Binder(std::shared_ptr<BinderCollection> collection, int64_t value,
+           std::string name = ""):
+        m_collection(collection), m_name(name), m_use_null_if_empty(false),
+        m_is_integer(true), m_integer(value) {}
 };
 
 std::ostream& operator << (std::ostream& os, const Binder& binder);
@@ -103,11 +120,56 @@ std::ostream& operator << (std::ostream& os, const Binder& binder);
  *   The SQL queries are intended to be placed only within the implementation
  *   of this class, while the logic corresponding to those queries should not
  *   belong here.
+ *  All queries after initDatabase are run by a separate database thread, so
+ *   that the lobby never waits for the disk (or for another process locking
+ *   the database). Writes are simply queued, queries with a result take a
+ *   callback, which is called by the lobby thread in handleCallbacks. The
+ *   queries queued while the database thread was busy are run in a single
+ *   transaction, and statements with '?'-placeholders are prepared only once.
+ *  The ban and IP geolocation tables are loaded by the database thread into
+ *   sorted interval arrays (IPIntervalIndex), so checking a peer is a binary
+ *   search instead of a query. They are reloaded when another connection
+ *   changed the database (PRAGMA data_version): the small ban tables before
+ *   checking peers, the geolocation tables only when polling and if their
+ *   row count or sums of ranges changed.
  */
 class DatabaseConnector
 {
 private:
+    /** A query for the database thread, and an optional function called by
+     *   the lobby thread after the query finished. */
+    struct DatabaseQuery
+    {
+        std::function<void()> m_query;
+        std::function<void()> m_callback;
+    };
+
     sqlite3* m_db;
+
+    /** Prepared statements of queries with '?'-placeholders, only used by
+     *   the thread running the queries. */
+    mutable std::map<std::string, sqlite3_stmt*> m_statements;
+
+    std::thread m_thread;
+
+    /** Process type of the lobby, used by the database thread too. */
+    ProcessType m_process_type;
+
+    /** Protects m_queries and m_stop_thread. */
+    std::mutex m_queries_mutex;
+
+    std::condition_variable m_queries_cv;
+
+    std::vector<DatabaseQuery> m_queries;
+
+    bool m_stop_thread;
+
+    /** Protects m_callbacks. */
+    std::mutex m_callbacks_mutex;
+
+    /** Callbacks of finished queries, called in handleCallbacks. */
+    std::vector<std::function<void()> > m_callbacks;
+
     std::string m_server_stats_table;
     bool m_ip_ban_table_exists;
     bool m_ipv6_ban_table_exists;
@@ -117,6 +179,26 @@ private:
     bool m_player_reports_table_exists;
     uint64_t m_last_poll_db_time;
 
+
+    bool openDatabase(const std::string& path);
+    void closeDatabase();
+    void runQueries();
+    void finalizeStatements();
+    bool readRows(const std::string& query,
+                  std::function<void(sqlite3_stmt* stmt)> row_function) const;
+    void refreshTables(bool geolocation);
+    void loadBanTables();
+    void loadGeolocationTables();
+    uint16_t getCountryCodeId(const std::string& country_code);
+    uint32_t createServerStatsTable();
+    void writeDisconnectInfo(uint32_t host_id, int ping, int packet_loss);
+    void writePlayerJoin(uint32_t host_id, const SocketAddress& addr,
+                         uint32_t online_id, const std::string& name,
+                         unsigned player_count,
+                         const std::string& country_code,
+                         const std::string& version, const std::string& os,
+                         int ping);
+
 public:
     /** Corresponds to the row of IPv4 ban table. */
     struct IpBanTableData
@@ -126,6 +208,9 @@ public:
         uint32_t ip_end;
         std::string reason;
         std::string description;
+        /** Unix times, expired_time is -1 for bans without expired_days. */
+        int64_t starting_time;
+        int64_t expired_time;
     };
     /** Corresponds to the row of IPv6 ban table. */
     struct Ipv6BanTableData
@@ -134,6 +219,8 @@ public:
         std::string ipv6_cidr;
         std::string reason;
         std::string description;
+        int64_t starting_time;
+        int64_t expired_time;
     };
     /** Corresponds to the row of online id ban table. */
     struct OnlineIdBanTableData
@@ -142,7 +229,56 @@ public:
         uint32_t online_id;
         std::string reason;
         std::string description;
+        int64_t starting_time;
+        int64_t expired_time;
     };
+    /** The result of the checks done when a peer connects. */
+    struct ConnectionCheck
+    {
+        /** Empty if the peer is not banned, else "IP", "IPv6" or
+         *  "online id". */
+        std::string m_banned_by;
+        int m_row_id;
+        std::string m_reason;
+        std::string m_description;
+        /** Country code from the IP geolocation tables (if not banned). */
+        std::string m_country_code;
+    };
+
+private:
+    /** The following members are only used by the database thread. The
+     *   values of the ban indexes are indices in the ban rows. */
+    std::vector<IpBanTableData> m_ip_bans;
+    IPIntervalIndex<uint32_t, uint32_t> m_ip_ban_index;
+    std::vector<Ipv6BanTableData> m_ipv6_bans;
+    IPIntervalIndex<IPv6Key, uint32_t> m_ipv6_ban_index;
+    std::vector<OnlineIdBanTableData> m_online_id_bans;
+    IPIntervalIndex<uint32_t, uint32_t> m_online_id_ban_index;
+
+    /** The values of the geolocation indexes are indices in
+     *   m_country_codes. */
+    std::vector<std::string> m_country_codes;
+    std::map<std::string, uint16_t> m_country_code_ids;
+    IPIntervalIndex<uint32_t, uint16_t> m_ip_geolocation_index;
+    /** Keyed by upperIPv6, like the ipv6 geolocation table. */
+    IPIntervalIndex<int64_t, uint16_t> m_ipv6_geolocation_index;
+    std::string m_ip_geolocation_fingerprint;
+    std::string m_ipv6_geolocation_fingerprint;
+
+    /** PRAGMA data_version when the tables were last loaded, -1 before
+     *   they are loaded. */
+    int64_t m_ban_data_version;
+    int64_t m_geolocation_data_version;
+    /** Set when this connection changed a ban table, which doesn't change
+     *   its data_version. */
+    bool m_ban_tables_changed;
+
+    bool findBan(const SocketAddress& addr, bool check_online_id,
+                 uint32_t online_id, ConnectionCheck* result,
+                 bool increase_trigger_count);
+
+public:
+    DatabaseConnector();
     void initDatabase();
     void destroyDatabase();
 
@@ -151,6 +287,10 @@ public:
                std::function<void(sqlite3_stmt* stmt)> bind_function = nullptr,
                                             std::string null_value = "") const;
 
+    void addQuery(std::function<void()> query,
+                  std::function<void()> callback = nullptr);
+    void handleCallbacks();
+
     void checkTableExists(const std::string& table, bool& result);
 
     std::string ip2Country(const SocketAddress& addr) const;
@@ -163,10 +303,11 @@ public:
                                                          sqlite3_value** argv);
     void writeDisconnectInfoTable(STKPeer* peer);
     void initServerStatsTable();
-    bool writeReport(
+    void writeReport(
          STKPeer* reporter, std::shared_ptr<NetworkPlayerProfile> reporter_npp,
        STKPeer* reporting, std::shared_ptr<NetworkPlayerProfile> reporting_npp,
-                                                     irr::core::stringw& info);
+                                                     irr::core::stringw& info,
+                                         std::function<void(bool)> callback);
     bool hasDatabase() const                        { return m_db != nullptr; }
     bool hasServerStatsTable() const  { return !m_server_stats_table.empty(); }
     bool hasPlayerReportsTable() const
@@ -177,18 +318,20 @@ public:
     bool isTimeToPoll() const
             { return StkTime::getMonoTimeMs() >= m_last_poll_db_time + 60000; }
     void updatePollTime()   { m_last_poll_db_time = StkTime::getMonoTimeMs(); }
-    std::vector<IpBanTableData> getIpBanTableData(uint32_t ip = 0) const;
-    std::vector<Ipv6BanTableData> getIpv6BanTableData(std::string ipv6 = "") const;
-    std::vector<OnlineIdBanTableData> getOnlineIdBanTableData(uint32_t online_id = 0) const;
     void increaseIpBanTriggerCount(uint32_t ip_start, uint32_t ip_end) const;
     void increaseIpv6BanTriggerCount(const std::string& ipv6_cidr) const;
     void increaseOnlineIdBanTriggerCount(uint32_t online_id) const;
+    void checkConnection(const SocketAddress& addr, uint32_t online_id,
+                   std::function<void(const ConnectionCheck&)> callback);
+    void checkBannedPeers(std::function<void(std::shared_ptr<STKPeer>,
+                                             const ConnectionCheck&)> kick);
     void clearOldReports();
     void setDisconnectionTimes(std::vector<uint32_t>& present_hosts);
     void saveAddressToIpBanTable(const SocketAddress& addr);
     void onPlayerJoinQueries(std::shared_ptr<STKPeer> peer, uint32_t online_id,
         unsigned player_count, const std::string& country_code);
     void listBanTable();
+    static void unitTesting();
 };
 
 #endif // ifndef DATABASE_CONNECTOR_HPP
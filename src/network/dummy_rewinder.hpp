@@ -29,7 +29,8 @@ class DummyRewinder : public Rewinder, public EventRewinder
 {
 public:
     // -------------------------------------------------------------------------
-    BareNetworkString* saveState(std::vector<std::string>* ru)  { return NULL; }
+    bool saveState(BareNetworkString* b, std::vector<uint16_t>* ru)
+                                                             { return false; }
     // -------------------------------------------------------------------------
     virtual void undoEvent(BareNetworkString* s)                              {}
     // -------------------------------------------------------------------------
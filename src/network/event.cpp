@@ -69,32 +69,41 @@ Event::Event(ENetEvent* event, std::shared_ptr<STKPeer> peer)
             throw std::runtime_error("Invalid packet before validation.");
         }
 
+        // The received data is read from the packet without copying it, so
+        // the packet is destroyed when the event and all strings sharing
+        // its data (e.g. the states in the rewind queue) are deleted
+        std::shared_ptr<ENetPacket> packet(event->packet,
+                                           enet_packet_destroy);
+        event->packet = NULL;
+
         auto cl = LobbyProtocol::get<ClientLobby>();
         if (event->channelID == EVENT_CHANNEL_UNENCRYPTED && (!cl ||
             (cl && !cl->waitingForServerRespond())))
         {
             throw std::runtime_error("Unencrypted content at wrong state.");
         }
-        if (m_peer->getCrypto() && (event->channelID == EVENT_CHANNEL_NORMAL ||
+        if (event->channelID == EVENT_CHANNEL_BROADCAST)
+        {
+            std::shared_ptr<Crypto> crypto = m_peer->getBroadcastCrypto();
+            if (!cl || !crypto)
+                throw std::runtime_error("Broadcast content without key.");
+            m_data = crypto->decryptRecieve(packet);
+        }
+        else if (m_peer->getCrypto() &&
+            (event->channelID == EVENT_CHANNEL_NORMAL ||
             event->channelID == EVENT_CHANNEL_DATA_TRANSFER))
         {
-            m_data = m_peer->getCrypto()->decryptRecieve(event->packet);
+            m_data = m_peer->getCrypto()->decryptRecieve(packet);
         }
         else
         {
-            m_data = new NetworkString(event->packet->data, 
-                (int)event->packet->dataLength);
+            m_data = new NetworkString(packet, packet->data,
+                (int)packet->dataLength);
         }
     }
     else
         m_data = NULL;
 
-    if (event->packet)
-    {
-        // we got all we need, just remove the data.
-        enet_packet_destroy(event->packet);
-    }
-
 }   // Event(ENetEvent)
 
 // ----------------------------------------------------------------------------
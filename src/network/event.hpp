@@ -54,7 +54,8 @@ enum EVENT_CHANNEL : uint8_t
     EVENT_CHANNEL_NORMAL = 0,   //!< Normal channel (encrypted if supported)
     EVENT_CHANNEL_UNENCRYPTED = 1,//!< Unencrypted channel
     EVENT_CHANNEL_DATA_TRANSFER = 2,//!< Data transfer channel (like game replay)
-    EVENT_CHANNEL_COUNT = 3
+    EVENT_CHANNEL_BROADCAST = 3,//!< Encrypted with the key shared by all peers in game
+    EVENT_CHANNEL_COUNT = 4
 };
 
 enum PeerDisconnectInfo : unsigned int;
@@ -74,7 +75,8 @@ class Event
 private:
     LEAK_CHECK()
 
-    /** Copy of the data passed by the event. */
+    /** Data passed by the event, a view of the received ENet packet which
+     *  is kept alive as long as the data is used. */
     NetworkString *m_data;
 
     /**  Type of the event. */
@@ -109,8 +111,8 @@ public:
     const NetworkString& data() const { return *m_data; }
     // ------------------------------------------------------------------------
     /** \brief Get a non-const reference to the received data.
-     *  A copy of the message data. This is empty for events like
-     *  connection or disconnections. */
+     *  The message data is copied the first time it is changed. This is
+     *  empty for events like connection or disconnections. */
     NetworkString& data() { return *m_data; }
     // ------------------------------------------------------------------------
     /** Determines if this event should be delivered synchronous or not.
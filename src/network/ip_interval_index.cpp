@@ -0,0 +1,182 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/ip_interval_index.hpp"
+#include "network/stk_ipv6.hpp"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ----------------------------------------------------------------------------
+bool IPv6Key::fromString(const std::string& ipv6, IPv6Key* key)
+{
+    struct in6_addr in6;
+    if (!getIPv6FromString(ipv6.c_str(), &in6))
+        return false;
+    key->m_upper = 0;
+    key->m_lower = 0;
+    for (unsigned i = 0; i < 8; i++)
+    {
+        key->m_upper = (key->m_upper << 8) | in6.s6_addr[i];
+        key->m_lower = (key->m_lower << 8) | in6.s6_addr[i + 8];
+    }
+    return true;
+}   // fromString
+
+// ----------------------------------------------------------------------------
+/** Accepts the same blocks as insideIPv6CIDR: a valid address followed by a
+ *  prefix length from 1 to 128. */
+bool IPv6Key::fromCIDR(const std::string& ipv6_cidr, IPv6Key* first,
+                       IPv6Key* last)
+{
+    size_t mask_location = ipv6_cidr.find('/');
+    if (mask_location == std::string::npos)
+        return false;
+    if (!fromString(ipv6_cidr.substr(0, mask_location), first))
+        return false;
+    int mask_length = atoi(ipv6_cidr.c_str() + mask_location + 1);
+    if (mask_length > 128 || mask_length <= 0)
+        return false;
+
+    // Bits of the address which are not part of the prefix
+    uint64_t upper_host = 0;
+    uint64_t lower_host = 0;
+    if (mask_length < 64)
+    {
+        upper_host = ~0ull >> mask_length;
+        lower_host = ~0ull;
+    }
+    else if (mask_length < 128)
+        lower_host = ~0ull >> (mask_length - 64);
+    first->m_upper &= ~upper_host;
+    first->m_lower &= ~lower_host;
+    last->m_upper = first->m_upper | upper_host;
+    last->m_lower = first->m_lower | lower_host;
+    return true;
+}   // fromCIDR
+
+// ============================================================================
+namespace IPIntervalIndexTest
+{
+    // ------------------------------------------------------------------------
+    /** Compares find() with a linear search through all intervals, using
+     *  ORDER BY start DESC semantics (the last added interval first if the
+     *  starts are the same). */
+    void testRandomIntervals(unsigned count, uint32_t max_length)
+    {
+        IPIntervalIndex<uint32_t, uint32_t> index;
+        std::vector<uint32_t> starts, ends;
+        for (unsigned i = 0; i < count; i++)
+        {
+            uint32_t start = (uint32_t)(rand() % 100000);
+            uint32_t end = start + (uint32_t)(rand() % max_length);
+            starts.push_back(start);
+            ends.push_back(end);
+            index.add(start, end, i);
+        }
+        index.finish();
+        assert(index.size() == count);
+        for (uint32_t key = 0; key < 101000; key += 7)
+        {
+            int expected = -1;
+            for (unsigned i = 0; i < count; i++)
+            {
+                if (starts[i] <= key && key <= ends[i] &&
+                    (expected == -1 || starts[i] >= starts[expected]))
+                    expected = (int)i;
+            }
+            const uint32_t* found = index.find(key);
+            assert(expected == -1 ? found == NULL :
+                (found != NULL && *found == (uint32_t)expected));
+            // Only accept even values, like a ban which is not active
+            int expected_even = -1;
+            for (unsigned i = 0; i < count; i++)
+            {
+                if (starts[i] <= key && key <= ends[i] && i % 2 == 0 &&
+                    (expected_even == -1 ||
+                    starts[i] >= starts[expected_even]))
+                    expected_even = (int)i;
+            }
+            found = index.find(key, [](uint32_t v) { return v % 2 == 0; });
+            assert(expected_even == -1 ? found == NULL :
+                (found != NULL && *found == (uint32_t)expected_even));
+            (void)found;
+        }
+    }   // testRandomIntervals
+
+    // ------------------------------------------------------------------------
+    void unitTesting()
+    {
+        srand(1);
+        // Overlapping intervals
+        testRandomIntervals(1000, 500);
+        // Mostly separate intervals
+        testRandomIntervals(1000, 20);
+
+        IPIntervalIndex<uint32_t, int> index;
+        index.add(10, 20, 1);
+        index.add(30, 30, 2);
+        index.add(50, 40, 3);
+        index.finish();
+        assert(!index.hasOverlaps());
+        assert(index.size() == 2);
+        assert(index.find(9) == NULL);
+        assert(*index.find(10) == 1);
+        assert(*index.find(20) == 1);
+        assert(index.find(21) == NULL);
+        assert(*index.find(30) == 2);
+        assert(index.find(45) == NULL);
+
+        // IPv6 blocks
+        IPv6Key first, last, key;
+        bool ok = IPv6Key::fromCIDR("2001:db8::/32", &first, &last);
+        assert(ok);
+        assert(first.m_upper == 0x20010db800000000ull && first.m_lower == 0);
+        assert(last.m_upper == 0x20010db8ffffffffull &&
+            last.m_lower == ~0ull);
+        ok = IPv6Key::fromCIDR("2001:db8::1:2/112", &first, &last);
+        assert(ok);
+        assert(first.m_lower == 0x10000ull && last.m_lower == 0x1ffffull);
+        ok = IPv6Key::fromCIDR("2001:db8::1/128", &first, &last);
+        assert(ok && first == last && first.m_lower == 1);
+        assert(!IPv6Key::fromCIDR("2001:db8::1", &first, &last));
+        assert(!IPv6Key::fromCIDR("2001:db8::1/0", &first, &last));
+        assert(!IPv6Key::fromCIDR("2001:db8::1/129", &first, &last));
+
+        IPIntervalIndex<IPv6Key, int> ipv6_index;
+        IPv6Key::fromCIDR("2001:db8::/32", &first, &last);
+        ipv6_index.add(first, last, 1);
+        IPv6Key::fromCIDR("2001:db8:1::/48", &first, &last);
+        ipv6_index.add(first, last, 2);
+        ipv6_index.finish();
+        assert(ipv6_index.hasOverlaps());
+        IPv6Key::fromString("2001:db8:1::5", &key);
+        assert(*ipv6_index.find(key) == 2);
+        // Must give the same results as insideIPv6CIDR
+        assert(insideIPv6CIDR("2001:db8:1::/48", "2001:db8:1::5") == 1);
+        IPv6Key::fromString("2001:db8:2::5", &key);
+        assert(*ipv6_index.find(key) == 1);
+        assert(insideIPv6CIDR("2001:db8:1::/48", "2001:db8:2::5") == 0);
+        IPv6Key::fromString("2001:db9::", &key);
+        assert(ipv6_index.find(key) == NULL);
+        assert(!IPv6Key::fromString("2001:db8::g", &key));
+        (void)ok;
+    }   // unitTesting
+
+}   // namespace IPIntervalIndexTest
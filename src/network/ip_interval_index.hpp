@@ -0,0 +1,195 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_IP_INTERVAL_INDEX_HPP
+#define HEADER_IP_INTERVAL_INDEX_HPP
+
+#include "utils/types.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/** A full 128-bit IPv6 address, ordered like the address bytes. */
+struct IPv6Key
+{
+    uint64_t m_upper;
+    uint64_t m_lower;
+
+    // ------------------------------------------------------------------------
+    bool operator<(const IPv6Key& other) const
+    {
+        return m_upper < other.m_upper ||
+            (m_upper == other.m_upper && m_lower < other.m_lower);
+    }   // operator<
+    // ------------------------------------------------------------------------
+    bool operator<=(const IPv6Key& other) const   { return !(other < *this); }
+    // ------------------------------------------------------------------------
+    bool operator==(const IPv6Key& other) const
+    {
+        return m_upper == other.m_upper && m_lower == other.m_lower;
+    }   // operator==
+    // ------------------------------------------------------------------------
+    /** Converts an IPv6 address string, returns false if it's invalid. */
+    static bool fromString(const std::string& ipv6, IPv6Key* key);
+    // ------------------------------------------------------------------------
+    /** Converts an IPv6 CIDR block (e.g. 2001::/64) to its first and last
+     *  address, returns false if it's invalid. */
+    static bool fromCIDR(const std::string& ipv6_cidr, IPv6Key* first,
+                         IPv6Key* last);
+};   // IPv6Key
+
+// ============================================================================
+/** \brief Sorted arrays of [start, end] intervals (of IP addresses) with a
+ *  value each, so that the intervals containing a key are found with a
+ *  binary search instead of a range query or a linear scan. Used for the IP
+ *  geolocation and ban tables of the database.
+ *  Intervals are added first, then finish() sorts them. Intervals may
+ *  overlap: find() goes through the intervals containing the key starting
+ *  with the largest start (like ORDER BY ip_start DESC in SQL). To stop
+ *  early, the largest end up to each interval is kept, which is only needed
+ *  if any intervals overlap.
+ *  \ingroup network
+ */
+template<typename KEY, typename VALUE>
+class IPIntervalIndex
+{
+private:
+    std::vector<KEY> m_starts;
+
+    std::vector<KEY> m_ends;
+
+    std::vector<VALUE> m_values;
+
+    /** m_max_ends[i] is the largest end of the intervals 0 to i, empty if
+     *  no intervals overlap. */
+    std::vector<KEY> m_max_ends;
+
+public:
+    // ------------------------------------------------------------------------
+    void clear()
+    {
+        m_starts.clear();
+        m_ends.clear();
+        m_values.clear();
+        m_max_ends.clear();
+    }   // clear
+    // ------------------------------------------------------------------------
+    void reserve(size_t size)
+    {
+        m_starts.reserve(size);
+        m_ends.reserve(size);
+        m_values.reserve(size);
+    }   // reserve
+    // ------------------------------------------------------------------------
+    /** Adds an interval, finish() must be called before using find. Empty
+     *  intervals (end before start) are ignored. */
+    void add(const KEY& start, const KEY& end, const VALUE& value)
+    {
+        if (end < start)
+            return;
+        m_starts.push_back(start);
+        m_ends.push_back(end);
+        m_values.push_back(value);
+    }   // add
+    // ------------------------------------------------------------------------
+    /** Sorts the intervals added, intervals with the same start keep the
+     *  order in which they were added. */
+    void finish()
+    {
+        const size_t size = m_starts.size();
+        std::vector<uint32_t> order(size);
+        for (size_t i = 0; i < size; i++)
+            order[i] = (uint32_t)i;
+        const std::vector<KEY>& starts = m_starts;
+        std::stable_sort(order.begin(), order.end(),
+            [&starts](uint32_t a, uint32_t b)
+            { return starts[a] < starts[b]; });
+
+        std::vector<KEY> sorted_starts, sorted_ends;
+        std::vector<VALUE> sorted_values;
+        sorted_starts.reserve(size);
+        sorted_ends.reserve(size);
+        sorted_values.reserve(size);
+        bool overlap = false;
+        for (size_t i = 0; i < size; i++)
+        {
+            const uint32_t j = order[i];
+            if (i > 0 && m_starts[j] <= sorted_ends.back())
+                overlap = true;
+            sorted_starts.push_back(m_starts[j]);
+            sorted_ends.push_back(m_ends[j]);
+            sorted_values.push_back(m_values[j]);
+        }
+        std::swap(m_starts, sorted_starts);
+        std::swap(m_ends, sorted_ends);
+        std::swap(m_values, sorted_values);
+
+        m_max_ends.clear();
+        if (!overlap)
+            return;
+        m_max_ends.resize(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            m_max_ends[i] = (i > 0 && m_ends[i] < m_max_ends[i - 1]) ?
+                m_max_ends[i - 1] : m_ends[i];
+        }
+    }   // finish
+    // ------------------------------------------------------------------------
+    /** Calls accept with the values of the intervals containing key,
+     *  starting with the largest start, until it returns true.
+     *  \return The accepted value, or NULL if there is none. */
+    template<typename ACCEPT>
+    const VALUE* find(const KEY& key, ACCEPT accept) const
+    {
+        // The first interval with a start after key
+        size_t i = std::upper_bound(m_starts.begin(), m_starts.end(), key) -
+            m_starts.begin();
+        while (i > 0)
+        {
+            i--;
+            if (key <= m_ends[i] && accept(m_values[i]))
+                return &m_values[i];
+            // Without overlaps only the last interval can contain key, else
+            // stop when no interval before reaches it
+            if (m_max_ends.empty() || i == 0 || m_max_ends[i - 1] < key)
+                break;
+        }
+        return NULL;
+    }   // find
+    // ------------------------------------------------------------------------
+    /** Returns the value of the interval containing key with the largest
+     *  start, or NULL if there is none. */
+    const VALUE* find(const KEY& key) const
+    {
+        return find(key, [](const VALUE&) { return true; });
+    }   // find
+    // ------------------------------------------------------------------------
+    size_t size() const                              { return m_starts.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns true if any intervals overlap. */
+    bool hasOverlaps() const                   { return !m_max_ends.empty(); }
+
+};   // class IPIntervalIndex
+
+namespace IPIntervalIndexTest
+{
+    void unitTesting();
+}
+
+#endif
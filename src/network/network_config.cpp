@@ -154,12 +154,14 @@ NetworkConfig::NetworkConfig()
     m_cur_user_id           = 0;
     m_cur_user_token        = "";
     m_client_port = 0;
+    m_server_port_offset = 0;
     m_joined_server_version = 0;
     m_network_ai_instance = false;
     m_state_frequency = 10;
     m_nat64_prefix_data.fill(-1);
     m_num_fixed_ai = 0;
     m_tux_hitbox_addon = false;
+    m_bit_packed_state = false;
 }   // NetworkConfig
 
 // ----------------------------------------------------------------------------
@@ -95,6 +95,10 @@ private:
     /** When live join is disabled addon kart will use their real hitbox */
     bool m_tux_hitbox_addon;
 
+    /** If the states of the current game are bit packed (see BitWriter),
+     *  which the server only does if all peers in game support it. */
+    bool m_bit_packed_state;
+
     /** No. of fixed AI in all-in-one graphical client server, the player
      *  connecting with 127.* or ::1/128 will be in charged of controlling the
      *  AI. */
@@ -103,6 +107,10 @@ private:
     /** The LAN port on which a client is waiting for a server connection. */
     uint16_t m_client_port;
 
+    /** Added to the server port, so each extra server lobby of a process
+     *  uses its own port. */
+    uint16_t m_server_port_offset;
+
     /** Used by wan server. */
     uint32_t m_cur_user_id;
     std::string m_cur_user_token;
@@ -179,6 +187,10 @@ public:
     /** Returns the port on which a client listens for server connections. */
     uint16_t getClientPort() const { return m_client_port; }
     // ------------------------------------------------------------------------
+    void setServerPortOffset(uint16_t offset) { m_server_port_offset = offset; }
+    // ------------------------------------------------------------------------
+    uint16_t getServerPortOffset() const      { return m_server_port_offset; }
+    // ------------------------------------------------------------------------
     /** Sets that this server can be contacted directly. */
     void setIsPublicServer() { m_is_public_server = true; }
     // ------------------------------------------------------------------------
@@ -321,6 +333,10 @@ public:
     void setTuxHitboxAddon(bool val)              { m_tux_hitbox_addon = val; }
     // ------------------------------------------------------------------------
     bool useTuxHitboxAddon() const               { return m_tux_hitbox_addon; }
+    // ------------------------------------------------------------------------
+    void setBitPackedState(bool val)              { m_bit_packed_state = val; }
+    // ------------------------------------------------------------------------
+    bool useBitPackedState() const               { return m_bit_packed_state; }
 };   // class NetworkConfig
 
 #endif // HEADER_NETWORK_CONFIG
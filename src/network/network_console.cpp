@@ -23,6 +23,7 @@
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
 #include "network/protocols/server_lobby.hpp"
+#include "utils/tick_scheduler.hpp"
 #include "utils/time.hpp"
 #include "utils/vs.hpp"
 #include "main_loop.hpp"
@@ -53,6 +54,12 @@ void showHelp()
     std::cout << "listpeers, List all peers with host ID and IP." << std::endl;
     std::cout << "listban, List IP ban list of server." << std::endl;
     std::cout << "speedstats, Show upload and download speed." << std::endl;
+    std::cout << "latencystats, Show the time from adding a packet to "
+        "sending it." << std::endl;
+    std::cout << "tickstats, Show the duration and lateness of the server "
+        "ticks." << std::endl;
+    std::cout << "staterate, Show the rate of states sent to each peer."
+        << std::endl;
 }   // showHelp
 
 // ----------------------------------------------------------------------------
@@ -178,6 +185,32 @@ void mainLoop(STKHost* host)
                 "   Download speed (KBps): " <<
                 (float)host->getDownloadSpeed() / 1024.0f  << std::endl;
         }
+        else if (str == "latencystats")
+        {
+            std::cout << "Send latency: " << host->getSendLatencyStats() <<
+                std::endl;
+        }
+        else if (str == "tickstats")
+        {
+            std::cout << TickScheduler::getAllStats() << std::endl;
+        }
+        else if (str == "staterate" && NetworkConfig::get()->isServer())
+        {
+            auto peers = host->getPeers();
+            if (peers.empty())
+                std::cout << "No peers exist" << std::endl;
+            for (unsigned int i = 0; i < peers.size(); i++)
+            {
+                std::cout << peers[i]->getHostId() << ": " <<
+                    (float)NetworkConfig::get()->getStateFrequency() /
+                    (float)peers[i]->getStateInterval() <<
+                    " states/s x" << peers[i]->getStateRedundancy() <<
+                    "   Ping: " << peers[i]->getRoundTripTime() <<
+                    "ms   Packet loss: " <<
+                    (float)peers[i]->getPacketLoss() * 100.0f /
+                    (float)ENET_PEER_PACKET_LOSS_SCALE << "%" << std::endl;
+            }
+        }
         else
         {
             std::cout << "Unknown command: " << str << std::endl;
@@ -69,6 +69,46 @@ void NetworkString::unitTesting()
     std::string log = slog.getLogMessage();
     assert(log=="0x000 | 00 01 02 03 04 05 06 07  08 09 0a 0b 0c 0d 0e 0f   | ................\n"
                 "0x010 | 10 11 12 13 14 15 16 17  18 19 1a 1b               | ............\n");
+
+    // A view of received data is read without copying it, and copied
+    // before it is changed
+    std::shared_ptr<std::vector<uint8_t> > packet =
+        std::make_shared<std::vector<uint8_t> >();
+    packet->push_back(PROTOCOL_GAME_EVENTS | PROTOCOL_SYNCHRONOUS);
+    for (unsigned int i = 0; i < 6; i++)
+        packet->push_back(i);
+    NetworkString view(packet, packet->data(), (int)packet->size());
+    assert(view.isView() && view.isSynchronous());
+    assert(view.getProtocolType() == PROTOCOL_GAME_EVENTS);
+    assert(view.size() == 6 && view.getCurrentData() ==
+           (const char*)packet->data() + 1);
+    assert(view.getUInt16() == 0x0001);
+
+    // A state sharing the unread data of the view
+    BareNetworkString state;
+    state.addUInt32(0xffffffff);
+    state.assignUnread(view);
+    assert(state.isView() && state.getTotalSize() == 4);
+    assert(state.getUInt32() == 0x02030405);
+    bool out_of_range = false;
+    try
+    {
+        state.getUInt8();
+    }
+    catch (std::out_of_range&)
+    {
+        out_of_range = true;
+    }
+    assert(out_of_range);
+
+    view.addUInt8(6);
+    assert(!view.isView() && view.getTotalSize() == 8);
+    (*packet)[3] = 0xff;
+    assert(view.getUInt8() == 2 && state.isView());
+    state.clearData();
+    assert(!state.isView() && state.getTotalSize() == 0);
+    assert(packet.use_count() == 1);
+    (void)out_of_range;
 }   // unitTesting
 
 // ============================================================================
@@ -202,15 +242,15 @@ int BareNetworkString::decodeString16(irr::core::stringw* out,
 std::string BareNetworkString::getLogMessage(const std::string &indent) const
 {
     std::ostringstream oss;
-    for(unsigned int line=0; line<m_buffer.size(); line+=16)
+    for(unsigned int line=0; line<getTotalSize(); line+=16)
     {
         oss << "0x" << std::hex << std::setw(3) << std::setfill('0') 
             << line << " | ";
-        unsigned int upper_limit = std::min(line+16, (unsigned int)m_buffer.size());
+        unsigned int upper_limit = std::min(line+16, getTotalSize());
         for(unsigned int i=line; i<upper_limit; i++)
         {
             oss << std::hex << std::setfill('0') << std::setw(2) 
-                << int(m_buffer[i])<< ' ';
+                << int(bytes()[i])<< ' ';
             if(i%8==7) oss << " ";
         }   // for i
         // fill with spaces if necessary to properly align ascii columns
@@ -224,7 +264,7 @@ std::string BareNetworkString::getLogMessage(const std::string &indent) const
         oss << " | ";
         for(unsigned int i=line; i<upper_limit; i++)
         {
-            uint8_t c = m_buffer[i];
+            uint8_t c = bytes()[i];
             // Don't print tabs, and characters >=128, which are often shown
             // as more than one character.
             if(isprint(c) && c!=0x09 && c<=0x80)
@@ -235,7 +275,7 @@ std::string BareNetworkString::getLogMessage(const std::string &indent) const
         oss << "\n";
         // If it's not the last line, add the indentation in front
         // of the next line
-        if(line+16<m_buffer.size())
+        if(line+16<getTotalSize())
             oss << indent;
     }   // for line
 
@@ -33,6 +33,7 @@
 #include "irrString.h"
 
 #include <assert.h>
+#include <memory>
 #include <stdarg.h>
 #include <stdexcept>
 #include <string>
@@ -47,6 +48,10 @@ typedef unsigned char uchar;
  *  functions to add and read other data types (e.g. int, strings). It does
  *  not enforce any structure on the sequence (NetworkString uses this as
  *  a base class, and enforces a protocol type in the first byte)
+ *  A string can also be a read-only view of data it does not own, e.g. the
+ *  payload of a received packet (see setView), so that received data can be
+ *  read without copying it. The data is copied into the own buffer of the
+ *  string the first time the string is changed.
  */
 
 class BareNetworkString
@@ -56,9 +61,18 @@ private:
     LEAK_CHECK();
 
 protected:
-    /** The actual buffer. */
+    /** The actual buffer, unused as long as the string is a view. */
     std::vector<uint8_t> m_buffer;
 
+    /** The viewed data if the string is a view, NULL otherwise. */
+    const uint8_t* m_view;
+
+    /** Number of bytes of the viewed data. */
+    int m_view_size;
+
+    /** Keeps the viewed data alive (e.g. the received ENet packet). */
+    std::shared_ptr<const void> m_view_owner;
+
     /** To avoid copying the buffer when bytes are deleted (which only
     *  happens at the front), use an offset index. All positions given
     *  by the user will be relative to this index. Note that the type
@@ -67,6 +81,35 @@ protected:
     */
     mutable int m_current_offset;
 
+    // ------------------------------------------------------------------------
+    /** Returns a pointer to the content, viewed or owned. */
+    const uint8_t* bytes() const
+    {
+        return m_view ? m_view : m_buffer.data();
+    }   // bytes
+    // ------------------------------------------------------------------------
+    /** Returns the byte at pos, throws std::out_of_range if pos is not in
+     *  the string (like std::vector::at). */
+    uint8_t byteAt(int pos) const
+    {
+        if (pos < 0 || pos >= (int)getTotalSize())
+            throw std::out_of_range("Network string index out of range.");
+        return bytes()[pos];
+    }   // byteAt
+    // ------------------------------------------------------------------------
+    /** Returns the own buffer to change the content, the viewed data is
+     *  copied into it first if the string is a view. */
+    std::vector<uint8_t>& buffer()
+    {
+        if (m_view)
+        {
+            m_buffer.assign(m_view, m_view + m_view_size);
+            m_view = NULL;
+            m_view_size = 0;
+            m_view_owner.reset();
+        }
+        return m_buffer;
+    }   // buffer
     // ------------------------------------------------------------------------
     /** Returns a part of the network string as a std::string. This is an
     *  internal function only, the user should call decodeString(W) instead.
@@ -75,12 +118,12 @@ protected:
     */
     std::string getString(int len) const
     {
-        if (m_current_offset > (int)m_buffer.size() ||
-            m_current_offset + len > (int)m_buffer.size())
+        if (m_current_offset > (int)getTotalSize() ||
+            m_current_offset + len > (int)getTotalSize())
             throw std::out_of_range("getString out of range.");
 
-        std::string a(m_buffer.begin() + (m_current_offset      ),
-                      m_buffer.begin() + (m_current_offset + len));
+        std::string a(bytes() + (m_current_offset      ),
+                      bytes() + (m_current_offset + len));
         m_current_offset += len;
         return a;
     }   // getString
@@ -88,8 +131,9 @@ protected:
     /** Adds a std::string. Internal use only. */
     BareNetworkString& addString(const std::string& value)
     {
+        std::vector<uint8_t>& b = buffer();
         for (unsigned int i = 0; i < value.size(); i++)
-            m_buffer.push_back((uint8_t)(value[i]));
+            b.push_back((uint8_t)(value[i]));
         return *this;
     }   // addString
 
@@ -106,7 +150,7 @@ protected:
         {
             result <<= 8; // offset one byte
                           // add the data to result
-            result += m_buffer.at(offset - a);
+            result += byteAt(offset - a);
         }
         return result;
     }   // get(int pos)
@@ -115,7 +159,7 @@ protected:
     template<typename T>
     T get() const
     {
-        return m_buffer.at(m_current_offset++);
+        return byteAt(m_current_offset++);
     }   // get
 
 public:
@@ -124,12 +168,16 @@ public:
     BareNetworkString(int capacity=16)
     {
         m_buffer.reserve(capacity);
+        m_view = NULL;
+        m_view_size = 0;
         m_current_offset = 0;
     }   // BareNetworkString
 
     // ------------------------------------------------------------------------
     BareNetworkString(const std::string &s)
     {
+        m_view = NULL;
+        m_view_size = 0;
         m_current_offset = 0;
         encodeString(s);
     }   // BareNetworkString
@@ -137,10 +185,56 @@ public:
     /** Initialises the string with a sequence of characters. */
     BareNetworkString(const char *data, int len)
     {
+        m_view = NULL;
+        m_view_size = 0;
         m_current_offset = 0;
         m_buffer.resize(len);
         memcpy(m_buffer.data(), data, len);
     }   // BareNetworkString
+    // ------------------------------------------------------------------------
+    /** Makes this string a read-only view of len bytes at data without
+     *  copying them, and starts reading at the beginning.
+     *  \param owner Keeps the data alive as long as the string views it.
+     */
+    void setView(std::shared_ptr<const void> owner, const uint8_t* data,
+                 int len)
+    {
+        m_buffer.clear();
+        m_view_owner = std::move(owner);
+        m_view = data;
+        m_view_size = len;
+        m_current_offset = 0;
+    }   // setView
+    // ------------------------------------------------------------------------
+    /** Sets the content of this string to the unread content of another
+     *  string. If the other string is a view, its data is shared and not
+     *  copied. */
+    void assignUnread(const BareNetworkString& other)
+    {
+        if (other.m_view)
+        {
+            setView(other.m_view_owner,
+                    other.m_view + other.m_current_offset, other.size());
+            return;
+        }
+        clearData();
+        m_buffer.assign(other.m_buffer.begin() + other.m_current_offset,
+                        other.m_buffer.end());
+    }   // assignUnread
+    // ------------------------------------------------------------------------
+    /** Removes the whole content (releasing viewed data), but keeps the
+     *  capacity of the own buffer. */
+    void clearData()
+    {
+        m_buffer.clear();
+        m_view = NULL;
+        m_view_size = 0;
+        m_view_owner.reset();
+        m_current_offset = 0;
+    }   // clearData
+    // ------------------------------------------------------------------------
+    /** Returns if this string is a view of data it does not own. */
+    bool isView() const                             { return m_view != NULL; }
 
     // ------------------------------------------------------------------------
     /** Allows one to read a buffer from the beginning again. */
@@ -158,23 +252,25 @@ public:
     int decodeStringW(irr::core::stringw *out) const;
     std::string getLogMessage(const std::string &indent="") const;
     // ------------------------------------------------------------------------
-    /** Returns the internal buffer of the network string. */
-    std::vector<uint8_t>& getBuffer() { return m_buffer; }
+    /** Returns the internal buffer of the network string, the viewed data
+     *  is copied into it if the string is a view. */
+    std::vector<uint8_t>& getBuffer() { return buffer(); }
 
     // ------------------------------------------------------------------------
-    /** Returns a byte pointer to the content of the network string. */
-    char* getData() { return (char*)(m_buffer.data()); };
+    /** Returns a byte pointer to the content of the network string, which
+     *  must not be changed if the string is a view. */
+    char* getData() { return (char*)(bytes()); };
 
     // ------------------------------------------------------------------------
     /** Returns a byte pointer to the content of the network string. */
-    const char* getData() const { return (char*)(m_buffer.data()); };
+    const char* getData() const { return (char*)(bytes()); };
 
     // ------------------------------------------------------------------------
     /** Returns a byte pointer to the unread remaining content of the network
-     *  string. */
+     *  string, which must not be changed if the string is a view. */
     char* getCurrentData()
     {
-        return (char*)(m_buffer.data()+m_current_offset);
+        return (char*)(bytes()+m_current_offset);
     }   // getCurrentData
 
     // ------------------------------------------------------------------------
@@ -182,13 +278,13 @@ public:
      *  string. */
     const char* getCurrentData() const
     {
-        return (char*)(m_buffer.data()+m_current_offset); 
+        return (char*)(bytes()+m_current_offset); 
     }   // getCurrentData
     // ------------------------------------------------------------------------
     int getCurrentOffset() const                   { return m_current_offset; }
     // ------------------------------------------------------------------------
     /** Returns the remaining length of the network string. */
-    unsigned int size() const { return (int)m_buffer.size()-m_current_offset; }
+    unsigned int size() const { return (int)getTotalSize()-m_current_offset; }
 
     // ------------------------------------------------------------------------
     /** Skips the specified number of bytes when reading. */
@@ -196,20 +292,24 @@ public:
     {
         m_current_offset += n;
         assert(m_current_offset >=0 &&
-               m_current_offset <= (int)m_buffer.size());
+               m_current_offset <= (int)getTotalSize());
     }   // skip
     // ------------------------------------------------------------------------
     /** Returns the send size, which is the full length of the buffer. A 
      *  difference to size() happens if the string to be sent was previously
      *  read, and has m_current_offset != 0. Even in this case the whole
      *  string must be sent. */
-    unsigned int getTotalSize() const { return (unsigned int)m_buffer.size(); }
+    unsigned int getTotalSize() const
+    {
+        return m_view ? (unsigned int)m_view_size
+                      : (unsigned int)m_buffer.size();
+    }   // getTotalSize
     // ------------------------------------------------------------------------
     // All functions related to adding data to a network string
     /** Add 8 bit unsigned int. */
     BareNetworkString& addUInt8(const uint8_t value)
     {
-        m_buffer.push_back(value);
+        buffer().push_back(value);
         return *this;
     }   // addUInt8
 
@@ -217,15 +317,16 @@ public:
     /** Adds a single character to the string. */
     BareNetworkString& addChar(const char value)
     {
-        m_buffer.push_back((uint8_t)(value));
+        buffer().push_back((uint8_t)(value));
         return *this;
     }   // addChar
     // ------------------------------------------------------------------------
     /** Adds 16 bit unsigned int. */
     BareNetworkString& addUInt16(const uint16_t value)
     {
-        m_buffer.push_back((value >> 8) & 0xff);
-        m_buffer.push_back(value & 0xff);
+        std::vector<uint8_t>& b = buffer();
+        b.push_back((value >> 8) & 0xff);
+        b.push_back(value & 0xff);
         return *this;
     }   // addUInt16
 
@@ -234,9 +335,10 @@ public:
     BareNetworkString& addInt24(const int value)
     {
         uint32_t combined = (uint32_t)value & 0xffffff;
-        m_buffer.push_back((combined >> 16) & 0xff);
-        m_buffer.push_back((combined >> 8) & 0xff);
-        m_buffer.push_back(combined & 0xff);
+        std::vector<uint8_t>& b = buffer();
+        b.push_back((combined >> 16) & 0xff);
+        b.push_back((combined >> 8) & 0xff);
+        b.push_back(combined & 0xff);
         return *this;
     }   // addInt24
 
@@ -244,10 +346,11 @@ public:
     /** Adds unsigned 32 bit integer. */
     BareNetworkString& addUInt32(const uint32_t& value)
     {
-        m_buffer.push_back((value >> 24) & 0xff);
-        m_buffer.push_back((value >> 16) & 0xff);
-        m_buffer.push_back((value >>  8) & 0xff);
-        m_buffer.push_back( value        & 0xff);
+        std::vector<uint8_t>& b = buffer();
+        b.push_back((value >> 24) & 0xff);
+        b.push_back((value >> 16) & 0xff);
+        b.push_back((value >>  8) & 0xff);
+        b.push_back( value        & 0xff);
         return *this;
     }   // addUInt32
 
@@ -255,14 +358,15 @@ public:
     /** Adds unsigned 64 bit integer. */
     BareNetworkString& addUInt64(const uint64_t& value)
     {
-        m_buffer.push_back((value >> 56) & 0xff);
-        m_buffer.push_back((value >> 48) & 0xff);
-        m_buffer.push_back((value >> 40) & 0xff);
-        m_buffer.push_back((value >> 32) & 0xff);
-        m_buffer.push_back((value >> 24) & 0xff);
-        m_buffer.push_back((value >> 16) & 0xff);
-        m_buffer.push_back((value >>  8) & 0xff);
-        m_buffer.push_back( value        & 0xff);
+        std::vector<uint8_t>& b = buffer();
+        b.push_back((value >> 56) & 0xff);
+        b.push_back((value >> 48) & 0xff);
+        b.push_back((value >> 40) & 0xff);
+        b.push_back((value >> 32) & 0xff);
+        b.push_back((value >> 24) & 0xff);
+        b.push_back((value >> 16) & 0xff);
+        b.push_back((value >>  8) & 0xff);
+        b.push_back( value        & 0xff);
         return *this;
     }   // addUInt64
 
@@ -279,9 +383,9 @@ public:
      *  has not been 'removed' (i.e. skipped). */
     BareNetworkString& operator+=(BareNetworkString const& value)
     {
-        m_buffer.insert(m_buffer.end(),
-                       value.m_buffer.begin()+value.m_current_offset,
-                       value.m_buffer.end()   );
+        std::vector<uint8_t>& b = buffer();
+        b.insert(b.end(), value.bytes() + value.m_current_offset,
+                 value.bytes() + value.getTotalSize());
         return *this;
     }   // operator+=
 
@@ -345,13 +449,13 @@ public:
     /** Returns an unsigned 8-bit integer. */
     inline uint8_t getUInt8() const
     {
-        return m_buffer.at(m_current_offset++);
+        return byteAt(m_current_offset++);
     }   // getUInt8
     // ------------------------------------------------------------------------
     /** Returns an unsigned 8-bit integer. */
     inline int8_t getInt8() const
     {
-        return m_buffer.at(m_current_offset++);
+        return byteAt(m_current_offset++);
     }   // getInt8
     // ------------------------------------------------------------------------
     /** Gets a 4 byte floating point value. */
@@ -442,18 +546,31 @@ public:
         m_current_offset = 1;   // ignore type
     }   // NetworkString
 
+    // ------------------------------------------------------------------------
+    /** Constructor for a received message which is read without copying it:
+     *  the string is a view of len bytes at data, kept alive by owner (e.g.
+     *  the received ENet packet). */
+    NetworkString(std::shared_ptr<const void> owner, const uint8_t *data,
+                  int len)
+        : BareNetworkString(0)
+    {
+        setView(std::move(owner), data, len);
+        m_current_offset = 1;   // ignore type
+    }   // NetworkString
+
     // ------------------------------------------------------------------------
     /** Empties the string, but does not reset the pre-allocated size. */
     void clear()
     {
-        m_buffer.erase(m_buffer.begin() + 1, m_buffer.end());
+        std::vector<uint8_t>& b = buffer();
+        b.erase(b.begin() + 1, b.end());
         m_current_offset = 1;
     }   // clear
     // ------------------------------------------------------------------------
     /** Returns the protocol type of this message. */
     ProtocolType getProtocolType() const
     {
-        return (ProtocolType)(m_buffer.at(0) & ~PROTOCOL_SYNCHRONOUS);
+        return (ProtocolType)(byteAt(0) & ~PROTOCOL_SYNCHRONOUS);
     }   // getProtocolType
 
     // ------------------------------------------------------------------------
@@ -461,15 +578,15 @@ public:
     void setSynchronous(bool b)
     {
         if(b)
-            m_buffer[0] |= PROTOCOL_SYNCHRONOUS;
+            buffer()[0] |= PROTOCOL_SYNCHRONOUS;
         else
-            m_buffer[0] &= ~PROTOCOL_SYNCHRONOUS;
+            buffer()[0] &= ~PROTOCOL_SYNCHRONOUS;
     }   // setSynchronous
     // ------------------------------------------------------------------------
     /** Returns if this message is synchronous or not. */
     bool isSynchronous() const
     {
-        return (m_buffer[0] & PROTOCOL_SYNCHRONOUS) == PROTOCOL_SYNCHRONOUS;
+        return (bytes()[0] & PROTOCOL_SYNCHRONOUS) == PROTOCOL_SYNCHRONOUS;
     }   // isSynchronous
 
 };   // class NetworkString
@@ -0,0 +1,376 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/peer_registry.hpp"
+
+#include "network/network_player_profile.hpp"
+#include "network/remote_kart_info.hpp"
+#include "network/socket_address.hpp"
+#include "network/stk_peer.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+/** Rebuilds all indexes from m_peers. */
+void PeerRegistry::Snapshot::buildIndexes()
+{
+    m_by_host_id.clear();
+    m_by_online_id.clear();
+    m_by_address.clear();
+    m_by_host_id.reserve(m_peers.size());
+    m_by_address.reserve(m_peers.size());
+    for (unsigned i = 0; i < m_peers.size(); i++)
+    {
+        STKPeer* peer = m_peers[i].get();
+        m_by_host_id[peer->getHostId()] = i;
+        m_by_address[peer->getAddress().toString()] = i;
+        auto& players = peer->getPlayerProfiles();
+        if (!players.empty())
+            m_by_online_id.emplace(players[0]->getOnlineId(), i);
+    }
+}   // buildIndexes
+
+// ----------------------------------------------------------------------------
+std::shared_ptr<STKPeer>
+    PeerRegistry::Snapshot::findPeer(ENetPeer* enet_peer) const
+{
+    auto it = std::lower_bound(m_enet_peers.begin(), m_enet_peers.end(),
+        enet_peer);
+    if (it == m_enet_peers.end() || *it != enet_peer)
+        return nullptr;
+    return m_peers[it - m_enet_peers.begin()];
+}   // findPeer
+
+// ----------------------------------------------------------------------------
+std::shared_ptr<STKPeer>
+    PeerRegistry::Snapshot::findPeerByHostId(uint32_t host_id) const
+{
+    auto it = m_by_host_id.find(host_id);
+    return it == m_by_host_id.end() ? nullptr : m_peers[it->second];
+}   // findPeerByHostId
+
+// ----------------------------------------------------------------------------
+/** Returns the peers whose first player has this online id (0 for offline
+ *  players), in the order of m_peers. */
+std::vector<std::shared_ptr<STKPeer> >
+    PeerRegistry::Snapshot::findPeersByOnlineId(uint32_t online_id) const
+{
+    std::vector<unsigned> indices;
+    auto range = m_by_online_id.equal_range(online_id);
+    for (auto it = range.first; it != range.second; it++)
+        indices.push_back(it->second);
+    std::sort(indices.begin(), indices.end());
+    std::vector<std::shared_ptr<STKPeer> > peers;
+    for (unsigned i : indices)
+        peers.push_back(m_peers[i]);
+    return peers;
+}   // findPeersByOnlineId
+
+// ----------------------------------------------------------------------------
+std::shared_ptr<STKPeer>
+    PeerRegistry::Snapshot::findPeerByAddress(const SocketAddress& addr) const
+{
+    auto it = m_by_address.find(addr.toString());
+    return it == m_by_address.end() ? nullptr : m_peers[it->second];
+}   // findPeerByAddress
+
+// ============================================================================
+PeerRegistry::PeerRegistry()
+{
+    m_snapshot = std::make_shared<const Snapshot>();
+}   // PeerRegistry
+
+// ----------------------------------------------------------------------------
+/** Builds the indexes of a new snapshot and makes it the current one, must
+ *  be called with m_write_mutex locked. */
+void PeerRegistry::publish(Snapshot* snapshot)
+{
+    snapshot->buildIndexes();
+    std::shared_ptr<const Snapshot> new_snapshot(snapshot);
+    std::atomic_store(&m_snapshot, new_snapshot);
+}   // publish
+
+// ----------------------------------------------------------------------------
+/** Adds a peer (or replaces the peer of this enet peer).
+ *  \return The number of peers after adding it. */
+size_t PeerRegistry::add(ENetPeer* enet_peer, std::shared_ptr<STKPeer> peer)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    Snapshot* snapshot = new Snapshot(*get());
+    auto it = std::lower_bound(snapshot->m_enet_peers.begin(),
+        snapshot->m_enet_peers.end(), enet_peer);
+    const size_t index = it - snapshot->m_enet_peers.begin();
+    if (it != snapshot->m_enet_peers.end() && *it == enet_peer)
+        snapshot->m_peers[index] = peer;
+    else
+    {
+        snapshot->m_enet_peers.insert(it, enet_peer);
+        snapshot->m_peers.insert(snapshot->m_peers.begin() + index, peer);
+    }
+    const size_t size = snapshot->size();
+    publish(snapshot);
+    return size;
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Removes the peer of an enet peer.
+ *  \param new_peer_count If not NULL, the number of peers after removing.
+ *  \return The peer removed, or NULL if the enet peer was not found. */
+std::shared_ptr<STKPeer> PeerRegistry::remove(ENetPeer* enet_peer,
+                                              size_t* new_peer_count)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    std::shared_ptr<const Snapshot> current = get();
+    auto it = std::lower_bound(current->m_enet_peers.begin(),
+        current->m_enet_peers.end(), enet_peer);
+    if (it == current->m_enet_peers.end() || *it != enet_peer)
+    {
+        if (new_peer_count)
+            *new_peer_count = current->size();
+        return nullptr;
+    }
+    const size_t index = it - current->m_enet_peers.begin();
+    std::shared_ptr<STKPeer> peer = current->m_peers[index];
+    Snapshot* snapshot = new Snapshot(*current);
+    snapshot->m_enet_peers.erase(snapshot->m_enet_peers.begin() + index);
+    snapshot->m_peers.erase(snapshot->m_peers.begin() + index);
+    if (new_peer_count)
+        *new_peer_count = snapshot->size();
+    publish(snapshot);
+    return peer;
+}   // remove
+
+// ----------------------------------------------------------------------------
+/** Removes the peers of several enet peers with a single new snapshot. */
+void PeerRegistry::remove(const std::vector<ENetPeer*>& enet_peers)
+{
+    if (enet_peers.empty())
+        return;
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    std::shared_ptr<const Snapshot> current = get();
+    Snapshot* snapshot = new Snapshot();
+    for (unsigned i = 0; i < current->m_enet_peers.size(); i++)
+    {
+        ENetPeer* enet_peer = current->m_enet_peers[i];
+        if (std::find(enet_peers.begin(), enet_peers.end(), enet_peer) !=
+            enet_peers.end())
+            continue;
+        snapshot->m_enet_peers.push_back(enet_peer);
+        snapshot->m_peers.push_back(current->m_peers[i]);
+    }
+    publish(snapshot);
+}   // remove
+
+// ----------------------------------------------------------------------------
+/** Removes all peers.
+ *  \return The peers removed. */
+std::vector<std::shared_ptr<STKPeer> > PeerRegistry::clear()
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    std::vector<std::shared_ptr<STKPeer> > peers = get()->m_peers;
+    publish(new Snapshot());
+    return peers;
+}   // clear
+
+// ----------------------------------------------------------------------------
+/** Publishes a new snapshot with the same peers, to update the online id
+ *  index after the players of a peer changed. */
+void PeerRegistry::updateIndexes()
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    publish(new Snapshot(*get()));
+}   // updateIndexes
+
+// ============================================================================
+namespace PeerRegistryTest
+{
+    // ------------------------------------------------------------------------
+    /** Compares the indexes of the current snapshot with linear searches. */
+    void checkIndexes(const PeerRegistry& registry)
+    {
+        std::shared_ptr<const PeerRegistry::Snapshot> snapshot =
+            registry.get();
+        assert(std::is_sorted(snapshot->m_enet_peers.begin(),
+            snapshot->m_enet_peers.end()));
+        for (unsigned i = 0; i < snapshot->size(); i++)
+        {
+            std::shared_ptr<STKPeer> peer = snapshot->m_peers[i];
+            assert(snapshot->findPeer(snapshot->m_enet_peers[i]) == peer);
+            assert(snapshot->findPeerByHostId(peer->getHostId()) == peer);
+            assert(snapshot->findPeerByAddress(peer->getAddress()) == peer);
+            if (peer->getPlayerProfiles().empty())
+                continue;
+            const uint32_t online_id =
+                peer->getPlayerProfiles()[0]->getOnlineId();
+            std::vector<std::shared_ptr<STKPeer> > expected;
+            for (auto& p : snapshot->m_peers)
+            {
+                if (!p->getPlayerProfiles().empty() &&
+                    p->getPlayerProfiles()[0]->getOnlineId() == online_id)
+                    expected.push_back(p);
+            }
+            assert(snapshot->findPeersByOnlineId(online_id) == expected);
+        }
+    }   // checkIndexes
+
+    // ------------------------------------------------------------------------
+    /** Checks the indexes while adding and removing peers, then measures
+     *  readers looking up peers while a writer keeps changing the peers,
+     *  compared with a linear search in a map locked by a mutex (the
+     *  previous implementation in STKHost). */
+    void unitTesting()
+    {
+        const unsigned PEER_COUNT = 64;
+        std::vector<ENetPeer> enet_peers(PEER_COUNT);
+        std::vector<std::shared_ptr<STKPeer> > peers;
+        for (unsigned i = 0; i < PEER_COUNT; i++)
+        {
+            memset(&enet_peers[i], 0, sizeof(ENetPeer));
+            enet_peers[i].address =
+                SocketAddress(10, 0, (uint8_t)(i / 256), (uint8_t)(i % 256),
+                2759).toENetAddress();
+            peers.push_back(std::make_shared<STKPeer>(&enet_peers[i],
+                (STKHost*)NULL, i + 1));
+            // Two peers share each online id
+            peers.back()->getPlayerProfiles().push_back(
+                std::make_shared<NetworkPlayerProfile>(peers.back(),
+                L"Player", i + 1, 0.0f, i / 2, HANDICAP_NONE, 0,
+                KART_TEAM_NONE, ""));
+        }
+
+        PeerRegistry registry;
+        assert(registry.get()->empty());
+        // Add in reverse order, the snapshot is sorted anyway
+        for (unsigned i = PEER_COUNT; i > 0; i--)
+        {
+            size_t count = registry.add(&enet_peers[i - 1], peers[i - 1]);
+            assert(count == PEER_COUNT - i + 1);
+            (void)count;
+        }
+        checkIndexes(registry);
+        std::shared_ptr<const PeerRegistry::Snapshot> old = registry.get();
+        assert(old->findPeersByOnlineId(3).size() == 2);
+        SocketAddress unknown(10, 0, 0, 1, 2760);
+        assert(old->findPeerByAddress(unknown) == nullptr);
+        assert(old->findPeerByHostId(PEER_COUNT + 1) == nullptr);
+
+        size_t count = 0;
+        assert(registry.remove(&enet_peers[6], &count) == peers[6]);
+        assert(count == PEER_COUNT - 1);
+        assert(registry.remove(&enet_peers[6], &count) == nullptr);
+        (void)count;
+        registry.remove({ &enet_peers[7], &enet_peers[8] });
+        checkIndexes(registry);
+        assert(registry.get()->size() == PEER_COUNT - 3);
+        assert(registry.get()->findPeersByOnlineId(3).empty());
+        assert(registry.get()->findPeerByHostId(9) == nullptr);
+        // A snapshot held by a reader is not changed
+        assert(old->size() == PEER_COUNT);
+        assert(old->findPeerByHostId(7) == peers[6]);
+
+        // Player profiles changed: the online id index is updated by
+        // updateIndexes
+        peers[0]->getPlayerProfiles().clear();
+        registry.updateIndexes();
+        checkIndexes(registry);
+        assert(registry.get()->findPeersByOnlineId(0).size() == 1);
+
+        // Readers with a writer changing the peers in another thread
+        const unsigned LOOKUPS = 200000;
+        std::atomic_bool stop(false);
+        std::thread writer([&]()
+            {
+                unsigned i = 0;
+                while (!stop.load())
+                {
+                    registry.remove(&enet_peers[i % PEER_COUNT]);
+                    registry.add(&enet_peers[i % PEER_COUNT],
+                        peers[i % PEER_COUNT]);
+                    i++;
+                }
+            });
+        uint64_t start = StkTime::getMonoTimeMs();
+        unsigned found = 0;
+        for (unsigned i = 0; i < LOOKUPS; i++)
+        {
+            std::shared_ptr<const PeerRegistry::Snapshot> snapshot =
+                registry.get();
+            std::shared_ptr<STKPeer> peer =
+                snapshot->findPeerByHostId(i % PEER_COUNT + 1);
+            if (peer)
+            {
+                assert(peer->getHostId() == i % PEER_COUNT + 1);
+                found++;
+            }
+        }
+        const uint64_t registry_time = StkTime::getMonoTimeMs() - start;
+        stop.store(true);
+        writer.join();
+        // At most one peer is missing in each snapshot, so most are found
+        assert(found > 0);
+
+        std::mutex mutex;
+        std::map<ENetPeer*, std::shared_ptr<STKPeer> > map;
+        for (unsigned i = 0; i < PEER_COUNT; i++)
+            map[&enet_peers[i]] = peers[i];
+        stop.store(false);
+        std::thread map_writer([&]()
+            {
+                unsigned i = 0;
+                while (!stop.load())
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    map.erase(&enet_peers[i % PEER_COUNT]);
+                    map[&enet_peers[i % PEER_COUNT]] = peers[i % PEER_COUNT];
+                    i++;
+                }
+            });
+        start = StkTime::getMonoTimeMs();
+        unsigned map_found = 0;
+        for (unsigned i = 0; i < LOOKUPS; i++)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const uint32_t host_id = i % PEER_COUNT + 1;
+            auto it = std::find_if(map.begin(), map.end(),
+                [host_id](const std::pair<ENetPeer*,
+                std::shared_ptr<STKPeer> >& p)
+                {
+                    return p.second->getHostId() == host_id;
+                });
+            if (it != map.end())
+                map_found++;
+        }
+        const uint64_t map_time = StkTime::getMonoTimeMs() - start;
+        stop.store(true);
+        map_writer.join();
+        Log::info("PeerRegistry", "%u lookups by host id with a writer "
+            "running: %u ms with snapshots, %u ms with a locked map "
+            "(%u peers).", LOOKUPS, (unsigned)registry_time,
+            (unsigned)map_time, PEER_COUNT);
+        (void)found;
+        (void)map_found;
+    }   // unitTesting
+
+}   // namespace PeerRegistryTest
@@ -0,0 +1,130 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_PEER_REGISTRY_HPP
+#define HEADER_PEER_REGISTRY_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <enet/enet.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class SocketAddress;
+class STKPeer;
+
+/** \brief The peers connected to a host, published as immutable snapshots
+ *  (read-copy-update). Adding or removing a peer copies the current
+ *  snapshot, changes the copy and replaces the current one atomically, so
+ *  readers (the lobby, game and console threads) only take a reference to
+ *  the current snapshot and never wait for the enet thread, and a snapshot
+ *  they hold is never changed. A snapshot is freed when the last reader
+ *  releases it.
+ *  Each snapshot has hash indexes by host id, online id and address. The
+ *  online ids are read from the player profiles of the peers, so
+ *  updateIndexes must be called when they change (see STKPeer::addPlayer).
+ *  \ingroup network
+ */
+class PeerRegistry : public NoCopy
+{
+public:
+    /** An immutable list of peers with its indexes. */
+    class Snapshot
+    {
+    friend class PeerRegistry;
+    private:
+        /** Index of each peer in m_peers by host id. */
+        std::unordered_map<uint32_t, unsigned> m_by_host_id;
+
+        /** Indices of the peers by the online id of their first player,
+         *  a peer without players is not in it. */
+        std::unordered_multimap<uint32_t, unsigned> m_by_online_id;
+
+        /** Index of each peer in m_peers by its address (with port). */
+        std::unordered_map<std::string, unsigned> m_by_address;
+
+        // --------------------------------------------------------------------
+        void buildIndexes();
+
+    public:
+        /** The enet peers, sorted by address in memory (the order of the
+         *  previous std::map of peers). */
+        std::vector<ENetPeer*> m_enet_peers;
+
+        /** The peer of each enet peer in m_enet_peers. */
+        std::vector<std::shared_ptr<STKPeer> > m_peers;
+
+        // --------------------------------------------------------------------
+        std::shared_ptr<STKPeer> findPeer(ENetPeer* enet_peer) const;
+        // --------------------------------------------------------------------
+        std::shared_ptr<STKPeer> findPeerByHostId(uint32_t host_id) const;
+        // --------------------------------------------------------------------
+        std::vector<std::shared_ptr<STKPeer> >
+                                findPeersByOnlineId(uint32_t online_id) const;
+        // --------------------------------------------------------------------
+        std::shared_ptr<STKPeer>
+                           findPeerByAddress(const SocketAddress& addr) const;
+        // --------------------------------------------------------------------
+        size_t size() const                          { return m_peers.size(); }
+        // --------------------------------------------------------------------
+        bool empty() const                          { return m_peers.empty(); }
+    };   // class Snapshot
+
+private:
+    /** The current snapshot, only accessed with std::atomic_load and
+     *  std::atomic_store. */
+    std::shared_ptr<const Snapshot> m_snapshot;
+
+    /** Serializes the writers, readers never take it. */
+    std::mutex m_write_mutex;
+
+    // ------------------------------------------------------------------------
+    void publish(Snapshot* snapshot);
+
+public:
+    PeerRegistry();
+    // ------------------------------------------------------------------------
+    /** Returns the current snapshot, which stays valid and unchanged as long
+     *  as it's held. */
+    std::shared_ptr<const Snapshot> get() const
+                                    { return std::atomic_load(&m_snapshot); }
+    // ------------------------------------------------------------------------
+    size_t add(ENetPeer* enet_peer, std::shared_ptr<STKPeer> peer);
+    // ------------------------------------------------------------------------
+    std::shared_ptr<STKPeer> remove(ENetPeer* enet_peer,
+                                    size_t* new_peer_count = NULL);
+    // ------------------------------------------------------------------------
+    void remove(const std::vector<ENetPeer*>& enet_peers);
+    // ------------------------------------------------------------------------
+    std::vector<std::shared_ptr<STKPeer> > clear();
+    // ------------------------------------------------------------------------
+    void updateIndexes();
+
+};   // class PeerRegistry
+
+namespace PeerRegistryTest
+{
+    void unitTesting();
+}
+
+#endif
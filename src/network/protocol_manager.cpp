@@ -26,6 +26,7 @@
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
 #include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 #include "utils/vs.hpp"
 
@@ -54,8 +55,8 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
     pm->m_asynchronous_update_thread = std::thread([pm, pt]()
         {
             std::string thread_name = "PtlMgr";
-            if (pt == PT_CHILD)
-                thread_name += "_child";
+            if (pt != PT_MAIN)
+                thread_name += "_child" + StringUtils::toString(pt);
             VS::setThreadName(thread_name.c_str());
             STKProcess::init(pt);
             while(!pm->m_exit.load())
@@ -72,18 +73,26 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
             {
                 VS::setThreadName("CtrlEvents");
                 STKProcess::init(pt);
-                while (true)
+                while (!pm->m_exit.load())
                 {
-                    std::unique_lock<std::mutex> ul(pm->m_game_protocol_mutex);
-                    pm->m_game_protocol_cv.wait(ul, [&pm]
-                        {
-                            return !pm->m_controller_events_list.empty();
-                        });
-                    Event* event_top = pm->m_controller_events_list.front();
-                    pm->m_controller_events_list.pop_front();
-                    ul.unlock();
-                    if (event_top == NULL)
-                        break;
+                    Event* event_top = NULL;
+                    if (!pm->m_controller_events_queue.pop(&event_top))
+                    {
+                        std::unique_lock<std::mutex> ul(
+                            pm->m_game_protocol_mutex);
+                        pm->m_game_protocol_waiting.store(true);
+                        // Pairs with the fence in propagateEvent, so either
+                        // the new event is seen here or the listening thread
+                        // sees that it has to notify
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        pm->m_game_protocol_cv.wait(ul, [&pm]
+                            {
+                                return pm->m_exit.load() ||
+                                    !pm->m_controller_events_queue.empty();
+                            });
+                        pm->m_game_protocol_waiting.store(false);
+                        continue;
+                    }
                     auto sl = LobbyProtocol::get<ServerLobby>();
                     if (sl)
                     {
@@ -110,6 +119,7 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
 ProtocolManager::ProtocolManager()
 {
     m_exit.store(false);
+    m_game_protocol_waiting.store(false);
 }   // ProtocolManager
 
 // ----------------------------------------------------------------------------
@@ -121,24 +131,23 @@ ProtocolManager::~ProtocolManager()
         m_all_protocols[i].abort();
     }
 
-    m_sync_events_to_process.lock();
-    for (EventList::iterator i =m_sync_events_to_process.getData().begin();
-                             i!=m_sync_events_to_process.getData().end(); ++i)
+    for (EventList::iterator i =m_sync_events_to_process.begin();
+                             i!=m_sync_events_to_process.end(); ++i)
         delete *i;
-    m_sync_events_to_process.getData().clear();
-    m_sync_events_to_process.unlock();
+    m_sync_events_to_process.clear();
 
-    m_async_events_to_process.lock();
-    for (EventList::iterator i = m_async_events_to_process.getData().begin();
-                             i!= m_async_events_to_process.getData().end(); ++i)
+    for (EventList::iterator i = m_async_events_to_process.begin();
+                             i!= m_async_events_to_process.end(); ++i)
         delete *i;
-    m_async_events_to_process.getData().clear();
-    m_async_events_to_process.unlock();
+    m_async_events_to_process.clear();
 
-    for (EventList::iterator i = m_controller_events_list.begin();
-                             i!= m_controller_events_list.end(); ++i)
-        delete *i;
-    m_controller_events_list.clear();
+    Event* event;
+    while (m_sync_events_queue.pop(&event))
+        delete event;
+    while (m_async_events_queue.pop(&event))
+        delete event;
+    while (m_controller_events_queue.pop(&event))
+        delete event;
 
 }   // ~ProtocolManager
 
@@ -163,7 +172,6 @@ void ProtocolManager::abort()
     if (NetworkConfig::get()->isServer())
     {
         std::unique_lock<std::mutex> ul(m_game_protocol_mutex);
-        m_controller_events_list.push_back(NULL);
         m_game_protocol_cv.notify_one();
         ul.unlock();
         m_game_protocol_thread.join();
@@ -175,7 +183,9 @@ void ProtocolManager::abort()
 // ----------------------------------------------------------------------------
 /** \brief Function that processes incoming events.
  *  This function is called by the network manager each time there is an
- *  incoming packet.
+ *  incoming packet. It must only be called by one thread at a time (the
+ *  listening thread of STKHost), since the event queues have a single
+ *  producer.
  */
 void ProtocolManager::propagateEvent(Event* event)
 {
@@ -184,23 +194,19 @@ void ProtocolManager::propagateEvent(Event* event)
         event->getType() == EVENT_TYPE_MESSAGE &&
         event->data().getProtocolType() == PROTOCOL_CONTROLLER_EVENTS)
     {
-        std::lock_guard<std::mutex> lock(m_game_protocol_mutex);
-        m_controller_events_list.push_back(event);
-        m_game_protocol_cv.notify_one();
+        m_controller_events_queue.push(event);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_game_protocol_waiting.load())
+        {
+            std::lock_guard<std::mutex> lock(m_game_protocol_mutex);
+            m_game_protocol_cv.notify_one();
+        }
         return;
     }
     if (event->isSynchronous())
-    {
-        m_sync_events_to_process.lock();
-        m_sync_events_to_process.getData().push_back(event);
-        m_sync_events_to_process.unlock();
-    }
+        m_sync_events_queue.push(event);
     else
-    {
-        m_async_events_to_process.lock();
-        m_async_events_to_process.getData().push_back(event);
-        m_async_events_to_process.unlock();
-    }
+        m_async_events_queue.push(event);
 }   // propagateEvent
 
 // ----------------------------------------------------------------------------
@@ -378,12 +384,13 @@ void ProtocolManager::update(int ticks)
     ul.unlock();
 
     // before updating, notify protocols that they have received events
-    m_sync_events_to_process.lock();
-    EventList::iterator i = m_sync_events_to_process.getData().begin();
+    Event* event;
+    while (m_sync_events_queue.pop(&event))
+        m_sync_events_to_process.push_back(event);
+    EventList::iterator i = m_sync_events_to_process.begin();
 
-    while (i != m_sync_events_to_process.getData().end())
+    while (i != m_sync_events_to_process.end())
     {
-        m_sync_events_to_process.unlock();
         bool can_be_deleted = true;
         try
         {
@@ -396,11 +403,10 @@ void ProtocolManager::update(int ticks)
                 "Synchronous event error from %s: %s", name.c_str(), e.what());
             Log::error("ProtocolManager", (*i)->data().getLogMessage().c_str());
         }
-        m_sync_events_to_process.lock();
         if (can_be_deleted)
         {
             delete *i;
-            i = m_sync_events_to_process.getData().erase(i);
+            i = m_sync_events_to_process.erase(i);
         }
         else
         {
@@ -408,7 +414,6 @@ void ProtocolManager::update(int ticks)
             ++i;
         }
     }
-    m_sync_events_to_process.unlock();
 
     // Now update all protocols.
     for (unsigned int i = 0; i < all_protocols.size(); i++)
@@ -437,11 +442,12 @@ void ProtocolManager::asynchronousUpdate()
     auto all_protocols = m_all_protocols;
     ul.unlock();
 
-    m_async_events_to_process.lock();
-    EventList::iterator i = m_async_events_to_process.getData().begin();
-    while (i != m_async_events_to_process.getData().end())
+    Event* event;
+    while (m_async_events_queue.pop(&event))
+        m_async_events_to_process.push_back(event);
+    EventList::iterator i = m_async_events_to_process.begin();
+    while (i != m_async_events_to_process.end())
     {
-        m_async_events_to_process.unlock();
 
         bool result = true;
         try
@@ -457,11 +463,10 @@ void ProtocolManager::asynchronousUpdate()
                 (*i)->data().getLogMessage().c_str());
         }
 
-        m_async_events_to_process.lock();
         if (result)
         {
             delete *i;
-            i = m_async_events_to_process.getData().erase(i);
+            i = m_async_events_to_process.erase(i);
         }
         else
         {
@@ -470,7 +475,6 @@ void ProtocolManager::asynchronousUpdate()
             ++i;
         }
     }   // while i != m_events_to_process.end()
-    m_async_events_to_process.unlock();
 
     PROFILER_POP_CPU_MARKER();
     PROFILER_PUSH_CPU_MARKER("Message delivery", 255, 0, 0);
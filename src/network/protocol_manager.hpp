@@ -27,6 +27,7 @@
 #include "network/protocol.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/singleton.hpp"
+#include "utils/spsc_queue.hpp"
 #include "utils/stk_process.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/types.hpp"
@@ -150,13 +151,27 @@ private:
     /** A list of network events - messages, disconnect and disconnects. */
     typedef std::list<Event*> EventList;
 
-    /** Contains the network events to pass synchronously to protocols
-     *  (i.e. from the main thread). */
-    Synchronised<EventList> m_sync_events_to_process;
+    /** The network events received by the listening thread of STKHost
+     *  (which is the only thread adding events) to pass synchronously to
+     *  protocols (i.e. from the main thread). */
+    SPSCQueue<Event*> m_sync_events_queue;
 
-    /** Contains the network events to pass asynchronously to protocols
-    *  (i.e. from the separate ProtocolManager thread). */
-    Synchronised<EventList> m_async_events_to_process;
+    /** The network events to pass asynchronously to protocols (i.e. from the
+     *  separate ProtocolManager thread). */
+    SPSCQueue<Event*> m_async_events_queue;
+
+    /** Controller events on the server, handled by the game protocol
+     *  thread. */
+    SPSCQueue<Event*> m_controller_events_queue;
+
+    /** The events taken from m_sync_events_queue which were not handled yet
+     *  (e.g. because the protocol has not been started), only used by the
+     *  main thread. */
+    EventList m_sync_events_to_process;
+
+    /** The events taken from m_async_events_queue which were not handled
+     *  yet, only used by the ProtocolManager thread. */
+    EventList m_async_events_to_process;
 
     /** When set to true, the main thread will exit. */
     std::atomic_bool m_exit;
@@ -172,7 +187,9 @@ private:
 
     std::mutex m_game_protocol_mutex, m_protocols_mutex;
 
-    EventList m_controller_events_list;
+    /** Set by the game protocol thread before it waits for controller
+     *  events, so it is only notified if needed. */
+    std::atomic_bool m_game_protocol_waiting;
 
     /*! Single instance of protocol manager.*/
     static std::weak_ptr<ProtocolManager> m_protocol_manager[PT_COUNT];
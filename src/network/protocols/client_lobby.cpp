@@ -334,6 +334,10 @@ void ClientLobby::addAllPlayers(Event* event)
         RaceManager::get()->setFlagDeactivatedTicks(flag_deactivated_time);
     }
     getPlayersAddonKartType(data, players);
+    const std::set<std::string>& caps =
+        NetworkConfig::get()->getServerCapabilities();
+    NetworkConfig::get()->setBitPackedState(
+        caps.find("bit_packed_state") != caps.end() && data.getUInt8() == 1);
     configRemoteKart(players, isSpectator() ? 1 :
         (int)NetworkConfig::get()->getNetworkPlayers().size());
     loadWorld();
@@ -22,6 +22,7 @@
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/player_controller.hpp"
 #include "modes/world.hpp"
+#include "network/crypto.hpp"
 #include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/game_setup.hpp"
@@ -31,6 +32,7 @@
 #include "network/protocol_manager.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/server_config.hpp"
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
@@ -39,6 +41,25 @@
 #include "utils/time.hpp"
 #include "main_loop.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+/** Number of states the server keeps as baselines for delta compression. A
+ *  client keeps twice as many, so any baseline still known to the server is
+ *  also still known to the client. */
+const unsigned MAX_STATE_HISTORY = 16;
+
+/** With adaptive state rate: packet loss above which the rate of states to a
+ *  client is lowered, and from which each state is sent twice (if the upload
+ *  speed allows it). */
+const float STATE_LOSS_CONGESTED = 0.1f;
+const float STATE_LOSS_REDUNDANT = 0.02f;
+
+/** Clients with less packet loss and ping than this can get states at a
+ *  higher rate than state-frequency. */
+const float STATE_LOSS_GOOD = 0.01f;
+const unsigned STATE_RTT_GOOD = 50;
+
 // ============================================================================
 std::weak_ptr<GameProtocol> GameProtocol::m_game_protocol[PT_COUNT];
 // ============================================================================
@@ -63,12 +84,50 @@ GameProtocol::GameProtocol()
     m_network_item_manager = static_cast<NetworkItemManager*>
         (Track::getCurrentTrack()->getItemManager());
     m_data_to_send = getNetworkString();
+    m_state_bytes_full = 0;
+    m_state_bytes_sent = 0;
+    m_state_peer_count = 0;
+    m_state_count = 0;
+    m_state_history.resize(NetworkConfig::get()->isServer() ?
+        MAX_STATE_HISTORY : MAX_STATE_HISTORY * 2);
+    m_state_history_next = 0;
+    m_new_state = NULL;
+    m_latest_state = NULL;
+    m_nominal_state_interval = 1;
+    if (NetworkConfig::get()->isServer())
+    {
+        if (ServerConfig::m_adaptive_state_rate)
+        {
+            m_nominal_state_interval = std::max(1, (int)roundf(
+                (float)NetworkConfig::get()->getStateFrequency() /
+                (float)ServerConfig::m_state_frequency));
+        }
+        Crypto::generateKeyIV(&m_broadcast_key, &m_broadcast_iv);
+        m_broadcast_crypto.reset(new Crypto(m_broadcast_key,
+            m_broadcast_iv));
+    }
 }   // GameProtocol
 
 //-----------------------------------------------------------------------------
 GameProtocol::~GameProtocol()
 {
     delete m_data_to_send;
+    if (m_state_peer_count > 0)
+    {
+        // Report the average bandwidth used by states for each peer
+        const float per_second = (float)NetworkConfig::get()
+            ->getStateFrequency() / (float)m_state_peer_count;
+        Log::info("GameProtocol", "%u states sent, %.1f bytes/s per peer, "
+            "%.1f bytes/s per peer without delta compression.",
+            m_state_count, (float)m_state_bytes_sent * per_second,
+            (float)m_state_bytes_full * per_second);
+    }
+    for (auto& p : m_rewinder_state_bytes)
+    {
+        Log::info("GameProtocol", "Rewinder type %d: %u states, %.1f bytes "
+            "per state.", (int)p.first, p.second.second,
+            (float)p.second.first / (float)p.second.second);
+    }
 }   // ~GameProtocol
 
 //-----------------------------------------------------------------------------
@@ -131,6 +190,11 @@ bool GameProtocol::notifyEventAsynchronous(Event* event)
     {
     case GP_CONTROLLER_ACTION: handleControllerAction(event); break;
     case GP_STATE:             handleState(event);            break;
+    case GP_STATE_DELTA:       handleDeltaState(event);       break;
+    case GP_PARTIAL_STATE:     handlePartialState(event);     break;
+    case GP_STATE_ACK:         handleStateAck(event);         break;
+    case GP_BROADCAST_KEY:     handleBroadcastKey(event);     break;
+    case GP_REWINDER_ID:       handleRewinderID(event);       break;
     case GP_ITEM_CONFIRMATION: handleItemEventConfirmation(event); break;
     case GP_ADJUST_TIME:
     case GP_ITEM_UPDATE:
@@ -288,26 +352,54 @@ void GameProtocol::startNewState()
     m_data_to_send->clear();
     m_data_to_send->addUInt8(GP_STATE)
         .addUInt32(World::getWorld()->getTicksSinceStart());
+    // Snapshots are also needed to create partial states for each peer
+    m_new_state = ServerConfig::m_delta_state ||
+        ServerConfig::m_state_relevance_distance > 0.0f ?
+        getNextSnapshot() : NULL;
+    m_relevance_position.clear();
 }   // startNewState
 
 // ----------------------------------------------------------------------------
-/** Called by a server to add data to the current state. The data in buffer
- *  is copied, so the data can be freed after this call/.
- *  \param buffer Adds the data in the buffer to the current state.
+/** Called by a server to add the state of a rewinder to the current state.
+ *  The rewinder writes its data directly into the message, after the size
+ *  of the data which is set afterwards.
+ *  \param rewinder The rewinder to save the state of.
+ *  \param ru The network ids of all rewinders in the current state.
  */
-void GameProtocol::addState(BareNetworkString *buffer)
+void GameProtocol::addState(Rewinder* rewinder, std::vector<uint16_t>* ru)
 {
     assert(NetworkConfig::get()->isServer());
-    m_data_to_send->addUInt16(buffer->size());
-    (*m_data_to_send) += *buffer;
+    std::vector<uint8_t>& buffer = m_data_to_send->getBuffer();
+    const size_t size_pos = buffer.size();
+    m_data_to_send->addUInt16(0);
+    if (!rewinder->saveState(m_data_to_send, ru))
+    {
+        buffer.resize(size_pos);
+        return;
+    }
+    const size_t size = buffer.size() - size_pos - 2;
+    const std::string& identity = rewinder->getUniqueIdentity();
+    if (!identity.empty())
+    {
+        auto& bytes = m_rewinder_state_bytes[identity[0]];
+        bytes.first += size;
+        bytes.second++;
+    }
+    buffer[size_pos] = (uint8_t)((size >> 8) & 0xff);
+    buffer[size_pos + 1] = (uint8_t)(size & 0xff);
+    if (m_new_state)
+        m_new_state->add(ru->back(), buffer.data() + size_pos + 2,
+            (unsigned)size);
+    if (const Vec3* xyz = rewinder->getRelevancePosition())
+        m_relevance_position.emplace_back(ru->back(), *xyz);
 }   // addState
 
 // ----------------------------------------------------------------------------
 /** Called by a server to finalize the current state, which add updated
- *  names of rewinder using to the beginning of state buffer
+ *  network ids of rewinder using to the beginning of state buffer
  *  \param cur_rewinder List of current rewinder using.
  */
-void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
+void GameProtocol::finalizeState(std::vector<uint16_t>& cur_rewinder)
 {
     assert(NetworkConfig::get()->isServer());
     auto& buffer = m_data_to_send->getBuffer();
@@ -315,27 +407,784 @@ void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
         4/*time*/;
 
     m_data_to_send->reset();
-    std::vector<uint8_t> names;
-    names.push_back((uint8_t)cur_rewinder.size());
-    for (std::string& name : cur_rewinder)
+    uint8_t ids[1 + 255 * 2];
+    unsigned size = 0;
+    ids[size++] = (uint8_t)cur_rewinder.size();
+    for (uint16_t id : cur_rewinder)
     {
-        names.push_back((uint8_t)name.size());
-        std::vector<uint8_t> rewinder(name.begin(), name.end());
-        names.insert(names.end(), rewinder.begin(), rewinder.end());
+        ids[size++] = (uint8_t)(id >> 8);
+        ids[size++] = (uint8_t)id;
     }
-    buffer.insert(pos, names.begin(), names.end());
+    buffer.insert(pos, ids, ids + size);
+    m_rewinder_using = cur_rewinder;
+
+    if (!m_new_state)
+        return;
+    // Keep the state so it can be used as a baseline for delta states
+    m_new_state->m_ticks = World::getWorld()->getTicksSinceStart();
+    m_latest_state = m_new_state;
+    m_new_state = NULL;
+    m_state_history_next = (m_state_history_next + 1) %
+        m_state_history.size();
 }   // finalizeState
 
 // ----------------------------------------------------------------------------
 /** Called when the last state information has been added and the message
- *  can be sent to the clients.
+ *  can be sent to the clients. Clients which have acknowledged a state still
+ *  in m_state_history receive a delta compressed state against it instead
+ *  of the full state.
  */
 void GameProtocol::sendState()
 {
     assert(NetworkConfig::get()->isServer());
-    sendMessageToPeers(m_data_to_send, /*reliable*/false);
+    const unsigned full_size = m_data_to_send->getTotalSize();
+    // Delta states for each baseline used, shared by all peers which
+    // acknowledged the same state. NULL if the full state is smaller.
+    std::map<int, NetworkString*> delta_states;
+    // All peers receiving the same message
+    std::map<NetworkString*, std::vector<std::shared_ptr<STKPeer> > >
+        recipients;
+    // State with unique identities instead of network ids of rewinders
+    NetworkString* legacy_state = NULL;
+    // States without the rewinders which are not relevant for some peers,
+    // for each baseline used, rewinders left out and rewinders left out of
+    // the baseline
+    std::map<std::tuple<int, std::vector<uint16_t>, std::vector<uint16_t> >,
+        NetworkString*> partial_states;
+    const bool partial_state =
+        ServerConfig::m_state_relevance_distance > 0.0f && m_latest_state &&
+        m_latest_state->m_ticks == World::getWorld()->getTicksSinceStart();
+
+    m_state_count++;
+    auto peers = STKHost::get()->getPeerSnapshot();
+    for (auto& peer : peers->m_peers)
+    {
+        if (!peer->isValidated() || peer->isWaitingForGame())
+            continue;
+        if (ServerConfig::m_adaptive_state_rate &&
+            !shouldSendState(peer, (unsigned)peers->size()))
+            continue;
+
+        const std::set<std::string>& caps = peer->getClientCapabilities();
+        if (caps.find("rewinder_id") == caps.end())
+        {
+            // Client which needs the unique identities of rewinders
+            if (!legacy_state)
+                legacy_state = createLegacyState();
+            recipients[legacy_state].push_back(peer);
+            m_state_peer_count++;
+            m_state_bytes_full += legacy_state->getTotalSize();
+            m_state_bytes_sent += legacy_state->getTotalSize();
+            continue;
+        }
+        sendRewinderID(peer);
+
+        if (partial_state && caps.find("partial_state") != caps.end())
+        {
+            // Leave out rewinders far away from the karts of this peer
+            std::vector<uint16_t> skipped;
+            // Peers which don't get all states take turns on their own
+            // states to send far rewinders
+            auto rate = m_state_rate.find(peer);
+            getSkippedRewinders(peer.get(), rate == m_state_rate.end() ?
+                m_state_count : rate->second.m_states_sent, &skipped);
+            auto& history = m_state_skipped[peer];
+
+            // Rewinders left out of the baseline are unknown to the client
+            const StateSnapshot* baseline = NULL;
+            const std::vector<uint16_t>* baseline_skipped = NULL;
+            if (ServerConfig::m_delta_state &&
+                caps.find("delta_state") != caps.end())
+            {
+                std::unique_lock<std::mutex> ul(m_state_acked_mutex);
+                auto it = m_state_acked.find(peer);
+                if (it != m_state_acked.end())
+                {
+                    for (auto& h : history)
+                    {
+                        if (h.first == it->second)
+                            baseline_skipped = &h.second;
+                    }
+                    if (baseline_skipped)
+                        baseline = findSnapshot(it->second);
+                }
+            }
+            static const std::vector<uint16_t> none;
+            NetworkString*& ns = partial_states[std::make_tuple(
+                baseline ? baseline->m_ticks : -1, skipped,
+                baseline ? *baseline_skipped : none)];
+            if (!ns)
+            {
+                ns = createPartialState(baseline, skipped,
+                    baseline ? *baseline_skipped : none);
+                if (baseline && ns->getTotalSize() >= full_size)
+                {
+                    delete ns;
+                    ns = createPartialState(NULL, skipped, none);
+                }
+            }
+            history.emplace_back(m_latest_state->m_ticks, std::move(skipped));
+            while (history.size() > m_state_history.size())
+                history.pop_front();
+            recipients[ns].push_back(peer);
+            m_state_peer_count++;
+            m_state_bytes_full += full_size;
+            m_state_bytes_sent += ns->getTotalSize();
+            continue;
+        }
+
+        NetworkString* ns = m_data_to_send;
+        const StateSnapshot* baseline = NULL;
+        if (ServerConfig::m_delta_state &&
+            caps.find("delta_state") != caps.end())
+        {
+            std::unique_lock<std::mutex> ul(m_state_acked_mutex);
+            auto it = m_state_acked.find(peer);
+            if (it != m_state_acked.end())
+                baseline = findSnapshot(it->second);
+        }
+        if (baseline)
+        {
+            auto it = delta_states.find(baseline->m_ticks);
+            if (it == delta_states.end())
+            {
+                NetworkString* delta = createDeltaState(*baseline);
+                if (delta->getTotalSize() >= full_size)
+                {
+                    delete delta;
+                    delta = NULL;
+                }
+                it = delta_states.emplace(baseline->m_ticks, delta).first;
+            }
+            if (it->second)
+                ns = it->second;
+        }
+        recipients[ns].push_back(peer);
+        m_state_peer_count++;
+        m_state_bytes_full += full_size;
+        m_state_bytes_sent += ns->getTotalSize();
+    }
+
+    for (auto& r : recipients)
+    {
+        std::vector<std::shared_ptr<STKPeer> >& to = r.second;
+        const unsigned size = r.first->getTotalSize();
+        // Copy of this state kept for lossy peers, shared by all of them
+        std::shared_ptr<NetworkString> copy;
+        for (auto& peer : to)
+        {
+            auto it = m_state_rate.find(peer);
+            if (it == m_state_rate.end())
+                continue;
+            StateRate& rate = it->second;
+            rate.m_average_size = rate.m_average_size * 0.9f +
+                (float)size * 0.1f;
+            // Lossy peers get each state a second time together with their
+            // next state, so that both copies are not lost in the same
+            // datagram (the client ignores the copy if it has the state)
+            if (rate.m_previous_state)
+            {
+                sendUnreliableToPeers(rate.m_previous_state.get(), { peer });
+                m_state_bytes_sent += rate.m_previous_state->getTotalSize();
+                rate.m_previous_state.reset();
+            }
+            if (rate.m_redundancy > 1)
+            {
+                if (!copy)
+                    copy = std::make_shared<NetworkString>(*r.first);
+                rate.m_previous_state = copy;
+            }
+        }
+        sendUnreliableToPeers(r.first, to);
+    }
+    for (auto& p : delta_states)
+        delete p.second;
+    for (auto& p : partial_states)
+        delete p.second;
+    delete legacy_state;
 }   // sendState
 
+// ----------------------------------------------------------------------------
+/** Returns if the current state is sent to a peer with adaptive state rate,
+ *  and adapts the rate of the peer once per second.
+ *  \param peer The peer.
+ *  \param peer_count Number of peers sharing the upload speed.
+ */
+bool GameProtocol::shouldSendState(std::shared_ptr<STKPeer> peer,
+                                   unsigned peer_count)
+{
+    auto it = m_state_rate.find(peer);
+    if (it == m_state_rate.end())
+    {
+        for (auto i = m_state_rate.begin(); i != m_state_rate.end();)
+        {
+            if (i->first.expired())
+                i = m_state_rate.erase(i);
+            else
+                i++;
+        }
+        StateRate rate;
+        rate.m_interval = m_nominal_state_interval;
+        rate.m_redundancy = 1;
+        rate.m_next_state = m_state_count;
+        rate.m_next_update = StkTime::getMonoTimeMs() + 1000;
+        rate.m_average_size = 0.0f;
+        rate.m_states_sent = 0;
+        it = m_state_rate.emplace(peer, rate).first;
+        peer->setStateRate(rate.m_interval, rate.m_redundancy);
+    }
+    StateRate& rate = it->second;
+
+    const uint64_t now = StkTime::getMonoTimeMs();
+    if (now >= rate.m_next_update)
+    {
+        rate.m_next_update = now + 1000;
+        // Bytes per second used by this peer compared to its share of the
+        // upload limit
+        const float limit = (float)ServerConfig::m_state_upload_limit *
+            1024.0f;
+        const float upload = (float)STKHost::get()->getUploadSpeed();
+        const float peer_upload = rate.m_average_size *
+            (float)rate.m_redundancy *
+            (float)NetworkConfig::get()->getStateFrequency() /
+            (float)rate.m_interval;
+        const bool over_share = limit > 0.0f && upload > limit &&
+            peer_upload > limit / (float)std::max(peer_count, 1u);
+        const bool upload_headroom = limit <= 0.0f || upload < limit * 0.9f;
+        const std::set<std::string>& caps = peer->getClientCapabilities();
+        adaptStateRate(&rate,
+            (float)peer->getPacketLoss() / (float)ENET_PEER_PACKET_LOSS_SCALE,
+            peer->getRoundTripTime(), over_share, upload_headroom,
+            m_nominal_state_interval,
+            caps.find("state_redundancy") != caps.end() ? 2 : 1);
+        peer->setStateRate(rate.m_interval, rate.m_redundancy);
+    }
+
+    if (m_state_count < rate.m_next_state)
+        return false;
+    rate.m_next_state = m_state_count + rate.m_interval;
+    rate.m_states_sent++;
+    return true;
+}   // shouldSendState
+
+// ----------------------------------------------------------------------------
+/** Adapts the state rate of a client to its connection: the rate is halved
+ *  for congested clients, and increased step by step for others, up to the
+ *  maximum rate for clients with a good connection and to state-frequency
+ *  for the others.
+ *  \param rate The rate to adapt.
+ *  \param loss Packet loss of the client (between 0 and 1).
+ *  \param rtt Round trip time to the client in ms.
+ *  \param over_share If the server upload speed is above the limit, and
+ *         this client uses more than its share of it.
+ *  \param upload_headroom If the rate can be increased without reaching the
+ *         upload limit.
+ *  \param nominal_interval Interval for state-frequency states per second.
+ *  \param max_redundancy Maximum number of copies supported by the client.
+ */
+void GameProtocol::adaptStateRate(StateRate* rate, float loss, unsigned rtt,
+                                  bool over_share, bool upload_headroom,
+                                  unsigned nominal_interval,
+                                  unsigned max_redundancy)
+{
+    const unsigned max_interval = nominal_interval * 3;
+    if (loss >= STATE_LOSS_CONGESTED || over_share)
+    {
+        rate->m_interval = std::min(rate->m_interval * 2, max_interval);
+    }
+    else if (rate->m_interval > nominal_interval ||
+        (loss < STATE_LOSS_GOOD && rtt <= STATE_RTT_GOOD))
+    {
+        if (upload_headroom && rate->m_interval > 1)
+            rate->m_interval--;
+    }
+    else if (rate->m_interval < nominal_interval)
+    {
+        // No longer good enough for the higher rate
+        rate->m_interval++;
+    }
+    rate->m_redundancy = max_redundancy > 1 && upload_headroom &&
+        !over_share && loss >= STATE_LOSS_REDUNDANT &&
+        loss < STATE_LOSS_CONGESTED ? 2 : 1;
+}   // adaptStateRate
+
+// ----------------------------------------------------------------------------
+/** Finds the rewinders of the current state which are far away from all
+ *  karts of a peer. They are left out of the state for this peer, except in
+ *  every state-far-interval state (which one depends on the network id, so
+ *  that not all of them are sent in the same state).
+ *  \param peer The peer.
+ *  \param state_count Number of states sent to the peer.
+ *  \param skipped The sorted network ids of the rewinders to leave out.
+ */
+void GameProtocol::getSkippedRewinders(STKPeer* peer, unsigned state_count,
+                                       std::vector<uint16_t>* skipped)
+{
+    // Spectators get everything
+    const std::set<unsigned>& kart_ids = peer->getAvailableKartIDs();
+    if (kart_ids.empty())
+        return;
+    World* world = World::getWorld();
+    const float max_distance2 = ServerConfig::m_state_relevance_distance *
+        ServerConfig::m_state_relevance_distance;
+    const unsigned interval =
+        (unsigned)std::max((int)ServerConfig::m_state_far_interval, 1);
+    for (auto& p : m_relevance_position)
+    {
+        if ((state_count + p.first) % interval == 0)
+            continue;
+        bool relevant = false;
+        for (unsigned id : kart_ids)
+        {
+            if (id < world->getNumKarts() &&
+                (world->getKart(id)->getXYZ() - p.second).length2() <=
+                max_distance2)
+            {
+                relevant = true;
+                break;
+            }
+        }
+        if (!relevant)
+            skipped->push_back(p.first);
+    }
+    std::sort(skipped->begin(), skipped->end());
+}   // getSkippedRewinders
+
+// ----------------------------------------------------------------------------
+/** Creates a state without some rewinders from the latest state, either
+ *  full or delta compressed.
+ *  \param baseline The baseline state for delta compression, NULL for a
+ *         full state.
+ *  \param skipped The sorted network ids of the rewinders to leave out.
+ *  \param baseline_skipped The sorted network ids of the rewinders which
+ *         were left out of the baseline state for the peers of this state.
+ */
+NetworkString* GameProtocol::createPartialState(const StateSnapshot* baseline,
+                                                const std::vector<uint16_t>&
+                                                skipped,
+                                                const std::vector<uint16_t>&
+                                                baseline_skipped)
+{
+    const StateSnapshot& current = *m_latest_state;
+    NetworkString* ns = getNetworkString(m_data_to_send->getTotalSize());
+    ns->addUInt8(GP_PARTIAL_STATE).addUInt32(current.m_ticks)
+        .addUInt32(baseline ? baseline->m_ticks : -1)
+        .addUInt8((uint8_t)(current.m_rewinder_using.size() -
+        skipped.size()));
+    for (uint16_t id : current.m_rewinder_using)
+    {
+        if (!std::binary_search(skipped.begin(), skipped.end(), id))
+            ns->addUInt16(id);
+    }
+    ns->addUInt8((uint8_t)skipped.size());
+    for (uint16_t id : skipped)
+        ns->addUInt16(id);
+
+    std::vector<uint8_t>& buffer = ns->getBuffer();
+    for (unsigned i = 0; i < current.m_rewinder_using.size(); i++)
+    {
+        const uint16_t id = current.m_rewinder_using[i];
+        if (std::binary_search(skipped.begin(), skipped.end(), id))
+            continue;
+        if (!baseline)
+        {
+            ns->addUInt16((uint16_t)current.getSize(i));
+            buffer.insert(buffer.end(), current.getData(i),
+                current.getData(i) + current.getSize(i));
+            continue;
+        }
+        int b = baseline->find(id);
+        if (std::binary_search(baseline_skipped.begin(),
+            baseline_skipped.end(), id))
+            b = -1;
+        addRewinderDelta(ns, current.getData(i), current.getSize(i),
+            b == -1 ? NULL : baseline->getData(b),
+            b == -1 ? 0 : baseline->getSize(b));
+    }
+    return ns;
+}   // createPartialState
+
+// ----------------------------------------------------------------------------
+/** Sends the unique identities of all rewinders, which were added since the
+ *  last call and still exist, to a client. The client needs them to know
+ *  the rewinder of each network id in states.
+ *  \param peer The client to send to.
+ */
+void GameProtocol::sendRewinderID(std::shared_ptr<STKPeer> peer)
+{
+    const unsigned count = RewindManager::get()->getRewinderIDCount();
+    auto it = m_rewinder_id_sent.find(peer);
+    if (it == m_rewinder_id_sent.end())
+    {
+        for (auto i = m_rewinder_id_sent.begin();
+             i != m_rewinder_id_sent.end();)
+        {
+            if (i->first.expired())
+                i = m_rewinder_id_sent.erase(i);
+            else
+                i++;
+        }
+        it = m_rewinder_id_sent.emplace(peer, 0).first;
+    }
+    if (it->second >= count)
+        return;
+
+    std::vector<std::pair<uint16_t, std::string> > names;
+    for (unsigned i = it->second; i < count; i++)
+    {
+        std::string name = RewindManager::get()->getRewinderName(i);
+        if (RewindManager::get()->findRewinder(name))
+            names.emplace_back(i, name);
+    }
+    it->second = count;
+    if (names.empty())
+        return;
+
+    NetworkString* ns = getNetworkString();
+    ns->addUInt8(GP_REWINDER_ID).addUInt16((uint16_t)names.size());
+    for (auto& name : names)
+        ns->addUInt16(name.first).encodeString(name.second);
+    peer->sendPacket(ns, /*reliable*/true);
+    delete ns;
+}   // sendRewinderID
+
+// ----------------------------------------------------------------------------
+/** Called on a client when the server sends the unique identities of new
+ *  rewinder network ids.
+ *  \param event The message.
+ */
+void GameProtocol::handleRewinderID(Event *event)
+{
+    if (!NetworkConfig::get()->isClient())
+        return;
+    NetworkString &data = event->data();
+    try
+    {
+        const unsigned count = data.getUInt16();
+        for (unsigned i = 0; i < count; i++)
+        {
+            const uint16_t id = data.getUInt16();
+            std::string name;
+            data.decodeString(&name);
+            RewindManager::get()->addRewinderName(id, name);
+        }
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("GameProtocol", "Invalid rewinder ids: %s.", e.what());
+    }
+}   // handleRewinderID
+
+// ----------------------------------------------------------------------------
+/** Creates a copy of the current state which contains the unique identities
+ *  of rewinders instead of their network ids, for clients which don't
+ *  support them.
+ */
+NetworkString* GameProtocol::createLegacyState()
+{
+    const std::vector<uint8_t>& state = m_data_to_send->getBuffer();
+    const unsigned header = 1/*protocol type*/ + 1 /*gp event type*/+
+        4/*time*/;
+    const unsigned ids_size = 1 + (unsigned)m_rewinder_using.size() * 2;
+    NetworkString* ns = getNetworkString(m_data_to_send->getTotalSize() +
+        (unsigned)m_rewinder_using.size() * 8);
+    std::vector<uint8_t>& buffer = ns->getBuffer();
+    buffer.insert(buffer.end(), state.begin() + 1, state.begin() + header);
+    ns->addUInt8((uint8_t)m_rewinder_using.size());
+    for (uint16_t id : m_rewinder_using)
+        ns->encodeString(RewindManager::get()->getRewinderName(id));
+    buffer.insert(buffer.end(), state.begin() + header + ids_size,
+        state.end());
+    return ns;
+}   // createLegacyState
+
+// ----------------------------------------------------------------------------
+/** Sends the same unreliable message to several peers. The enet packet is
+ *  created only once for all peers without encryption and once for all
+ *  peers which have the broadcast key, only other peers need the message
+ *  to be encrypted separately.
+ *  \param ns The message to send.
+ *  \param peers The peers to send it to.
+ */
+void GameProtocol::sendUnreliableToPeers(NetworkString* ns,
+                               const std::vector<std::shared_ptr<STKPeer> >&
+                               peers)
+{
+    std::vector<STKPeer*> unencrypted, broadcast;
+    for (auto& peer : peers)
+    {
+        if (!peer->getCrypto())
+            unencrypted.push_back(peer.get());
+        else if (useBroadcastKey(peer))
+            broadcast.push_back(peer.get());
+        else
+            peer->sendPacket(ns, /*reliable*/false);
+    }
+
+    if (!unencrypted.empty())
+    {
+        ENetPacket* packet = enet_packet_create(ns->getData(),
+            ns->getTotalSize(), ENET_PACKET_FLAG_UNSEQUENCED |
+            ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT);
+        if (packet)
+        {
+            STKHost::get()->sendSharedPacket(unencrypted, packet,
+                EVENT_CHANNEL_NORMAL);
+        }
+    }
+    if (!broadcast.empty())
+    {
+        ENetPacket* packet = m_broadcast_crypto->encryptSend(*ns,
+            /*reliable*/false);
+        if (packet)
+        {
+            STKHost::get()->sendSharedPacket(broadcast, packet,
+                EVENT_CHANNEL_BROADCAST);
+        }
+    }
+}   // sendUnreliableToPeers
+
+// ----------------------------------------------------------------------------
+/** Returns if unreliable messages to the given peer can be encrypted with
+ *  the broadcast key. If the peer supports it but doesn't have the key yet,
+ *  the key is sent to it (encrypted with the key of the peer).
+ *  \param peer The peer to check.
+ */
+bool GameProtocol::useBroadcastKey(std::shared_ptr<STKPeer> peer)
+{
+    if (peer->getClientCapabilities().find("broadcast_crypto") ==
+        peer->getClientCapabilities().end())
+        return false;
+
+    std::unique_lock<std::mutex> ul(m_broadcast_key_mutex);
+    auto it = m_broadcast_key_peers.find(peer);
+    if (it != m_broadcast_key_peers.end())
+        return it->second;
+    m_broadcast_key_peers[peer] = false;
+    ul.unlock();
+
+    NetworkString* ns = getNetworkString(1 + 16 + 12);
+    ns->addUInt8(GP_BROADCAST_KEY);
+    for (uint8_t k : m_broadcast_key)
+        ns->addUInt8(k);
+    for (uint8_t iv : m_broadcast_iv)
+        ns->addUInt8(iv);
+    peer->sendPacket(ns, /*reliable*/true);
+    delete ns;
+    return false;
+}   // useBroadcastKey
+
+// ----------------------------------------------------------------------------
+/** On a client, receives the broadcast key from the server, which is then
+ *  used to decrypt messages on the broadcast channel, and confirms it. On
+ *  the server, handles the confirmation of a client.
+ *  \param event The message.
+ */
+void GameProtocol::handleBroadcastKey(Event *event)
+{
+    if (NetworkConfig::get()->isServer())
+    {
+        std::unique_lock<std::mutex> ul(m_broadcast_key_mutex);
+        for (auto it = m_broadcast_key_peers.begin();
+             it != m_broadcast_key_peers.end();)
+        {
+            if (it->first.expired())
+                it = m_broadcast_key_peers.erase(it);
+            else
+                it++;
+        }
+        auto it = m_broadcast_key_peers.find(event->getPeerSP());
+        if (it != m_broadcast_key_peers.end())
+            it->second = true;
+        return;
+    }
+
+    NetworkString &data = event->data();
+    if (data.size() != 16 + 12)
+    {
+        Log::warn("GameProtocol", "Invalid broadcast key.");
+        return;
+    }
+    std::vector<uint8_t> key, iv;
+    for (unsigned i = 0; i < 16; i++)
+        key.push_back(data.getUInt8());
+    for (unsigned i = 0; i < 12; i++)
+        iv.push_back(data.getUInt8());
+    event->getPeer()->setBroadcastCrypto(std::make_shared<Crypto>(key, iv));
+
+    NetworkString *ns = getNetworkString(1);
+    ns->addUInt8(GP_BROADCAST_KEY);
+    sendToServer(ns, /*reliable*/true);
+    delete ns;
+}   // handleBroadcastKey
+
+// ----------------------------------------------------------------------------
+/** Returns the state with the given ticks in m_state_history, or NULL if
+ *  it's not available (anymore).
+ *  \param ticks Time of the state.
+ */
+const GameProtocol::StateSnapshot* GameProtocol::findSnapshot(int ticks) const
+{
+    if (ticks < 0)
+        return NULL;
+    for (const StateSnapshot& snapshot : m_state_history)
+    {
+        if (snapshot.m_ticks == ticks)
+            return &snapshot;
+    }
+    return NULL;
+}   // findSnapshot
+
+// ----------------------------------------------------------------------------
+/** Returns the oldest slot in m_state_history, cleared to store a new state.
+ *  The slot is only used as baseline after m_state_history_next is
+ *  advanced and its ticks are set.
+ */
+GameProtocol::StateSnapshot* GameProtocol::getNextSnapshot()
+{
+    StateSnapshot* snapshot = &m_state_history[m_state_history_next];
+    if (snapshot == m_latest_state)
+        m_latest_state = NULL;
+    snapshot->clear(-1);
+    return snapshot;
+}   // getNextSnapshot
+
+// ----------------------------------------------------------------------------
+/** Creates a delta compressed message of the latest state against an older
+ *  state the client has acknowledged.
+ *  \param baseline The state the client already has.
+ */
+NetworkString* GameProtocol::createDeltaState(const StateSnapshot& baseline)
+{
+    const StateSnapshot& current = *m_latest_state;
+    NetworkString* ns = getNetworkString(m_data_to_send->getTotalSize());
+    ns->addUInt8(GP_STATE_DELTA).addUInt32(current.m_ticks)
+        .addUInt32(baseline.m_ticks)
+        .addUInt8((uint8_t)current.m_rewinder_using.size());
+    for (uint16_t id : current.m_rewinder_using)
+        ns->addUInt16(id);
+    for (unsigned i = 0; i < current.m_rewinder_using.size(); i++)
+    {
+        const int b = baseline.find(current.m_rewinder_using[i]);
+        addRewinderDelta(ns, current.getData(i), current.getSize(i),
+            b == -1 ? NULL : baseline.getData(b),
+            b == -1 ? 0 : baseline.getSize(b));
+    }
+    return ns;
+}   // createDeltaState
+
+// ----------------------------------------------------------------------------
+/** Adds the state of one rewinder, either as the XOR against the same
+ *  rewinder in the baseline state with runs of unchanged bytes skipped, or
+ *  as full data if there is no usable baseline or it's not smaller.
+ *  \param out The message to add the data to.
+ *  \param data The state data of the rewinder.
+ *  \param size Size of the state data.
+ *  \param baseline The state data of the rewinder in the baseline state,
+ *         can be NULL.
+ *  \param baseline_size Size of the baseline data.
+ */
+void GameProtocol::addRewinderDelta(BareNetworkString* out,
+                                    const uint8_t* data, unsigned size,
+                                    const uint8_t* baseline,
+                                    unsigned baseline_size)
+{
+    out->addUInt16((uint16_t)size);
+    std::vector<uint8_t>& buffer = out->getBuffer();
+    const size_t mode_pos = buffer.size();
+    if (baseline && baseline_size == size && size > 0)
+    {
+        out->addUInt8(SD_XOR);
+        unsigned i = 0;
+        while (i < size)
+        {
+            uint8_t zeros = 0;
+            while (i < size && zeros < 255 && data[i] == baseline[i])
+            {
+                zeros++;
+                i++;
+            }
+            const size_t literals_pos = buffer.size() + 1;
+            out->addUInt8(zeros).addUInt8(0);
+            uint8_t literals = 0;
+            while (i < size && literals < 255 && data[i] != baseline[i])
+            {
+                out->addUInt8(data[i] ^ baseline[i]);
+                literals++;
+                i++;
+            }
+            buffer[literals_pos] = literals;
+        }
+        if (buffer.size() - mode_pos - 1 < size)
+            return;
+        // Not enough similarity, use the full data
+        buffer.resize(mode_pos);
+    }
+    out->addUInt8(SD_FULL);
+    buffer.insert(buffer.end(), data, data + size);
+}   // addRewinderDelta
+
+// ----------------------------------------------------------------------------
+/** Reads the state of one rewinder written by addRewinderDelta.
+ *  \param in The message to read from.
+ *  \param data The reconstructed state data of the rewinder is appended
+ *         to it.
+ *  \param baseline The state data of the rewinder in the baseline state,
+ *         can be NULL.
+ *  \param baseline_size Size of the baseline data.
+ */
+void GameProtocol::getRewinderDelta(BareNetworkString* in,
+                                    std::vector<uint8_t>* data,
+                                    const uint8_t* baseline,
+                                    unsigned baseline_size)
+{
+    const unsigned size = in->getUInt16();
+    const uint8_t mode = in->getUInt8();
+    if (mode == SD_FULL)
+    {
+        if (in->size() < size)
+            throw std::out_of_range("Rewinder state out of range.");
+        const uint8_t* d = (const uint8_t*)in->getCurrentData();
+        data->insert(data->end(), d, d + size);
+        in->skip(size);
+        return;
+    }
+    if (mode != SD_XOR || !baseline || baseline_size != size)
+        throw std::invalid_argument("Missing baseline for rewinder state.");
+
+    const size_t start = data->size();
+    data->resize(start + size);
+    uint8_t* out = data->data() + start;
+    unsigned i = 0;
+    while (i < size)
+    {
+        const unsigned zeros = in->getUInt8();
+        const unsigned literals = in->getUInt8();
+        if ((zeros == 0 && literals == 0) || i + zeros + literals > size)
+            throw std::out_of_range("Rewinder delta out of range.");
+        memcpy(out + i, baseline + i, zeros);
+        i += zeros;
+        for (unsigned j = 0; j < literals; j++, i++)
+            out[i] = baseline[i] ^ in->getUInt8();
+    }
+}   // getRewinderDelta
+
+// ----------------------------------------------------------------------------
+/** Returns if a state with the given time was received before, which happens
+ *  if the server sends each state twice to lossy clients.
+ *  \param ticks Time of the state.
+ */
+bool GameProtocol::isDuplicateState(int ticks)
+{
+    if (std::find(m_received_state_ticks.begin(),
+        m_received_state_ticks.end(), ticks) != m_received_state_ticks.end())
+        return true;
+    m_received_state_ticks.push_back(ticks);
+    if (m_received_state_ticks.size() > MAX_STATE_HISTORY)
+        m_received_state_ticks.pop_front();
+    return false;
+}   // isDuplicateState
+
 // ----------------------------------------------------------------------------
 /** Called when a new full state is received form the server.
  */
@@ -345,23 +1194,270 @@ void GameProtocol::handleState(Event *event)
         return;
     NetworkString &data = event->data();
     int ticks          = data.getUInt32();
+    if (isDuplicateState(ticks))
+        return;
 
-    // Check for updated rewinder using
-    unsigned rewinder_size = data.getUInt8();
-    std::vector<std::string> rewinder_using;
-    for (unsigned i = 0; i < rewinder_size; i++)
+    // The state is copied into a recycled state of the rewind queue
+    RewindInfoState* ris = RewindManager::get()->allocateState(ticks);
+    std::vector<uint16_t>& rewinder_using = ris->getRewinderUsing();
+    try
     {
-        std::string name;
-        data.decodeString(&name);
-        rewinder_using.push_back(name);
+        // Check for updated rewinder using, older servers send the unique
+        // identities of rewinders instead of network ids
+        const bool use_id = NetworkConfig::get()->getServerCapabilities()
+            .find("rewinder_id") !=
+            NetworkConfig::get()->getServerCapabilities().end();
+        unsigned rewinder_size = data.getUInt8();
+        for (unsigned i = 0; i < rewinder_size; i++)
+        {
+            if (use_id)
+            {
+                rewinder_using.push_back(data.getUInt16());
+                continue;
+            }
+            std::string name;
+            data.decodeString(&name);
+            rewinder_using.push_back(
+                RewindManager::get()->getRewinderID(name));
+        }
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("GameProtocol", "Invalid state %d: %s.", ticks, e.what());
+        RewindManager::get()->freeRewindInfo(ris);
+        return;
     }
 
-    // The memory for bns will be handled in the RewindInfoState object
-    RewindInfoState* ris = new RewindInfoState(ticks, data.getCurrentOffset(),
-        rewinder_using, data.getBuffer());
-    RewindManager::get()->addNetworkRewindInfo(ris);
+    addFullState(ticks, data, ris);
 }   // handleState
 
+// ----------------------------------------------------------------------------
+/** Adds a full state received from the server to the rewind queue.
+ *  \param ticks Time of the state.
+ *  \param data The state message, with the current offset at the state
+ *         of the first rewinder.
+ *  \param ris The state with the network ids of all rewinders in it set.
+ */
+void GameProtocol::addFullState(int ticks, NetworkString& data,
+                                RewindInfoState* ris)
+{
+    if (NetworkConfig::get()->getServerCapabilities().find("delta_state") !=
+        NetworkConfig::get()->getServerCapabilities().end())
+    {
+        addClientSnapshot(ticks, ris->getRewinderUsing(), data);
+        sendStateAck(ticks);
+    }
+
+    // The state shares the data of the received packet, no copy is made
+    ris->getBuffer()->assignUnread(data);
+    RewindManager::get()->addNetworkRewindInfo(ris);
+}   // addFullState
+
+// ----------------------------------------------------------------------------
+/** Called when a delta compressed state is received from the server. The
+ *  full state is reconstructed from the baseline state (which this client
+ *  has acknowledged before), and then handled like a full state.
+ */
+void GameProtocol::handleDeltaState(Event *event)
+{
+    if (!NetworkConfig::get()->isClient())
+        return;
+    NetworkString &data = event->data();
+    int ticks          = data.getUInt32();
+    int baseline_ticks = data.getUInt32();
+    if (isDuplicateState(ticks))
+        return;
+    RewindInfoState* ris = RewindManager::get()->allocateState(ticks);
+    try
+    {
+        unsigned rewinder_size = data.getUInt8();
+        for (unsigned i = 0; i < rewinder_size; i++)
+            ris->getRewinderUsing().push_back(data.getUInt16());
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("GameProtocol", "Invalid delta state %d: %s.", ticks,
+            e.what());
+        RewindManager::get()->freeRewindInfo(ris);
+        return;
+    }
+    addDeltaState(ticks, baseline_ticks, data, ris);
+}   // handleDeltaState
+
+// ----------------------------------------------------------------------------
+/** Reconstructs a delta compressed state received from the server and adds
+ *  it to the rewind queue.
+ *  \param ticks Time of the state.
+ *  \param baseline_ticks Time of the baseline state.
+ *  \param data The state message, with the current offset at the data of
+ *         the first rewinder.
+ *  \param ris The state with the network ids of all rewinders in it set.
+ */
+void GameProtocol::addDeltaState(int ticks, int baseline_ticks,
+                                 NetworkString& data, RewindInfoState* ris)
+{
+    const StateSnapshot* baseline = findSnapshot(baseline_ticks);
+    if (!baseline || baseline == &m_state_history[m_state_history_next])
+    {
+        // The server will send a full state once the baseline is too old
+        Log::debug("GameProtocol", "Missing baseline %d for state %d.",
+            baseline_ticks, ticks);
+        RewindManager::get()->freeRewindInfo(ris);
+        return;
+    }
+
+    StateSnapshot* snapshot = getNextSnapshot();
+    snapshot->m_rewinder_using = ris->getRewinderUsing();
+    BareNetworkString* state = ris->getBuffer();
+    try
+    {
+        for (unsigned i = 0; i < snapshot->m_rewinder_using.size(); i++)
+        {
+            const int b = baseline->find(snapshot->m_rewinder_using[i]);
+            getRewinderDelta(&data, &snapshot->m_buffer,
+                b == -1 ? NULL : baseline->getData(b),
+                b == -1 ? 0 : baseline->getSize(b));
+            snapshot->m_offsets.push_back(
+                (uint32_t)snapshot->m_buffer.size());
+            const uint8_t* d = snapshot->getData(i);
+            state->addUInt16((uint16_t)snapshot->getSize(i));
+            state->getBuffer().insert(state->getBuffer().end(), d,
+                d + snapshot->getSize(i));
+        }
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("GameProtocol", "Invalid delta state %d: %s.", ticks,
+            e.what());
+        snapshot->clear(-1);
+        RewindManager::get()->freeRewindInfo(ris);
+        return;
+    }
+
+    snapshot->m_ticks = ticks;
+    m_state_history_next = (m_state_history_next + 1) %
+        m_state_history.size();
+    sendStateAck(ticks);
+    RewindManager::get()->addNetworkRewindInfo(ris);
+}   // addDeltaState
+
+// ----------------------------------------------------------------------------
+/** Called when a state without the rewinders far away from the karts of
+ *  this client is received from the server. It is either full or delta
+ *  compressed, the rewinders left out are restored from the states saved
+ *  locally when rewinding.
+ */
+void GameProtocol::handlePartialState(Event *event)
+{
+    if (!NetworkConfig::get()->isClient())
+        return;
+    NetworkString &data = event->data();
+    int ticks          = data.getUInt32();
+    int baseline_ticks = data.getUInt32();
+    if (isDuplicateState(ticks))
+        return;
+    RewindInfoState* ris = RewindManager::get()->allocateState(ticks);
+    try
+    {
+        unsigned rewinder_size = data.getUInt8();
+        for (unsigned i = 0; i < rewinder_size; i++)
+            ris->getRewinderUsing().push_back(data.getUInt16());
+        unsigned skipped_size = data.getUInt8();
+        for (unsigned i = 0; i < skipped_size; i++)
+            ris->getRewinderSkipped().push_back(data.getUInt16());
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("GameProtocol", "Invalid partial state %d: %s.", ticks,
+            e.what());
+        RewindManager::get()->freeRewindInfo(ris);
+        return;
+    }
+    if (baseline_ticks == -1)
+        addFullState(ticks, data, ris);
+    else
+        addDeltaState(ticks, baseline_ticks, data, ris);
+}   // handlePartialState
+
+// ----------------------------------------------------------------------------
+/** Stores the per-rewinder data of a full state received from the server in
+ *  m_state_history, so it can be used as a baseline for delta states.
+ *  \param ticks Time of the state.
+ *  \param rewinder_using Network ids of all rewinders in the state.
+ *  \param data The state message, with the current offset at the state
+ *         of the first rewinder. The offset is not changed.
+ */
+void GameProtocol::addClientSnapshot(int ticks,
+                                     const std::vector<uint16_t>&
+                                     rewinder_using,
+                                     NetworkString& data)
+{
+    const int offset = data.getCurrentOffset();
+    StateSnapshot* snapshot = getNextSnapshot();
+    try
+    {
+        for (unsigned i = 0; i < rewinder_using.size(); i++)
+        {
+            const unsigned size = data.getUInt16();
+            if (data.size() < size)
+                throw std::out_of_range("Rewinder state out of range.");
+            snapshot->add(rewinder_using[i],
+                (const uint8_t*)data.getCurrentData(), size);
+            data.skip(size);
+        }
+        snapshot->m_ticks = ticks;
+        m_state_history_next = (m_state_history_next + 1) %
+            m_state_history.size();
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("GameProtocol", "Invalid state %d: %s.", ticks, e.what());
+        snapshot->clear(-1);
+    }
+    data.reset();
+    data.skip(offset);
+}   // addClientSnapshot
+
+// ----------------------------------------------------------------------------
+/** Tells the server that this client has the state at the given time, so
+ *  it can be used as the baseline for delta states. This message can be
+ *  sent unreliable, a later acknowledgement will replace a lost one.
+ *  \param ticks Time of the state received.
+ */
+void GameProtocol::sendStateAck(int ticks)
+{
+    assert(NetworkConfig::get()->isClient());
+    NetworkString *ns = getNetworkString(5);
+    ns->addUInt8(GP_STATE_ACK).addUInt32(ticks);
+    sendToServer(ns, /*reliable*/false);
+    delete ns;
+}   // sendStateAck
+
+// ----------------------------------------------------------------------------
+/** Handles a state acknowledgement from a client, the latest acknowledged
+ *  state will be used as baseline for the next states sent to it.
+ *  \param event The data from the client.
+ */
+void GameProtocol::handleStateAck(Event *event)
+{
+    if (!NetworkConfig::get()->isServer())
+        return;
+    int ticks = event->data().getUInt32();
+    std::unique_lock<std::mutex> ul(m_state_acked_mutex);
+    for (auto it = m_state_acked.begin(); it != m_state_acked.end();)
+    {
+        if (it->first.expired())
+            it = m_state_acked.erase(it);
+        else
+            it++;
+    }
+    auto it = m_state_acked.find(event->getPeerSP());
+    if (it == m_state_acked.end())
+        m_state_acked[event->getPeerSP()] = ticks;
+    else if (ticks > it->second)
+        it->second = ticks;
+}   // handleStateAck
+
 // ----------------------------------------------------------------------------
 /** Called from the RewindManager when rolling back.
  *  \param buffer Pointer to the saved state information.
@@ -400,3 +1496,101 @@ void GameProtocol::update(int ticks)
     if (!World::getWorld())
         ProtocolManager::lock()->findAndTerminate(PROTOCOL_CONTROLLER_EVENTS);
 }   // update
+
+// ----------------------------------------------------------------------------
+/** Unit tests for the delta compression of rewinder states. */
+void GameProtocol::unitTesting()
+{
+    std::vector<uint8_t> baseline(600), data, result;
+    for (unsigned i = 0; i < baseline.size(); i++)
+        baseline[i] = (uint8_t)(i * 7);
+
+    // Identical data: only runs of unchanged bytes are written
+    BareNetworkString s0;
+    addRewinderDelta(&s0, baseline.data(), 600, baseline.data(), 600);
+    assert(s0.size() < 16);
+    getRewinderDelta(&s0, &result, baseline.data(), 600);
+    assert(result == baseline);
+    assert(s0.size() == 0);
+
+    // A few changed bytes, including the first and last one
+    data = baseline;
+    data[0]++;
+    data[300] ^= 0x55;
+    data[301] ^= 0x01;
+    data[599]--;
+    BareNetworkString s1;
+    addRewinderDelta(&s1, data.data(), 600, baseline.data(), 600);
+    assert(s1.size() < 32);
+    result.clear();
+    getRewinderDelta(&s1, &result, baseline.data(), 600);
+    assert(result == data);
+
+    // Completely different data falls back to the full data
+    for (unsigned i = 0; i < data.size(); i++)
+        data[i] = ~baseline[i];
+    BareNetworkString s2;
+    addRewinderDelta(&s2, data.data(), 600, baseline.data(), 600);
+    assert(s2.size() == data.size() + 3);
+    result.clear();
+    getRewinderDelta(&s2, &result, NULL, 0);
+    assert(result == data);
+
+    // Different size or missing baseline, and an empty state
+    data.resize(10);
+    BareNetworkString s3;
+    addRewinderDelta(&s3, data.data(), 10, baseline.data(), 600);
+    addRewinderDelta(&s3, baseline.data(), 600, NULL, 0);
+    addRewinderDelta(&s3, NULL, 0, baseline.data(), 600);
+    result.clear();
+    getRewinderDelta(&s3, &result, baseline.data(), 600);
+    assert(result == data);
+    result.clear();
+    getRewinderDelta(&s3, &result, NULL, 0);
+    assert(result == baseline);
+    result.clear();
+    getRewinderDelta(&s3, &result, baseline.data(), 600);
+    assert(result.empty());
+    assert(s3.size() == 0);
+
+    // A delta without the baseline must be rejected
+    BareNetworkString s4;
+    addRewinderDelta(&s4, baseline.data(), 600, baseline.data(), 600);
+    bool rejected = false;
+    try
+    {
+        getRewinderDelta(&s4, &result, NULL, 0);
+    }
+    catch (std::exception& e)
+    {
+        rejected = true;
+    }
+    assert(rejected);
+    (void)rejected;
+
+    // Adaptive state rate with 3 saved states per state-frequency state
+    StateRate rate;
+    rate.m_interval = 3;
+    rate.m_redundancy = 1;
+    // A good connection gets every state
+    for (unsigned i = 0; i < 5; i++)
+        adaptStateRate(&rate, 0.0f, 20, false, true, 3, 2);
+    assert(rate.m_interval == 1 && rate.m_redundancy == 1);
+    // An average connection goes back to the nominal rate
+    for (unsigned i = 0; i < 5; i++)
+        adaptStateRate(&rate, 0.0f, 150, false, true, 3, 2);
+    assert(rate.m_interval == 3);
+    // Congestion lowers the rate down to a third of the nominal rate
+    for (unsigned i = 0; i < 5; i++)
+        adaptStateRate(&rate, 0.2f, 150, false, true, 3, 2);
+    assert(rate.m_interval == 9 && rate.m_redundancy == 1);
+    adaptStateRate(&rate, 0.05f, 150, false, true, 3, 2);
+    assert(rate.m_interval == 8 && rate.m_redundancy == 2);
+    adaptStateRate(&rate, 0.05f, 150, false, true, 3, 1);
+    assert(rate.m_redundancy == 1);
+    // Not above the share of the upload limit
+    adaptStateRate(&rate, 0.0f, 20, true, false, 3, 2);
+    assert(rate.m_interval == 9 && rate.m_redundancy == 1);
+    adaptStateRate(&rate, 0.0f, 20, false, false, 3, 2);
+    assert(rate.m_interval == 9);
+}   // unitTesting
@@ -25,15 +25,23 @@
 #include "input/input.hpp"                // for PlayerAction
 #include "utils/cpp2011.hpp"
 #include "utils/stk_process.hpp"
+#include "utils/vec3.hpp"
 
 #include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 #include <tuple>
 
 class BareNetworkString;
+class Crypto;
 class NetworkItemManager;
 class NetworkString;
+class Rewinder;
+class RewindInfoState;
 class STKPeer;
 
 class GameProtocol : public Protocol
@@ -49,17 +57,179 @@ private:
            GP_STATE,
            GP_ITEM_UPDATE,
            GP_ITEM_CONFIRMATION,
-           GP_ADJUST_TIME
+           GP_ADJUST_TIME,
+           GP_STATE_DELTA,
+           GP_STATE_ACK,
+           GP_BROADCAST_KEY,
+           GP_REWINDER_ID,
+           GP_PARTIAL_STATE
     };
 
+    /** How the data of a rewinder is stored in a delta compressed state. */
+    enum { SD_FULL, SD_XOR };
+
+    /** Per-rewinder data of a full state, used as baseline for delta
+     *  compressed states. Snapshots are kept in a ring and reused, so they
+     *  don't need new memory once their buffers are large enough. */
+    struct StateSnapshot
+    {
+        /** Time of the state, -1 if the slot is not used. */
+        int m_ticks;
+        std::vector<uint16_t> m_rewinder_using;
+        /** The data of all rewinders. */
+        std::vector<uint8_t> m_buffer;
+        /** Offset of the data of each rewinder in m_buffer, and the end of
+         *  the data of the last one. */
+        std::vector<uint32_t> m_offsets;
+        // --------------------------------------------------------------------
+        StateSnapshot() { clear(-1); }
+        // --------------------------------------------------------------------
+        void clear(int ticks)
+        {
+            m_ticks = ticks;
+            m_rewinder_using.clear();
+            m_buffer.clear();
+            m_offsets.clear();
+            m_offsets.push_back(0);
+        }
+        // --------------------------------------------------------------------
+        /** Adds the data of the next rewinder. */
+        void add(uint16_t id, const uint8_t* data, unsigned size)
+        {
+            m_rewinder_using.push_back(id);
+            m_buffer.insert(m_buffer.end(), data, data + size);
+            m_offsets.push_back((uint32_t)m_buffer.size());
+        }
+        // --------------------------------------------------------------------
+        const uint8_t* getData(unsigned i) const
+                                       { return m_buffer.data() + m_offsets[i]; }
+        // --------------------------------------------------------------------
+        unsigned getSize(unsigned i) const
+                                   { return m_offsets[i + 1] - m_offsets[i]; }
+        // --------------------------------------------------------------------
+        /** Returns the index of the data of a rewinder, or -1 if the rewinder
+         *  is not in this state. */
+        int find(uint16_t id) const
+        {
+            for (unsigned i = 0; i < m_rewinder_using.size(); i++)
+            {
+                if (m_rewinder_using[i] == id)
+                    return i;
+            }
+            return -1;
+        }
+    };   // struct StateSnapshot
+
+    /** The rate of the states sent to a client, adapted to its connection
+     *  if adaptive-state-rate is enabled (server only). */
+    struct StateRate
+    {
+        /** The client is sent every this many states saved. */
+        unsigned m_interval;
+        /** Number of copies sent of each state. */
+        unsigned m_redundancy;
+        /** Value of m_state_count at which the next state is sent. */
+        unsigned m_next_state;
+        /** Time (in ms) at which the rate is adapted next. */
+        uint64_t m_next_update;
+        /** Average size of the states sent to the client in bytes. */
+        float m_average_size;
+        /** Number of states sent to the client. */
+        unsigned m_states_sent;
+        /** Copy of the last state sent to the client, which is sent again
+         *  before the next state if the client gets two copies of each. */
+        std::shared_ptr<NetworkString> m_previous_state;
+    };   // struct StateRate
+
     /** A network string that collects all information from the server to be sent
      *  next. */
     NetworkString *m_data_to_send;
 
+    /** Network ids of the rewinders in m_data_to_send. */
+    std::vector<uint16_t> m_rewinder_using;
+
+    /** Number of rewinder network ids each client was told the unique
+     *  identity of (server only). */
+    std::map<std::weak_ptr<STKPeer>, unsigned,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_rewinder_id_sent;
+
     /** The server might request that the world clock of a client is adjusted
      *  to reduce number of rollbacks. */
     std::vector<int8_t> m_adjust_time;
 
+    /** On the server the states last sent to clients, on the client the
+     *  states last received (or reconstructed from a delta). */
+    std::vector<StateSnapshot> m_state_history;
+
+    /** Index of the slot in m_state_history used for the next state. */
+    unsigned m_state_history_next;
+
+    /** The state currently assembled by the server (in m_state_history). */
+    StateSnapshot* m_new_state;
+
+    /** The latest state sent by the server, NULL if none. */
+    const StateSnapshot* m_latest_state;
+
+    /** Protects m_state_acked, which is updated from the network thread. */
+    std::mutex m_state_acked_mutex;
+
+    /** The latest state each client has acknowledged to have, which is used
+     *  as the baseline for the next delta compressed state. */
+    std::map<std::weak_ptr<STKPeer>, int,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_state_acked;
+
+    /** Bytes of states which would have been sent without delta compression,
+     *  and which were actually sent, to all peers. */
+    uint64_t m_state_bytes_full, m_state_bytes_sent;
+
+    /** Number of states sent (counted for each peer). */
+    unsigned m_state_peer_count;
+
+    /** Number of states sent. */
+    unsigned m_state_count;
+
+    /** The state rate of each client (server only). */
+    std::map<std::weak_ptr<STKPeer>, StateRate,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_state_rate;
+
+    /** The interval (in saved states) which gives state-frequency states
+     *  per second to a client. */
+    unsigned m_nominal_state_interval;
+
+    /** Time of the latest states received, to ignore copies of them which
+     *  the server sends to lossy clients (client only). */
+    std::deque<int> m_received_state_ticks;
+
+    /** Network id and position of each rewinder in the current state which
+     *  is only sent to the clients it is relevant for (server only). */
+    std::vector<std::pair<uint16_t, Vec3> > m_relevance_position;
+
+    /** The rewinders left out of the last states sent to each client which
+     *  supports partial states, needed to know the data a client has of a
+     *  baseline state (server only). */
+    std::map<std::weak_ptr<STKPeer>,
+        std::deque<std::pair<int, std::vector<uint16_t> > >,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_state_skipped;
+
+    /** Total bytes and number of saved states for each type of rewinder
+     *  (the first character of its unique identity), server only. */
+    std::map<char, std::pair<uint64_t, unsigned> > m_rewinder_state_bytes;
+
+    /** The key shared by all peers in game which support it, so unreliable
+     *  states need to be encrypted only once for all of them (server only). */
+    std::unique_ptr<Crypto> m_broadcast_crypto;
+
+    std::vector<uint8_t> m_broadcast_key, m_broadcast_iv;
+
+    /** Protects m_broadcast_key_peers, which is updated from the network
+     *  thread. */
+    std::mutex m_broadcast_key_mutex;
+
+    /** Peers which were sent the broadcast key, true if they confirmed to
+     *  have received it. */
+    std::map<std::weak_ptr<STKPeer>, bool,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_broadcast_key_peers;
+
     // Dummy data structure to save all kart actions.
     struct Action
     {
@@ -76,6 +246,47 @@ private:
 
     void handleControllerAction(Event *event);
     void handleState(Event *event);
+    void handleDeltaState(Event *event);
+    void handlePartialState(Event *event);
+    void addFullState(int ticks, NetworkString& data, RewindInfoState* ris);
+    void addDeltaState(int ticks, int baseline_ticks, NetworkString& data,
+                       RewindInfoState* ris);
+    void handleStateAck(Event *event);
+    void handleBroadcastKey(Event *event);
+    void handleRewinderID(Event *event);
+    void sendRewinderID(std::shared_ptr<STKPeer> peer);
+    NetworkString* createLegacyState();
+    bool useBroadcastKey(std::shared_ptr<STKPeer> peer);
+    void sendUnreliableToPeers(NetworkString* ns,
+                               const std::vector<std::shared_ptr<STKPeer> >&
+                               peers);
+    void addClientSnapshot(int ticks,
+                           const std::vector<uint16_t>& rewinder_using,
+                           NetworkString& data);
+    void sendStateAck(int ticks);
+    const StateSnapshot* findSnapshot(int ticks) const;
+    NetworkString* createDeltaState(const StateSnapshot& baseline);
+    void getSkippedRewinders(STKPeer* peer, unsigned state_count,
+                             std::vector<uint16_t>* skipped);
+    bool shouldSendState(std::shared_ptr<STKPeer> peer, unsigned peer_count);
+    static void adaptStateRate(StateRate* rate, float loss, unsigned rtt,
+                               bool over_share, bool upload_headroom,
+                               unsigned nominal_interval,
+                               unsigned max_redundancy);
+    bool isDuplicateState(int ticks);
+    NetworkString* createPartialState(const StateSnapshot* baseline,
+                                      const std::vector<uint16_t>& skipped,
+                                      const std::vector<uint16_t>&
+                                      baseline_skipped);
+    StateSnapshot* getNextSnapshot();
+    static void addRewinderDelta(BareNetworkString* out,
+                                 const uint8_t* data, unsigned size,
+                                 const uint8_t* baseline,
+                                 unsigned baseline_size);
+    static void getRewinderDelta(BareNetworkString* in,
+                                 std::vector<uint8_t>* data,
+                                 const uint8_t* baseline,
+                                 unsigned baseline_size);
     void handleAdjustTime(Event *event);
     void handleItemEventConfirmation(Event *event);
     static std::weak_ptr<GameProtocol> m_game_protocol[PT_COUNT];
@@ -103,6 +314,8 @@ private:
         return std::make_tuple(a, b, c, d);
     }
 public:
+    static void unitTesting();
+
              GameProtocol();
     virtual ~GameProtocol();
 
@@ -112,9 +325,9 @@ public:
     void controllerAction(int kart_id, PlayerAction action,
                           int value, int val_l, int val_r);
     void startNewState();
-    void addState(BareNetworkString *buffer);
+    void addState(Rewinder* rewinder, std::vector<uint16_t>* ru);
     void sendState();
-    void finalizeState(std::vector<std::string>& cur_rewinder);
+    void finalizeState(std::vector<uint16_t>& cur_rewinder);
     void sendItemEventConfirmation(int ticks);
 
     virtual void undo(BareNetworkString *buffer) OVERRIDE;
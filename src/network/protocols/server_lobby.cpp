@@ -640,10 +640,26 @@ bool ServerLobby::notifyEventAsynchronous(Event* event)
 
 //-----------------------------------------------------------------------------
 #ifdef ENABLE_SQLITE3
+/** Kicks a peer found in the ban tables by pollDatabase. */
+static void kickBannedPeer(std::shared_ptr<STKPeer> peer,
+                           const DatabaseConnector::ConnectionCheck& check)
+{
+    std::string address = peer->getAddress().isIPv6() ?
+        peer->getAddress().toString(false) : peer->getAddress().toString();
+    Log::info("ServerLobby", "Kick %s, reason: %s, description: %s",
+        address.c_str(), check.m_reason.c_str(),
+        check.m_description.c_str());
+    peer->kick();
+}   // kickBannedPeer
+
+//-----------------------------------------------------------------------------
 /* Every 1 minute STK will poll database:
  * 1. Set disconnected time to now for non-exists host.
  * 2. Clear expired player reports if necessary
  * 3. Kick active peer from ban list
+ * The peers are checked by the database thread (which reloads the ban and
+ * IP geolocation tables if they changed), the banned ones are kicked in
+ * kickBannedPeer when the result is handled.
  */
 void ServerLobby::pollDatabase()
 {
@@ -655,74 +671,7 @@ void ServerLobby::pollDatabase()
 
     m_db_connector->updatePollTime();
 
-    std::vector<DatabaseConnector::IpBanTableData> ip_ban_list =
-            m_db_connector->getIpBanTableData();
-    std::vector<DatabaseConnector::Ipv6BanTableData> ipv6_ban_list =
-            m_db_connector->getIpv6BanTableData();
-    std::vector<DatabaseConnector::OnlineIdBanTableData> online_id_ban_list =
-            m_db_connector->getOnlineIdBanTableData();
-
-    for (std::shared_ptr<STKPeer>& p : STKHost::get()->getPeers())
-    {
-        if (p->isAIPeer())
-            continue;
-        bool is_kicked = false;
-        std::string address = "";
-        std::string reason = "";
-        std::string description = "";
-
-        if (p->getAddress().isIPv6())
-        {
-            address = p->getAddress().toString(false);
-            if (address.empty())
-                continue;
-            for (auto& item: ipv6_ban_list)
-            {
-                if (insideIPv6CIDR(item.ipv6_cidr.c_str(), address.c_str()) == 1)
-                {
-                    is_kicked = true;
-                    reason = item.reason;
-                    description = item.description;
-                    break;
-                }
-            }
-        }
-        else
-        {
-            uint32_t peer_addr = p->getAddress().getIP();
-            address = p->getAddress().toString();
-            for (auto& item: ip_ban_list)
-            {
-                if (item.ip_start <= peer_addr && item.ip_end >= peer_addr)
-                {
-                    is_kicked = true;
-                    reason = item.reason;
-                    description = item.description;
-                    break;
-                }
-            }
-        }
-        if (!is_kicked && !p->getPlayerProfiles().empty())
-        {
-            uint32_t online_id = p->getPlayerProfiles()[0]->getOnlineId();
-            for (auto& item: online_id_ban_list)
-            {
-                if (item.online_id == online_id)
-                {
-                    is_kicked = true;
-                    reason = item.reason;
-                    description = item.description;
-                    break;
-                }
-            }
-        }
-        if (is_kicked)
-        {
-            Log::info("ServerLobby", "Kick %s, reason: %s, description: %s",
-                address.c_str(), reason.c_str(), description.c_str());
-            p->kick();
-        }
-    } // for p in peers
+    m_db_connector->checkBannedPeers(kickBannedPeer);
 
     m_db_connector->clearOldReports();
 
@@ -739,6 +688,7 @@ void ServerLobby::pollDatabase()
     }
     m_db_connector->setDisconnectionTimes(hosts);
 }   // pollDatabase
+
 #endif
 //-----------------------------------------------------------------------------
 void ServerLobby::writePlayerReport(Event* event)
@@ -762,17 +712,20 @@ void ServerLobby::writePlayerReport(Event* event)
         return;
     auto reporting_npp = reporting_peer->getPlayerProfiles()[0];
 
-    bool written = m_db_connector->writeReport(reporter, reporter_npp,
-            reporting_peer.get(), reporting_npp, info);
-    if (written)
-    {
-        NetworkString* success = getNetworkString();
-        success->setSynchronous(true);
-        success->addUInt8(LE_REPORT_PLAYER).addUInt8(1)
-            .encodeString(reporting_npp->getName());
-        event->getPeer()->sendPacket(success, true/*reliable*/);
-        delete success;
-    }
+    std::shared_ptr<STKPeer> reporter_sp = event->getPeerSP();
+    m_db_connector->writeReport(reporter, reporter_npp,
+        reporting_peer.get(), reporting_npp, info,
+        [this, reporter_sp, reporting_npp](bool written)
+        {
+            if (!written || reporter_sp->isDisconnected())
+                return;
+            NetworkString* success = getNetworkString();
+            success->setSynchronous(true);
+            success->addUInt8(LE_REPORT_PLAYER).addUInt8(1)
+                .encodeString(reporting_npp->getName());
+            reporter_sp->sendPacket(success, true/*reliable*/);
+            delete success;
+        });
 #endif
 }   // writePlayerReport
 
@@ -797,6 +750,8 @@ void ServerLobby::asynchronousUpdate()
     }
 
 #ifdef ENABLE_SQLITE3
+    // Results of database queries (ban checks of connecting peers...)
+    m_db_connector->handleCallbacks();
     pollDatabase();
 #endif
 
@@ -1072,6 +1027,18 @@ void ServerLobby::asynchronousUpdate()
                 }
             }
 
+            // Old clients in game need the byte aligned states
+            bool bit_packed_state = true;
+            for (auto peer : peers)
+            {
+                const std::set<std::string>& caps =
+                    peer->getClientCapabilities();
+                if (peer->isValidated() && !peer->isWaitingForGame() &&
+                    caps.find("bit_packed_state") == caps.end())
+                    bit_packed_state = false;
+            }
+            NetworkConfig::get()->setBitPackedState(bit_packed_state);
+
             NetworkString* load_world_message = getLoadWorldMessage(players,
                 false/*live_join*/);
             m_game_setup->setHitCaptureTime(m_battle_hit_capture_limit,
@@ -1149,6 +1116,8 @@ NetworkString* ServerLobby::getLoadWorldMessage(
     }
     for (unsigned i = 0; i < players.size(); i++)
         players[i]->getKartData().encode(load_world_message);
+    load_world_message->addUInt8(
+        NetworkConfig::get()->useBitPackedState() ? 1 : 0);
     return load_world_message;
 }   // getLoadWorldMessage
 
@@ -1232,6 +1201,14 @@ void ServerLobby::liveJoinRequest(Event* event)
         rejectLiveJoin(peer, BLR_NO_GAME_FOR_LIVE_JOIN);
         return;
     }
+    const std::set<std::string>& caps = peer->getClientCapabilities();
+    if (NetworkConfig::get()->useBitPackedState() &&
+        caps.find("bit_packed_state") == caps.end())
+    {
+        // The states of this game can't be read by the client
+        rejectLiveJoin(peer, BLR_NO_GAME_FOR_LIVE_JOIN);
+        return;
+    }
     bool spectator = data.getUInt8() == 1;
     if (RaceManager::get()->modeHasLaps() && !spectator)
     {
@@ -1539,7 +1516,7 @@ void ServerLobby::update(int ticks)
                 if (w && w->getKart(i)->hasFinishedRace())
                     continue;
                 // Don't kick in game GUI server host so he can idle in game
-                if (m_process_type == PT_CHILD &&
+                if (m_process_type != PT_MAIN &&
                     peer->getHostId() == m_client_server_host_id.load())
                     continue;
                 Log::info("ServerLobby", "%s %s has been idle for more than"
@@ -2597,7 +2574,7 @@ bool ServerLobby::handleAssets(const NetworkString& ns, STKPeer* peer)
     peer->setAvailableKartsTracks(client_karts, client_tracks);
     peer->setAddonsScores(addons_scores);
 
-    if (m_process_type == PT_CHILD &&
+    if (m_process_type != PT_MAIN &&
         peer->getHostId() == m_client_server_host_id.load())
     {
         // Update child process addons list too so player can choose later
@@ -2616,22 +2593,6 @@ void ServerLobby::connectionRequested(Event* event)
 
     peer->cleanPlayerProfiles();
 
-    // can we add the player ?
-    if (!allowJoinedPlayersWaiting() &&
-        (m_state.load() != WAITING_FOR_START_GAME ||
-        m_game_setup->isGrandPrixStarted()))
-    {
-        NetworkString *message = getNetworkString(2);
-        message->setSynchronous(true);
-        message->addUInt8(LE_CONNECTION_REFUSED).addUInt8(RR_BUSY);
-        // send only to the peer that made the request and disconnect it now
-        peer->sendPacket(message, true/*reliable*/, false/*encrypted*/);
-        peer->reset();
-        delete message;
-        Log::verbose("ServerLobby", "Player refused: selection started");
-        return;
-    }
-
     // Check server version
     int version = data.getUInt32();
     if (version < stk_config->m_min_server_version ||
@@ -2669,20 +2630,65 @@ void ServerLobby::connectionRequested(Event* event)
     online_id = data.getUInt32();
     encrypted_size = data.getUInt32();
 
-    // Will be disconnected if banned by IP
-    testBannedForIP(peer.get());
-    if (peer->isDisconnected())
-        return;
-
-    testBannedForIPv6(peer.get());
-    if (peer->isDisconnected())
+#ifdef ENABLE_SQLITE3
+    // The ban and IP geolocation tables are queried by the database thread,
+    // the request is handled when the result is available
+    if (m_db_connector->hasDatabase())
+    {
+        BareNetworkString remaining(data.getCurrentData(), data.size());
+        m_db_connector->checkConnection(peer->getAddress(), online_id,
+            [this, peer, remaining, player_count, online_id, encrypted_size]
+            (const DatabaseConnector::ConnectionCheck& check) mutable
+            {
+                if (peer->isDisconnected())
+                    return;
+                if (!check.m_banned_by.empty())
+                {
+                    Log::info("ServerLobby", "%s banned by %s: %s "
+                        "(online id: %u, rowid: %d, description: %s).",
+                        peer->getAddress().toString(false).c_str(),
+                        check.m_banned_by.c_str(), check.m_reason.c_str(),
+                        online_id, check.m_row_id,
+                        check.m_description.c_str());
+                    kickPlayerWithReason(peer.get(), check.m_reason.c_str());
+                    return;
+                }
+                handleConnectionRequest(peer, remaining, player_count,
+                    online_id, encrypted_size, check.m_country_code);
+            });
         return;
+    }
+#endif
+    handleConnectionRequest(peer, data, player_count, online_id,
+        encrypted_size, "");
+}   // connectionRequested
 
-    if (online_id != 0)
-        testBannedForOnlineId(peer.get(), online_id);
-    // Will be disconnected if banned by online id
-    if (peer->isDisconnected())
+//-----------------------------------------------------------------------------
+/** Checks the number of players and if the player can join, after the peer
+ *  passed the ban checks of connectionRequested.
+ *  \param data The remaining data of the connection request.
+ *  \param country_code Country code from the IP geolocation tables.
+ */
+void ServerLobby::handleConnectionRequest(std::shared_ptr<STKPeer> peer,
+    BareNetworkString& data, unsigned player_count, uint32_t online_id,
+    uint32_t encrypted_size, const std::string& country_code)
+{
+    // can we add the player ? (checked here as the state can change while
+    // the database is queried)
+    if (!allowJoinedPlayersWaiting() &&
+        (m_state.load() != WAITING_FOR_START_GAME ||
+        m_game_setup->isGrandPrixStarted()))
+    {
+        NetworkString *message = getNetworkString(2);
+        message->setSynchronous(true);
+        message->addUInt8(LE_CONNECTION_REFUSED).addUInt8(RR_BUSY);
+        // send only to the peer that made the request and disconnect it now
+        peer->sendPacket(message, true/*reliable*/, false/*encrypted*/);
+        peer->reset();
+        delete message;
+        Log::verbose("ServerLobby", "Player refused: selection started");
         return;
+    }
 
     unsigned total_players = 0;
     STKHost::get()->updatePlayers(NULL, NULL, &total_players);
@@ -2703,10 +2709,8 @@ void ServerLobby::connectionRequested(Event* event)
     // encforement of validation, unless it's player from localhost or lan
     // And no duplicated online id or split screen players in ranked server
     // AIPeer only from lan and only 1 if ai handling
-    std::set<uint32_t> all_online_ids =
-        STKHost::get()->getAllPlayerOnlineIds();
     bool duplicated_ranked_player =
-        all_online_ids.find(online_id) != all_online_ids.end();
+        STKHost::get()->hasPlayerWithOnlineId(online_id);
 
     if (((encrypted_size == 0 || online_id == 0) &&
         !(peer->getAddress().isPublicAddressLocalhost() ||
@@ -2734,8 +2738,10 @@ void ServerLobby::connectionRequested(Event* event)
 
     if (encrypted_size != 0)
     {
-        m_pending_connection[peer] = std::make_pair(online_id,
-            BareNetworkString(data.getCurrentData(), encrypted_size));
+        PendingConnection& pc = m_pending_connection[peer];
+        pc.m_online_id = online_id;
+        pc.m_data = BareNetworkString(data.getCurrentData(), encrypted_size);
+        pc.m_country_code = country_code;
     }
     else
     {
@@ -2743,9 +2749,9 @@ void ServerLobby::connectionRequested(Event* event)
         if (online_id > 0)
             data.decodeStringW(&online_name);
         handleUnencryptedConnection(peer, data, online_id, online_name,
-            false/*is_pending_connection*/);
+            false/*is_pending_connection*/, country_code);
     }
-}   // connectionRequested
+}   // handleConnectionRequest
 
 //-----------------------------------------------------------------------------
 void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
@@ -2794,10 +2800,8 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
             return;
         }
 
-        std::set<uint32_t> all_online_ids =
-            STKHost::get()->getAllPlayerOnlineIds();
         bool duplicated_ranked_player =
-            all_online_ids.find(online_id) != all_online_ids.end();
+            STKHost::get()->hasPlayerWithOnlineId(online_id);
         if (ServerConfig::m_ranked && duplicated_ranked_player)
         {
             NetworkString* message = getNetworkString(2);
@@ -2812,13 +2816,6 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
         }
     }
 
-#ifdef ENABLE_SQLITE3
-    if (country_code.empty() && !peer->getAddress().isIPv6())
-        country_code = m_db_connector->ip2Country(peer->getAddress());
-    if (country_code.empty() && peer->getAddress().isIPv6())
-        country_code = m_db_connector->ipv62Country(peer->getAddress());
-#endif
-
     auto red_blue = STKHost::get()->getAllPlayersTeamInfo();
     for (unsigned i = 0; i < player_count; i++)
     {
@@ -2886,7 +2883,7 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
         message_ack->encodeString(cap);
 
     message_ack->addFloat(auto_start_timer)
-        .addUInt32(ServerConfig::m_state_frequency)
+        .addUInt32(NetworkConfig::get()->getStateFrequency())
         .addUInt8(ServerConfig::m_chat ? 1 : 0)
         .addUInt8(playerReportsTableExists() ? 1 : 0);
 
@@ -3514,15 +3511,20 @@ void ServerLobby::handlePendingConnection()
         }
         else
         {
-            const uint32_t online_id = it->second.first;
+            const uint32_t online_id = it->second.m_online_id;
             auto key = m_keys.find(online_id);
             if (key != m_keys.end() && key->second.m_tried == false)
             {
+                // Use the IP geolocation tables if the STK server doesn't
+                // know the country
+                const std::string& country_code =
+                    key->second.m_country_code.empty() ?
+                    it->second.m_country_code : key->second.m_country_code;
                 try
                 {
-                    if (decryptConnectionRequest(peer, it->second.second,
+                    if (decryptConnectionRequest(peer, it->second.m_data,
                         key->second.m_aes_key, key->second.m_aes_iv, online_id,
-                        key->second.m_name, key->second.m_country_code))
+                        key->second.m_name, country_code))
                     {
                         it = m_pending_connection.erase(it);
                         m_keys.erase(online_id);
@@ -3754,103 +3756,6 @@ void ServerLobby::resetServer()
     updatePlayerList();
 }   // resetServer
 
-//-----------------------------------------------------------------------------
-void ServerLobby::testBannedForIP(STKPeer* peer) const
-{
-#ifdef ENABLE_SQLITE3
-    if (!m_db_connector->hasDatabase() || !m_db_connector->hasIpBanTable())
-        return;
-
-    // Test for IPv4
-    if (peer->getAddress().isIPv6())
-        return;
-
-    bool is_banned = false;
-    uint32_t ip_start = 0;
-    uint32_t ip_end = 0;
-
-    std::vector<DatabaseConnector::IpBanTableData> ip_ban_list =
-            m_db_connector->getIpBanTableData(peer->getAddress().getIP());
-    if (!ip_ban_list.empty())
-    {
-        is_banned = true;
-        ip_start = ip_ban_list[0].ip_start;
-        ip_end = ip_ban_list[0].ip_end;
-        int row_id = ip_ban_list[0].row_id;
-        std::string reason = ip_ban_list[0].reason;
-        std::string description = ip_ban_list[0].description;
-        Log::info("ServerLobby", "%s banned by IP: %s "
-                "(rowid: %d, description: %s).",
-                peer->getAddress().toString().c_str(), reason.c_str(), row_id, description.c_str());
-        kickPlayerWithReason(peer, reason.c_str());
-    }
-    if (is_banned)
-        m_db_connector->increaseIpBanTriggerCount(ip_start, ip_end);
-#endif
-}   // testBannedForIP
-
-//-----------------------------------------------------------------------------
-void ServerLobby::testBannedForIPv6(STKPeer* peer) const
-{
-#ifdef ENABLE_SQLITE3
-    if (!m_db_connector->hasDatabase() || !m_db_connector->hasIpv6BanTable())
-        return;
-
-    // Test for IPv6
-    if (!peer->getAddress().isIPv6())
-        return;
-
-    bool is_banned = false;
-    std::string ipv6_cidr = "";
-
-    std::vector<DatabaseConnector::Ipv6BanTableData> ipv6_ban_list =
-            m_db_connector->getIpv6BanTableData(peer->getAddress().toString(false));
-
-    if (!ipv6_ban_list.empty())
-    {
-        is_banned = true;
-        ipv6_cidr = ipv6_ban_list[0].ipv6_cidr;
-        int row_id = ipv6_ban_list[0].row_id;
-        std::string reason = ipv6_ban_list[0].reason;
-        std::string description = ipv6_ban_list[0].description;
-        Log::info("ServerLobby", "%s banned by IPv6: %s "
-                "(rowid: %d, description: %s).",
-                peer->getAddress().toString(false).c_str(), reason.c_str(), row_id, description.c_str());
-        kickPlayerWithReason(peer, reason.c_str());
-    }
-    if (is_banned)
-        m_db_connector->increaseIpv6BanTriggerCount(ipv6_cidr);
-#endif
-}   // testBannedForIPv6
-
-//-----------------------------------------------------------------------------
-void ServerLobby::testBannedForOnlineId(STKPeer* peer,
-                                        uint32_t online_id) const
-{
-#ifdef ENABLE_SQLITE3
-    if (!m_db_connector->hasDatabase() || !m_db_connector->hasOnlineIdBanTable())
-        return;
-
-    bool is_banned = false;
-    std::vector<DatabaseConnector::OnlineIdBanTableData> online_id_ban_list =
-            m_db_connector->getOnlineIdBanTableData(online_id);
-
-    if (!online_id_ban_list.empty())
-    {
-        is_banned = true;
-        int row_id = online_id_ban_list[0].row_id;
-        std::string reason = online_id_ban_list[0].reason;
-        std::string description = online_id_ban_list[0].description;
-        Log::info("ServerLobby", "%s banned by online id: %s "
-                "(online id: %u, rowid: %d, description: %s).",
-                peer->getAddress().toString().c_str(), reason.c_str(), online_id, row_id, description.c_str());
-        kickPlayerWithReason(peer, reason.c_str());
-    }
-    if (is_banned)
-        m_db_connector->increaseOnlineIdBanTriggerCount(online_id);
-#endif
-}   // testBannedForOnlineId
-
 //-----------------------------------------------------------------------------
 void ServerLobby::listBanTable()
 {
@@ -4256,7 +4161,7 @@ void ServerLobby::clientInGameWantsToBackLobby(Event* event)
         return;
     }
 
-    if (m_process_type == PT_CHILD &&
+    if (m_process_type != PT_MAIN &&
         event->getPeer()->getHostId() == m_client_server_host_id.load())
     {
         // For child server the remaining client cannot go on player when the
@@ -4340,7 +4245,7 @@ void ServerLobby::clientSelectingAssetsWantsToBackLobby(Event* event)
         return;
     }
 
-    if (m_process_type == PT_CHILD &&
+    if (m_process_type != PT_MAIN &&
         event->getPeer()->getHostId() == m_client_server_host_id.load())
     {
         NetworkString* back_to_lobby = getNetworkString(2);
@@ -4506,7 +4411,7 @@ void ServerLobby::handleServerCommand(Event* event,
 
         if (argv[1] == "1")
         {
-            if (m_process_type == PT_CHILD &&
+            if (m_process_type != PT_MAIN &&
                 peer->getHostId() == m_client_server_host_id.load())
             {
                 NetworkString* chat = getNetworkString();
@@ -19,6 +19,7 @@
 #ifndef SERVER_LOBBY_HPP
 #define SERVER_LOBBY_HPP
 
+#include "network/network_string.hpp"
 #include "network/protocols/lobby_protocol.hpp"
 #include "utils/cpp2011.hpp"
 #include "utils/time.hpp"
@@ -34,7 +35,6 @@
 #include <mutex>
 #include <set>
 
-class BareNetworkString;
 class DatabaseConnector;
 class NetworkItemManager;
 class NetworkString;
@@ -149,8 +149,17 @@ private:
 
     std::map<uint32_t, KeyData> m_keys;
 
-    std::map<std::weak_ptr<STKPeer>,
-        std::pair<uint32_t, BareNetworkString>,
+    /** An encrypted connection request waiting for the key of the player
+     *  from the STK server. */
+    struct PendingConnection
+    {
+        uint32_t m_online_id;
+        BareNetworkString m_data;
+        /** Country code from the IP geolocation tables of the database. */
+        std::string m_country_code;
+    };
+
+    std::map<std::weak_ptr<STKPeer>, PendingConnection,
         std::owner_less<std::weak_ptr<STKPeer> > > m_pending_connection;
 
     std::map<std::string, uint64_t> m_pending_peer_connection;
@@ -255,6 +264,12 @@ private:
         std::swap(m_keys, new_keys);
     }
     void handlePendingConnection();
+    void handleConnectionRequest(std::shared_ptr<STKPeer> peer,
+                                 BareNetworkString& data,
+                                 unsigned player_count,
+                                 uint32_t online_id,
+                                 uint32_t encrypted_size,
+                                 const std::string& country_code);
     void handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
                                      BareNetworkString& data,
                                      uint32_t online_id,
@@ -304,9 +319,6 @@ private:
     void clientSelectingAssetsWantsToBackLobby(Event* event);
     std::set<std::shared_ptr<STKPeer>> getSpectatorsByLimit();
     void kickPlayerWithReason(STKPeer* peer, const char* reason) const;
-    void testBannedForIP(STKPeer* peer) const;
-    void testBannedForIPv6(STKPeer* peer) const;
-    void testBannedForOnlineId(STKPeer* peer, uint32_t online_id) const;
     void writePlayerReport(Event* event);
     bool supportsAI();
     void updateAddons();
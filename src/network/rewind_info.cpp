@@ -47,15 +47,14 @@ void RewindInfo::setTicks(int ticks)
 }   // setTicks
 
 // ============================================================================
-RewindInfoState::RewindInfoState(int ticks, int start_offset,
-                                 std::vector<std::string>& rewinder_using,
-                                 std::vector<uint8_t>& buffer)
+/** Constructor for a confirmed state received from the server, the state
+ *  data and the rewinders using are set by the caller.
+ */
+RewindInfoState::RewindInfoState(int ticks)
                : RewindInfo(ticks, true/*is_confirmed*/)
 {
-    std::swap(m_rewinder_using, rewinder_using);
-    m_start_offset = start_offset;
+    m_start_offset = 0;
     m_buffer = new BareNetworkString();
-    std::swap(m_buffer->getBuffer(), buffer);
 }   // RewindInfoState
 
 // ------------------------------------------------------------------------
@@ -76,31 +75,49 @@ RewindInfoState::RewindInfoState(int ticks, BareNetworkString* buffer,
  */
 void RewindInfoState::restore()
 {
+    // Rewinders left out by the server are karts and flyables, restore them
+    // first so that e.g. flags which read the transform of karts get the
+    // right values
+    for (uint16_t id : m_rewinder_skipped)
+    {
+        std::shared_ptr<Rewinder> r = RewindManager::get()->getRewinder(id);
+        if (r && !RewindManager::get()->restoreLocalState(getTicks(), r))
+            r->restoreSkippedState();
+    }
+
     m_buffer->reset();
     m_buffer->skip(m_start_offset);
-    for (const std::string& name : m_rewinder_using)
+    for (uint16_t id : m_rewinder_using)
     {
         const uint16_t data_size = m_buffer->getUInt16();
         const unsigned current_offset_now = m_buffer->getCurrentOffset();
-        std::shared_ptr<Rewinder> r =
-            RewindManager::get()->getRewinder(name);
+        std::shared_ptr<Rewinder> r = RewindManager::get()->getRewinder(id);
 
         if (!r)
         {
+            const std::string name =
+                RewindManager::get()->getRewinderName(id);
+            if (name.empty())
+            {
+                // The name of this id is not yet received from the server
+                Log::debug("RewindInfoState", "Unknown rewinder id %d", id);
+                m_buffer->skip(data_size);
+                continue;
+            }
             // For now we only need to get missing rewinder from
             // projectile_manager
             r = ProjectileManager::get()->addRewinderFromNetworkState(name);
-        }
-        if (!r)
-        {
-            if (!RewindManager::get()->hasMissingRewinder(name))
+            if (!r)
             {
-                Log::error("RewindInfoState", "Missing rewinder %s",
-                    name.c_str());
-                RewindManager::get()->addMissingRewinder(name);
+                if (!RewindManager::get()->hasMissingRewinder(name))
+                {
+                    Log::error("RewindInfoState", "Missing rewinder %s",
+                        name.c_str());
+                    RewindManager::get()->addMissingRewinder(name);
+                }
+                m_buffer->skip(data_size);
+                continue;
             }
-            m_buffer->skip(data_size);
-            continue;
         }
         try
         {
@@ -54,6 +54,14 @@ private:
      *  object.  */
     bool m_is_confirmed;
 
+protected:
+    /** Used when a recycled RewindInfo is reused for a new time. */
+    void reuse(int ticks, bool is_confirmed)
+    {
+        m_ticks        = ticks;
+        m_is_confirmed = is_confirmed;
+    }   // reuse
+
 public:
     RewindInfo(int ticks, bool is_confirmed);
 
@@ -92,7 +100,13 @@ public:
 class RewindInfoState: public RewindInfo
 {
 private:
-    std::vector<std::string> m_rewinder_using;
+    /** Network ids of the rewinders in this state, in the order of the
+     *  data in the buffer. */
+    std::vector<uint16_t> m_rewinder_using;
+
+    /** Network ids of rewinders which the server left out of this state for
+     *  this client, they are restored from the state saved locally. */
+    std::vector<uint16_t> m_rewinder_skipped;
 
     int m_start_offset;
 
@@ -101,9 +115,7 @@ private:
 
 public:
     // ------------------------------------------------------------------------
-    RewindInfoState(int ticks, int start_offset,
-                    std::vector<std::string>& rewinder_using,
-                    std::vector<uint8_t>& buffer);
+    RewindInfoState(int ticks);
     // ------------------------------------------------------------------------
     RewindInfoState(int ticks, BareNetworkString *buffer, bool is_confirmed);
     // ------------------------------------------------------------------------
@@ -111,9 +123,27 @@ public:
     // ------------------------------------------------------------------------
     virtual void restore();
     // ------------------------------------------------------------------------
+    /** Prepares a recycled confirmed state to store a new state from the
+     *  server. The buffers keep their capacity, so no memory needs to be
+     *  allocated if they are large enough. */
+    void reuse(int ticks)
+    {
+        RewindInfo::reuse(ticks, /*is_confirmed*/true);
+        m_start_offset = 0;
+        m_rewinder_using.clear();
+        m_rewinder_skipped.clear();
+        m_buffer->clearData();
+    }   // reuse
+    // ------------------------------------------------------------------------
     /** Returns a pointer to the state buffer. */
     BareNetworkString *getBuffer() const { return m_buffer; }
     // ------------------------------------------------------------------------
+    /** Returns the network ids of the rewinders in this state. */
+    std::vector<uint16_t>& getRewinderUsing()      { return m_rewinder_using; }
+    // ------------------------------------------------------------------------
+    /** Returns the network ids of the rewinders left out of this state. */
+    std::vector<uint16_t>& getRewinderSkipped()  { return m_rewinder_skipped; }
+    // ------------------------------------------------------------------------
     virtual bool isState() const { return true; }
     // ------------------------------------------------------------------------
     /** Called when going back in time to undo any rewind information.
@@ -18,7 +18,9 @@
 
 #include "network/rewind_manager.hpp"
 
+#include "config/user_config.hpp"
 #include "graphics/irr_driver.hpp"
+#include "karts/abstract_kart.hpp"
 #include "modes/soccer_world.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
@@ -26,7 +28,9 @@
 #include "network/rewinder.hpp"
 #include "network/rewind_info.hpp"
 #include "network/smooth_network_body.hpp"
+#include "physics/btKart.hpp"
 #include "physics/physics.hpp"
+#include "physics/physics_snapshot.hpp"
 #include "race/history.hpp"
 #include "tracks/check_manager.hpp"
 #include "tracks/track.hpp"
@@ -34,8 +38,28 @@
 #include "tracks/track_object_manager.hpp"
 #include "utils/log.hpp"
 #include "utils/profiler.hpp"
+#include "utils/time.hpp"
 
 #include <algorithm>
+#include <string.h>
+
+/** Number of physics snapshots kept, enough for about 3 seconds with the
+ *  default state frequency. */
+const unsigned PHYSICS_SNAPSHOT_COUNT = 32;
+
+/** Resolution of the rollback lengths in the rollback cost report. */
+const int ROLLBACK_COST_BUCKET_MS = 50;
+
+// ============================================================================
+struct RewindManager::PhysicsSnapshot
+{
+    /** Time of the snapshot, -1 if the slot is not used. */
+    int m_ticks;
+    /** The world kart id and physics state of each kart. */
+    std::vector<std::pair<unsigned, btKart::Snapshot> > m_karts;
+    /** The bodies of all physical objects moved by 3d animation. */
+    std::vector<RigidBodySnapshot> m_objects;
+};   // PhysicsSnapshot
 
 RewindManager* RewindManager::m_rewind_manager[PT_COUNT];
 std::atomic_bool RewindManager::m_enable_rewind_manager(false);
@@ -64,6 +88,8 @@ void RewindManager::destroy()
  */
 RewindManager::RewindManager()
 {
+    m_rollbacks_avoided = 0;
+    m_rollback_ticks_saved = 0;
     reset();
 }   // RewindManager
 
@@ -76,6 +102,7 @@ RewindManager::~RewindManager()
     for (RewindInfoEventFunction* rief : m_pending_rief)
         delete rief;
     m_pending_rief.clear();
+    printRollbackCost();
 }   // ~RewindManager
 
 // ----------------------------------------------------------------------------
@@ -89,6 +116,16 @@ void RewindManager::reset()
     m_overall_state_size = 0;
     m_state_frequency = stk_config->getPhysicsFPS() /
         NetworkConfig::get()->getStateFrequency();
+    for (LocalRewinderState& s : m_local_rewinder_state)
+        s.m_ticks = -1;
+    m_local_rewinder_state_next = 0;
+    for (auto& s : m_physics_snapshot)
+        s->m_ticks = -1;
+    m_physics_snapshot_next = 0;
+    m_pending_rewind_ticks = -1;
+    m_pending_rewind_since = -1;
+    m_late_event_ticks = -1;
+    printRollbackCost();
 
     if (!m_enable_rewind_manager) return;
 
@@ -159,25 +196,16 @@ void RewindManager::saveState()
     if (!gp)
         return;
     gp->startNewState();
+    m_rewinder_using.clear();
 
-    m_overall_state_size = 0;
-    std::vector<std::string> rewinder_using;
-
+    // Each rewinder writes directly into the state of GameProtocol
     for (auto& p : m_all_rewinder)
     {
-        // TODO: check if it's worth passing in a sufficiently large buffer from
-        // GameProtocol - this would save the copy operation.
-        BareNetworkString* buffer = NULL;
         if (auto r = p.second.lock())
-            buffer = r->saveState(&rewinder_using);
-        if (buffer != NULL)
-        {
-            m_overall_state_size += buffer->size();
-            gp->addState(buffer);
-        }
-        delete buffer;    // buffer can be freed
+            gp->addState(r.get(), &m_rewinder_using);
     }
-    gp->finalizeState(rewinder_using);
+    gp->finalizeState(m_rewinder_using);
+    m_overall_state_size = gp->getState()->getTotalSize();
     PROFILER_POP_CPU_MARKER();
 }   // saveState
 
@@ -190,11 +218,22 @@ void RewindManager::update(int ticks_not_used)
 {
     // FIXME: rename ticks_not_used
     if (!m_enable_rewind_manager ||
-        m_all_rewinder.size() == 0 ||
-        m_is_rewinding)  return;
+        m_all_rewinder.size() == 0)  return;
 
     int ticks = World::getWorld()->getTicksSinceStart();
 
+    if (m_is_rewinding)
+    {
+        // Replace the values predicted before the rewind with the corrected
+        // ones, so that later states from the server are compared with them
+        if (NetworkConfig::get()->isClient() && shouldSaveState(ticks))
+        {
+            saveLocalState(ticks);
+            savePhysicsSnapshot(ticks);
+        }
+        return;
+    }
+
     m_not_rewound_ticks.store(ticks, std::memory_order_relaxed);
 
     if (!shouldSaveState(ticks))
@@ -210,6 +249,8 @@ void RewindManager::update(int ticks_not_used)
             if (auto r = p.second.lock())
                 ret.push_back(r->getLocalStateRestoreFunction());
         }
+        saveLocalState(ticks);
+        savePhysicsSnapshot(ticks);
     }
     else
     {
@@ -240,17 +281,56 @@ void RewindManager::playEventsTill(int world_ticks, bool fast_forward)
     // time step.
     // merge and that have happened before the current time (which will
     // be getTime()+dt - world time has not been updated yet).
-    m_rewind_queue.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
+    m_rewind_queue.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks,
+        &m_late_event_ticks);
 
+    // States received within the rollback window are combined into one
+    // rewind to the latest of them, which supersedes the earlier ones
     if (needs_rewind)
     {
-        Log::setPrefix("Rewind");
-        PROFILER_PUSH_CPU_MARKER("Rewind", 128, 128, 128);
-        rewindTo(rewind_ticks, world_ticks, fast_forward);
-        // This should replay everything up to 'now'
-        assert(World::getWorld()->getTicksSinceStart() == world_ticks);
-        PROFILER_POP_CPU_MARKER();
-        Log::setPrefix("");
+        if (m_pending_rewind_ticks == -1)
+        {
+            m_pending_rewind_ticks = rewind_ticks;
+            m_pending_rewind_since = world_ticks;
+        }
+        else
+        {
+            m_rollbacks_avoided++;
+            m_rollback_ticks_saved += world_ticks -
+                std::min(m_pending_rewind_ticks, rewind_ticks);
+            m_pending_rewind_ticks =
+                std::max(m_pending_rewind_ticks, rewind_ticks);
+        }
+    }
+
+    const int window = stk_config->time2Ticks(
+        (float)UserConfigParams::m_rollback_window / 1000.0f);
+    if (m_pending_rewind_ticks != -1 &&
+        (fast_forward || world_ticks - m_pending_rewind_since >= window))
+    {
+        rewind_ticks = m_pending_rewind_ticks;
+        // Events received late which happened after the state change the
+        // simulation even if the state was predicted correctly
+        RewindInfoState* state = NULL;
+        if (!fast_forward && m_late_event_ticks < rewind_ticks)
+            state = m_rewind_queue.findConfirmedState(rewind_ticks);
+        if (state && isPredictionCorrect(state))
+        {
+            m_rollbacks_avoided++;
+            m_rollback_ticks_saved += world_ticks - rewind_ticks;
+        }
+        else
+        {
+            Log::setPrefix("Rewind");
+            PROFILER_PUSH_CPU_MARKER("Rewind", 128, 128, 128);
+            rewindTo(rewind_ticks, world_ticks, fast_forward);
+            // This should replay everything up to 'now'
+            assert(World::getWorld()->getTicksSinceStart() == world_ticks);
+            PROFILER_POP_CPU_MARKER();
+            Log::setPrefix("");
+        }
+        m_pending_rewind_ticks = -1;
+        m_late_event_ticks = -1;
     }
 
     assert(!m_is_rewinding);
@@ -260,6 +340,10 @@ void RewindManager::playEventsTill(int world_ticks, bool fast_forward)
     // event again as a seemingly new event.
     m_is_rewinding = true;
 
+    // Rewind infos in the past which were not rewound to (yet) are not
+    // replayed, a later rewind starts again from the state before them
+    m_rewind_queue.skipUntil(world_ticks);
+
     // Now play all events that happened at the current time stamp.
     m_rewind_queue.replayAllEvents(world_ticks);
 
@@ -276,10 +360,419 @@ bool RewindManager::addRewinder(std::shared_ptr<Rewinder> rewinder)
     // Maximum 1 bit to store no of rewinder used
     if (m_all_rewinder.size() == 255)
         return false;
-    m_all_rewinder[rewinder->getUniqueIdentity()] = rewinder;
+    const std::string& name = rewinder->getUniqueIdentity();
+    if (NetworkConfig::get()->isServer())
+    {
+        // Rewinders re-added with the same identity (like karts in live
+        // join) keep their network id
+        std::lock_guard<std::mutex> lock(m_rewinder_names_mutex);
+        auto id = m_rewinder_ids.find(name);
+        if (id == m_rewinder_ids.end())
+        {
+            if (m_rewinder_names.size() > 65535)
+                return false;
+            id = m_rewinder_ids.emplace(name,
+                (uint16_t)m_rewinder_names.size()).first;
+            m_rewinder_names.push_back(name);
+        }
+        rewinder->setRewinderID(id->second);
+    }
+
+    auto it = std::lower_bound(m_all_rewinder.begin(), m_all_rewinder.end(),
+        name, [](const std::pair<std::string, std::weak_ptr<Rewinder> >& p,
+                 const std::string& n) { return p.first < n; });
+    if (it != m_all_rewinder.end() && it->first == name)
+        it->second = rewinder;
+    else
+        m_all_rewinder.emplace(it, name, rewinder);
     return true;
 }   // addRewinder
 
+// ----------------------------------------------------------------------------
+/** Returns the rewinder with the given unique identity, or nullptr if it
+ *  doesn't exist (anymore).
+ *  \param name The unique identity of the rewinder.
+ */
+std::shared_ptr<Rewinder> RewindManager::findRewinder(const std::string& name)
+                                                                          const
+{
+    auto it = std::lower_bound(m_all_rewinder.begin(), m_all_rewinder.end(),
+        name, [](const std::pair<std::string, std::weak_ptr<Rewinder> >& p,
+                 const std::string& n) { return p.first < n; });
+    if (it != m_all_rewinder.end() && it->first == name)
+        return it->second.lock();
+    return nullptr;
+}   // findRewinder
+
+// ----------------------------------------------------------------------------
+/** Returns the rewinder of a network id used in a state from the server, or
+ *  nullptr if the rewinder doesn't exist on this client (yet).
+ *  \param id The network id.
+ */
+std::shared_ptr<Rewinder> RewindManager::getRewinder(uint16_t id)
+{
+    if (id < m_network_rewinder.size())
+    {
+        if (auto r = m_network_rewinder[id].lock())
+            return r;
+    }
+    const std::string name = getRewinderName(id);
+    if (name.empty())
+        return nullptr;
+    std::shared_ptr<Rewinder> r = findRewinder(name);
+    if (r)
+    {
+        if (id >= m_network_rewinder.size())
+            m_network_rewinder.resize(id + 1);
+        m_network_rewinder[id] = r;
+    }
+    return r;
+}   // getRewinder
+
+// ----------------------------------------------------------------------------
+/** Returns the unique identity of a network id, or an empty string if the id
+ *  is unknown.
+ *  \param id The network id.
+ */
+std::string RewindManager::getRewinderName(uint16_t id) const
+{
+    std::lock_guard<std::mutex> lock(m_rewinder_names_mutex);
+    if (id < m_rewinder_names.size())
+        return m_rewinder_names[id];
+    return "";
+}   // getRewinderName
+
+// ----------------------------------------------------------------------------
+/** Client only: returns the network id of a unique identity, a new id is
+ *  assigned if needed. This is used for states of servers which send names
+ *  of rewinders instead of their ids.
+ *  \param name The unique identity of the rewinder.
+ */
+uint16_t RewindManager::getRewinderID(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_rewinder_names_mutex);
+    auto it = m_rewinder_ids.find(name);
+    if (it != m_rewinder_ids.end())
+        return it->second;
+    const uint16_t id = (uint16_t)m_rewinder_names.size();
+    m_rewinder_ids[name] = id;
+    m_rewinder_names.push_back(name);
+    return id;
+}   // getRewinderID
+
+// ----------------------------------------------------------------------------
+/** Client only: stores the unique identity of a network id announced by the
+ *  server.
+ *  \param id The network id.
+ *  \param name The unique identity of the rewinder.
+ */
+void RewindManager::addRewinderName(uint16_t id, const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_rewinder_names_mutex);
+    if (id >= m_rewinder_names.size())
+        m_rewinder_names.resize(id + 1);
+    m_rewinder_names[id] = name;
+    m_rewinder_ids[name] = id;
+}   // addRewinderName
+
+// ----------------------------------------------------------------------------
+/** Client only: saves the state of all rewinders which the server can leave
+ *  out of a state, so a state of the server without them can be completed
+ *  with the values predicted on this client. The saved states are also
+ *  compared with the states of the server to skip unneeded rewinds, see
+ *  isPredictionCorrect().
+ *  \param ticks Time of the state.
+ */
+void RewindManager::saveLocalState(int ticks)
+{
+    // Enough for about 3 seconds with the default state frequency
+    if (m_local_rewinder_state.empty())
+    {
+        m_local_rewinder_state.resize(32);
+        for (LocalRewinderState& s : m_local_rewinder_state)
+        {
+            s.m_ticks = -1;
+            s.m_buffer.reset(new BareNetworkString());
+        }
+    }
+    // A state saved again after a rewind replaces the one predicted before
+    LocalRewinderState* slot = NULL;
+    for (LocalRewinderState& s : m_local_rewinder_state)
+    {
+        if (s.m_ticks == ticks)
+        {
+            slot = &s;
+            break;
+        }
+    }
+    if (!slot)
+    {
+        slot = &m_local_rewinder_state[m_local_rewinder_state_next];
+        m_local_rewinder_state_next = (m_local_rewinder_state_next + 1) %
+            m_local_rewinder_state.size();
+    }
+    LocalRewinderState& state = *slot;
+
+    state.m_ticks = ticks;
+    state.m_names.clear();
+    state.m_offsets.clear();
+    std::vector<uint8_t>& buffer = state.m_buffer->getBuffer();
+    buffer.clear();
+    state.m_buffer->reset();
+    for (auto& p : m_all_rewinder)
+    {
+        std::shared_ptr<Rewinder> r = p.second.lock();
+        if (!r || !r->isStateComparable())
+            continue;
+        const size_t offset = buffer.size();
+        m_rewinder_using.clear();
+        if (!r->saveState(state.m_buffer.get(), &m_rewinder_using))
+        {
+            buffer.resize(offset);
+            continue;
+        }
+        state.m_names.push_back(p.first);
+        state.m_offsets.push_back((uint32_t)offset);
+    }
+    state.m_offsets.push_back((uint32_t)buffer.size());
+}   // saveLocalState
+
+// ----------------------------------------------------------------------------
+/** Client only: restores a rewinder which the server left out of a state
+ *  to the values saved locally at the same time.
+ *  \param ticks Time of the state.
+ *  \param rewinder The rewinder to restore.
+ *  \return False if no local state of the rewinder at that time exists.
+ */
+bool RewindManager::restoreLocalState(int ticks,
+                                      std::shared_ptr<Rewinder> rewinder)
+{
+    for (LocalRewinderState& state : m_local_rewinder_state)
+    {
+        if (state.m_ticks != ticks)
+            continue;
+        const std::string& name = rewinder->getUniqueIdentity();
+        auto it = std::lower_bound(state.m_names.begin(),
+            state.m_names.end(), name);
+        if (it == state.m_names.end() || *it != name)
+            return false;
+        const unsigned i = (unsigned)(it - state.m_names.begin());
+        state.m_buffer->reset();
+        state.m_buffer->skip(state.m_offsets[i]);
+        try
+        {
+            rewinder->restoreState(state.m_buffer.get(),
+                state.m_offsets[i + 1] - state.m_offsets[i]);
+        }
+        catch (std::exception& e)
+        {
+            Log::error("RewindManager", "Restore local state error: %s",
+                e.what());
+            return false;
+        }
+        return true;
+    }
+    return false;
+}   // restoreLocalState
+
+// ----------------------------------------------------------------------------
+/** Client only: saves the physics state of all karts and animated track
+ *  objects. When rewinding to this time, they are restored with plain copies
+ *  before the confirmed state is applied, so that the values which are not
+ *  part of a state (e.g. the wheels) are the ones predicted at that time
+ *  instead of the current ones, and animated objects don't need to be
+ *  moved back by running their animations again.
+ *  \param ticks Time of the snapshot.
+ */
+void RewindManager::savePhysicsSnapshot(int ticks)
+{
+    if (m_physics_snapshot.empty())
+    {
+        m_physics_snapshot.resize(PHYSICS_SNAPSHOT_COUNT);
+        for (auto& s : m_physics_snapshot)
+        {
+            s.reset(new PhysicsSnapshot());
+            s->m_ticks = -1;
+        }
+    }
+    PhysicsSnapshot* slot = NULL;
+    for (auto& s : m_physics_snapshot)
+    {
+        if (s->m_ticks == ticks)
+        {
+            slot = s.get();
+            break;
+        }
+    }
+    if (!slot)
+    {
+        slot = m_physics_snapshot[m_physics_snapshot_next].get();
+        m_physics_snapshot_next = (m_physics_snapshot_next + 1) %
+            m_physics_snapshot.size();
+    }
+    PhysicsSnapshot& snapshot = *slot;
+
+    snapshot.m_ticks = ticks;
+    World* world = World::getWorld();
+    snapshot.m_karts.resize(world->getNumKarts());
+    unsigned count = 0;
+    for (unsigned i = 0; i < world->getNumKarts(); i++)
+    {
+        btKart* vehicle = world->getKart(i)->getVehicle();
+        if (!vehicle)
+            continue;
+        snapshot.m_karts[count].first = i;
+        vehicle->saveSnapshot(&snapshot.m_karts[count].second);
+        count++;
+    }
+    snapshot.m_karts.resize(count);
+    Track::getCurrentTrack()->getTrackObjectManager()
+        ->saveAnimatedBodies(&snapshot.m_objects);
+}   // savePhysicsSnapshot
+
+// ----------------------------------------------------------------------------
+/** Client only: restores the physics snapshot saved at the given time.
+ *  \param ticks Time of the snapshot.
+ *  \return True if the snapshot was found and the animated track objects
+ *          could be restored.
+ */
+bool RewindManager::restorePhysicsSnapshot(int ticks)
+{
+    for (auto& s : m_physics_snapshot)
+    {
+        if (s->m_ticks != ticks)
+            continue;
+        World* world = World::getWorld();
+        for (auto& k : s->m_karts)
+        {
+            if (k.first >= world->getNumKarts())
+                continue;
+            if (btKart* vehicle = world->getKart(k.first)->getVehicle())
+                vehicle->restoreSnapshot(k.second);
+        }
+        return Track::getCurrentTrack()->getTrackObjectManager()
+            ->restoreAnimatedBodies(s->m_objects);
+    }
+    return false;
+}   // restorePhysicsSnapshot
+
+// ----------------------------------------------------------------------------
+/** Client only: compares a state received from the server with the state
+ *  saved by this client at the same time. If they are identical, a rewind
+ *  to this state would simulate exactly what was already simulated, so it
+ *  can be skipped. Since both sides save the quantized values, the
+ *  quantization of the state is the tolerance of the comparison.
+ *  \param state The confirmed state.
+ *  \return True if the state contains only comparable rewinders, and all
+ *          of them are identical to the ones saved locally.
+ */
+bool RewindManager::isPredictionCorrect(RewindInfoState* state)
+{
+    const LocalRewinderState* local = NULL;
+    for (const LocalRewinderState& s : m_local_rewinder_state)
+    {
+        if (s.m_ticks == state->getTicks())
+        {
+            local = &s;
+            break;
+        }
+    }
+    if (!local)
+        return false;
+
+    BareNetworkString* buffer = state->getBuffer();
+    const std::vector<uint8_t>& local_data = local->m_buffer->getBuffer();
+    unsigned compared = 0;
+    bool correct = true;
+    buffer->reset();
+    try
+    {
+        for (uint16_t id : state->getRewinderUsing())
+        {
+            const uint16_t data_size = buffer->getUInt16();
+            const uint8_t* data = (const uint8_t*)buffer->getCurrentData();
+            buffer->skip(data_size);
+            std::shared_ptr<Rewinder> r = getRewinder(id);
+            if (!r)
+            {
+                correct = false;
+                break;
+            }
+            if (!r->isStateComparable())
+            {
+                // E.g. the item manager without any new item events
+                if (data_size != 0)
+                {
+                    correct = false;
+                    break;
+                }
+                continue;
+            }
+            auto it = std::lower_bound(local->m_names.begin(),
+                local->m_names.end(), r->getUniqueIdentity());
+            if (it == local->m_names.end() || *it != r->getUniqueIdentity())
+            {
+                correct = false;
+                break;
+            }
+            const unsigned i = (unsigned)(it - local->m_names.begin());
+            const uint32_t offset = local->m_offsets[i];
+            if (local->m_offsets[i + 1] - offset != data_size ||
+                (data_size > 0 &&
+                 memcmp(data, local_data.data() + offset, data_size) != 0))
+            {
+                correct = false;
+                break;
+            }
+            compared++;
+        }
+    }
+    catch (std::exception&)
+    {
+        correct = false;
+    }
+    buffer->reset();
+    if (!correct)
+        return false;
+
+    // A rewinder which exists on this client but not on the server must be
+    // removed by a rewind, unless the server left it out of the state
+    unsigned skipped = 0;
+    for (uint16_t id : state->getRewinderSkipped())
+    {
+        std::shared_ptr<Rewinder> r = getRewinder(id);
+        if (r && std::binary_search(local->m_names.begin(),
+            local->m_names.end(), r->getUniqueIdentity()))
+            skipped++;
+    }
+    return compared + skipped == local->m_names.size();
+}   // isPredictionCorrect
+
+// ----------------------------------------------------------------------------
+/** Logs the time spent in rollbacks for each rollback length and the
+ *  rollbacks avoided, and clears the values.
+ */
+void RewindManager::printRollbackCost()
+{
+    for (auto& p : m_rollback_cost)
+    {
+        Log::info("RewindManager", "Rollback of %d-%d ms: %u times, "
+            "%.1f us average, %u us max.", p.first,
+            p.first + ROLLBACK_COST_BUCKET_MS - 1, p.second.m_count,
+            (float)p.second.m_total_us / (float)p.second.m_count,
+            (unsigned)p.second.m_max_us);
+    }
+    m_rollback_cost.clear();
+    if (m_rollbacks_avoided > 0)
+    {
+        Log::info("RewindManager", "Rollbacks avoided: %u, ticks not "
+            "simulated again: %u.", m_rollbacks_avoided,
+            (unsigned)m_rollback_ticks_saved);
+    }
+    m_rollbacks_avoided = 0;
+    m_rollback_ticks_saved = 0;
+}   // printRollbackCost
+
 // ----------------------------------------------------------------------------
 /** Rewinds to the specified time, then goes forward till the current
  *  World::getTime() is reached again: it will replay everything before
@@ -295,6 +788,7 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
                              bool fast_forward)
 {
     assert(!m_is_rewinding);
+    const uint64_t start_us = StkTime::getMonoTimeUs();
     bool is_history = history->replayHistory();
     history->setReplayHistory(false);
 
@@ -353,6 +847,10 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
             exact_rewind_ticks);
     }
 
+    // Restore the predicted physics state first, the confirmed states
+    // overwrite it for the values they contain
+    const bool restored_objects = restorePhysicsSnapshot(exact_rewind_ticks);
+
     // A loop in case that we should split states into several smaller ones:
     while (current && current->getTicks() == exact_rewind_ticks && 
            current->isState()                                        )
@@ -365,13 +863,14 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
     // Update check line, so the cannon animation can be replayed correctly
     Track::getCurrentTrack()->getCheckManager()->resetAfterRewind();
 
-    if (exact_rewind_ticks >= 2)
+    if (exact_rewind_ticks >= 2 && !restored_objects)
     {
         // Restore all physical objects moved by 3d animation, as it only
         // set the motion state of physical bodies, it has 1 frame delay
         // the resetAfterRewind will do the saveKinematicState which needs
         // the previous frame transforms to calculate current linear and
-        // angular velocities
+        // angular velocities. Not needed if the bodies were restored from
+        // the physics snapshot.
         world->setTicksForRewind(exact_rewind_ticks - 2);
         Track::getCurrentTrack()->getTrackObjectManager()->resetAfterRewind();
         world->setTicksForRewind(exact_rewind_ticks - 1);
@@ -405,6 +904,18 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
     history->setReplayHistory(is_history);
     m_is_rewinding = false;
     mergeRewindInfoEventFunction();
+
+    if (!fast_forward)
+    {
+        const int length_ms = (int)(stk_config->ticks2Time(
+            now_ticks - exact_rewind_ticks) * 1000.0f);
+        RollbackCost& cost = m_rollback_cost[length_ms /
+            ROLLBACK_COST_BUCKET_MS * ROLLBACK_COST_BUCKET_MS];
+        const uint64_t us = StkTime::getMonoTimeUs() - start_us;
+        cost.m_count++;
+        cost.m_total_us += us;
+        cost.m_max_us = std::max(cost.m_max_us, us);
+    }
 }   // rewindTo
 
 // ----------------------------------------------------------------------------
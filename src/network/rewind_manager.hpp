@@ -21,19 +21,25 @@
 
 #include "network/rewind_queue.hpp"
 #include "utils/stk_process.hpp"
+#include "utils/types.hpp"
 
+#include <algorithm>
 #include <assert.h>
 #include <atomic>
 #include <functional>
 #include <memory>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
+class BareNetworkString;
 class Rewinder;
 class RewindInfo;
 class RewindInfoEventFunction;
+class RewindInfoState;
 class EventRewinder;
 
 /** \ingroup network
@@ -93,8 +99,26 @@ private:
 
     std::map<int, std::vector<std::function<void()> > > m_local_state;
 
-    /** A list of all objects that can be rewound. */
-    std::map<std::string, std::weak_ptr<Rewinder> > m_all_rewinder;
+    /** A list of all objects that can be rewound, sorted by their unique
+     *  identity (which determines the order states are restored in). */
+    std::vector<std::pair<std::string, std::weak_ptr<Rewinder> > >
+        m_all_rewinder;
+
+    /** The unique identity of each rewinder indexed by its network id. On
+     *  the server ids are assigned when a rewinder is added, on a client
+     *  they are received from the server. */
+    std::vector<std::string> m_rewinder_names;
+
+    /** Network id of each unique identity in m_rewinder_names. */
+    std::map<std::string, uint16_t> m_rewinder_ids;
+
+    /** Protects m_rewinder_names and m_rewinder_ids, which are updated by
+     *  the network thread on clients. */
+    mutable std::mutex m_rewinder_names_mutex;
+
+    /** Client only: the rewinder of each network id, resolved from
+     *  m_rewinder_names when first needed. */
+    std::vector<std::weak_ptr<Rewinder> > m_network_rewinder;
 
     /** The queue that stores all rewind infos. */
     RewindQueue m_rewind_queue;
@@ -119,23 +143,91 @@ private:
 
     std::set<std::string> m_missing_rewinders;
 
+    /** Network ids of the rewinders in the state being saved, kept to
+     *  reuse its memory. */
+    std::vector<uint16_t> m_rewinder_using;
+
+    /** States of the rewinders which the server can leave out of a state for
+     *  this client (see Rewinder::getRelevancePosition), saved by a client
+     *  at each state time. */
+    struct LocalRewinderState
+    {
+        /** Time of the state, -1 if the slot is not used. */
+        int m_ticks;
+        /** Unique identities of the rewinders, sorted. */
+        std::vector<std::string> m_names;
+        /** Offset of the data of each rewinder in m_buffer, and the end of
+         *  the data of the last one. */
+        std::vector<uint32_t> m_offsets;
+        std::unique_ptr<BareNetworkString> m_buffer;
+    };
+
+    /** Ring of the last local rewinder states, slots are reused. */
+    std::vector<LocalRewinderState> m_local_rewinder_state;
+
+    /** Index of the slot in m_local_rewinder_state used next. */
+    unsigned m_local_rewinder_state_next;
+
+    /** Physics state of all karts and animated track objects predicted by
+     *  this client at a state time, see savePhysicsSnapshot(). */
+    struct PhysicsSnapshot;
+
+    /** Ring of the last physics snapshots, slots are reused. */
+    std::vector<std::unique_ptr<PhysicsSnapshot> > m_physics_snapshot;
+
+    /** Index of the slot in m_physics_snapshot used next. */
+    unsigned m_physics_snapshot_next;
+
+    /** Time spent in rollbacks of a certain length. */
+    struct RollbackCost
+    {
+        unsigned m_count;
+        uint64_t m_total_us;
+        uint64_t m_max_us;
+    };
+
+    /** Rollback cost for each length of the rollback in milliseconds
+     *  (rounded down to ROLLBACK_COST_BUCKET_MS), which is about the ping
+     *  of the client. */
+    std::map<int, RollbackCost> m_rollback_cost;
+
+    /** Time of the latest state received from the server which needs a
+     *  rewind that was not done yet, -1 if there is none. */
+    int m_pending_rewind_ticks;
+
+    /** World time when m_pending_rewind_ticks was set, rewinding is
+     *  delayed by at most the rollback window from then. */
+    int m_pending_rewind_since;
+
+    /** Latest time of the events received from the server in the past of
+     *  this client since the last rewind, -1 if there are none. */
+    int m_late_event_ticks;
+
+    /** Number of rewinds not done, either because they were combined with
+     *  a later one or because this client predicted the state correctly. */
+    unsigned m_rollbacks_avoided;
+
+    /** Number of ticks which didn't need to be simulated again because of
+     *  the rewinds avoided. */
+    uint64_t m_rollback_ticks_saved;
+
     RewindManager();
    ~RewindManager();
     // ------------------------------------------------------------------------
     void clearExpiredRewinder()
     {
-        for (auto it = m_all_rewinder.begin(); it != m_all_rewinder.end();)
-        {
-            if (it->second.expired())
-            {
-                it = m_all_rewinder.erase(it);
-                continue;
-            }
-            it++;
-        }
+        m_all_rewinder.erase(std::remove_if(m_all_rewinder.begin(),
+            m_all_rewinder.end(),
+            [](const std::pair<std::string, std::weak_ptr<Rewinder> >& p)
+            { return p.second.expired(); }), m_all_rewinder.end());
     }
     // ------------------------------------------------------------------------
     void mergeRewindInfoEventFunction();
+    void saveLocalState(int ticks);
+    void savePhysicsSnapshot(int ticks);
+    bool restorePhysicsSnapshot(int ticks);
+    bool isPredictionCorrect(RewindInfoState* state);
+    void printRollbackCost();
 
 public:
     // First static functions to manage rewinding.
@@ -176,20 +268,22 @@ public:
                          BareNetworkString *buffer, int ticks);
     void addNetworkState(BareNetworkString *buffer, int ticks);
     void saveState();
-    // ------------------------------------------------------------------------
-    std::shared_ptr<Rewinder> getRewinder(const std::string& name)
-    {
-        auto it = m_all_rewinder.find(name);
-        if (it != m_all_rewinder.end())
-        {
-            if (auto r = it->second.lock())
-                return r;
-        }
-        return nullptr;
-    }
+    std::shared_ptr<Rewinder> findRewinder(const std::string& name) const;
+    std::shared_ptr<Rewinder> getRewinder(uint16_t id);
+    std::string getRewinderName(uint16_t id) const;
+    uint16_t getRewinderID(const std::string& name);
+    void addRewinderName(uint16_t id, const std::string& name);
+    bool restoreLocalState(int ticks, std::shared_ptr<Rewinder> rewinder);
     // ------------------------------------------------------------------------
     bool addRewinder(std::shared_ptr<Rewinder> rewinder);
     // ------------------------------------------------------------------------
+    /** Returns the number of network ids assigned so far. */
+    unsigned getRewinderIDCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_rewinder_names_mutex);
+        return (unsigned)m_rewinder_names.size();
+    }   // getRewinderIDCount
+    // ------------------------------------------------------------------------
     /** Returns true if currently a rewind is happening. */
     bool isRewinding() const { return m_is_rewinding; }
 
@@ -213,6 +307,13 @@ public:
     void addNetworkRewindInfo(RewindInfo* ri)
                                    { m_rewind_queue.addNetworkRewindInfo(ri); }
     // ------------------------------------------------------------------------
+    /** Returns a (reused if possible) state for a state from the server. */
+    RewindInfoState* allocateState(int ticks)
+                                { return m_rewind_queue.allocateState(ticks); }
+    // ------------------------------------------------------------------------
+    /** Frees a RewindInfo which was not added to the rewind queue. */
+    void freeRewindInfo(RewindInfo* ri)  { m_rewind_queue.freeRewindInfo(ri); }
+    // ------------------------------------------------------------------------
     bool shouldSaveState(int ticks)
     {
         int a = ticks - m_state_frequency + 1;
@@ -45,6 +45,7 @@
  */
 RewindQueue::RewindQueue()
 {
+    m_state_allocations.store(0);
     reset();
 }   // RewindQueue
 
@@ -56,6 +57,11 @@ RewindQueue::~RewindQueue()
 {
     // This frees all current data
     reset();
+    m_free_states.lock();
+    for (RewindInfoState* ris : m_free_states.getData())
+        delete ris;
+    m_free_states.getData().clear();
+    m_free_states.unlock();
 }   // ~RewindQueue
 
 // ----------------------------------------------------------------------------
@@ -69,14 +75,14 @@ void RewindQueue::reset()
     for (AllNetworkRewindInfo::const_iterator i  = info.begin(); 
                                               i != info.end(); ++i)
     {
-        delete *i;
+        freeRewindInfo(*i);
     }
     m_network_events.getData().clear();
     m_network_events.unlock();
 
     AllRewindInfo::const_iterator i;
     for (i = m_all_rewind_info.begin(); i != m_all_rewind_info.end(); ++i)
-        delete *i;
+        freeRewindInfo(*i);
 
     m_all_rewind_info.clear();
     m_current = m_all_rewind_info.end();
@@ -187,6 +193,53 @@ void RewindQueue::addNetworkState(BareNetworkString *buffer, int ticks)
     m_network_events.unlock();
 }   // addNetworkState
 
+// ----------------------------------------------------------------------------
+/** Returns a confirmed state to store a state received from the server,
+ *  which is reused from the states not needed anymore if possible. This
+ *  function is threadsafe so can be called by the network thread.
+ *  \param ticks Time of the state.
+ */
+RewindInfoState* RewindQueue::allocateState(int ticks)
+{
+    RewindInfoState* ris = NULL;
+    m_free_states.lock();
+    if (!m_free_states.getData().empty())
+    {
+        ris = m_free_states.getData().back();
+        m_free_states.getData().pop_back();
+    }
+    m_free_states.unlock();
+    if (!ris)
+    {
+        m_state_allocations++;
+        return new RewindInfoState(ticks);
+    }
+    ris->reuse(ticks);
+    return ris;
+}   // allocateState
+
+// ----------------------------------------------------------------------------
+/** Frees a RewindInfo which is not needed anymore. Confirmed states are
+ *  kept to be reused by allocateState.
+ *  \param ri The RewindInfo to free.
+ */
+void RewindQueue::freeRewindInfo(RewindInfo* ri)
+{
+    RewindInfoState* ris = NULL;
+    if (ri && ri->isState() && ri->isConfirmed())
+        ris = static_cast<RewindInfoState*>(ri);
+    if (!ris || !ris->getBuffer())
+    {
+        delete ri;
+        return;
+    }
+    // Release the received packet the state may share its data with
+    ris->getBuffer()->clearData();
+    m_free_states.lock();
+    m_free_states.getData().push_back(ris);
+    m_free_states.unlock();
+}   // freeRewindInfo
+
 // ----------------------------------------------------------------------------
 /** Merges thread-safe all data received from the network up to and including
  *  the current time (tick) with the current local rewind information.
@@ -197,9 +250,12 @@ void RewindQueue::addNetworkState(BareNetworkString *buffer, int ticks)
  *         performed.
  *  \param rewind_time[out] If needs_rewind is true, the time to which a rewind
  *         must be performed (at least). Otherwise undefined.
+ *  \param late_event_ticks[out] If not NULL, it is set to the latest time of
+ *         the events merged which are in the past of this simulation, or
+ *         left unchanged if there are none.
  */
 void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
-                                   int *rewind_ticks)
+                                   int *rewind_ticks, int *late_event_ticks)
 {
     *needs_rewind = false;
     m_network_events.lock();
@@ -236,7 +292,7 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
                       (*i)->isEvent() ? "event" : "state",
                       (*i)->getTicks(),
                       m_latest_confirmed_state_time);
-            delete *i;
+            freeRewindInfo(*i);
             i = m_network_events.getData().erase(i);
             continue;
         }
@@ -283,6 +339,11 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
                 *rewind_ticks = (*i)->getTicks();
         }   // if client and ticks < world_ticks
 
+        if (late_event_ticks && (*i)->isEvent() &&
+            (*i)->getTicks() < world_ticks &&
+            (*i)->getTicks() > *late_event_ticks)
+            *late_event_ticks = (*i)->getTicks();
+
         if ((*i)->isState() && (*i)->getTicks() > latest_confirmed_state &&
             (*i)->isConfirmed())
         {
@@ -333,7 +394,7 @@ void RewindQueue::cleanupOldRewindInfo(int ticks)
         (*i)->getTicks() < ticks)
     {
         if (m_current == i) next();
-        delete *i;
+        freeRewindInfo(*i);
         i = m_all_rewind_info.erase(i);
     }
 
@@ -342,6 +403,37 @@ void RewindQueue::cleanupOldRewindInfo(int ticks)
 
 }   // cleanupOldRewindInfo
 
+// ----------------------------------------------------------------------------
+/** Returns the confirmed state at the given time, or NULL if there is none.
+ *  \param ticks Time of the state.
+ */
+RewindInfoState* RewindQueue::findConfirmedState(int ticks)
+{
+    for (auto i = m_all_rewind_info.rbegin(); i != m_all_rewind_info.rend();
+         i++)
+    {
+        if ((*i)->getTicks() < ticks)
+            break;
+        if ((*i)->getTicks() == ticks && (*i)->isState() &&
+            (*i)->isConfirmed())
+            return dynamic_cast<RewindInfoState*>(*i);
+    }
+    return NULL;
+}   // findConfirmedState
+
+// ----------------------------------------------------------------------------
+/** Moves the current pointer past all RewindInfos before the given time
+ *  without replaying them. Used instead of a rewind if the states and
+ *  events received would not change the simulation.
+ *  \param ticks The current time.
+ */
+void RewindQueue::skipUntil(int ticks)
+{
+    while (m_current != m_all_rewind_info.end() &&
+           (*m_current)->getTicks() < ticks)
+        m_current++;
+}   // skipUntil
+
 // ----------------------------------------------------------------------------
 bool RewindQueue::isEmpty() const
 {
@@ -520,5 +612,39 @@ void RewindQueue::unitTesting()
     b2.mergeNetworkData(4, &needs_rewind, &rewind_ticks);
     assert((*b2.m_current)->getTicks() == 3);
 
-
+    // 4) States from the server are reused once they are not needed
+    //    anymore, so after the first few states no memory is allocated
+    //    for new states: neither new states nor larger buffers.
+    RewindQueue b3;
+    std::vector<uint8_t> state(300, 1);
+    for (int ticks = 1; ticks <= 100; ticks++)
+    {
+        RewindInfoState* ris = b3.allocateState(ticks);
+        assert(ris->getTicks() == ticks && ris->isConfirmed());
+        assert(ris->getRewinderUsing().empty());
+        if (ticks > 10)
+            assert(ris->getBuffer()->getBuffer().capacity() >= state.size());
+        ris->getRewinderUsing().push_back(0);
+        ris->getBuffer()->getBuffer().assign(state.begin(), state.end());
+        b3.addNetworkRewindInfo(ris);
+        b3.mergeNetworkData(ticks, &needs_rewind, &rewind_ticks);
+        if (ticks == 10)
+            assert(b3.m_state_allocations <= 2);
+    }
+    assert(b3.m_state_allocations <= 2);
+
+    // 5) Late events are reported, and skipping a rewind moves the current
+    //    pointer to the current time
+    RewindQueue b4;
+    b4.addNetworkState(NULL, 2);
+    b4.addNetworkEvent(dummy_rewinder.get(), NULL, 3);
+    b4.addNetworkEvent(dummy_rewinder.get(), NULL, 6);
+    b4.addNetworkEvent(dummy_rewinder.get(), NULL, 8);
+    int late_event_ticks = -1;
+    b4.mergeNetworkData(7, &needs_rewind, &rewind_ticks, &late_event_ticks);
+    assert(needs_rewind && rewind_ticks == 2 && late_event_ticks == 6);
+    assert(b4.findConfirmedState(2) != NULL);
+    assert(b4.findConfirmedState(3) == NULL);
+    b4.skipUntil(7);
+    assert(!b4.hasMoreRewindInfo());
 }   // unitTesting
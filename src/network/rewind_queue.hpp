@@ -22,12 +22,14 @@
 #include "utils/synchronised.hpp"
 
 #include <assert.h>
+#include <atomic>
 #include <list>
 #include <vector>
 
 class BareNetworkString;
 class EventRewinder;
 class RewindInfo;
+class RewindInfoState;
 class TimeStepInfo;
 
 /** \ingroup network
@@ -55,6 +57,15 @@ private:
     /** Time at which the latest confirmed state is at. */
     int m_latest_confirmed_state_time;
 
+    /** Confirmed states which are not needed anymore. They are reused for
+     *  new states from the server, so no memory needs to be allocated for
+     *  states once enough are available. */
+    Synchronised<std::vector<RewindInfoState*> > m_free_states;
+
+    /** Number of states allocated in allocateState, i.e. which could not
+     *  be reused. */
+    std::atomic<unsigned> m_state_allocations;
+
 
     void cleanupOldRewindInfo(int ticks);
 
@@ -70,6 +81,8 @@ public:
     void addNetworkEvent(EventRewinder *event_rewinder,
                          BareNetworkString *buffer, int ticks);
     void addNetworkState(BareNetworkString *buffer, int ticks);
+    RewindInfoState* allocateState(int ticks);
+    void freeRewindInfo(RewindInfo* ri);
     void addNetworkRewindInfo(RewindInfo* ri)
     {
         m_network_events.lock();
@@ -77,7 +90,9 @@ public:
         m_network_events.unlock();
     }
     void mergeNetworkData(int world_ticks,  bool *needs_rewind, 
-                          int *rewind_ticks);
+                          int *rewind_ticks, int *late_event_ticks = NULL);
+    RewindInfoState* findConfirmedState(int ticks);
+    void skipUntil(int ticks);
     void replayAllEvents(int ticks);
     bool isEmpty() const;
     bool hasMoreRewindInfo() const;
@@ -20,12 +20,14 @@
 #define HEADER_REWINDER_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <memory>
 #include <vector>
 
 class BareNetworkString;
+class Vec3;
 
 enum RewinderName : char
 {
@@ -56,8 +58,17 @@ private:
     */
     std::string m_unique_identity;
 
+    /** The network id of this rewinder, assigned by the RewindManager of
+     *  the server when it is added. It is used instead of the unique
+     *  identity in states sent to clients. */
+    uint16_t m_rewinder_id;
+
 public:
-    Rewinder(const std::string& ui = "")             { m_unique_identity = ui; }
+    Rewinder(const std::string& ui = "")
+    {
+        m_unique_identity = ui;
+        m_rewinder_id = 0;
+    }
 
     virtual ~Rewinder() {}
 
@@ -70,12 +81,15 @@ public:
      *  caused by the rewind (which is then visually smoothed over time). */
     virtual void computeError() = 0;
 
-    /** Provides a copy of the state of the object in one memory buffer.
-     *  The memory is managed by the RewindManager.
-     *  \param[out] ru The unique identity of rewinder writing to.
-     *  \return The address of the memory buffer with the state.
+    /** Writes the state of the object directly into the state buffer, which
+     *  already contains the states of other rewinders.
+     *  \param buffer The buffer to write the state to.
+     *  \param[out] ru The network id of rewinder writing to.
+     *  \return True if a state was written, if false anything written to
+     *          the buffer is discarded.
      */
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru) = 0;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<uint16_t>* ru) = 0;
 
     /** Called when an event needs to be undone. This is called while going
      *  backwards for rewinding - all stored events will get an 'undo' call.
@@ -99,6 +113,21 @@ public:
      */
     virtual void undoState(BareNetworkString *buffer) = 0;
 
+    // -------------------------------------------------------------------------
+    /** Returns the position used by the server to decide if the state of this
+     *  rewinder is relevant for a client, or NULL if it is always sent. */
+    virtual const Vec3* getRelevancePosition() const       { return nullptr; }
+    // -------------------------------------------------------------------------
+    /** Returns true if saveState on a client only depends on the current
+     *  values of this rewinder, so that it can be compared with a state
+     *  from the server to find out if the client predicted it correctly.
+     *  Rewinders with a relevance position must return true. */
+    virtual bool isStateComparable() const                   { return false; }
+    // -------------------------------------------------------------------------
+    /** Called on a client instead of restoreState if the server left this
+     *  rewinder out of a state (because it is far away from the karts of the
+     *  client), and no state was saved locally at that time either. */
+    virtual void restoreSkippedState() {}
     // -------------------------------------------------------------------------
     /** Nothing to do here. */
     virtual void reset() {}
@@ -112,6 +141,11 @@ public:
         return m_unique_identity;
     }
     // -------------------------------------------------------------------------
+    uint16_t getRewinderID() const                   { return m_rewinder_id; }
+    // -------------------------------------------------------------------------
+    /** Only used by the RewindManager when this rewinder is added. */
+    void setRewinderID(uint16_t id)                    { m_rewinder_id = id; }
+    // -------------------------------------------------------------------------
     bool rewinderAdd();
     // -------------------------------------------------------------------------
     template<typename T> std::shared_ptr<T> getShared()
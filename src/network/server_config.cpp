@@ -313,7 +313,18 @@ void loadServerLobbyFromConfig()
             frequency_in_config, stk_config->getPhysicsFPS());
         m_state_frequency.revertToDefaults();
     }
-    NetworkConfig::get()->setStateFrequency(m_state_frequency);
+    // With adaptive state rate states are saved at the maximum frequency,
+    // and each client is sent only some of them
+    if (m_adaptive_state_rate)
+    {
+        if (m_max_state_frequency < m_state_frequency)
+            m_max_state_frequency = m_state_frequency;
+        if (m_max_state_frequency > stk_config->getPhysicsFPS())
+            m_max_state_frequency = stk_config->getPhysicsFPS();
+        NetworkConfig::get()->setStateFrequency(m_max_state_frequency);
+    }
+    else
+        NetworkConfig::get()->setStateFrequency(m_state_frequency);
 
     if (m_player_reports_expired_days < 0.0f)
         m_player_reports_expired_days.revertToDefaults();
@@ -406,6 +417,10 @@ void loadServerLobbyFromConfig()
     // The extra server info has to be set before the server lobby is started
     if (server_lobby)
         server_lobby->requestStart();
+
+    if (STKProcess::getType() == PT_MAIN && m_extra_lobbies > 0 &&
+        STKHost::existHost())
+        STKHost::get()->createExtraLobbies(m_extra_lobbies);
 }   // loadServerLobbyFromConfig
 
 // ----------------------------------------------------------------------------
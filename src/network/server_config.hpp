@@ -99,6 +99,19 @@ namespace ServerConfig
         "set random-server-port to '1' in user config. STK will automatically "
         "switch to a random port if the port you specify fails to be bound."));
 
+    SERVER_CFG_PREFIX IntServerConfigParam m_extra_lobbies
+        SERVER_CFG_DEFAULT(IntServerConfigParam(0, "extra-lobbies",
+        "Number of extra lobbies (at most 7) started in this server process, "
+        "each one uses the next server port and the same settings as this "
+        "one. Karts, materials and meshes are loaded only once for all "
+        "lobbies."));
+
+    SERVER_CFG_PREFIX BoolServerConfigParam m_fast_simulation
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(false, "fast-simulation",
+        "Run the game ticks of the server as fast as possible instead of in "
+        "real time, only useful for offline simulation (e.g. races with AI "
+        "karts only), players cannot play on such a server."));
+
     SERVER_CFG_PREFIX IntServerConfigParam m_server_mode
         SERVER_CFG_DEFAULT(IntServerConfigParam(3, "server-mode",
         "Game mode in server, 0 is normal race (grand prix), "
@@ -357,6 +370,48 @@ namespace ServerConfig
         "more rewind, which clients with slow device may have problem playing "
         "this server, use the default value is recommended."));
 
+    SERVER_CFG_PREFIX BoolServerConfigParam m_delta_state
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(true,
+        "delta-state",
+        "Send states to supported clients as differences to the last state "
+        "acknowledged by them, which reduces the bandwidth used by the "
+        "server. A full state is sent if no acknowledged state is available."));
+
+    SERVER_CFG_PREFIX FloatServerConfigParam m_state_relevance_distance
+        SERVER_CFG_DEFAULT(FloatServerConfigParam(0.0f,
+        "state-relevance-distance",
+        "Karts and flyables further away (in meters) than this from all karts "
+        "of a supported client are only sent in every state-far-interval "
+        "state to it, which reduces the bandwidth used by the server with "
+        "many players (like in big soccer or free-for-all servers). 0 to "
+        "send everything in every state."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_state_far_interval
+        SERVER_CFG_DEFAULT(IntServerConfigParam(3, "state-far-interval",
+        "Far karts and flyables (see state-relevance-distance) are sent in "
+        "every this many states."));
+
+    SERVER_CFG_PREFIX BoolServerConfigParam m_adaptive_state_rate
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(false,
+        "adaptive-state-rate",
+        "Adapt the rate of states sent to each client to its ping, packet "
+        "loss and the upload speed of the server. Clients with a good "
+        "connection get up to max-state-frequency states per second, "
+        "congested clients get less states than state-frequency."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_max_state_frequency
+        SERVER_CFG_DEFAULT(IntServerConfigParam(30,
+        "max-state-frequency",
+        "Maximum number of states per second sent to a client if "
+        "adaptive-state-rate is enabled."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_state_upload_limit
+        SERVER_CFG_DEFAULT(IntServerConfigParam(0,
+        "state-upload-limit",
+        "Upload speed (in KBps) of the server above which the rate of states "
+        "is lowered for the clients using more than their share of it, if "
+        "adaptive-state-rate is enabled. 0 for no limit."));
+
     SERVER_CFG_PREFIX BoolServerConfigParam m_sql_management
         SERVER_CFG_DEFAULT(BoolServerConfigParam(false,
         "sql-management",
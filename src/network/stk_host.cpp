@@ -48,7 +48,13 @@
 #else
 #  include <arpa/inet.h>
 #  include <errno.h>
+#  include <fcntl.h>
+#  include <poll.h>
 #  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+#ifdef __linux__
+#  include <sys/eventfd.h>
 #endif
 
 #ifdef __MINGW32__
@@ -68,11 +74,28 @@
 #include <functional>
 #include <limits>
 #include <random>
+#include <sstream>
 #include <string>
 #include <utility>
 
 STKHost *STKHost::m_stk_host[PT_COUNT];
+std::atomic<unsigned> STKHost::m_extra_lobby_count(0);
 bool     STKHost::m_enable_console = false;
+const uint64_t STKHost::SEND_LATENCY_LIMITS[] =
+    { 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+
+namespace
+{
+    /** Incremented for each STKHost, so a cached queue index can't be used
+     *  with a later host. */
+    std::atomic<uint32_t> g_enet_cmd_generation(0);
+
+    /** The STKHost generation and the index of the enet command queue of
+     *  this thread in it, the index is MAX_ENET_COMMAND_QUEUES if the
+     *  thread has no own queue. */
+    thread_local uint32_t g_cached_enet_cmd_generation = 0;
+    thread_local unsigned g_cached_enet_cmd_queue = 0;
+}   // namespace
 
 std::shared_ptr<LobbyProtocol> STKHost::create(ChildLoop* cl)
 {
@@ -106,6 +129,60 @@ std::shared_ptr<LobbyProtocol> STKHost::create(ChildLoop* cl)
     return lp;
 }   // create
 
+// ----------------------------------------------------------------------------
+/** Starts extra server lobbies in this process, each one in its own
+ *  ChildLoop thread with its own set of singletons (race manager, world,
+ *  physics, network host...) and the next server port. Kart properties,
+ *  materials and meshes are loaded only once and shared read-only. The
+ *  lobbies are started one after another, so the additional resident
+ *  memory of each one can be logged.
+ *  \param count Number of lobbies besides the one of the main process.
+ */
+void STKHost::createExtraLobbies(unsigned count)
+{
+    assert(STKProcess::getType() == PT_MAIN);
+    if (count > MAX_CHILD_PROCESSES - 1)
+    {
+        Log::warn("STKHost", "Only %d extra lobbies are supported.",
+            MAX_CHILD_PROCESSES - 1);
+        count = MAX_CHILD_PROCESSES - 1;
+    }
+    const uint64_t process_memory = STKProcess::getResidentMemoryKB();
+    for (unsigned i = 0; i < count; i++)
+    {
+        ChildLoopConfig clc;
+        clc.m_lan_server = NetworkConfig::get()->isLAN();
+        clc.m_login_id = NetworkConfig::get()->getCurrentUserId();
+        clc.m_token = NetworkConfig::get()->getCurrentUserToken();
+        clc.m_server_ai = NetworkConfig::get()->getNumFixedAI();
+        clc.m_process_type = STKProcess::getExtraLobbyType(i);
+        clc.m_port_offset = (uint16_t)(i + 1);
+        const uint64_t before = STKProcess::getResidentMemoryKB();
+        ChildLoop* cl = new ChildLoop(clc);
+        m_extra_lobbies.push_back(cl);
+        m_extra_lobby_threads.push_back(std::thread(
+            std::bind(&ChildLoop::run, cl)));
+        m_extra_lobby_count.fetch_add(1);
+
+        // Wait until the lobby accepts players (or failed to start)
+        const uint64_t timeout = StkTime::getMonoTimeMs() + 10000;
+        while (cl->getPort() == 0 && !cl->isAborted() &&
+            !requestedShutdown() && StkTime::getMonoTimeMs() < timeout)
+            StkTime::sleep(1);
+        if (cl->getPort() == 0)
+        {
+            Log::error("STKHost", "Extra lobby %d failed to start.", i + 1);
+            continue;
+        }
+        const uint64_t after = STKProcess::getResidentMemoryKB();
+        Log::info("STKHost", "Extra lobby %d started on port %d, it uses "
+            "%d KB more resident memory (the process with one lobby, like a "
+            "separate server process, used %d KB).",
+            i + 1, cl->getPort(), (int)(after > before ? after - before : 0),
+            (int)process_memory);
+    }
+}   // createExtraLobbies
+
 // ============================================================================
 /** \class STKHost
  *  \brief Represents the local host. It is the main managing point for 
@@ -277,6 +354,8 @@ STKHost::STKHost(bool server)
         addr.port = ServerConfig::m_server_port;
         if (addr.port == 0 && !UserConfigParams::m_random_server_port)
             addr.port = stk_config->m_server_port;
+        if (addr.port != 0)
+            addr.port += NetworkConfig::get()->getServerPortOffset();
         // Reserve 1 peer to deliver full server message
         int peer_count = ServerConfig::m_server_max_players + 1;
         // 1 more peer to hold ai peer
@@ -321,6 +400,13 @@ void STKHost::init()
     m_network          = NULL;
     m_exit_timeout.store(std::numeric_limits<uint64_t>::max());
     m_client_ping.store(0);
+    m_enet_cmd_queue_count.store(0);
+    m_has_enet_cmd.store(false);
+    m_enet_cmd_generation = ++g_enet_cmd_generation;
+    m_enet_waiting.store(false);
+    for (auto& count : m_send_latency)
+        count.store(0);
+    createWakeup();
 
     // Start with initialising ENet
     // ============================
@@ -334,8 +420,9 @@ void STKHost::init()
     Network::openLog();  // Open packet log file
     ProtocolManager::createInstance();
 
-    // Optional: start the network console
-    if (m_enable_console)
+    // Optional: start the network console (only once for all lobbies of
+    // this process)
+    if (m_enable_console && STKProcess::getType() == PT_MAIN)
     {
         m_network_console = std::thread(std::bind(&NetworkConsole::mainLoop,
             this));
@@ -352,6 +439,8 @@ STKHost::~STKHost()
     // soon as possible
     if (m_client_loop)
         m_client_loop->abort();
+    for (ChildLoop* cl : m_extra_lobbies)
+        cl->abort();
 
     NetworkConfig::get()->clearActivePlayersForClient();
     requestShutdown();
@@ -362,10 +451,14 @@ STKHost::~STKHost()
     Network::closeLog();
     stopListening();
 
-    // Drop all unsent packets
-    for (auto& p : m_enet_cmd)
+    // Drop all unsent packets, shared packets are freed by their release
+    // command
+    std::vector<ENetCommand> commands;
+    takeEnetCommands(&commands);
+    for (auto& p : commands)
     {
-        if (std::get<3>(p) == ECT_SEND_PACKET)
+        if (std::get<3>(p) == ECT_SEND_PACKET ||
+            std::get<3>(p) == ECT_RELEASE_PACKET)
         {
             ENetPacket* packet = std::get<1>(p);
             enet_packet_destroy(packet);
@@ -373,11 +466,31 @@ STKHost::~STKHost()
     }
     delete m_network;
     enet_deinitialize();
+#ifndef WIN32
+    if (m_wakeup_fd[0] != -1)
+        close(m_wakeup_fd[0]);
+    if (m_wakeup_fd[1] != -1 && m_wakeup_fd[1] != m_wakeup_fd[0])
+        close(m_wakeup_fd[1]);
+#endif
+    uint32_t sent = 0;
+    for (auto& count : m_send_latency)
+        sent += count.load();
+    if (sent > 0)
+    {
+        Log::info("STKHost", "Send latency: %s",
+            getSendLatencyStats().c_str());
+    }
     if (m_client_loop)
     {
         m_client_loop_thread.join();
         delete m_client_loop;
     }
+    for (unsigned i = 0; i < m_extra_lobbies.size(); i++)
+    {
+        m_extra_lobby_threads[i].join();
+        delete m_extra_lobbies[i];
+    }
+    m_extra_lobby_count.fetch_sub((unsigned)m_extra_lobbies.size());
 }   // ~STKHost
 
 //-----------------------------------------------------------------------------
@@ -737,15 +850,14 @@ void STKHost::setPublicAddress(short family)
 */
 void STKHost::disconnectAllPeers(bool timeout_waiting)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    if (!m_peers.empty() && timeout_waiting)
+    std::vector<std::shared_ptr<STKPeer> > peers = m_peers.clear();
+    if (!peers.empty() && timeout_waiting)
     {
-        for (auto peer : m_peers)
-            peer.second->disconnect();
+        for (auto peer : peers)
+            peer->disconnect();
         // Wait for at most 2 seconds for disconnect event to be generated
         m_exit_timeout.store(StkTime::getMonoTimeMs() + 2000);
     }
-    m_peers.clear();
 }   // disconnectAllPeers
 
 //-----------------------------------------------------------------------------
@@ -779,6 +891,7 @@ void STKHost::stopListening()
 {
     if (m_exit_timeout.load() == std::numeric_limits<uint64_t>::max())
         m_exit_timeout.store(0);
+    wakeUp();
     if (m_listening_thread.joinable())
         m_listening_thread.join();
 }   // stopListening
@@ -793,8 +906,8 @@ void STKHost::stopListening()
 void STKHost::mainLoop(ProcessType pt)
 {
     std::string thread_name = "STKHost";
-    if (pt == PT_CHILD)
-        thread_name += "_child";
+    if (pt != PT_MAIN)
+        thread_name += "_child" + StringUtils::toString(pt);
     VS::setThreadName(thread_name.c_str());
 
     STKProcess::init(pt);
@@ -824,6 +937,8 @@ void STKHost::mainLoop(ProcessType pt)
     uint64_t last_update_speed_time = StkTime::getMonoTimeMs();
     uint64_t last_ping_time_update_for_client = StkTime::getMonoTimeMs();
     std::map<std::string, uint64_t> ctp;
+    // Reused in each loop to avoid allocations
+    std::vector<ENetCommand> copied_list;
     while (m_exit_timeout.load() > StkTime::getMonoTimeMs())
     {
         // Clear outdated connect to peer list every 15 seconds
@@ -844,6 +959,19 @@ void STKHost::mainLoop(ProcessType pt)
                 getNetwork()->getENetHost()->totalReceivedData);
             getNetwork()->getENetHost()->totalSentData = 0;
             getNetwork()->getENetHost()->totalReceivedData = 0;
+            if (is_server)
+            {
+                // Also during the race, for the state rate of each peer
+                std::shared_ptr<const PeerRegistry::Snapshot> peers =
+                    m_peers.get();
+                for (unsigned i = 0; i < peers->size(); i++)
+                {
+                    auto& p = peers->m_peers[i];
+                    p->setRoundTripTime(
+                        peers->m_enet_peers[i]->roundTripTime);
+                    p->setPacketLoss(peers->m_enet_peers[i]->packetLoss);
+                }
+            }
         }
 
         auto sl = LobbyProtocol::get<ServerLobby>();
@@ -862,7 +990,8 @@ void STKHost::mainLoop(ProcessType pt)
 
         if (is_server)
         {
-            std::unique_lock<std::mutex> peer_lock(m_peers_mutex);
+            std::shared_ptr<const PeerRegistry::Snapshot> peers =
+                m_peers.get();
             const float timeout = ServerConfig::m_validation_timeout;
             bool need_ping = false;
             if (sl && (!sl->isRacing() || sl->allowJoinedPlayersWaiting()) &&
@@ -879,52 +1008,51 @@ void STKHost::mainLoop(ProcessType pt)
             if (need_ping)
             {
                 m_peer_pings.getData().clear();
-                for (auto& p : m_peers)
+                for (unsigned i = 0; i < peers->size(); i++)
                 {
-                    m_peer_pings.getData()[p.second->getHostId()] =
-                        p.second->getPing();
+                    auto& p = peers->m_peers[i];
+                    m_peer_pings.getData()[p->getHostId()] = p->getPing();
                     // Set packet loss before enet command, so if the peer is
                     // disconnected later the loss won't be cleared
-                    p.second->setPacketLoss(p.first->packetLoss);
-                    const unsigned ap = p.second->getAveragePing();
+                    p->setPacketLoss(peers->m_enet_peers[i]->packetLoss);
+                    const unsigned ap = p->getAveragePing();
                     const unsigned max_ping = ServerConfig::m_max_ping;
-                    if (p.second->isValidated() &&
-                        p.second->getConnectedTime() > 5.0f && ap > max_ping)
+                    if (p->isValidated() &&
+                        p->getConnectedTime() > 5.0f && ap > max_ping)
                     {
                         std::string player_name;
-                        if (!p.second->getPlayerProfiles().empty())
+                        if (!p->getPlayerProfiles().empty())
                         {
                             player_name = StringUtils::wideToUtf8
-                                (p.second->getPlayerProfiles()[0]->getName());
+                                (p->getPlayerProfiles()[0]->getName());
                         }
                         const bool peer_not_in_game =
                             sl->getCurrentState() <= ServerLobby::SELECTING
-                            || p.second->isWaitingForGame();
+                            || p->isWaitingForGame();
                         if (ServerConfig::m_kick_high_ping_players &&
-                            !p.second->isDisconnected() && peer_not_in_game)
+                            !p->isDisconnected() && peer_not_in_game)
                         {
                             Log::info("STKHost", "%s %s with ping %d is higher"
                                 " than %d ms when not in game, kick.",
-                                p.second->getAddress().toString().c_str(),
+                                p->getAddress().toString().c_str(),
                                 player_name.c_str(), ap, max_ping);
-                            p.second->setWarnedForHighPing(true);
-                            p.second->setDisconnected(true);
-                            std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
-                            m_enet_cmd.emplace_back(p.second->getENetPeer(),
+                            p->setWarnedForHighPing(true);
+                            p->setDisconnected(true);
+                            addEnetCommand(p->getENetPeer(),
                                 (ENetPacket*)NULL, PDI_KICK_HIGH_PING,
-                                ECT_DISCONNECT, p.first->address);
+                                ECT_DISCONNECT, peers->m_enet_peers[i]->address);
                         }
-                        else if (!p.second->hasWarnedForHighPing())
+                        else if (!p->hasWarnedForHighPing())
                         {
                             Log::info("STKHost", "%s %s with ping %d is higher"
                                 " than %d ms.",
-                                p.second->getAddress().toString().c_str(),
+                                p->getAddress().toString().c_str(),
                                 player_name.c_str(), ap, max_ping);
-                            p.second->setWarnedForHighPing(true);
+                            p->setWarnedForHighPing(true);
                             NetworkString msg(PROTOCOL_LOBBY_ROOM);
                             msg.setSynchronous(true);
                             msg.addUInt8(LobbyProtocol::LE_BAD_CONNECTION);
-                            p.second->sendPacket(&msg, /*reliable*/true);
+                            p->sendPacket(&msg, /*reliable*/true);
                         }
                     }
                 }
@@ -951,11 +1079,14 @@ void STKHost::mainLoop(ProcessType pt)
                     g_ping_packet.end());
             }
 
-            for (auto it = m_peers.begin(); it != m_peers.end();)
+            std::vector<ENetPeer*> timed_out_peers;
+            for (unsigned i = 0; i < peers->size(); i++)
             {
+                ENetPeer* enet_peer = peers->m_enet_peers[i];
+                STKPeer* peer = peers->m_peers[i].get();
                 if (!ping_packet.getBuffer().empty() &&
                     (!sl->allowJoinedPlayersWaiting() ||
-                    !sl->isRacing() || it->second->isWaitingForGame()))
+                    !sl->isRacing() || peer->isWaitingForGame()))
                 {
                     ENetPacket* packet = enet_packet_create(ping_packet.getData(),
                         ping_packet.getTotalSize(), ENET_PACKET_FLAG_RELIABLE);
@@ -965,7 +1096,7 @@ void STKHost::mainLoop(ProcessType pt)
                         // prevent leaking, this can only be done if the packet
                         // is copied instead of shared sending to all peers
                         if (enet_peer_send(
-                            it->first, EVENT_CHANNEL_UNENCRYPTED, packet) < 0)
+                            enet_peer, EVENT_CHANNEL_UNENCRYPTED, packet) < 0)
                         {
                             enet_packet_destroy(packet);
                         }
@@ -974,37 +1105,36 @@ void STKHost::mainLoop(ProcessType pt)
 
                 // Remove peer which has not been validated after a specific time
                 // It is validated when the first connection request has finished
-                if (!it->second->isAIPeer() &&
-                    !it->second->isValidated() &&
-                    it->second->getConnectedTime() > timeout)
+                if (!peer->isAIPeer() && !peer->isValidated() &&
+                    peer->getConnectedTime() > timeout)
                 {
                     Log::info("STKHost", "%s has not been validated for more"
                         " than %f seconds, disconnect it by force.",
-                        it->second->getAddress().toString().c_str(),
-                        timeout);
+                        peer->getAddress().toString().c_str(), timeout);
                     enet_host_flush(host);
-                    enet_peer_reset(it->first);
-                    it = m_peers.erase(it);
-                }
-                else
-                {
-                    it++;
+                    enet_peer_reset(enet_peer);
+                    timed_out_peers.push_back(enet_peer);
                 }
             }
-            peer_lock.unlock();
+            m_peers.remove(timed_out_peers);
         }
 
-        std::vector<std::tuple<ENetPeer*, ENetPacket*, uint32_t,
-            ENetCommandType, ENetAddress> > copied_list;
-        std::unique_lock<std::mutex> lock(m_enet_cmd_mutex);
-        std::swap(copied_list, m_enet_cmd);
-        lock.unlock();
+        copied_list.clear();
+        takeEnetCommands(&copied_list);
         for (auto& p : copied_list)
         {
             ENetPeer* peer = std::get<0>(p);
+            ENetPacket* packet = std::get<1>(p);
+            if (std::get<3>(p) == ECT_RELEASE_PACKET)
+            {
+                // All peers sharing the packet have queued it (or failed to),
+                // drop the reference of sendSharedPacket
+                if (--packet->referenceCount == 0)
+                    enet_packet_destroy(packet);
+                continue;
+            }
             ENetAddress& ea = std::get<4>(p);
             ENetAddress& ea_peer_now = peer->address;
-            ENetPacket* packet = std::get<1>(p);
             // Enet will reuse a disconnected peer so we check here to avoid
             // sending to wrong peer
             if (peer->state != ENET_PEER_STATE_CONNECTED ||
@@ -1015,7 +1145,7 @@ void STKHost::mainLoop(ProcessType pt)
                 (ea_peer_now.host != ea.host && ea_peer_now.port != ea.port))
 #endif
             {
-                if (packet != NULL)
+                if (packet != NULL && std::get<3>(p) != ECT_SEND_SHARED_PACKET)
                     enet_packet_destroy(packet);
                 continue;
             }
@@ -1033,6 +1163,12 @@ void STKHost::mainLoop(ProcessType pt)
                 }
                 break;
             }
+            case ECT_SEND_SHARED_PACKET:
+                // The packet is freed by enet after the last peer sent it
+                enet_peer_send(peer, (uint8_t)std::get<2>(p), packet);
+                break;
+            case ECT_RELEASE_PACKET:
+                break;
             case ECT_DISCONNECT:
                 enet_peer_disconnect(peer, std::get<2>(p));
                 break;
@@ -1041,14 +1177,15 @@ void STKHost::mainLoop(ProcessType pt)
                 enet_host_flush(host);
                 enet_peer_reset(peer);
                 // Remove the stk peer of it
-                std::lock_guard<std::mutex> lock(m_peers_mutex);
-                m_peers.erase(peer);
+                m_peers.remove(peer);
                 break;
             }
         }
 
         bool need_ping_update = false;
-        while (enet_host_service(host, &event, 10) != 0)
+        // Handle all datagrams received so far without waiting, the wait
+        // is done below (and ends when a command is added)
+        while (enet_host_service(host, &event, 0) > 0)
         {
             auto lp = LobbyProtocol::get<LobbyProtocol>();
             if (!is_server &&
@@ -1078,10 +1215,7 @@ void STKHost::mainLoop(ProcessType pt)
                 // ++m_next_unique_host_id for unique host id for database
                 auto stk_peer = std::make_shared<STKPeer>
                     (event.peer, this, ++m_next_unique_host_id);
-                std::unique_lock<std::mutex> lock(m_peers_mutex);
-                m_peers[event.peer] = stk_peer;
-                size_t new_peer_count = m_peers.size();
-                lock.unlock();
+                size_t new_peer_count = m_peers.add(event.peer, stk_peer);
                 stk_event = new Event(&event, stk_peer);
                 Log::info("STKHost", "%s has just connected. There are "
                     "now %u peers.", stk_peer->getAddress().toString().c_str(),
@@ -1104,25 +1238,21 @@ void STKHost::mainLoop(ProcessType pt)
                 // Use the previous stk peer so protocol can see the network
                 // profile and handle it for disconnection
                 std::string addr;
-                std::lock_guard<std::mutex> lock(m_peers_mutex);
-                size_t new_peer_count = m_peers.size();
-                if (m_peers.find(event.peer) != m_peers.end())
+                size_t new_peer_count = 0;
+                std::shared_ptr<STKPeer> peer =
+                    m_peers.remove(event.peer, &new_peer_count);
+                if (peer)
                 {
-                    std::shared_ptr<STKPeer>& peer = m_peers.at(event.peer);
                     addr = peer->getAddress().toString();
                     stk_event = new Event(&event, peer);
-                    m_peers.erase(event.peer);
-                    new_peer_count = m_peers.size();
                 }
                 Log::info("STKHost", "%s has just disconnected. There are "
                     "now %u peers.", addr.c_str(), new_peer_count);
             }   // ENET_EVENT_TYPE_DISCONNECT
 
-            std::unique_lock<std::mutex> lock(m_peers_mutex);
-            if (!stk_event && m_peers.find(event.peer) != m_peers.end())
+            std::shared_ptr<STKPeer> peer;
+            if (!stk_event && (peer = m_peers.get()->findPeer(event.peer)))
             {
-                std::shared_ptr<STKPeer> peer = m_peers.at(event.peer);
-                lock.unlock();
                 if (isPingPacket(event.packet->data, event.packet->dataLength))
                 {
                     if (!is_server)
@@ -1218,6 +1348,13 @@ void STKHost::mainLoop(ProcessType pt)
             else
                 delete stk_event;
         }   // while enet_host_service
+
+        // Send the packets of all commands (and acknowledgements of the
+        // datagrams received) at once
+        enet_host_flush(host);
+        addSendLatency(copied_list);
+        if (m_exit_timeout.load() > StkTime::getMonoTimeMs())
+            waitForNetwork(host, 10);
     }   // while m_exit_timeout.load() > StkTime::getMonoTimeMs()
     delete direct_socket;
     Log::info("STKHost", "Listening has been stopped.");
@@ -1307,14 +1444,16 @@ void STKHost::handleDirectSocketRequest(Network* direct_socket,
  */
 bool STKHost::peerExists(const SocketAddress& peer)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    if (peers->findPeerByAddress(peer))
+        return true;
+    if (!peer.isPublicAddressLocalhost())
+        return false;
+    // Any localhost address with the same port is the same peer
+    for (auto& stk_peer : peers->m_peers)
     {
-        auto stk_peer = p.second;
-        if (stk_peer->getAddress() == peer ||
-            ((stk_peer->getAddress().isPublicAddressLocalhost() &&
-            peer.isPublicAddressLocalhost()) &&
-            stk_peer->getAddress().getPort() == peer.getPort()))
+        if (stk_peer->getAddress().isPublicAddressLocalhost() &&
+            stk_peer->getAddress().getPort() == peer.getPort())
             return true;
     }
     return false;
@@ -1327,9 +1466,10 @@ bool STKHost::peerExists(const SocketAddress& peer)
 std::shared_ptr<STKPeer> STKHost::getServerPeerForClient() const
 {
     assert(NetworkConfig::get()->isClient());
-    if (m_peers.size() != 1)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    if (peers->size() != 1)
         return nullptr;
-    return m_peers.begin()->second;
+    return peers->m_peers[0];
 }   // getServerPeerForClient
 
 //-----------------------------------------------------------------------------
@@ -1339,11 +1479,11 @@ std::shared_ptr<STKPeer> STKHost::getServerPeerForClient() const
  */
 void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& p : peers->m_peers)
     {
-        if (p.second->isValidated())
-            p.second->sendPacket(data, reliable);
+        if (p->isValidated())
+            p->sendPacket(data, reliable);
     }
 }   // sendPacketToAllPeersInServer
 
@@ -1354,14 +1494,256 @@ void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
  */
 void STKHost::sendPacketToAllPeers(NetworkString *data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& p : peers->m_peers)
     {
-        if (p.second->isValidated() && !p.second->isWaitingForGame())
-            p.second->sendPacket(data, reliable);
+        if (p->isValidated() && !p->isWaitingForGame())
+            p->sendPacket(data, reliable);
     }
 }   // sendPacketToAllPeers
 
+//-----------------------------------------------------------------------------
+/** Sends the same enet packet to several peers without copying it, which
+ *  allows the packet to be created (and encrypted with a shared key) only
+ *  once. The packet is freed by enet when it was sent to all peers.
+ *  \param peers Peers to send the packet to.
+ *  \param packet The packet to send, it must not be used after this call.
+ *  \param channel The enet channel to use.
+ */
+void STKHost::sendSharedPacket(const std::vector<STKPeer*>& peers,
+                               ENetPacket* packet, uint32_t channel)
+{
+    // Keep the packet alive until the enet thread has queued it for all
+    // peers, enet_peer_send would otherwise free it after the first peer
+    // sent it. The reference count is only changed by the enet thread
+    // later, which takes the commands of this thread after this one.
+    packet->referenceCount++;
+    for (STKPeer* peer : peers)
+    {
+        if (peer->isDisconnected())
+            continue;
+        addEnetCommand(peer->getENetPeer(), packet, channel,
+            ECT_SEND_SHARED_PACKET, peer->getENetAddress());
+    }
+    addEnetCommand((ENetPeer*)NULL, packet, 0, ECT_RELEASE_PACKET,
+        ENetAddress());
+}   // sendSharedPacket
+
+//-----------------------------------------------------------------------------
+/** Adds a command which is run by the listening thread (which is the only
+ *  thread using enet functions). Each thread uses its own lock free queue,
+ *  the queue is created the first time a thread adds a command. If all
+ *  queues are used, the commands are added to a list protected by a mutex.
+ */
+void STKHost::addEnetCommand(ENetPeer* peer, ENetPacket* packet, uint32_t i,
+                             ENetCommandType ect, ENetAddress ea)
+{
+    if (g_cached_enet_cmd_generation != m_enet_cmd_generation)
+    {
+        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+        const std::thread::id id = std::this_thread::get_id();
+        const unsigned count = m_enet_cmd_queue_count.load();
+        unsigned index = 0;
+        while (index < count && m_enet_cmd_queues[index]->m_thread != id)
+            index++;
+        if (index == count && count < MAX_ENET_COMMAND_QUEUES)
+        {
+            m_enet_cmd_queues[index].reset(new ENetCommandQueue());
+            m_enet_cmd_queues[index]->m_thread = id;
+            m_enet_cmd_queue_count.store(count + 1);
+        }
+        g_cached_enet_cmd_generation = m_enet_cmd_generation;
+        g_cached_enet_cmd_queue = index;
+    }
+
+    const uint64_t now = StkTime::getMonoTimeUs();
+    if (g_cached_enet_cmd_queue < MAX_ENET_COMMAND_QUEUES)
+    {
+        m_enet_cmd_queues[g_cached_enet_cmd_queue]->m_queue.push(
+            ENetCommand(peer, packet, i, ect, ea, now));
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+        m_enet_cmd.emplace_back(peer, packet, i, ect, ea, now);
+        m_has_enet_cmd.store(true);
+    }
+    // Pairs with the fence in waitForNetwork: either the listening thread
+    // sees the command before waiting, or it is woken up here
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_enet_waiting.load())
+        wakeUp();
+}   // addEnetCommand
+
+//-----------------------------------------------------------------------------
+/** Listening thread only: appends all commands added by other threads to
+ *  the list. The commands of each thread are kept in order.
+ */
+void STKHost::takeEnetCommands(std::vector<ENetCommand>* commands)
+{
+    const unsigned count = m_enet_cmd_queue_count.load();
+    for (unsigned i = 0; i < count; i++)
+    {
+        ENetCommand command;
+        while (m_enet_cmd_queues[i]->m_queue.pop(&command))
+            commands->push_back(command);
+    }
+    if (m_has_enet_cmd.load())
+    {
+        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+        commands->insert(commands->end(), m_enet_cmd.begin(),
+            m_enet_cmd.end());
+        m_enet_cmd.clear();
+        m_has_enet_cmd.store(false);
+    }
+}   // takeEnetCommands
+
+//-----------------------------------------------------------------------------
+/** Listening thread only: returns true if there are enet commands which
+ *  were not taken yet.
+ */
+bool STKHost::hasEnetCommands() const
+{
+    const unsigned count = m_enet_cmd_queue_count.load();
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!m_enet_cmd_queues[i]->m_queue.empty())
+            return true;
+    }
+    return m_has_enet_cmd.load();
+}   // hasEnetCommands
+
+//-----------------------------------------------------------------------------
+/** Creates the eventfd (or pipe) used to wake up the listening thread. */
+void STKHost::createWakeup()
+{
+    m_wakeup_fd[0] = m_wakeup_fd[1] = -1;
+#if defined(__linux__)
+    m_wakeup_fd[0] = m_wakeup_fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif !defined(WIN32)
+    if (pipe(m_wakeup_fd) == 0)
+    {
+        for (int fd : m_wakeup_fd)
+        {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    else
+        m_wakeup_fd[0] = m_wakeup_fd[1] = -1;
+#endif
+    if (m_wakeup_fd[0] == -1)
+    {
+        Log::info("STKHost", "No wake up of the listening thread available, "
+            "polling for enet commands.");
+    }
+}   // createWakeup
+
+//-----------------------------------------------------------------------------
+/** Wakes up the listening thread if it is waiting for network data. */
+void STKHost::wakeUp()
+{
+#ifndef WIN32
+    if (m_wakeup_fd[1] == -1)
+        return;
+    uint64_t one = 1;
+    // The eventfd takes 8 bytes, for a pipe any data is fine. If the pipe is
+    // full the listening thread will wake up anyway.
+    ssize_t written = write(m_wakeup_fd[1], &one, sizeof(one));
+    (void)written;
+#endif
+}   // wakeUp
+
+//-----------------------------------------------------------------------------
+/** Listening thread only: waits until a datagram is received, an enet
+ *  command is added, or the timeout is over. The timeout is needed for the
+ *  timers of enet (e.g. resending reliable packets) and the periodic tasks
+ *  of the listening thread.
+ *  \param host The enet host.
+ *  \param timeout_ms Maximum time to wait.
+ */
+void STKHost::waitForNetwork(ENetHost* host, int timeout_ms)
+{
+#ifndef WIN32
+    if (m_wakeup_fd[0] != -1)
+    {
+        m_enet_waiting.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (hasEnetCommands())
+        {
+            m_enet_waiting.store(false);
+            return;
+        }
+        struct pollfd fds[2];
+        fds[0].fd = host->socket;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = m_wakeup_fd[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        poll(fds, 2, timeout_ms);
+        m_enet_waiting.store(false);
+        if (fds[1].revents & POLLIN)
+        {
+            uint64_t value[8];
+            while (read(m_wakeup_fd[0], value, sizeof(value)) > 0)
+            {
+            }
+        }
+        return;
+    }
+#endif
+    // Without a way to wake up, check for new commands frequently
+    enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+    enet_socket_wait(host->socket, &condition,
+        std::min(timeout_ms, 2));
+}   // waitForNetwork
+
+//-----------------------------------------------------------------------------
+/** Listening thread only: adds the time from adding the packets of the
+ *  commands to sending them to the socket to the histogram.
+ *  \param commands The commands handled before the last enet_host_flush.
+ */
+void STKHost::addSendLatency(const std::vector<ENetCommand>& commands)
+{
+    if (commands.empty())
+        return;
+    const uint64_t now = StkTime::getMonoTimeUs();
+    for (const ENetCommand& command : commands)
+    {
+        if (std::get<3>(command) != ECT_SEND_PACKET &&
+            std::get<3>(command) != ECT_SEND_SHARED_PACKET)
+            continue;
+        const uint64_t added = std::get<5>(command);
+        const uint64_t latency = now > added ? now - added : 0;
+        unsigned bucket = 0;
+        while (bucket < SEND_LATENCY_BUCKETS - 1 &&
+               latency >= SEND_LATENCY_LIMITS[bucket])
+            bucket++;
+        m_send_latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+}   // addSendLatency
+
+//-----------------------------------------------------------------------------
+/** Returns the histogram of the time between adding a packet and sending it
+ *  to the socket as text, e.g. for the network console.
+ */
+std::string STKHost::getSendLatencyStats() const
+{
+    std::ostringstream oss;
+    for (unsigned i = 0; i < SEND_LATENCY_BUCKETS; i++)
+    {
+        if (i > 0)
+            oss << ", ";
+        if (i < SEND_LATENCY_BUCKETS - 1)
+            oss << "<" << SEND_LATENCY_LIMITS[i] << "us: ";
+        else
+            oss << ">=" << SEND_LATENCY_LIMITS[i - 1] << "us: ";
+        oss << m_send_latency[i].load(std::memory_order_relaxed);
+    }
+    return oss.str();
+}   // getSendLatencyStats
+
 //-----------------------------------------------------------------------------
 /** Sends data to all validated peers except the specified currently in game
  *  \param peer Peer which will not receive the message.
@@ -1371,12 +1753,12 @@ void STKHost::sendPacketToAllPeers(NetworkString *data, bool reliable)
 void STKHost::sendPacketExcept(STKPeer* peer, NetworkString *data,
                                bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& p : peers->m_peers)
     {
-        STKPeer* stk_peer = p.second.get();
-        if (!stk_peer->isSamePeer(peer) && p.second->isValidated() &&
-            !p.second->isWaitingForGame())
+        STKPeer* stk_peer = p.get();
+        if (!stk_peer->isSamePeer(peer) && stk_peer->isValidated() &&
+            !stk_peer->isWaitingForGame())
         {
             stk_peer->sendPacket(data, reliable);
         }
@@ -1392,10 +1774,10 @@ void STKHost::sendPacketExcept(STKPeer* peer, NetworkString *data,
 void STKHost::sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
                                        NetworkString* data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& p : peers->m_peers)
     {
-        STKPeer* stk_peer = p.second.get();
+        STKPeer* stk_peer = p.get();
         if (!stk_peer->isValidated())
             continue;
         if (predicate(stk_peer))
@@ -1407,11 +1789,11 @@ void STKHost::sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
 /** Sends a message from a client to the server. */
 void STKHost::sendToServer(NetworkString *data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    if (m_peers.empty())
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    if (peers->empty())
         return;
     assert(NetworkConfig::get()->isClient());
-    m_peers.begin()->second->sendPacket(data, reliable);
+    peers->m_peers[0]->sendPacket(data, reliable);
 }   // sendToServer
 
 //-----------------------------------------------------------------------------
@@ -1419,17 +1801,16 @@ std::vector<std::shared_ptr<NetworkPlayerProfile> >
     STKHost::getAllPlayerProfiles() const
 {
     std::vector<std::shared_ptr<NetworkPlayerProfile> > p;
-    std::unique_lock<std::mutex> lock(m_peers_mutex);
-    for (auto& peer : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& peer : peers->m_peers)
     {
-        if (peer.second->isDisconnected() || !peer.second->isValidated())
+        if (peer->isDisconnected() || !peer->isValidated())
             continue;
-        if (ServerConfig::m_ai_handling && peer.second->isAIPeer())
+        if (ServerConfig::m_ai_handling && peer->isAIPeer())
             continue;
-        auto peer_profile = peer.second->getPlayerProfiles();
+        auto& peer_profile = peer->getPlayerProfiles();
         p.insert(p.end(), peer_profile.begin(), peer_profile.end());
     }
-    lock.unlock();
     return p;
 }   // getAllPlayerProfiles
 
@@ -1437,43 +1818,47 @@ std::vector<std::shared_ptr<NetworkPlayerProfile> >
 std::set<uint32_t> STKHost::getAllPlayerOnlineIds() const
 {
     std::set<uint32_t> online_ids;
-    std::unique_lock<std::mutex> lock(m_peers_mutex);
-    for (auto& peer : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& peer : peers->m_peers)
     {
-        if (peer.second->isDisconnected() || !peer.second->isValidated())
+        if (peer->isDisconnected() || !peer->isValidated())
             continue;
-        if (!peer.second->getPlayerProfiles().empty())
-        {
-            online_ids.insert(
-                peer.second->getPlayerProfiles()[0]->getOnlineId());
-        }
+        if (!peer->getPlayerProfiles().empty())
+            online_ids.insert(peer->getPlayerProfiles()[0]->getOnlineId());
     }
-    lock.unlock();
     return online_ids;
 }   // getAllPlayerOnlineIds
 
+//-----------------------------------------------------------------------------
+/** Returns true if the first player of a connected and validated peer has
+ *  this online id, same as searching getAllPlayerOnlineIds but with the
+ *  online id index. */
+bool STKHost::hasPlayerWithOnlineId(uint32_t online_id) const
+{
+    for (auto& peer : m_peers.get()->findPeersByOnlineId(online_id))
+    {
+        if (!peer->isDisconnected() && peer->isValidated())
+            return true;
+    }
+    return false;
+}   // hasPlayerWithOnlineId
+
 //-----------------------------------------------------------------------------
 std::shared_ptr<STKPeer> STKHost::findPeerByHostId(uint32_t id) const
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    auto ret = std::find_if(m_peers.begin(), m_peers.end(),
-        [id](const std::pair<ENetPeer*, std::shared_ptr<STKPeer> >& p)
-        {
-            return p.second->getHostId() == id;
-        });
-    return ret != m_peers.end() ? ret->second : nullptr;
+    return m_peers.get()->findPeerByHostId(id);
 }   // findPeerByHostId
 
 //-----------------------------------------------------------------------------
 std::shared_ptr<STKPeer>
     STKHost::findPeerByName(const core::stringw& name) const
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    auto ret = std::find_if(m_peers.begin(), m_peers.end(),
-        [name](const std::pair<ENetPeer*, std::shared_ptr<STKPeer> >& p)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    auto ret = std::find_if(peers->m_peers.begin(), peers->m_peers.end(),
+        [name](const std::shared_ptr<STKPeer>& p)
         {
             bool found = false;
-            for (auto& profile : p.second->getPlayerProfiles())
+            for (auto& profile : p->getPlayerProfiles())
             {
                 if (profile->getName() == name)
                 {
@@ -1483,7 +1868,7 @@ std::shared_ptr<STKPeer>
             }
             return found;
         });
-    return ret != m_peers.end() ? ret->second : nullptr;
+    return ret != peers->m_peers.end() ? *ret : nullptr;
 }   // findPeerByName
 
 //-----------------------------------------------------------------------------
@@ -1500,7 +1885,7 @@ void STKHost::initClientNetwork(ENetEvent& event, Network* new_network)
     auto stk_peer = std::make_shared<STKPeer>(event.peer, this,
         m_next_unique_host_id++);
     stk_peer->setValidated(true);
-    m_peers[event.peer] = stk_peer;
+    m_peers.add(event.peer, stk_peer);
     auto pm = ProtocolManager::lock();
     if (pm && !pm->isExiting())
         pm->propagateEvent(new Event(&event, stk_peer));
@@ -1530,10 +1915,9 @@ std::vector<std::shared_ptr<NetworkPlayerProfile> >
     STKHost::getPlayersForNewGame(bool* has_always_on_spectators) const
 {
     std::vector<std::shared_ptr<NetworkPlayerProfile> > players;
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto& p : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& stk_peer : peers->m_peers)
     {
-        auto& stk_peer = p.second;
         // Handle always spectate for peer
         if (has_always_on_spectators && stk_peer->alwaysSpectate())
         {
@@ -1564,10 +1948,9 @@ void STKHost::updatePlayers(unsigned* ingame, unsigned* waiting,
     uint32_t ingame_players = 0;
     uint32_t waiting_players = 0;
     uint32_t total_players = 0;
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto& p : m_peers)
+    std::shared_ptr<const PeerRegistry::Snapshot> peers = m_peers.get();
+    for (auto& stk_peer : peers->m_peers)
     {
-        auto& stk_peer = p.second;
         if (!stk_peer->isValidated())
             continue;
         if (ServerConfig::m_ai_handling && stk_peer->isAIPeer())
@@ -22,6 +22,8 @@
 #ifndef STK_HOST_HPP
 #define STK_HOST_HPP
 
+#include "network/peer_registry.hpp"
+#include "utils/spsc_queue.hpp"
 #include "utils/stk_process.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/time.hpp"
@@ -34,6 +36,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <enet/enet.h>
 
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <cstring>
@@ -66,7 +69,9 @@ enum ENetCommandType : unsigned int
 {
     ECT_SEND_PACKET = 0,
     ECT_DISCONNECT = 1,
-    ECT_RESET = 2
+    ECT_RESET = 2,
+    ECT_SEND_SHARED_PACKET = 3,
+    ECT_RELEASE_PACKET = 4
 };
 
 class STKHost
@@ -80,26 +85,80 @@ private:
 
     std::thread m_client_loop_thread;
 
+    /** Extra server lobbies of this process (see extra-lobbies in server
+     *  config), each one runs in its own ChildLoop thread and port. */
+    std::vector<ChildLoop*> m_extra_lobbies;
+
+    std::vector<std::thread> m_extra_lobby_threads;
+
+    /** Number of extra server lobbies running in this process. */
+    static std::atomic<unsigned> m_extra_lobby_count;
+
     /** ENet host interfacing sockets. */
     Network* m_network;
 
     /** Network console thread */
     std::thread m_network_console;
 
-    /** Make sure the removing or adding a peer is thread-safe. */
-    mutable std::mutex m_peers_mutex;
+    typedef std::tuple</*peer receive*/ENetPeer*,
+        /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
+        ENetCommandType, ENetAddress, /*time added in us*/uint64_t>
+        ENetCommand;
+
+    /** Maximum number of threads with their own queue of enet commands. */
+    static const unsigned MAX_ENET_COMMAND_QUEUES = 16;
 
     /** Let (atm enet_peer_send and enet_peer_disconnect) run in the listening
-     *  thread. */
-    std::vector<std::tuple</*peer receive*/ENetPeer*,
-        /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
-        ENetCommandType, ENetAddress> > m_enet_cmd;
+     *  thread. Each thread adding commands has its own queue, so the queues
+     *  need no lock. */
+    struct ENetCommandQueue
+    {
+        SPSCQueue<ENetCommand> m_queue;
+        std::thread::id m_thread;
+        ENetCommandQueue() : m_queue(4096)                                  {}
+    };
+    std::array<std::unique_ptr<ENetCommandQueue>, MAX_ENET_COMMAND_QUEUES>
+        m_enet_cmd_queues;
+
+    /** Number of queues in m_enet_cmd_queues used. */
+    std::atomic<unsigned> m_enet_cmd_queue_count;
+
+    /** Identifies this host in the queue index cached by each thread. */
+    uint32_t m_enet_cmd_generation;
 
-    /** Protect \ref m_enet_cmd from multiple threads usage. */
+    /** Commands of threads which didn't get an own queue, because all
+     *  queues are used. */
+    std::vector<ENetCommand> m_enet_cmd;
+
+    /** True if m_enet_cmd is not empty. */
+    std::atomic_bool m_has_enet_cmd;
+
+    /** Protect \ref m_enet_cmd from multiple threads usage, and the
+     *  creation of queues. */
     std::mutex m_enet_cmd_mutex;
 
-    /** The list of peers connected to this instance. */
-    std::map<ENetPeer*, std::shared_ptr<STKPeer> > m_peers;
+    /** Set by the listening thread while it waits for network data, so that
+     *  adding an enet command wakes it up. */
+    std::atomic_bool m_enet_waiting;
+
+    /** Read and write end of the pipe (or the eventfd in both) used to wake
+     *  up the listening thread, -1 if not supported on this platform. */
+    int m_wakeup_fd[2];
+
+    /** Upper limits (in microseconds) of the buckets of the histogram of
+     *  the time between adding a packet and sending it to the socket. */
+    static const uint64_t SEND_LATENCY_LIMITS[];
+
+    /** Number of buckets in the send latency histogram, the last one counts
+     *  all times larger than the last limit. */
+    static const unsigned SEND_LATENCY_BUCKETS = 9;
+
+    /** Number of packets sent with each send latency, written by the
+     *  listening thread. */
+    std::array<std::atomic<uint32_t>, SEND_LATENCY_BUCKETS> m_send_latency;
+
+    /** The peers connected to this instance, read without locking. */
+    PeerRegistry m_peers;
 
     /** Next unique host id. It is increased whenever a new peer is added (see
      *  getPeer()), but not decreased whena host (=peer) disconnects. This
@@ -265,10 +324,16 @@ public:
     // ------------------------------------------------------------------------
     std::set<uint32_t> getAllPlayerOnlineIds() const;
     // ------------------------------------------------------------------------
+    bool hasPlayerWithOnlineId(uint32_t online_id) const;
+    // ------------------------------------------------------------------------
     std::shared_ptr<STKPeer> findPeerByHostId(uint32_t id) const;
     // ------------------------------------------------------------------------
     std::shared_ptr<STKPeer> findPeerByName(const core::stringw& name) const;
     // ------------------------------------------------------------------------
+    /** Called when the players of a peer changed, to update the online id
+     *  index of the peers. */
+    void updatePeerIndexes()                      { m_peers.updateIndexes(); }
+    // ------------------------------------------------------------------------
     void sendPacketExcept(STKPeer* peer, NetworkString *data,
                           bool reliable = true);
     // ------------------------------------------------------------------------
@@ -287,11 +352,24 @@ public:
     void setErrorMessage(const irr::core::stringw &message);
     // ------------------------------------------------------------------------
     void addEnetCommand(ENetPeer* peer, ENetPacket* packet, uint32_t i,
-                        ENetCommandType ect, ENetAddress ea)
-    {
-        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
-        m_enet_cmd.emplace_back(peer, packet, i, ect, ea);
-    }
+                        ENetCommandType ect, ENetAddress ea);
+    // ------------------------------------------------------------------------
+    void takeEnetCommands(std::vector<ENetCommand>* commands);
+    // ------------------------------------------------------------------------
+    bool hasEnetCommands() const;
+    // ------------------------------------------------------------------------
+    void createWakeup();
+    // ------------------------------------------------------------------------
+    void wakeUp();
+    // ------------------------------------------------------------------------
+    void waitForNetwork(ENetHost* host, int timeout_ms);
+    // ------------------------------------------------------------------------
+    void addSendLatency(const std::vector<ENetCommand>& commands);
+    // ------------------------------------------------------------------------
+    std::string getSendLatencyStats() const;
+    // ------------------------------------------------------------------------
+    void sendSharedPacket(const std::vector<STKPeer*>& peers,
+                          ENetPacket* packet, uint32_t channel);
     // ------------------------------------------------------------------------
     /** Returns the last error (or "" if no error has happened). */
     const irr::core::stringw& getErrorMessage() const
@@ -311,15 +389,12 @@ public:
     // ------------------------------------------------------------------------
     /** Returns a copied list of peers. */
     std::vector<std::shared_ptr<STKPeer> > getPeers() const
-    {
-        std::lock_guard<std::mutex> lock(m_peers_mutex);
-        std::vector<std::shared_ptr<STKPeer> > peers;
-        for (auto p : m_peers)
-        {
-            peers.push_back(p.second);
-        }
-        return peers;
-    }
+                                             { return m_peers.get()->m_peers; }
+    // ------------------------------------------------------------------------
+    /** Returns the current immutable snapshot of the peers, which can be
+     *  iterated without copying the list of peers. */
+    std::shared_ptr<const PeerRegistry::Snapshot> getPeerSnapshot() const
+                                                      { return m_peers.get(); }
     // ------------------------------------------------------------------------
     /** Returns the next (unique) host id. */
     unsigned int getNextHostId() const
@@ -332,10 +407,7 @@ public:
     // ------------------------------------------------------------------------
     /** Returns the number of currently connected peers. */
     unsigned int getPeerCount() const
-    {
-        std::lock_guard<std::mutex> lock(m_peers_mutex);
-        return (unsigned)m_peers.size();
-    }
+                                    { return (unsigned)m_peers.get()->size(); }
     // ------------------------------------------------------------------------
     /** Sets the global host id of this host (client use). */
     void setMyHostId(uint32_t my_host_id)           { m_host_id = my_host_id; }
@@ -396,6 +468,12 @@ public:
     static BareNetworkString getStunRequest(uint8_t* stun_tansaction_id);
     // ------------------------------------------------------------------------
     ChildLoop* getChildLoop() const { return m_client_loop; }
+    // ------------------------------------------------------------------------
+    void createExtraLobbies(unsigned count);
+    // ------------------------------------------------------------------------
+    /** Returns the number of server lobbies running in child processes
+     *  besides the one of the main process. */
+    static unsigned getExtraLobbyCount()  { return m_extra_lobby_count.load(); }
 };   // class STKHost
 
 #endif // STK_HOST_HPP
@@ -482,6 +482,14 @@ extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
     return 1;
 }   // andIPv6
 
+// ----------------------------------------------------------------------------
+/** Converts an IPv6 address string to its binary form, returns false if it
+ *  is not a valid address. */
+bool getIPv6FromString(const char* ipv6, struct in6_addr* in6)
+{
+    return stk_inet_pton6(ipv6, in6) == 1;
+}   // getIPv6FromString
+
 #ifndef ENABLE_IPV6
 // ----------------------------------------------------------------------------
 extern "C" int isIPv6Socket()
@@ -47,6 +47,9 @@ STKPeer::STKPeer(ENetPeer *enet_peer, STKHost* host, uint32_t host_id)
     m_always_spectate.store(ASM_NONE);
     m_average_ping.store(0);
     m_packet_loss.store(0);
+    m_round_trip_time.store(0);
+    m_state_interval.store(1);
+    m_state_redundancy.store(1);
     m_waiting_for_game.store(true);
     m_spectator.store(false);
     m_disconnected.store(false);
@@ -61,6 +64,24 @@ STKPeer::~STKPeer()
 {
 }   // ~STKPeer
 
+//-----------------------------------------------------------------------------
+/** Removes all players of this peer, and updates the peer indexes of the
+ *  host (which know the online id of the first player). */
+void STKPeer::cleanPlayerProfiles()
+{
+    m_players.clear();
+    if (m_host)
+        m_host->updatePeerIndexes();
+}   // cleanPlayerProfiles
+
+//-----------------------------------------------------------------------------
+void STKPeer::addPlayer(std::shared_ptr<NetworkPlayerProfile> p)
+{
+    m_players.push_back(p);
+    if (m_host)
+        m_host->updatePeerIndexes();
+}   // addPlayer
+
 //-----------------------------------------------------------------------------
 void STKPeer::disconnect()
 {
@@ -116,12 +116,26 @@ protected:
 
     std::unique_ptr<Crypto> m_crypto;
 
+    /** On a client, the key shared by all peers in the current game to
+     *  decrypt packets which the server encrypts only once for everyone. */
+    std::shared_ptr<Crypto> m_broadcast_crypto;
+
     std::deque<uint32_t> m_previous_pings;
 
     std::atomic<uint32_t> m_average_ping;
 
     std::atomic<int> m_packet_loss;
 
+    /** Latest round trip time measured by enet in ms, updated every second
+     *  by the network thread. */
+    std::atomic<uint32_t> m_round_trip_time;
+
+    /** Interval (in saved states) and number of copies of the states sent to
+     *  this peer, set by GameProtocol on the server. */
+    std::atomic<unsigned> m_state_interval;
+
+    std::atomic<unsigned> m_state_redundancy;
+
     std::set<unsigned> m_available_kart_ids;
 
     std::string m_user_version;
@@ -155,10 +169,9 @@ public:
     // ------------------------------------------------------------------------
     bool hasPlayerProfiles() const               { return !m_players.empty(); }
     // ------------------------------------------------------------------------
-    void cleanPlayerProfiles()                           { m_players.clear(); }
+    void cleanPlayerProfiles();
     // ------------------------------------------------------------------------
-    void addPlayer(std::shared_ptr<NetworkPlayerProfile> p)
-                                                    { m_players.push_back(p); }
+    void addPlayer(std::shared_ptr<NetworkPlayerProfile> p);
     // ------------------------------------------------------------------------
     void setValidated(bool val)                     { m_validated.store(val); }
     // ------------------------------------------------------------------------
@@ -217,10 +230,18 @@ public:
     // ------------------------------------------------------------------------
     void setCrypto(std::unique_ptr<Crypto>&& c);
     // ------------------------------------------------------------------------
+    std::shared_ptr<Crypto> getBroadcastCrypto() const
+                                 { return std::atomic_load(&m_broadcast_crypto); }
+    // ------------------------------------------------------------------------
+    void setBroadcastCrypto(std::shared_ptr<Crypto> c)
+                                   { std::atomic_store(&m_broadcast_crypto, c); }
+    // ------------------------------------------------------------------------
     uint32_t getAveragePing() const           { return m_average_ping.load(); }
     // ------------------------------------------------------------------------
     ENetPeer* getENetPeer() const                       { return m_enet_peer; }
     // ------------------------------------------------------------------------
+    const ENetAddress& getENetAddress() const             { return m_address; }
+    // ------------------------------------------------------------------------
     void setWaitingForGame(bool val)         { m_waiting_for_game.store(val); }
     // ------------------------------------------------------------------------
     bool isWaitingForGame() const         { return m_waiting_for_game.load(); }
@@ -275,6 +296,20 @@ public:
     // ------------------------------------------------------------------------
     int getPacketLoss() const                  { return m_packet_loss.load(); }
     // ------------------------------------------------------------------------
+    void setRoundTripTime(uint32_t rtt)      { m_round_trip_time.store(rtt); }
+    // ------------------------------------------------------------------------
+    uint32_t getRoundTripTime() const     { return m_round_trip_time.load(); }
+    // ------------------------------------------------------------------------
+    void setStateRate(unsigned interval, unsigned redundancy)
+    {
+        m_state_interval.store(interval);
+        m_state_redundancy.store(redundancy);
+    }
+    // ------------------------------------------------------------------------
+    unsigned getStateInterval() const      { return m_state_interval.load(); }
+    // ------------------------------------------------------------------------
+    unsigned getStateRedundancy() const  { return m_state_redundancy.load(); }
+    // ------------------------------------------------------------------------
     const std::array<int, AS_TOTAL>& getAddonsScores() const
                                                     { return m_addons_scores; }
     // ------------------------------------------------------------------------
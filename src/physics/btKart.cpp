@@ -33,7 +33,7 @@
 #define ROLLING_INFLUENCE_FIX
 
 // ============================================================================
-btKart::btKart(btRigidBody* chassis, btVehicleRaycaster* raycaster,
+btKart::btKart(btRigidBody* chassis, btKartRaycaster* raycaster,
                Kart *kart)
       : m_vehicleRaycaster(raycaster), m_fixed_body(0, 0, 0)
 {
@@ -204,6 +204,77 @@ void btKart::updateWheelTransformsWS(btWheelInfo& wheel,
                                                 wheel.m_wheelAxleCS;
 }   // updateWheelTransformsWS
 
+// ----------------------------------------------------------------------------
+/** Saves the physics state of this kart, used by the rewind manager to go
+ *  back to the state predicted at a certain time without running the
+ *  simulation again.
+ *  \param snapshot Where to save the state.
+ */
+void btKart::saveSnapshot(Snapshot* snapshot) const
+{
+    assert(m_wheelInfo.size() <= 4);
+    snapshot->m_chassis.save(m_chassisBody);
+    for (int i = 0; i < m_wheelInfo.size(); i++)
+    {
+        const btWheelInfo& wheel = m_wheelInfo[i];
+        WheelSnapshot& ws = snapshot->m_wheels[i];
+        ws.m_raycast_info = wheel.m_raycastInfo;
+        ws.m_world_transform = wheel.m_worldTransform;
+        ws.m_steering = wheel.m_steering;
+        ws.m_engine_force = wheel.m_engineForce;
+        ws.m_brake = wheel.m_brake;
+        ws.m_clipped_inv_contact_dot_suspension =
+            wheel.m_clippedInvContactDotSuspension;
+        ws.m_suspension_relative_velocity = wheel.m_suspensionRelativeVelocity;
+        ws.m_suspension_force = wheel.m_wheelsSuspensionForce;
+        ws.m_skid_info = wheel.m_skidInfo;
+        ws.m_was_on_ground = wheel.m_was_on_ground;
+    }
+    snapshot->m_additional_impulse = m_additional_impulse;
+    snapshot->m_additional_rotation = m_additional_rotation;
+    snapshot->m_ticks_additional_impulse = m_ticks_additional_impulse;
+    snapshot->m_ticks_additional_rotation = m_ticks_additional_rotation;
+    snapshot->m_num_wheels_on_ground = m_num_wheels_on_ground;
+    snapshot->m_min_speed = m_min_speed;
+    snapshot->m_max_speed = m_max_speed;
+    snapshot->m_allow_sliding = m_allow_sliding;
+    snapshot->m_visual_wheels_touch_ground = m_visual_wheels_touch_ground;
+}   // saveSnapshot
+
+// ----------------------------------------------------------------------------
+/** Restores the physics state saved with saveSnapshot.
+ *  \param snapshot The saved state.
+ */
+void btKart::restoreSnapshot(const Snapshot& snapshot)
+{
+    snapshot.m_chassis.restore(m_chassisBody);
+    for (int i = 0; i < m_wheelInfo.size(); i++)
+    {
+        btWheelInfo& wheel = m_wheelInfo[i];
+        const WheelSnapshot& ws = snapshot.m_wheels[i];
+        wheel.m_raycastInfo = ws.m_raycast_info;
+        wheel.m_worldTransform = ws.m_world_transform;
+        wheel.m_steering = ws.m_steering;
+        wheel.m_engineForce = ws.m_engine_force;
+        wheel.m_brake = ws.m_brake;
+        wheel.m_clippedInvContactDotSuspension =
+            ws.m_clipped_inv_contact_dot_suspension;
+        wheel.m_suspensionRelativeVelocity = ws.m_suspension_relative_velocity;
+        wheel.m_wheelsSuspensionForce = ws.m_suspension_force;
+        wheel.m_skidInfo = ws.m_skid_info;
+        wheel.m_was_on_ground = ws.m_was_on_ground;
+    }
+    m_additional_impulse = snapshot.m_additional_impulse;
+    m_additional_rotation = snapshot.m_additional_rotation;
+    m_ticks_additional_impulse = snapshot.m_ticks_additional_impulse;
+    m_ticks_additional_rotation = snapshot.m_ticks_additional_rotation;
+    m_num_wheels_on_ground = snapshot.m_num_wheels_on_ground;
+    m_min_speed = snapshot.m_min_speed;
+    m_max_speed = snapshot.m_max_speed;
+    m_allow_sliding = snapshot.m_allow_sliding;
+    m_visual_wheels_touch_ground = snapshot.m_visual_wheels_touch_ground;
+}   // restoreSnapshot
+
 // ----------------------------------------------------------------------------
 /** Updates all wheel transform informations. This is used just after a rewind
  *  to update all m_hardPointWS (which is used by stk to determine the terrain
@@ -358,6 +429,30 @@ btScalar btKart::rayCast(unsigned int index, float fraction)
 
 }   // rayCast
 
+// ----------------------------------------------------------------------------
+/** Adds the suspension rays of all wheels, as rayCast() will cast them in
+ *  the next update, so that they can be cast against the track together
+ *  with the rays of all other karts (see STKDynamicsWorld::updateActions).
+ *  \param rays The rays to add to.
+ */
+void btKart::addWheelRays(AlignedArray<TriangleMesh::Ray> *rays)
+{
+    for (int i = 0; i < m_wheelInfo.size(); i++)
+    {
+        // Use a copy, the wheels are only changed in updateVehicle. This
+        // must compute the ray exactly as rayCast does, otherwise the ray
+        // is cast against the whole world again.
+        btWheelInfo wheel = m_wheelInfo[i];
+        updateWheelTransformsWS(wheel, getChassisWorldTransform(), false);
+        btScalar max_susp_len = wheel.getSuspensionRestLength()
+                              + wheel.m_maxSuspensionTravel;
+        btScalar raylen = max_susp_len + 0.5f;
+        btVector3 rayvector = wheel.m_raycastInfo.m_wheelDirectionWS * (raylen);
+        const btVector3& source = wheel.m_raycastInfo.m_hardPointWS;
+        rays->push_back(TriangleMesh::Ray(source, source + rayvector));
+    }
+}   // addWheelRays
+
 // ----------------------------------------------------------------------------
 /** Returns the contact point of a visual wheel.
 *  \param n Index of the wheel, must be 2 or 3 since only the two rear
@@ -20,6 +20,7 @@ class btDynamicsWorld;
 #include "BulletDynamics/Dynamics/btActionInterface.h"
 
 #include "config/stk_config.hpp"
+#include "physics/physics_snapshot.hpp"
 
 class btVehicleTuning;
 class Kart;
@@ -54,6 +55,39 @@ public:
 
     };   // class btVehicleTuning
 
+    /** The values of a wheel which are kept from one physics step to the
+     *  next (the rest of btWheelInfo is constant). */
+    struct WheelSnapshot
+    {
+        btWheelInfo::RaycastInfo m_raycast_info;
+        btTransform              m_world_transform;
+        btScalar                 m_steering;
+        btScalar                 m_engine_force;
+        btScalar                 m_brake;
+        btScalar                 m_clipped_inv_contact_dot_suspension;
+        btScalar                 m_suspension_relative_velocity;
+        btScalar                 m_suspension_force;
+        btScalar                 m_skid_info;
+        bool                     m_was_on_ground;
+    };   // WheelSnapshot
+
+    /** The complete physics state of a kart (chassis and wheels), which can
+     *  be saved and restored with plain copies, see saveSnapshot(). */
+    struct Snapshot
+    {
+        RigidBodySnapshot m_chassis;
+        WheelSnapshot     m_wheels[4];
+        btVector3         m_additional_impulse;
+        float             m_additional_rotation;
+        uint16_t          m_ticks_additional_impulse;
+        uint16_t          m_ticks_additional_rotation;
+        int               m_num_wheels_on_ground;
+        btScalar          m_min_speed;
+        btScalar          m_max_speed;
+        bool              m_allow_sliding;
+        bool              m_visual_wheels_touch_ground;
+    };   // Snapshot
+
 private:
 
     btAlignedObjectArray<btVector3> m_forwardWS;
@@ -69,7 +103,7 @@ private:
     btScalar calcRollingFriction(btWheelContactPoint& contactPoint);
 
     btScalar            m_damping;
-    btVehicleRaycaster *m_vehicleRaycaster;
+    btKartRaycaster    *m_vehicleRaycaster;
 
     /** Sliding (skidding) will only be permited when this is true. Also check
      *  the friction parameter in the wheels since friction directly affects
@@ -140,13 +174,14 @@ public:
      *         (this is used to get access to the kart properties).
      */
                        btKart(btRigidBody* chassis,
-                              btVehicleRaycaster* raycaster,
+                              btKartRaycaster* raycaster,
                               Kart *kart);
      virtual          ~btKart();
     void               reset();
     void               debugDraw(btIDebugDraw* debugDrawer);
     const btTransform& getChassisWorldTransform() const;
     btScalar           rayCast(unsigned int index, float fraction=1.0f);
+    void               addWheelRays(AlignedArray<TriangleMesh::Ray> *rays);
     virtual void       updateVehicle(btScalar step);
     void               resetSuspension();
     btScalar           getSteeringValue(int wheel) const;
@@ -174,6 +209,8 @@ public:
     void               updateAllWheelPositions();
     void               getVisualContactPoint(const btTransform& chassis_trans,
                                              btVector3 *left, btVector3 *right);
+    void               saveSnapshot(Snapshot* snapshot) const;
+    void               restoreSnapshot(const Snapshot& snapshot);
         // ------------------------------------------------------------------------
     /** Returns true if both rear visual wheels touch the ground. */
     bool visualWheelsTouchGround() const
@@ -192,6 +229,9 @@ public:
     /** Returns the number of wheels of this vehicle. */
     inline int getNumWheels() const { return int(m_wheelInfo.size());}
     // ------------------------------------------------------------------------
+    /** Returns the raycaster used for the suspension. */
+    btKartRaycaster* getRaycaster() { return m_vehicleRaycaster; }
+    // ------------------------------------------------------------------------
     /** Returns the chassis (rigid) body. */
     inline btRigidBody* getRigidBody() { return m_chassisBody; }
     // ------------------------------------------------------------------------
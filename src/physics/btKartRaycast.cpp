@@ -19,6 +19,21 @@
 #include "physics/triangle_mesh.hpp"
 #include "tracks/track.hpp"
 
+/** Returns the ray with the given start and end point if it was already
+ *  cast against the track, or NULL.
+ */
+const TriangleMesh::Ray* btKartRaycaster::findTrackRay(const btVector3& from,
+                                                       const btVector3& to) const
+{
+    for (unsigned int i = 0; i < m_track_rays.size(); i++)
+    {
+        if (m_track_rays[i].m_from == from && m_track_rays[i].m_to == to)
+            return &m_track_rays[i];
+    }
+    return NULL;
+}   // findTrackRay
+
+// ----------------------------------------------------------------------------
 void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
                                btVehicleRaycasterResult& result)
 {
@@ -27,6 +42,8 @@ void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
     {
     private:
         int m_triangle_index;
+        /** An object which is not tested, since it was tested before. */
+        const btCollisionObject* m_excluded;
     public:
         /** Constructor, initialises the triangle index. */
         ClosestWithNormal(const btVector3 &from,
@@ -34,8 +51,40 @@ void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
                           : btCollisionWorld::ClosestRayResultCallback(from,to)
         {
             m_triangle_index = -1;
+            m_excluded       = NULL;
         }   // CloestWithNormal
         // --------------------------------------------------------------------
+        /** Excludes the track mesh, which was hit by a ray at the given
+         *  fraction, so that only objects which are closer are tested. */
+        void excludeTrack(const TriangleMesh::Ray &track_ray,
+                          const btCollisionObject* track)
+        {
+            m_excluded = track;
+            if (track_ray.m_hit)
+                m_closestHitFraction = track_ray.m_fraction;
+        }   // excludeTrack
+        // --------------------------------------------------------------------
+        /** Sets the hit of the excluded track if no closer object was hit. */
+        void addTrackHit(const TriangleMesh::Ray &track_ray,
+                         btCollisionObject* track)
+        {
+            if (hasHit() || !track_ray.m_hit)
+                return;
+            m_collisionObject = track;
+            m_closestHitFraction = track_ray.m_fraction;
+            m_hitPointWorld = track_ray.m_hit_point;
+            m_hitNormalWorld = track_ray.m_normal;
+            m_triangle_index = track_ray.m_triangle_index;
+        }   // addTrackHit
+        // --------------------------------------------------------------------
+        virtual bool needsCollision(btBroadphaseProxy* proxy0) const
+        {
+            if (proxy0->m_clientObject == m_excluded)
+                return false;
+            return btCollisionWorld::ClosestRayResultCallback
+                ::needsCollision(proxy0);
+        }   // needsCollision
+        // --------------------------------------------------------------------
         /** Stores the index of the triangle hit. */
         virtual    btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult,
                                          bool normalInWorldSpace)
@@ -59,8 +108,21 @@ void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
 
     ClosestWithNormal rayCallback(from,to);
 
+    // If the ray was already cast against the track, only the other
+    // objects need to be tested
+    const TriangleMesh::Ray* track_ray = findTrackRay(from, to);
+    // The body is not modified, bullet only lacks const in the callback
+    btRigidBody* track = track_ray
+                       ? const_cast<btRigidBody*>(m_track_mesh->getBody())
+                       : NULL;
+    if (track_ray)
+        rayCallback.excludeTrack(*track_ray, track);
+
     m_dynamicsWorld->rayTest(from, to, rayCallback);
 
+    if (track_ray)
+        rayCallback.addTrackHit(*track_ray, track);
+
     if (rayCallback.hasHit())
     {
         btRigidBody* body = btRigidBody::upcast(rayCallback.m_collisionObject);
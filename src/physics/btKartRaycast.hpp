@@ -19,6 +19,8 @@ class btDynamicsWorld;
 #include "BulletDynamics/Vehicle/btWheelInfo.h"
 #include "BulletDynamics/Dynamics/btActionInterface.h"
 
+#include "physics/triangle_mesh.hpp"
+#include "utils/aligned_array.hpp"
 
 class btKartRaycaster : public btVehicleRaycaster
 {
@@ -27,14 +29,44 @@ private:
     /** True if the normals should be smoothed. Not all tracks support this,
     *  so this flag is set depending on track when constructing this object. */
     bool                m_smooth_normals;
+
+    /** The track mesh the rays in m_track_rays were cast against. */
+    const TriangleMesh *m_track_mesh;
+
+    /** Rays of this kart which were already cast against the track together
+     *  with the rays of all other karts, see STKDynamicsWorld. */
+    AlignedArray<TriangleMesh::Ray> m_track_rays;
+
+    const TriangleMesh::Ray* findTrackRay(const btVector3& from,
+                                          const btVector3& to) const;
 public:
     btKartRaycaster(btDynamicsWorld* world, bool smooth_normals=false)
-        :m_dynamicsWorld(world), m_smooth_normals(smooth_normals)
+        :m_dynamicsWorld(world), m_smooth_normals(smooth_normals),
+         m_track_mesh(NULL)
     {
     }
 
     virtual void* castRay(const btVector3& from,const btVector3& to,
                           btVehicleRaycasterResult& result);
+    // ------------------------------------------------------------------------
+    /** Sets the rays of this kart which were cast against the track mesh,
+     *  so that castRay only needs to test the other objects for them. */
+    void setTrackRays(const TriangleMesh *track_mesh,
+                      const TriangleMesh::Ray *rays, unsigned int count)
+    {
+        m_track_mesh = track_mesh;
+        m_track_rays.clear();
+        for (unsigned int i = 0; i < count; i++)
+            m_track_rays.push_back(rays[i]);
+    }   // setTrackRays
+    // ------------------------------------------------------------------------
+    /** Removes the rays cast against the track, so that all further
+     *  raycasts test the whole world again. */
+    void clearTrackRays()
+    {
+        m_track_mesh = NULL;
+        m_track_rays.clear();
+    }   // clearTrackRays
 
 };
 
@@ -0,0 +1,478 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "physics/bvh_cache.hpp"
+
+#include "io/file_manager.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
+
+#include <assert.h>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#if defined(WIN32) || defined(__SWITCH__)
+#  define BVH_CACHE_NO_MMAP
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+namespace
+{
+    /** Header of a cache file. It is followed by the vertices and indices of
+     *  all parts of the mesh, and then by the serialized BVH at
+     *  m_bvh_offset. The serialized BVH contains the bullet class as it is
+     *  in memory, so the file is only used by the same build of bullet. */
+    struct BvhFileHeader
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_bullet_version;
+        uint32_t m_bvh_class_size;
+        uint32_t m_pointer_size;
+        uint64_t m_hash;
+        uint64_t m_mesh_size;
+        uint64_t m_bvh_offset;
+        uint64_t m_bvh_size;
+    };   // BvhFileHeader
+
+    const char BVH_FILE_MAGIC[8] = { 'S', 'T', 'K', 'B', 'V', 'H', 0, 0 };
+    const uint32_t BVH_FILE_VERSION = 1;
+
+    /** Bullet can only store the triangle index of 2^21 triangles per part
+     *  (and 2^10 parts) in quantized nodes. */
+    const int MAX_QUANTIZED_TRIANGLES = 1 << 21;
+    const int MAX_QUANTIZED_PARTS = 1 << 10;
+
+    std::mutex g_cached_bvh_mutex;
+    /** The BVHs currently used, so that the same mesh loaded again (e.g. by
+     *  another lobby) shares it. */
+    std::map<uint64_t, std::weak_ptr<CachedBvh> > g_cached_bvh;
+
+    // ------------------------------------------------------------------------
+    /** Calls f(data, size) for the vertices and indices of all parts of the
+     *  mesh, in the order they are stored in a cache file. */
+    template<typename F> void forEachMeshData(btTriangleMesh* mesh, F f)
+    {
+        for (int part = 0; part < mesh->getNumSubParts(); part++)
+        {
+            const unsigned char* vertices;
+            const unsigned char* indices;
+            int num_vertices, vertex_stride, index_stride, num_faces;
+            PHY_ScalarType vertex_type, index_type;
+            mesh->getLockedReadOnlyVertexIndexBase(&vertices, num_vertices,
+                vertex_type, vertex_stride, &indices, index_stride,
+                num_faces, index_type, part);
+            f(vertices, (size_t)num_vertices * vertex_stride);
+            f(indices, (size_t)num_faces * index_stride);
+            mesh->unLockReadOnlyVertexBase(part);
+        }
+    }   // forEachMeshData
+
+    // ------------------------------------------------------------------------
+    /** FNV-1a hash of all vertices and indices of the mesh, 8 bytes at a
+     *  time. */
+    uint64_t hashMesh(btTriangleMesh* mesh, uint64_t* mesh_size)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        *mesh_size = 0;
+        forEachMeshData(mesh, [&hash, mesh_size](const unsigned char* data,
+                                                 size_t size)
+        {
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t v;
+                memcpy(&v, data + i, 8);
+                hash = (hash ^ v) * 0x100000001b3ULL;
+            }
+            for (; i < size; i++)
+                hash = (hash ^ data[i]) * 0x100000001b3ULL;
+            hash = (hash ^ (uint64_t)size) * 0x100000001b3ULL;
+            *mesh_size += size;
+        });
+        return hash;
+    }   // hashMesh
+
+    // ------------------------------------------------------------------------
+    /** Returns the name of the cache file of a mesh. */
+    std::string getFileName(const std::string& dir, uint64_t hash)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bvh", (unsigned long long)hash);
+        return dir + name;
+    }   // getFileName
+
+    // ------------------------------------------------------------------------
+    /** Returns the memory of a cache file, mapped copy-on-write if possible
+     *  (deserializing the BVH changes its first bytes), NULL on error. */
+    void* readFile(const std::string& path, size_t* size, bool* mapped)
+    {
+#ifndef BVH_CACHE_NO_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            return NULL;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BvhFileHeader))
+        {
+            close(fd);
+            return NULL;
+        }
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            return NULL;
+        *size = (size_t)st.st_size;
+        *mapped = true;
+        return data;
+#else
+        FILE* f = FileUtils::fopenU8Path(path, "rb");
+        if (!f)
+            return NULL;
+        fseek(f, 0, SEEK_END);
+        long pos = ftell(f);
+        if (pos < (long)sizeof(BvhFileHeader))
+        {
+            fclose(f);
+            return NULL;
+        }
+        fseek(f, 0, SEEK_SET);
+        void* data = btAlignedAlloc((int)pos, 16);
+        if (fread(data, pos, 1, f) != 1)
+        {
+            btAlignedFree(data);
+            fclose(f);
+            return NULL;
+        }
+        fclose(f);
+        *size = (size_t)pos;
+        *mapped = false;
+        return data;
+#endif
+    }   // readFile
+
+    // ------------------------------------------------------------------------
+    /** Loads the BVH of the mesh from a cache file, NULL if there is no
+     *  valid file for it. */
+    std::shared_ptr<CachedBvh> loadFile(const std::string& path,
+                                        btTriangleMesh* mesh, uint64_t hash)
+    {
+        size_t size = 0;
+        bool mapped = false;
+        void* data = readFile(path, &size, &mapped);
+        if (!data)
+            return NULL;
+        auto cached = std::make_shared<CachedBvh>(data, size, mapped);
+        if (!cached->init(mesh, hash))
+        {
+            Log::warn("BvhCache", "Invalid cache file %s.", path.c_str());
+            return NULL;
+        }
+        return cached;
+    }   // loadFile
+
+}   // namespace
+
+// ============================================================================
+CachedBvh::~CachedBvh()
+{
+    // The nodes of the BVH are in m_data, so the destructor frees nothing
+    if (m_bvh)
+        m_bvh->~btOptimizedBvh();
+#ifndef BVH_CACHE_NO_MMAP
+    if (m_mapped)
+    {
+        munmap(m_data, m_size);
+        return;
+    }
+#endif
+    btAlignedFree(m_data);
+}   // ~CachedBvh
+
+// ----------------------------------------------------------------------------
+/** Returns if the buffer contains the given mesh (and its BVH). */
+bool CachedBvh::matches(btTriangleMesh* mesh, uint64_t hash) const
+{
+    const BvhFileHeader* header = (const BvhFileHeader*)m_data;
+    if (m_size < sizeof(BvhFileHeader) ||
+        memcmp(header->m_magic, BVH_FILE_MAGIC, 8) != 0 ||
+        header->m_version != BVH_FILE_VERSION ||
+        header->m_bullet_version != (uint32_t)btGetVersion() ||
+        header->m_bvh_class_size != sizeof(btQuantizedBvh) ||
+        header->m_pointer_size != sizeof(void*) ||
+        header->m_hash != hash ||
+        header->m_bvh_offset % 16 != 0 ||
+        header->m_bvh_offset < sizeof(BvhFileHeader) + header->m_mesh_size ||
+        header->m_bvh_offset + header->m_bvh_size > m_size)
+        return false;
+
+    // Compare the triangles in case of a hash collision
+    const unsigned char* stored = (const unsigned char*)m_data +
+        sizeof(BvhFileHeader);
+    uint64_t offset = 0;
+    bool same = true;
+    forEachMeshData(mesh, [&](const unsigned char* data, size_t size)
+    {
+        if (!same || offset + size > header->m_mesh_size ||
+            memcmp(stored + offset, data, size) != 0)
+            same = false;
+        offset += size;
+    });
+    return same && offset == header->m_mesh_size;
+}   // matches
+
+// ----------------------------------------------------------------------------
+/** Checks that the buffer contains the given mesh, and deserializes the BVH
+ *  in place. Returns false if the buffer can't be used for the mesh. */
+bool CachedBvh::init(btTriangleMesh* mesh, uint64_t hash)
+{
+    assert(!m_bvh);
+    if (!matches(mesh, hash))
+        return false;
+    const BvhFileHeader* header = (const BvhFileHeader*)m_data;
+    m_bvh = btOptimizedBvh::deSerializeInPlace(
+        (char*)m_data + header->m_bvh_offset,
+        (unsigned)header->m_bvh_size, /*swap_endian*/false);
+    return m_bvh != NULL;
+}   // init
+
+// ============================================================================
+/** Returns true if bullet can use a quantized BVH for the mesh. Quantized
+ *  nodes store the part and triangle index of a leaf in one integer, so
+ *  larger meshes need a BVH which is not quantized.
+ */
+bool BvhCache::canQuantize(const btTriangleMesh* mesh)
+{
+    return mesh->getNumTriangles() < MAX_QUANTIZED_TRIANGLES &&
+           mesh->getNumSubParts() < MAX_QUANTIZED_PARTS;
+}   // canQuantize
+
+// ----------------------------------------------------------------------------
+/** Returns the BVH of a mesh: the one already used by the same mesh, or the
+ *  one in the cache file of the mesh. Otherwise the BVH is built and the
+ *  cache file written. The BVH is quantized if bullet supports it for the
+ *  size of the mesh.
+ *  \param mesh The triangles, which must not change as long as the BVH is
+ *         used.
+ *  \param aabb_min, aabb_max The bounding box of the mesh.
+ *  \param dir Directory of the cache files, empty to not use files.
+ */
+std::shared_ptr<CachedBvh> BvhCache::get(btTriangleMesh* mesh,
+                                         const btVector3& aabb_min,
+                                         const btVector3& aabb_max,
+                                         const std::string& dir)
+{
+    const uint64_t start = StkTime::getMonoTimeUs();
+    uint64_t mesh_size = 0;
+    const uint64_t hash = hashMesh(mesh, &mesh_size);
+
+    // Keep the lock while building, so that lobbies loading the same track
+    // at the same time build it only once
+    std::lock_guard<std::mutex> lock(g_cached_bvh_mutex);
+    auto it = g_cached_bvh.find(hash);
+    if (it != g_cached_bvh.end())
+    {
+        std::shared_ptr<CachedBvh> cached = it->second.lock();
+        if (cached && cached->matches(mesh, hash))
+            return cached;
+    }
+
+    const std::string path = dir.empty() ? "" : getFileName(dir, hash);
+    std::shared_ptr<CachedBvh> cached;
+    if (!path.empty())
+        cached = loadFile(path, mesh, hash);
+    if (cached)
+    {
+        Log::info("BvhCache", "Loaded BVH of %d triangles in %.1f ms.",
+            mesh->getNumTriangles(),
+            (float)(StkTime::getMonoTimeUs() - start) / 1000.0f);
+        g_cached_bvh[hash] = cached;
+        return cached;
+    }
+
+    const bool quantized = canQuantize(mesh);
+    void* mem = btAlignedAlloc(sizeof(btOptimizedBvh), 16);
+    btOptimizedBvh* bvh = new (mem) btOptimizedBvh();
+    bvh->build(mesh, quantized, aabb_min, aabb_max);
+
+    BvhFileHeader header;
+    memcpy(header.m_magic, BVH_FILE_MAGIC, 8);
+    header.m_version = BVH_FILE_VERSION;
+    header.m_bullet_version = (uint32_t)btGetVersion();
+    header.m_bvh_class_size = sizeof(btQuantizedBvh);
+    header.m_pointer_size = sizeof(void*);
+    header.m_hash = hash;
+    header.m_mesh_size = mesh_size;
+    header.m_bvh_offset = (sizeof(BvhFileHeader) + mesh_size + 15) & ~15ULL;
+    header.m_bvh_size = bvh->calculateSerializeBufferSize();
+    const size_t size = (size_t)(header.m_bvh_offset + header.m_bvh_size);
+
+    unsigned char* data = (unsigned char*)btAlignedAlloc((int)size, 16);
+    memset(data, 0, (size_t)header.m_bvh_offset);
+    memcpy(data, &header, sizeof(BvhFileHeader));
+    uint64_t offset = sizeof(BvhFileHeader);
+    forEachMeshData(mesh, [data, &offset](const unsigned char* part,
+                                          size_t part_size)
+    {
+        memcpy(data + offset, part, part_size);
+        offset += part_size;
+    });
+    bvh->serialize(data + header.m_bvh_offset,
+        (unsigned)header.m_bvh_size, /*swap_endian*/false);
+    bvh->~btOptimizedBvh();
+    btAlignedFree(mem);
+
+    // Use the written file, so that its memory is shared with other
+    // processes using it
+    if (!path.empty() && FileUtils::writeFileAtomic(path, data, size))
+        cached = loadFile(path, mesh, hash);
+    if (cached)
+    {
+        btAlignedFree(data);
+    }
+    else
+    {
+        cached = std::make_shared<CachedBvh>(data, size, /*mapped*/false);
+        bool valid = cached->init(mesh, hash);
+        assert(valid);
+        (void)valid;
+    }
+    Log::info("BvhCache", "Built %sBVH of %d triangles in %.1f ms.",
+        quantized ? "quantized " : "", mesh->getNumTriangles(),
+        (float)(StkTime::getMonoTimeUs() - start) / 1000.0f);
+    g_cached_bvh[hash] = cached;
+    return cached;
+}   // get
+
+// ----------------------------------------------------------------------------
+/** Checks that a BVH loaded from the cache gives the same raycast results
+ *  as a built one, and logs the time to build and to load the BVH of a
+ *  track sized mesh. */
+void BvhCache::unitTesting()
+{
+    // A hilly terrain with 2 * 300 * 300 triangles
+    const int n = 300;
+    btTriangleMesh mesh;
+    for (int x = 0; x < n; x++)
+    {
+        for (int z = 0; z < n; z++)
+        {
+            btVector3 p[4];
+            for (int i = 0; i < 4; i++)
+            {
+                const float px = (float)(x + (i & 1));
+                const float pz = (float)(z + (i >> 1));
+                p[i] = btVector3(px, sinf(px * 0.1f) * cosf(pz * 0.07f) * 5.0f,
+                    pz);
+            }
+            mesh.addTriangle(p[0], p[1], p[2]);
+            mesh.addTriangle(p[1], p[3], p[2]);
+        }
+    }
+
+    // The test files are written to a new temporary directory, not to the
+    // cache of the user
+#ifdef WIN32
+    const char* tmp = getenv("TEMP");
+#else
+    const char* tmp = getenv("TMPDIR");
+#endif
+    const std::string dir = std::string(tmp && tmp[0] ? tmp : "/tmp") +
+        "/stk-bvh-test-" + StringUtils::toString(StkTime::getMonoTimeUs());
+    bool created = file_manager->checkAndCreateDirectory(dir);
+    assert(created);
+    (void)created;
+    const std::string prefix = dir + "/";
+    btBvhTriangleMeshShape built(&mesh, /*useQuantizedAabbCompression*/true);
+    btBvhTriangleMeshShape shape(&mesh, /*useQuantizedAabbCompression*/true,
+        /*buildBvh*/false);
+    const btVector3& aabb_min = shape.getLocalAabbMin();
+    const btVector3& aabb_max = shape.getLocalAabbMax();
+
+    // Build and write the file (cold), and load it again (warm)
+    uint64_t t0 = StkTime::getMonoTimeUs();
+    std::shared_ptr<CachedBvh> cold = BvhCache::get(&mesh, aabb_min,
+        aabb_max, prefix);
+    uint64_t t1 = StkTime::getMonoTimeUs();
+    assert(cold && cold->getBvh());
+    assert(BvhCache::get(&mesh, aabb_min, aabb_max, prefix) == cold);
+    cold.reset();
+    std::shared_ptr<CachedBvh> warm = BvhCache::get(&mesh, aabb_min,
+        aabb_max, prefix);
+    uint64_t t2 = StkTime::getMonoTimeUs();
+    assert(warm && warm->getBvh());
+    Log::info("BvhCache", "BVH of %d triangles: %.1f ms to build, %.1f ms "
+        "to load from the cache.", mesh.getNumTriangles(),
+        (float)(t1 - t0) / 1000.0f, (float)(t2 - t1) / 1000.0f);
+
+    // The cached BVH finds the same triangles
+    shape.setOptimizedBvh(warm->getBvh());
+    btCollisionObject object;
+    for (int i = 0; i < 100; i++)
+    {
+        const btVector3 from((float)(i * 3 % n), 20.0f, (float)(i * 7 % n));
+        const btVector3 to = from + btVector3(5.0f, -40.0f, 3.0f);
+        btTransform tf_from, tf_to, identity;
+        tf_from.setIdentity();
+        tf_from.setOrigin(from);
+        tf_to.setIdentity();
+        tf_to.setOrigin(to);
+        identity.setIdentity();
+        btCollisionWorld::ClosestRayResultCallback r1(from, to), r2(from, to);
+        btCollisionWorld::rayTestSingle(tf_from, tf_to, &object, &built,
+            identity, r1);
+        btCollisionWorld::rayTestSingle(tf_from, tf_to, &object, &shape,
+            identity, r2);
+        assert(r1.hasHit() && r2.hasHit());
+        assert(r1.m_hitPointWorld.distance(r2.m_hitPointWorld) < 0.001f);
+    }
+
+    // A changed mesh doesn't use the file of the old one
+    uint64_t size = 0;
+    const std::string path = getFileName(prefix, hashMesh(&mesh, &size));
+    warm.reset();
+    mesh.addTriangle(btVector3(0, 0, 0), btVector3(1, 0, 0),
+        btVector3(0, 0, 1));
+    const uint64_t changed_hash = hashMesh(&mesh, &size);
+    const std::string changed_path = getFileName(prefix, changed_hash);
+    assert(changed_path != path);
+    assert(!loadFile(path, &mesh, changed_hash));
+    std::shared_ptr<CachedBvh> changed = BvhCache::get(&mesh, aabb_min,
+        aabb_max, prefix);
+    assert(changed && changed->getBvh());
+    changed.reset();
+
+    // A truncated file is not used
+    FILE* f = FileUtils::fopenU8Path(changed_path, "wb");
+    assert(f);
+    fclose(f);
+    assert(!loadFile(changed_path, &mesh, changed_hash));
+
+    remove(FileUtils::getPortableWritingPath(path).c_str());
+    remove(FileUtils::getPortableWritingPath(changed_path).c_str());
+    file_manager->removeDirectory(dir);
+}   // unitTesting
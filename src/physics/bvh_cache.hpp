@@ -0,0 +1,93 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_BVH_CACHE_HPP
+#define HEADER_BVH_CACHE_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <memory>
+#include <string>
+
+class btOptimizedBvh;
+class btTriangleMesh;
+class btVector3;
+
+/**
+ * \brief A quantized bullet BVH which lives in a serialized buffer, either
+ *  a mapped cache file or memory allocated for it.
+ *  The BVH is only read by collision queries, so it is shared by all meshes
+ *  with the same triangles (e.g. the tracks of several lobbies). The cache
+ *  file also contains the triangles, so that a file is only used for the
+ *  exact same mesh.
+ * \ingroup physics
+ */
+class CachedBvh : public NoCopy
+{
+private:
+    /** The buffer containing the header, the triangles and the BVH. */
+    void* m_data;
+
+    /** Size of m_data in bytes. */
+    size_t m_size;
+
+    /** True if m_data is a mapped file, false if it was allocated. */
+    bool m_mapped;
+
+    /** The BVH, deserialized in place in m_data. */
+    btOptimizedBvh* m_bvh;
+
+public:
+    CachedBvh(void* data, size_t size, bool mapped)
+        : m_data(data), m_size(size), m_mapped(mapped), m_bvh(NULL) {}
+    // ------------------------------------------------------------------------
+    ~CachedBvh();
+    // ------------------------------------------------------------------------
+    btOptimizedBvh* getBvh() const                            { return m_bvh; }
+    // ------------------------------------------------------------------------
+    bool isMapped() const                                  { return m_mapped; }
+    // ------------------------------------------------------------------------
+    bool matches(btTriangleMesh* mesh, uint64_t hash) const;
+    // ------------------------------------------------------------------------
+    bool init(btTriangleMesh* mesh, uint64_t hash);
+};   // CachedBvh
+
+// ============================================================================
+/**
+ * \brief Caches the BVH of static triangle meshes (like the track) on disk,
+ *  so that it is not built again each time a track is loaded.
+ *  Cache files are named after a content hash of the triangles and contain
+ *  the quantized BVH serialized by bullet, which is mapped and deserialized
+ *  in place when it is loaded. As long as a BVH is used, the same mesh gets
+ *  it without reading the file again.
+ * \ingroup physics
+ */
+class BvhCache
+{
+public:
+    static bool canQuantize(const btTriangleMesh* mesh);
+    // ------------------------------------------------------------------------
+    static std::shared_ptr<CachedBvh> get(btTriangleMesh* mesh,
+                                          const btVector3& aabb_min,
+                                          const btVector3& aabb_max,
+                                          const std::string& dir);
+    static void unitTesting();
+};   // BvhCache
+
+#endif
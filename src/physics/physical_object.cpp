@@ -838,18 +838,24 @@ void PhysicalObject::computeError()
 }   // computeError
 
 // ----------------------------------------------------------------------------
-BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
+bool PhysicalObject::saveState(BareNetworkString* buffer,
+                               std::vector<uint16_t>* ru)
 {
     bool has_live_join = false;
 
     if (auto sl = LobbyProtocol::get<LobbyProtocol>())
         has_live_join = sl->hasLiveJoiningRecently();
 
-    BareNetworkString* buffer = new BareNetworkString();
     // This will compress and round down values of body, use the rounded
     // down value to test if sending state is needed
     // If any client live-joined always send new state for this object
-    CompressNetworkBody::compress(m_body, m_motion_state, buffer);
+    if (!NetworkConfig::get()->useBitPackedState())
+        CompressNetworkBody::compress(m_body, m_motion_state, buffer);
+    else
+    {
+        BitWriter bw(buffer);
+        CompressNetworkBody::compress(m_body, m_motion_state, &bw);
+    }
     btTransform cur_transform = m_body->getWorldTransform();
     Vec3 current_lv = m_body->getLinearVelocity();
     Vec3 current_av = m_body->getAngularVelocity();
@@ -859,22 +865,27 @@ BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
         (current_lv - m_last_lv).length() < 0.01f &&
         (current_av - m_last_av).length() < 0.01f && !has_live_join)
     {
-        delete buffer;
-        return nullptr;
+        return false;
     }
 
-    ru->push_back(getUniqueIdentity());
+    ru->push_back(getRewinderID());
     m_last_transform = cur_transform;
     m_last_lv = current_lv;
     m_last_av = current_av;
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
 void PhysicalObject::restoreState(BareNetworkString *buffer, int count)
 {
     m_no_server_state = false;
-    CompressNetworkBody::decompress(buffer, m_body, m_motion_state);
+    if (!NetworkConfig::get()->useBitPackedState())
+        CompressNetworkBody::decompress(buffer, m_body, m_motion_state);
+    else
+    {
+        BitReader br(buffer);
+        CompressNetworkBody::decompress(&br, m_body, m_motion_state);
+    }
     // Save the newly decompressed value for local state restore
     m_last_transform = m_body->getWorldTransform();
     m_last_lv = m_body->getLinearVelocity();
@@ -210,7 +210,7 @@ void Physics::update(int ticks)
     // clean up is then done later in the projectile manager.
     std::vector<CollisionPair>::iterator p;
     // Child process currently has no scripting engine
-    bool is_child = STKProcess::getType() == PT_CHILD;
+    bool is_child = STKProcess::isChild();
     for(p=m_all_collisions.begin(); p!=m_all_collisions.end(); ++p)
     {
         // Kart-kart collision
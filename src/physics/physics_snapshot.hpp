@@ -0,0 +1,78 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_PHYSICS_SNAPSHOT_HPP
+#define HEADER_PHYSICS_SNAPSHOT_HPP
+
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+
+/** \brief The dynamic values of a rigid body as a flat struct, so the
+ *  physics state of a body at a certain time can be kept and restored
+ *  with a plain copy instead of being (de)serialized.
+ *  \ingroup physics
+ */
+struct RigidBodySnapshot
+{
+    btTransform m_world_transform;
+    btTransform m_interpolation_world_transform;
+    btTransform m_motion_state_transform;
+    btVector3   m_linear_velocity;
+    btVector3   m_angular_velocity;
+    btVector3   m_interpolation_linear_velocity;
+    btVector3   m_interpolation_angular_velocity;
+    btScalar    m_deactivation_time;
+    int         m_activation_state;
+
+    // ------------------------------------------------------------------------
+    void save(const btRigidBody* body)
+    {
+        m_world_transform = body->getWorldTransform();
+        m_interpolation_world_transform =
+            body->getInterpolationWorldTransform();
+        if (body->getMotionState())
+            body->getMotionState()->getWorldTransform(m_motion_state_transform);
+        m_linear_velocity = body->getLinearVelocity();
+        m_angular_velocity = body->getAngularVelocity();
+        m_interpolation_linear_velocity =
+            body->getInterpolationLinearVelocity();
+        m_interpolation_angular_velocity =
+            body->getInterpolationAngularVelocity();
+        m_deactivation_time = body->getDeactivationTime();
+        m_activation_state = body->getActivationState();
+    }   // save
+    // ------------------------------------------------------------------------
+    void restore(btRigidBody* body) const
+    {
+        body->setWorldTransform(m_world_transform);
+        body->setInterpolationWorldTransform(m_interpolation_world_transform);
+        if (body->getMotionState())
+            body->getMotionState()->setWorldTransform(m_motion_state_transform);
+        body->setLinearVelocity(m_linear_velocity);
+        body->setAngularVelocity(m_angular_velocity);
+        body->setInterpolationLinearVelocity(m_interpolation_linear_velocity);
+        body->setInterpolationAngularVelocity(
+            m_interpolation_angular_velocity);
+        // Forces are cleared after each physics step anyway
+        body->clearForces();
+        body->setDeactivationTime(m_deactivation_time);
+        body->forceActivationState(m_activation_state);
+    }   // restore
+
+};   // RigidBodySnapshot
+
+#endif
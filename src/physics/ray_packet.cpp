@@ -0,0 +1,616 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "physics/ray_packet.hpp"
+
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
+
+#include <assert.h>
+#include <cmath>
+#include <vector>
+
+#if __SSE2__ || _M_X64 || _M_IX86_FP >= 2
+ #include <emmintrin.h>
+ #define SIMD_SSE2_SUPPORT (1)
+#endif
+
+namespace
+{
+    // ------------------------------------------------------------------------
+    // Four floats, one per ray of a group. Comparisons return masks, which
+    // are only used with vand, select and lanes.
+#if SIMD_SSE2_SUPPORT
+    typedef __m128 Float4;
+    inline Float4 splat(float f)               { return _mm_set1_ps(f);    }
+    inline Float4 load(const float *f)         { return _mm_loadu_ps(f);   }
+    inline void store(Float4 a, float *f)      { _mm_storeu_ps(f, a);      }
+    inline Float4 add(Float4 a, Float4 b)      { return _mm_add_ps(a, b);  }
+    inline Float4 sub(Float4 a, Float4 b)      { return _mm_sub_ps(a, b);  }
+    inline Float4 mul(Float4 a, Float4 b)      { return _mm_mul_ps(a, b);  }
+    inline Float4 div(Float4 a, Float4 b)      { return _mm_div_ps(a, b);  }
+    inline Float4 vmin(Float4 a, Float4 b)     { return _mm_min_ps(a, b);  }
+    inline Float4 vmax(Float4 a, Float4 b)     { return _mm_max_ps(a, b);  }
+    inline Float4 cmpLt(Float4 a, Float4 b)    { return _mm_cmplt_ps(a, b);}
+    inline Float4 cmpLe(Float4 a, Float4 b)    { return _mm_cmple_ps(a, b);}
+    inline Float4 cmpGe(Float4 a, Float4 b)    { return _mm_cmpge_ps(a, b);}
+    inline Float4 vand(Float4 a, Float4 b)     { return _mm_and_ps(a, b);  }
+    /** Returns a bit for each lane in which the mask is set. */
+    inline int lanes(Float4 mask)              { return _mm_movemask_ps(mask); }
+    /** Returns b in the lanes where mask is set, a otherwise. */
+    inline Float4 select(Float4 mask, Float4 a, Float4 b)
+    {
+        return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+    }
+#else
+    struct Float4 { float v[4]; };
+#define FLOAT4_OP(name, expr)                                          \
+    inline Float4 name(Float4 a, Float4 b)                             \
+    {                                                                  \
+        Float4 r;                                                      \
+        for (int i = 0; i < 4; i++) { float x = a.v[i], y = b.v[i];    \
+                                      r.v[i] = (expr); }               \
+        return r;                                                      \
+    }
+    FLOAT4_OP(add,   x + y)
+    FLOAT4_OP(sub,   x - y)
+    FLOAT4_OP(mul,   x * y)
+    FLOAT4_OP(div,   x / y)
+    FLOAT4_OP(vmin,  x < y ? x : y)
+    FLOAT4_OP(vmax,  x > y ? x : y)
+    FLOAT4_OP(cmpLt, x <  y ? 1.0f : 0.0f)
+    FLOAT4_OP(cmpLe, x <= y ? 1.0f : 0.0f)
+    FLOAT4_OP(cmpGe, x >= y ? 1.0f : 0.0f)
+    FLOAT4_OP(vand,  x * y)
+#undef FLOAT4_OP
+    inline Float4 splat(float f)
+    {
+        Float4 r;
+        for (int i = 0; i < 4; i++) r.v[i] = f;
+        return r;
+    }
+    inline Float4 load(const float *f)
+    {
+        Float4 r;
+        for (int i = 0; i < 4; i++) r.v[i] = f[i];
+        return r;
+    }
+    inline void store(Float4 a, float *f)
+    {
+        for (int i = 0; i < 4; i++) f[i] = a.v[i];
+    }
+    inline int lanes(Float4 mask)
+    {
+        int r = 0;
+        for (int i = 0; i < 4; i++) if (mask.v[i] != 0.0f) r |= 1 << i;
+        return r;
+    }
+    inline Float4 select(Float4 mask, Float4 a, Float4 b)
+    {
+        Float4 r;
+        for (int i = 0; i < 4; i++) r.v[i] = mask.v[i] != 0.0f ? b.v[i] : a.v[i];
+        return r;
+    }
+#endif
+
+    // ------------------------------------------------------------------------
+    /** Four rays, stored by component. */
+    struct RayGroup
+    {
+        Float4 m_from[3];
+        Float4 m_to[3];
+        /** Inverse of the direction (to - from), for the slab test. */
+        Float4 m_inv_dir[3];
+        /** Fraction of the closest hit so far, 1 if nothing was hit yet. */
+        Float4 m_best;
+        /** Quantized bounding box of the four rays, to skip most nodes
+         *  with an integer test like bullet does. */
+        unsigned short m_quantized_min[3];
+        unsigned short m_quantized_max[3];
+    };   // RayGroup
+
+    /** Returns the index of the lowest bit set in a (non zero) mask. */
+    inline unsigned int lowestBit(uint64_t mask)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return (unsigned int)__builtin_ctzll(mask);
+#else
+        unsigned int i = 0;
+        while (!(mask & 1))
+        {
+            mask >>= 1;
+            i++;
+        }
+        return i;
+#endif
+    }   // lowestBit
+
+    // ------------------------------------------------------------------------
+    /** At most this many rays are traversed together, so that the groups a
+     *  node is tested against fit in a 64 bit mask. */
+    const unsigned int MAX_GROUPS = 64;
+
+    // ------------------------------------------------------------------------
+    /** Read access to the triangles of all parts of a bullet mesh. */
+    class MeshTriangles
+    {
+    private:
+        struct Part
+        {
+            const unsigned char *m_vertices;
+            const unsigned char *m_indices;
+            int                  m_vertex_stride;
+            int                  m_index_stride;
+            PHY_ScalarType       m_index_type;
+        };
+        const btStridingMeshInterface *m_mesh;
+        std::vector<Part>              m_parts;
+        btVector3                      m_scaling;
+
+    public:
+        MeshTriangles(const btStridingMeshInterface *mesh)
+            : m_mesh(mesh), m_scaling(mesh->getScaling()) {}
+        // --------------------------------------------------------------------
+        ~MeshTriangles()
+        {
+            for (unsigned int i = 0; i < m_parts.size(); i++)
+                m_mesh->unLockReadOnlyVertexBase(i);
+        }   // ~MeshTriangles
+        // --------------------------------------------------------------------
+        /** Locks all parts of the mesh. Returns false if a part has a
+         *  vertex or index type which is not supported. */
+        bool lock()
+        {
+            for (int i = 0; i < m_mesh->getNumSubParts(); i++)
+            {
+                Part part;
+                int num_vertices, num_faces;
+                PHY_ScalarType vertex_type;
+                m_mesh->getLockedReadOnlyVertexIndexBase(&part.m_vertices,
+                    num_vertices, vertex_type, part.m_vertex_stride,
+                    &part.m_indices, part.m_index_stride, num_faces,
+                    part.m_index_type, i);
+                m_parts.push_back(part);
+                if (vertex_type != PHY_FLOAT ||
+                    (part.m_index_type != PHY_INTEGER &&
+                     part.m_index_type != PHY_SHORT))
+                    return false;
+            }
+            return true;
+        }   // lock
+        // --------------------------------------------------------------------
+        /** Returns the three (scaled) points of a triangle. */
+        void get(int part_id, int index, btVector3 *v) const
+        {
+            const Part &part = m_parts[part_id];
+            const unsigned char *indices =
+                part.m_indices + index * part.m_index_stride;
+            for (int i = 0; i < 3; i++)
+            {
+                const int vertex = part.m_index_type == PHY_INTEGER
+                                 ? ((const int*)indices)[i]
+                                 : ((const unsigned short*)indices)[i];
+                const float *p = (const float*)(part.m_vertices +
+                                                vertex * part.m_vertex_stride);
+                v[i] = btVector3(p[0], p[1], p[2]) * m_scaling;
+            }
+        }   // get
+    };   // MeshTriangles
+
+    // ------------------------------------------------------------------------
+    /** Returns a bit for each ray of the group which enters the box before
+     *  its closest hit. */
+    inline int overlaps(const RayGroup &rays, const Float4 *lo,
+                        const Float4 *hi)
+    {
+        Float4 t_near = splat(0.0f), t_far = rays.m_best;
+        for (int i = 0; i < 3; i++)
+        {
+            const Float4 t0 = mul(sub(lo[i], rays.m_from[i]),
+                                  rays.m_inv_dir[i]);
+            const Float4 t1 = mul(sub(hi[i], rays.m_from[i]),
+                                  rays.m_inv_dir[i]);
+            t_near = vmax(t_near, vmin(t0, t1));
+            t_far  = vmin(t_far,  vmax(t0, t1));
+        }
+        return lanes(cmpLe(t_near, t_far));
+    }   // overlaps
+
+    // ------------------------------------------------------------------------
+    /** Tests a group of rays against one triangle, using the same test as
+     *  btTriangleRaycastCallback::processTriangle. Updates the closest hits
+     *  of the rays which hit the triangle before their closest hit.
+     *  \param index, back_face Triangle index and side of the closest hit
+     *         of the four rays of the group. */
+    inline void testTriangle(RayGroup *rays, const btVector3 *v,
+                             int triangle, int *index, bool *back_face)
+    {
+        const btVector3 normal = (v[1] - v[0]).cross(v[2] - v[0]);
+        const float dist = v[0].dot(normal);
+        const Float4 n[3] = { splat(normal.getX()), splat(normal.getY()),
+                              splat(normal.getZ()) };
+        const Float4 d = splat(dist);
+
+        const Float4 dist_a = sub(add(add(mul(n[0], rays->m_from[0]),
+                                          mul(n[1], rays->m_from[1])),
+                                      mul(n[2], rays->m_from[2])), d);
+        const Float4 dist_b = sub(add(add(mul(n[0], rays->m_to[0]),
+                                          mul(n[1], rays->m_to[1])),
+                                      mul(n[2], rays->m_to[2])), d);
+        const Float4 zero = splat(0.0f);
+        Float4 valid = cmpLt(mul(dist_a, dist_b), zero);
+        const Float4 distance = div(dist_a, sub(dist_a, dist_b));
+        valid = vand(valid, cmpLt(distance, rays->m_best));
+        if (!lanes(valid))
+            return;
+
+        // Intersection point with the plane of the triangle
+        const Float4 s = sub(splat(1.0f), distance);
+        Float4 p[3];
+        for (int i = 0; i < 3; i++)
+        {
+            p[i] = add(mul(s, rays->m_from[i]), mul(distance, rays->m_to[i]));
+        }
+        // The point is inside if it is on the inner side of all three edges
+        const Float4 tolerance = splat(normal.length2() * -0.0001f);
+        Float4 vp[3][3];
+        for (int k = 0; k < 3; k++)
+        {
+            for (int i = 0; i < 3; i++)
+                vp[k][i] = sub(splat(v[k][i]), p[i]);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            const Float4 *a = vp[k], *b = vp[(k + 1) % 3];
+            const Float4 cross_dot =
+                add(add(mul(sub(mul(a[1], b[2]), mul(a[2], b[1])), n[0]),
+                        mul(sub(mul(a[2], b[0]), mul(a[0], b[2])), n[1])),
+                    mul(sub(mul(a[0], b[1]), mul(a[1], b[0])), n[2]));
+            valid = vand(valid, cmpGe(cross_dot, tolerance));
+        }
+        const int hit = lanes(valid);
+        if (!hit)
+            return;
+
+        rays->m_best = select(valid, rays->m_best, distance);
+        float side[4];
+        store(dist_a, side);
+        for (int i = 0; i < 4; i++)
+        {
+            if (hit & (1 << i))
+            {
+                index[i]     = triangle;
+                back_face[i] = side[i] <= 0.0f;
+            }
+        }
+    }   // testTriangle
+
+    // ------------------------------------------------------------------------
+    /** Casts up to 4 * MAX_GROUPS rays against the BVH. */
+    void castGroups(btQuantizedBvh *bvh, const MeshTriangles &triangles,
+                    const btVector3 *from, const btVector3 *to,
+                    unsigned int count, RayPacket::Hit *hits)
+    {
+        const unsigned int num_groups = (count + 3) / 4;
+        assert(num_groups <= MAX_GROUPS);
+        RayGroup groups[MAX_GROUPS];
+        int index[4 * MAX_GROUPS];
+        bool back_face[4 * MAX_GROUPS];
+        for (unsigned int g = 0; g < num_groups; g++)
+        {
+            float f[3][4], t[3][4], inv[3][4];
+            for (unsigned int l = 0; l < 4; l++)
+            {
+                // The last group is padded with copies of the last ray
+                const unsigned int r = std::min(g * 4 + l, count - 1);
+                for (int i = 0; i < 3; i++)
+                {
+                    f[i][l] = from[r][i];
+                    t[i][l] = to[r][i];
+                    const float dir = t[i][l] - f[i][l];
+                    inv[i][l] = dir == 0.0f ? BT_LARGE_FLOAT : 1.0f / dir;
+                }
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                groups[g].m_from[i]    = load(f[i]);
+                groups[g].m_to[i]      = load(t[i]);
+                groups[g].m_inv_dir[i] = load(inv[i]);
+            }
+            groups[g].m_best = splat(1.0f);
+            btVector3 aabb_min = from[g * 4], aabb_max = from[g * 4];
+            for (unsigned int l = 0; l < 4 && g * 4 + l < count; l++)
+            {
+                aabb_min.setMin(from[g * 4 + l]);
+                aabb_min.setMin(to[g * 4 + l]);
+                aabb_max.setMax(from[g * 4 + l]);
+                aabb_max.setMax(to[g * 4 + l]);
+            }
+            bvh->quantizeWithClamp(groups[g].m_quantized_min, aabb_min, 0);
+            bvh->quantizeWithClamp(groups[g].m_quantized_max, aabb_max, 1);
+        }
+        for (unsigned int i = 0; i < 4 * num_groups; i++)
+        {
+            index[i]     = -1;
+            back_face[i] = false;
+        }
+
+        // Depth first traversal, left child first like bullet's own
+        // traversal, so that triangles hit at the same distance are
+        // resolved the same way.
+        struct StackEntry
+        {
+            int      m_node;
+            /** The groups which overlapped the parent node. */
+            uint64_t m_groups;
+        };
+        std::vector<StackEntry> stack;
+        stack.reserve(64);
+        StackEntry root = { 0, num_groups == 64
+                             ? ~uint64_t(0)
+                             : (uint64_t(1) << num_groups) - 1 };
+        stack.push_back(root);
+        const btQuantizedBvhNode *nodes = &bvh->getQuantizedNodeArray()[0];
+        const unsigned short zero[3] = { 0, 0, 0 }, one[3] = { 1, 1, 1 };
+        const btVector3 bvh_min = bvh->unQuantize(zero);
+        const btVector3 quantum = bvh->unQuantize(one) - bvh_min;
+        while (!stack.empty())
+        {
+            const StackEntry entry = stack.back();
+            stack.pop_back();
+            const btQuantizedBvhNode &node = nodes[entry.m_node];
+            uint64_t candidates = 0;
+            for (uint64_t m = entry.m_groups; m; m &= m - 1)
+            {
+                const unsigned int g = lowestBit(m);
+                if (testQuantizedAabbAgainstQuantizedAabb(
+                        groups[g].m_quantized_min, groups[g].m_quantized_max,
+                        node.m_quantizedAabbMin, node.m_quantizedAabbMax))
+                    candidates |= uint64_t(1) << g;
+            }
+            if (!candidates)
+                continue;
+
+            Float4 lo[3], hi[3];
+            for (int i = 0; i < 3; i++)
+            {
+                lo[i] = splat(bvh_min[i] +
+                              quantum[i] * node.m_quantizedAabbMin[i]);
+                hi[i] = splat(bvh_min[i] +
+                              quantum[i] * node.m_quantizedAabbMax[i]);
+            }
+            uint64_t active = 0;
+            for (uint64_t m = candidates; m; m &= m - 1)
+            {
+                const unsigned int g = lowestBit(m);
+                if (overlaps(groups[g], lo, hi))
+                    active |= uint64_t(1) << g;
+            }
+            if (!active)
+                continue;
+
+            if (node.isLeafNode())
+            {
+                btVector3 v[3];
+                triangles.get(node.getPartId(), node.getTriangleIndex(), v);
+                for (uint64_t m = active; m; m &= m - 1)
+                {
+                    const unsigned int g = lowestBit(m);
+                    testTriangle(&groups[g], v, node.getTriangleIndex(),
+                                 &index[g * 4], &back_face[g * 4]);
+                }
+                continue;
+            }
+            const int left = entry.m_node + 1;
+            const int right = nodes[left].isLeafNode()
+                            ? left + 1
+                            : left + nodes[left].getEscapeIndex();
+            StackEntry child = { right, active };
+            stack.push_back(child);
+            child.m_node = left;
+            stack.push_back(child);
+        }   // while !stack.empty()
+
+        for (unsigned int g = 0; g < num_groups; g++)
+        {
+            float best[4];
+            store(groups[g].m_best, best);
+            for (unsigned int l = 0; l < 4 && g * 4 + l < count; l++)
+            {
+                RayPacket::Hit &hit = hits[g * 4 + l];
+                hit.m_fraction       = best[l];
+                hit.m_triangle_index = index[g * 4 + l];
+                hit.m_back_face      = back_face[g * 4 + l];
+            }
+        }
+    }   // castGroups
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Casts rays against a triangle mesh shape in its local space.
+ *  \param shape The shape, which must be a btBvhTriangleMeshShape with a
+ *         quantized BVH.
+ *  \param from, to Start and end points of the rays, in the space of the
+ *         shape.
+ *  \param count Number of rays.
+ *  \param hits On return the closest hit of each ray.
+ *  \return False if the rays can't be cast against this shape (and hits is
+ *          not changed), in which case single ray tests must be used.
+ */
+bool RayPacket::cast(btCollisionShape *shape, const btVector3 *from,
+                     const btVector3 *to, unsigned int count, Hit *hits)
+{
+    if (!shape || shape->getShapeType() != TRIANGLE_MESH_SHAPE_PROXYTYPE)
+        return false;
+    btBvhTriangleMeshShape *mesh = static_cast<btBvhTriangleMeshShape*>(shape);
+    btOptimizedBvh *bvh = mesh->getOptimizedBvh();
+    if (!bvh || !bvh->isQuantized() || bvh->getQuantizedNodeArray().size() == 0)
+        return false;
+    MeshTriangles triangles(mesh->getMeshInterface());
+    if (!triangles.lock())
+        return false;
+
+    for (unsigned int start = 0; start < count; start += 4 * MAX_GROUPS)
+    {
+        castGroups(bvh, triangles, from + start, to + start,
+                   std::min(count - start, 4 * MAX_GROUPS), hits + start);
+    }
+    return true;
+}   // cast
+
+// ----------------------------------------------------------------------------
+void RayPacket::unitTesting()
+{
+    // A hilly terrain with 2 * 200 * 200 triangles
+    const int n = 200;
+    btTriangleMesh mesh;
+    for (int x = 0; x < n; x++)
+    {
+        for (int z = 0; z < n; z++)
+        {
+            btVector3 p[4];
+            for (int i = 0; i < 4; i++)
+            {
+                const float px = (float)(x + (i & 1));
+                const float pz = (float)(z + (i >> 1));
+                p[i] = btVector3(px, sinf(px * 0.1f) * cosf(pz * 0.07f) * 5.0f,
+                    pz);
+            }
+            mesh.addTriangle(p[0], p[1], p[2]);
+            mesh.addTriangle(p[1], p[3], p[2]);
+        }
+    }
+    btBvhTriangleMeshShape shape(&mesh, /*useQuantizedAabbCompression*/true);
+
+    // The suspension rays of 20 karts with 4 wheels during 100 ticks, some
+    // of them ending above the terrain
+    const int num_karts = 20, num_ticks = 100, rays_per_kart = 4;
+    const int num_rays = num_karts * rays_per_kart;
+    std::vector<btVector3> from(num_rays * num_ticks), to(num_rays * num_ticks);
+    unsigned int seed = 1;
+    for (int i = 0; i < num_karts * num_ticks; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        const float x = (float)(seed >> 16 & 0x7fff) / 32768.0f * (n - 4) + 2;
+        seed = seed * 1103515245 + 12345;
+        const float z = (float)(seed >> 16 & 0x7fff) / 32768.0f * (n - 4) + 2;
+        const float y = sinf(x * 0.1f) * cosf(z * 0.07f) * 5.0f +
+                        (i % 7 == 0 ? 3.0f : 0.6f);
+        for (int w = 0; w < 4; w++)
+        {
+            const btVector3 hard_point(x + (w & 1) * 0.8f - 0.4f, y,
+                                       z + (w >> 1) * 1.2f - 0.6f);
+            from[i * rays_per_kart + w] = hard_point;
+            to  [i * rays_per_kart + w] = hard_point +
+                                          btVector3(0.05f, -1.5f, 0.1f);
+        }
+    }
+
+    // Single rays, the way TriangleMesh::castRay tests them
+    class IndexRayResult : public btCollisionWorld::ClosestRayResultCallback
+    {
+    public:
+        int m_index;
+        IndexRayResult(const btVector3 &p1, const btVector3 &p2)
+            : btCollisionWorld::ClosestRayResultCallback(p1, p2), m_index(-1)
+        {
+        }
+        virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult &r,
+                                         bool normal_in_world_space)
+        {
+            m_index = r.m_localShapeInfo->m_triangleIndex;
+            return btCollisionWorld::ClosestRayResultCallback
+                   ::addSingleResult(r, normal_in_world_space);
+        }
+    };   // IndexRayResult
+
+    btCollisionObject object;
+    btTransform identity;
+    identity.setIdentity();
+    std::vector<float> fraction(from.size());
+    std::vector<int> index(from.size());
+    std::vector<btVector3> normal(from.size());
+    uint64_t t0 = StkTime::getMonoTimeUs();
+    for (unsigned int i = 0; i < from.size(); i++)
+    {
+        btTransform tf_from(identity), tf_to(identity);
+        tf_from.setOrigin(from[i]);
+        tf_to.setOrigin(to[i]);
+        IndexRayResult result(from[i], to[i]);
+        btCollisionWorld::rayTestSingle(tf_from, tf_to, &object, &shape,
+                                        identity, result);
+        fraction[i] = result.m_closestHitFraction;
+        index[i]    = result.hasHit() ? result.m_index : -1;
+        normal[i]   = result.m_hitNormalWorld;
+    }
+    uint64_t t1 = StkTime::getMonoTimeUs();
+
+    // The same rays, one packet per tick
+    std::vector<RayPacket::Hit> hits(from.size());
+    for (int tick = 0; tick < num_ticks; tick++)
+    {
+        bool success = RayPacket::cast(&shape, &from[tick * num_rays],
+                                       &to[tick * num_rays], num_rays,
+                                       &hits[tick * num_rays]);
+        assert(success);
+        (void)success;
+    }
+    uint64_t t2 = StkTime::getMonoTimeUs();
+
+    int num_hits = 0;
+    for (unsigned int i = 0; i < from.size(); i++)
+    {
+        assert(hits[i].m_triangle_index == index[i]);
+        if (index[i] == -1)
+            continue;
+        num_hits++;
+        assert(fabsf(hits[i].m_fraction - fraction[i]) < 0.0001f);
+        btVector3 v[3];
+        const unsigned char *vertices, *indices;
+        int num_vertices, vertex_stride, index_stride, num_faces;
+        PHY_ScalarType vertex_type, index_type;
+        mesh.getLockedReadOnlyVertexIndexBase(&vertices, num_vertices,
+            vertex_type, vertex_stride, &indices, index_stride, num_faces,
+            index_type);
+        const int *tri = (const int*)(indices + index[i] * index_stride);
+        for (int k = 0; k < 3; k++)
+        {
+            const float *p = (const float*)(vertices + tri[k] * vertex_stride);
+            v[k] = btVector3(p[0], p[1], p[2]);
+        }
+        mesh.unLockReadOnlyVertexBase(0);
+        btVector3 n = (v[1] - v[0]).cross(v[2] - v[0]).normalized();
+        if (hits[i].m_back_face)
+            n = -n;
+        assert(n.distance(normal[i]) < 0.001f);
+    }
+    assert(num_hits > 0 && num_hits < (int)from.size());
+
+    // Nothing is cast against shapes without a quantized BVH
+    btBoxShape box(btVector3(1, 1, 1));
+    assert(!RayPacket::cast(&box, &from[0], &to[0], 1, &hits[0]));
+
+    Log::info("RayPacket", "%d rays against %d triangles: %.2f Mrays/s with "
+        "single rays, %.2f Mrays/s with a packet per tick.",
+        (int)from.size(), mesh.getNumTriangles(),
+        (float)from.size() / std::max<float>((float)(t1 - t0), 1.0f),
+        (float)from.size() / std::max<float>((float)(t2 - t1), 1.0f));
+}   // unitTesting
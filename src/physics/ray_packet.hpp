@@ -0,0 +1,56 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_RAY_PACKET_HPP
+#define HEADER_RAY_PACKET_HPP
+
+class btCollisionShape;
+class btVector3;
+
+/**
+ * \brief Casts many rays at once against the quantized BVH of a triangle
+ *  mesh.
+ *  The rays are tested in groups of four against the bounding boxes and the
+ *  triangles (using SSE if available), and the BVH is traversed only once
+ *  for all rays, skipping nodes no ray reaches any more. The triangle test
+ *  is the one of bullet's btTriangleRaycastCallback, so the closest hit is
+ *  the one a single ray test against the mesh would find.
+ * \ingroup physics
+ */
+class RayPacket
+{
+public:
+    /** The result of one ray, in the local space of the mesh. */
+    struct Hit
+    {
+        /** Fraction of the ray at which the closest triangle was hit,
+         *  1 if no triangle was hit. */
+        float m_fraction;
+        /** Index of the triangle hit, or -1 if no triangle was hit. */
+        int   m_triangle_index;
+        /** True if the ray hit the back of the triangle, i.e. the normal
+         *  facing the start of the ray is the negated triangle normal. */
+        bool  m_back_face;
+    };   // Hit
+
+    static bool cast(btCollisionShape *shape, const btVector3 *from,
+                     const btVector3 *to, unsigned int count, Hit *hits);
+    static void unitTesting();
+};   // RayPacket
+
+#endif
@@ -0,0 +1,78 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "physics/stk_dynamics_world.hpp"
+
+#include "physics/btKart.hpp"
+#include "tracks/track.hpp"
+
+// ----------------------------------------------------------------------------
+/** Updates all actions (i.e. the karts). Before that the suspension rays of
+ *  all karts are cast against the track as one packet.
+ *  \param time_step The time step of the simulation.
+ */
+void STKDynamicsWorld::updateActions(btScalar time_step)
+{
+    castWheelRays();
+    btDiscreteDynamicsWorld::updateActions(time_step);
+
+    // Raycasts outside of the physics step test the whole world again
+    for (int i = 0; i < m_actions.size(); i++)
+    {
+        btKart* kart = dynamic_cast<btKart*>(m_actions[i]);
+        if (kart)
+            kart->getRaycaster()->clearTrackRays();
+    }
+}   // updateActions
+
+// ----------------------------------------------------------------------------
+/** Casts the suspension rays of all karts against the track mesh at once,
+ *  which is faster than casting each ray on its own. The karts are not
+ *  moved before their own update, so each kart then only needs to test the
+ *  other objects in the world for its rays.
+ */
+void STKDynamicsWorld::castWheelRays()
+{
+    Track* track = Track::getCurrentTrack();
+    if (!track || !track->getPtrTriangleMesh() ||
+        !track->getPtrTriangleMesh()->getBody())
+        return;
+    const TriangleMesh* track_mesh = track->getPtrTriangleMesh();
+
+    m_wheel_rays.clear();
+    for (int i = 0; i < m_actions.size(); i++)
+    {
+        btKart* kart = dynamic_cast<btKart*>(m_actions[i]);
+        if (kart)
+            kart->addWheelRays(&m_wheel_rays);
+    }
+    if (m_wheel_rays.size() == 0)
+        return;
+    track_mesh->castRays(&m_wheel_rays[0], (unsigned int)m_wheel_rays.size());
+
+    unsigned int start = 0;
+    for (int i = 0; i < m_actions.size(); i++)
+    {
+        btKart* kart = dynamic_cast<btKart*>(m_actions[i]);
+        if (!kart)
+            continue;
+        kart->getRaycaster()->setTrackRays(track_mesh, &m_wheel_rays[start],
+                                           kart->getNumWheels());
+        start += kart->getNumWheels();
+    }
+}   // castWheelRays
@@ -21,12 +21,26 @@
 
 #include "btBulletDynamicsCommon.h"
 
+#include "physics/triangle_mesh.hpp"
+#include "utils/aligned_array.hpp"
+
 /** A thin wrapper around bullet's btDiscreteDynamicsWorld. Used to
  *  be able to query and set the 'left over' time from a previous
  *  time step, which is needed for more precise rewind/replays.
+ *  It also casts the suspension rays of all karts against the track
+ *  together before the karts are updated.
  */
 class STKDynamicsWorld : public btDiscreteDynamicsWorld
 {
+private:
+    /** The suspension rays of all karts in the current step. */
+    AlignedArray<TriangleMesh::Ray> m_wheel_rays;
+
+    void castWheelRays();
+
+protected:
+    virtual void updateActions(btScalar time_step);
+
 public:
     /** The standard constructor which just created a btDiscreteDynamicsWorld. */
     STKDynamicsWorld(btDispatcher*             dispatcher,
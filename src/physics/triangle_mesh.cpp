@@ -19,16 +19,17 @@
 #include "physics/triangle_mesh.hpp"
 
 #include "config/stk_config.hpp"
+#include "io/file_manager.hpp"
 #include "main_loop.hpp"
+#include "physics/bvh_cache.hpp"
 #include "physics/physics.hpp"
+#include "physics/ray_packet.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
 #include "utils/time.hpp"
 
 #include "btBulletDynamicsCommon.h"
 
-#include <fstream>
-
 // -----------------------------------------------------------------------------
 /** Constructor: Initialises all data structures with zero.
  */
@@ -90,10 +91,13 @@ void TriangleMesh::addTriangle(const btVector3 &t1, const btVector3 &t2,
 // -----------------------------------------------------------------------------
 /** Creates a collision body only, which can be used for raycasting, but
  *  has no physical properties.
- *  @param serialized_bhv if non-null, load the serialized bhv from file instead
- *                        of builing it on the fly
+ *  \param create_collision_object If a collision object is created too.
+ *  \param cache_bvh If the BVH is loaded from (or stored in) the cache of
+ *         static meshes, which should be used for large meshes which are
+ *         not changed (like the track).
  */
-void TriangleMesh::createCollisionShape(bool create_collision_object, const char* serialized_bhv)
+void TriangleMesh::createCollisionShape(bool create_collision_object,
+                                        bool cache_bvh)
 {
     if(m_triangleIndex2Material.size()==0)
     {
@@ -105,54 +109,23 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
     }
     // Now convert the triangle mesh into a static rigid body
     btBvhTriangleMeshShape* bhv_triangle_mesh;
+    const bool quantized = BvhCache::canQuantize(&m_mesh);
 
-    if (serialized_bhv != NULL)
+    if (cache_bvh)
     {
-        FILE *f = fopen(serialized_bhv, "rb");
-        fseek(f, 0, SEEK_END);
-        long pos = ftell(f);
-        assert(pos != -1L);
-        fseek(f, 0, SEEK_SET);
-
-        void* bytes = btAlignedAlloc(pos, 16);
-        fread(bytes, pos, 1, f);
-        fclose(f);
-
-        btOptimizedBvh* bhv = btOptimizedBvh::deSerializeInPlace(bytes, pos, !IS_LITTLE_ENDIAN);
-        if (bhv == NULL)
-        {
-            Log::warn("TriangleMesh", "Failed to load serialized BHV");
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-        }
-        else
-        {
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */,
-                                                           false /* buildBvh */);
-            bhv_triangle_mesh->setOptimizedBvh( bhv );
-        }
-        // Do *NOT* free the bytes, 'deSerializeInPlace' makes the btOptimizedBvh object
-        // directly at this memory location
-        //free(bytes);
-
+        // The bounding box of the mesh is computed without building the BVH
+        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh,
+            quantized /* useQuantizedAabbCompression */, false /* buildBvh */);
+        m_cached_bvh = BvhCache::get(&m_mesh,
+            bhv_triangle_mesh->getLocalAabbMin(),
+            bhv_triangle_mesh->getLocalAabbMax(),
+            file_manager->getCachedPhysicsDir());
+        bhv_triangle_mesh->setOptimizedBvh(m_cached_bvh->getBvh());
     }
     else
     {
-        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-
-        /*
-         // code to serialize triangle mesh
-        btOptimizedBvh* bvh = bhv_triangle_mesh->getOptimizedBvh();
-        unsigned int ssize = bvh->calculateSerializeBufferSize();
-        char* buffer = (char*)btAlignedAlloc(ssize, 16);
-        bool success = bvh->serialize(buffer, ssize, !IS_LITTLE_ENDIAN);
-        printf("serialization success = %i\n", success);
-
-        std::ofstream fileout("/tmp/btOptimizedBvh");
-        fileout.write(buffer, ssize);
-        fileout.close();
-
-        btAlignedFree(buffer);
-         */
+        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh,
+            quantized /* useQuantizedAabbCompression */);
     }
 
     m_collision_shape = bhv_triangle_mesh;
@@ -179,16 +152,16 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
  *  for height of terrain detection).
  *  \param friction Friction to be used for this TriangleMesh.
  *  \param flags Additional collision flags (default 0).
- *  \param serializedBhv if non-NULL, the bhv is deserialized instead of
- *                       being calculated on the fly
+ *  \param cache_bvh If the BVH is loaded from (or stored in) the cache of
+ *         static meshes.
  */
 void TriangleMesh::createPhysicalBody(float friction,
                                       btCollisionObject::CollisionFlags flags,
-                                      const char* serializedBhv)
+                                      bool cache_bvh)
 {
     // We need the collision shape, but not the collision object (since
     // this will be created when the dynamics body is anyway).
-    createCollisionShape(/*create_collision_object*/false, serializedBhv);
+    createCollisionShape(/*create_collision_object*/false, cache_bvh);
     main_loop->renderGUI(5583);
 
     btTransform startTransform;
@@ -233,6 +206,7 @@ void TriangleMesh::removeAll()
     }
     delete m_collision_shape;
     m_collision_shape = NULL;
+    m_cached_bvh.reset();
 }   // removeAll
 
 // -----------------------------------------------------------------------------
@@ -305,29 +279,15 @@ btVector3 TriangleMesh::getInterpolatedNormal(unsigned int index,
 }   // getInterpolatedNormal
 
 // ----------------------------------------------------------------------------
-/** Casts a ray from 'from' to 'to'. If a triangle of this mesh was hit,
- *  xyz and material will be set.
+/** Casts a ray against this mesh using bullet.
  *  \param from/to The from and to position for the raycast.
- *  \param xyz The position in world where the ray hit.
- *  \param material The material of the mesh that was hit.
- *  \param normal The intrapolated normal at that position.
- *  \param interpolate_normal If true, the returned normal is the interpolated
- *         based on the three normals of the triangle and the location of the
- *         hit point (which is more compute intensive, but results in much
- *         smoother results).
- *  \return True if a triangle was hit, false otherwise (and no output
- *          variable will be set.
+ *  \param fraction On return the fraction of the ray at the hit point.
+ *  \param normal On return the normal of the triangle hit, in world space.
+ *  \return The index of the triangle hit, or -1 if no triangle was hit.
  */
-bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
-                           btVector3 *xyz, const Material **material,
-                           btVector3 *normal, bool interpolate_normal) const
+int TriangleMesh::rayTest(const btVector3 &from, const btVector3 &to,
+                          btScalar *fraction, btVector3 *normal) const
 {
-    if(!m_collision_shape)
-    {
-        *material=NULL;
-        return false;
-    }
-
     btTransform trans_from;
     trans_from.setIdentity();
     trans_from.setOrigin(from);
@@ -343,8 +303,6 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
     else
         world_trans.setIdentity();
 
-    btCollisionWorld::ClosestRayResultCallback result(from, to);
-
     /** A special ray result class that stores the index of the triangle
      *  that was hit. */
     class MaterialRayResult : public btCollisionWorld::ClosestRayResultCallback
@@ -378,11 +336,44 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
                                     m_collision_object ? m_collision_object : m_body,
                                     m_collision_shape, world_trans,
                                     ray_callback);
+    if(!ray_callback.hasHit())
+        return -1;
+    *fraction = ray_callback.m_closestHitFraction;
+    *normal   = ray_callback.m_hitNormalWorld;
+    return ray_callback.m_index;
+}   // rayTest
+
+// ----------------------------------------------------------------------------
+/** Casts a ray from 'from' to 'to'. If a triangle of this mesh was hit,
+ *  xyz and material will be set.
+ *  \param from/to The from and to position for the raycast.
+ *  \param xyz The position in world where the ray hit.
+ *  \param material The material of the mesh that was hit.
+ *  \param normal The intrapolated normal at that position.
+ *  \param interpolate_normal If true, the returned normal is the interpolated
+ *         based on the three normals of the triangle and the location of the
+ *         hit point (which is more compute intensive, but results in much
+ *         smoother results).
+ *  \return True if a triangle was hit, false otherwise (and no output
+ *          variable will be set.
+ */
+bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
+                           btVector3 *xyz, const Material **material,
+                           btVector3 *normal, bool interpolate_normal) const
+{
+    if(!m_collision_shape)
+    {
+        *material=NULL;
+        return false;
+    }
+
+    btScalar fraction;
+    btVector3 hit_normal;
     // Get the index of the triangle hit
-    int index = ray_callback.m_index;
-    if(ray_callback.hasHit())
+    int index = rayTest(from, to, &fraction, &hit_normal);
+    if(index > -1)
     {
-        *xyz      = ray_callback.m_hitPointWorld;
+        xyz->setInterpolate3(from, to, fraction);
         xyz->setW(0.0f);
         *material = m_triangleIndex2Material[index];
 
@@ -392,10 +383,9 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
             // the normal of the triangle interpolate the normal at the
             // hit position based on the three normals of the triangle.
             if(interpolate_normal)
-                *normal = getInterpolatedNormal(ray_callback.m_index,
-                                                ray_callback.m_hitPointWorld);
+                *normal = getInterpolatedNormal(index, *xyz);
             else
-                *normal = ray_callback.m_hitNormalWorld;
+                *normal = hit_normal;
             normal->normalize();
         }
     }
@@ -405,6 +395,79 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
         if(normal)
             normal->setValue(0, 1, 0);
     }
-    return ray_callback.hasHit();
+    return index > -1;
 
 }   // castRay
+
+// ----------------------------------------------------------------------------
+/** Casts a number of rays at once. The result of each ray is the same as
+ *  castRay() would return, but the BVH of the mesh is traversed only once
+ *  for all rays (see RayPacket), which is faster if there are many rays.
+ *  \param rays The rays to cast, on return containing the hits.
+ *  \param count Number of rays.
+ *  \param interpolate_normal If the normals of the hits are interpolated
+ *         (see castRay()).
+ */
+void TriangleMesh::castRays(Ray *rays, unsigned int count,
+                            bool interpolate_normal) const
+{
+    if(!m_collision_shape || count == 0)
+    {
+        for(unsigned int i = 0; i < count; i++)
+            rays[i] = Ray(rays[i].m_from, rays[i].m_to);
+        return;
+    }
+
+    btTransform world_trans;
+    if(m_body)
+        world_trans = m_body->getWorldTransform();
+    else
+        world_trans.setIdentity();
+
+    // The packet is cast in the space of the mesh
+    AlignedArray<btVector3> from(count), to(count);
+    for(unsigned int i = 0; i < count; i++)
+    {
+        from[i] = world_trans.invXform(rays[i].m_from);
+        to[i]   = world_trans.invXform(rays[i].m_to);
+    }
+    std::vector<RayPacket::Hit> hits(count);
+    const bool packet = RayPacket::cast(m_collision_shape, &from[0], &to[0],
+                                        count, &hits[0]);
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        Ray &ray = rays[i];
+        ray = Ray(ray.m_from, ray.m_to);
+        if(packet)
+        {
+            ray.m_triangle_index = hits[i].m_triangle_index;
+            if(ray.m_triangle_index == -1)
+                continue;
+            ray.m_fraction = hits[i].m_fraction;
+            btVector3 p1, p2, p3;
+            getTriangle(ray.m_triangle_index, &p1, &p2, &p3);
+            ray.m_normal = world_trans.getBasis() *
+                           (p2 - p1).cross(p3 - p1).normalized();
+            if(hits[i].m_back_face)
+                ray.m_normal = -ray.m_normal;
+        }
+        else
+        {
+            // The BVH can't be cast against as a packet, e.g. because the
+            // mesh is too large for a quantized BVH
+            ray.m_triangle_index = rayTest(ray.m_from, ray.m_to,
+                                           &ray.m_fraction, &ray.m_normal);
+            if(ray.m_triangle_index == -1)
+                continue;
+        }
+        ray.m_hit = true;
+        ray.m_hit_point.setInterpolate3(ray.m_from, ray.m_to, ray.m_fraction);
+        ray.m_hit_point.setW(0.0f);
+        ray.m_material = m_triangleIndex2Material[ray.m_triangle_index];
+        if(interpolate_normal)
+            ray.m_normal = getInterpolatedNormal(ray.m_triangle_index,
+                                                 ray.m_hit_point);
+        ray.m_normal.normalize();
+    }
+}   // castRays
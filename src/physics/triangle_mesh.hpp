@@ -19,12 +19,14 @@
 #ifndef HEADER_TRIANGLE_MESH_HPP
 #define HEADER_TRIANGLE_MESH_HPP
 
+#include <memory>
 #include <vector>
 #include "btBulletDynamicsCommon.h"
 
 #include "physics/user_pointer.hpp"
 #include "utils/aligned_array.hpp"
 
+class CachedBvh;
 class Material;
 
 /**
@@ -46,6 +48,9 @@ private:
     btDefaultMotionState        *m_motion_state;
     btCollisionShape            *m_collision_shape;
 
+    /** The BVH of m_collision_shape if it is shared with the cache. */
+    std::shared_ptr<CachedBvh>   m_cached_bvh;
+
     /** The three normals for each triangle. */
     AlignedArray<btVector3>      m_normals;
 
@@ -57,7 +62,37 @@ private:
      *  to the current transform of the body. */
     bool m_can_be_transformed;
 
+    int rayTest(const btVector3 &from, const btVector3 &to,
+                btScalar *fraction, btVector3 *normal) const;
+
 public:
+    /** A ray cast by castRays(). The results are only set if m_hit is
+     *  true. */
+    struct Ray
+    {
+        btVector3       m_from;
+        btVector3       m_to;
+        /** True if a triangle was hit. */
+        bool            m_hit;
+        /** The position in world where the ray hit. */
+        btVector3       m_hit_point;
+        /** The normal at the hit point, facing the start of the ray. */
+        btVector3       m_normal;
+        /** Fraction of the ray at the hit point. */
+        btScalar        m_fraction;
+        /** Index of the triangle hit. */
+        int             m_triangle_index;
+        /** The material of the triangle hit. */
+        const Material *m_material;
+        // --------------------------------------------------------------------
+        Ray() {}
+        // --------------------------------------------------------------------
+        Ray(const btVector3 &from, const btVector3 &to)
+            : m_from(from), m_to(to), m_hit(false), m_fraction(1.0f),
+              m_triangle_index(-1), m_material(NULL) {}
+    };   // Ray
+
+    // ========================================================================
     class RigidBodyTriangleMesh : public btRigidBody
     {
     public:
@@ -76,11 +111,12 @@ public:
                      const btVector3 &t3, const btVector3 &n1,
                      const btVector3 &n2, const btVector3 &n3,
                      const Material* m);
-    void createCollisionShape(bool create_collision_object=true, const char* serialized_bhv=NULL);
+    void createCollisionShape(bool create_collision_object=true,
+                              bool cache_bvh=false);
     void createPhysicalBody(float friction,
                             btCollisionObject::CollisionFlags flags=
                                (btCollisionObject::CollisionFlags)0,
-                            const char* serializedBhv = NULL);
+                            bool cache_bvh=false);
     void removeAll();
     void removeCollisionObject();
     btVector3 getInterpolatedNormal(unsigned int index,
@@ -113,6 +149,9 @@ public:
                  btVector3 *xyz, const Material **material,
                  btVector3 *normal=NULL, bool interpolate_normal=false) const;
     // ------------------------------------------------------------------------
+    void castRays(Ray *rays, unsigned int count,
+                  bool interpolate_normal=false) const;
+    // ------------------------------------------------------------------------
     /** Returns the points of the 'indx' triangle.
      *  \param indx Index of the triangle to get.
      *  \param p1,p2,p3 On return the three points of the triangle. */
@@ -20,17 +20,22 @@
 
 #include <stdio.h>
 
+#include "config/player_manager.hpp"
 #include "io/file_manager.hpp"
 #include "modes/world.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
+#include "karts/kart_properties_manager.hpp"
 #include "network/network_config.hpp"
 #include "network/rewind_manager.hpp"
 #include "physics/physics.hpp"
 #include "race/race_manager.hpp"
+#include "states_screens/state_manager.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/file_utils.hpp"
+#include "utils/job_system.hpp"
 
 History* history = 0;
 bool History::m_online_history_replay = false;
@@ -111,7 +116,10 @@ void History::updateReplay(int world_ticks)
     // Check if we have reached the end of the buffer
     if(m_event_index >= m_all_input_events.size())
     {
-        Log::info("History", "Replay finished");
+        // Replaying the same history (with the same --seed) must always
+        // give the same checksum, e.g. with any number of --job-threads
+        Log::info("History", "Replay finished at tick %d, kart state "
+                  "checksum %08x.", world_ticks, getKartStateChecksum());
         m_event_index= 0;
         // This is useful to use a reproducable rewind problem:
         // replay it with history, for debugging only
@@ -126,6 +134,36 @@ void History::updateReplay(int world_ticks)
 
 }   // updateReplay
 
+//-----------------------------------------------------------------------------
+/** Returns a hash (FNV-1a) of the exact physical state of all karts, i.e.
+ *  their transforms and velocities, to compare replays of a history.
+ */
+uint32_t History::getKartStateChecksum() const
+{
+    uint32_t hash = 2166136261u;
+    auto add = [&hash](const btScalar* values, unsigned count)
+    {
+        const uint8_t* bytes = (const uint8_t*)values;
+        for (unsigned i = 0; i < count * sizeof(btScalar); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    };
+    World *world = World::getWorld();
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        const btRigidBody* body = world->getKart(i)->getBody();
+        const btTransform& t = body->getWorldTransform();
+        const btQuaternion q = t.getRotation();
+        add(t.getOrigin().m_floats, 3);
+        add(&q[0], 4);
+        add(body->getLinearVelocity().m_floats, 3);
+        add(body->getAngularVelocity().m_floats, 3);
+    }
+    return hash;
+}   // getKartStateChecksum
+
 //-----------------------------------------------------------------------------
 /** Saves the history stored in the internal data structures into a file called
  *  history.dat.
@@ -187,14 +225,21 @@ void History::Save()
 
 //-----------------------------------------------------------------------------
 /** Loads a history from history.dat in the current directory.
+ *  \param filename If not empty, the history file to load instead.
  */
-void History::Load()
+void History::Load(const std::string &filename)
 {
     char s[1024], s1[1024];
     int  n;
 
-    FILE *fd = fopen("history.dat","r");
-    if(fd)
+    FILE *fd = NULL;
+    if (!filename.empty())
+    {
+        fd = FileUtils::fopenU8Path(filename, "r");
+        if (fd)
+            Log::info("History", "Reading '%s'.", filename.c_str());
+    }
+    else if ((fd = fopen("history.dat", "r")) != NULL)
         Log::info("History", "Reading ./history.dat");
     else
     {
@@ -268,6 +313,7 @@ void History::Load()
     // the racing phase can switch to 'ending'
     RaceManager::get()->setNumLaps(100);
 
+    m_kart_ident.clear();
     for(unsigned int i=0; i<num_karts; i++)
     {
         fgets(s, 1023, fd);
@@ -311,3 +357,87 @@ void History::Load()
     fclose(fd);
 }   // Load
 
+//-----------------------------------------------------------------------------
+/** Replays the checked-in history data/replay/job_threads_lighthouse.history
+ *  twice, once with all jobs in the main thread and once with worker
+ *  threads, and checks that the karts end in exactly the same state. The
+ *  test is skipped if the track or karts of the history are not installed.
+ */
+void History::unitTesting()
+{
+    const std::string filename =
+        file_manager->getAsset(FileManager::REPLAY,
+                               "job_threads_lighthouse.history");
+    const bool was_replaying = history->replayHistory();
+    history->setReplayHistory(true);
+    history->Load(filename);
+
+    bool all_assets = track_manager->getTrack(
+                               RaceManager::get()->getTrackName()) != NULL;
+    for (unsigned int i = 0; i < history->m_kart_ident.size(); i++)
+    {
+        if (!kart_properties_manager->getKart(history->m_kart_ident[i]))
+            all_assets = false;
+    }
+    if (!all_assets)
+    {
+        Log::warn("History", "Track or karts of '%s' not installed, "
+                  "skipping test.", filename.c_str());
+        history->setReplayHistory(was_replaying);
+        return;
+    }
+
+    // The replayed player kart needs an active player (without a device).
+    const bool had_active_players =
+        StateManager::get()->activePlayerCount() > 0;
+    if (!had_active_players)
+    {
+        PlayerManager::get()->enforceCurrentPlayer();
+        StateManager::get()->createActivePlayer(
+            PlayerManager::getCurrentPlayer(), NULL);
+    }
+
+    // Keep the job system the game was started with, to restore it at the end
+    const int num_workers = JobSystem::get()
+                          ? (int)JobSystem::get()->getNumWorkers() : -1;
+
+    uint32_t checksum[2];
+    for (unsigned int run = 0; run < 2; run++)
+    {
+        JobSystem::destroy();
+        JobSystem::create(run == 0 ? 0 : 4);
+        srand(1234);
+        history->Load(filename);
+        RaceManager* rm = RaceManager::get();
+        rm->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+        rm->setMinorMode(RaceManager::MINOR_MODE_NORMAL_RACE);
+        rm->setupPlayerKartInfo();
+        rm->startNew(false);
+
+        // Same as the main loop does. The last event only marks the end of
+        // the history, so stop before updateReplay() resets the world.
+        World* world = World::getWorld();
+        const int end_ticks = history->m_all_input_events.back().m_world_ticks;
+        while (world->getTicksSinceStart() < end_ticks)
+        {
+            history->updateReplay(world->getTicksSinceStart());
+            world->updateWorld(1);
+            world->updateTime(1);
+        }
+        checksum[run] = history->getKartStateChecksum();
+        Log::info("History", "Kart state checksum %08x with %s.",
+                  checksum[run], run == 0 ? "no worker threads"
+                                          : "4 worker threads");
+        rm->exitRace();
+    }
+
+    JobSystem::destroy();
+    if (num_workers >= 0)
+        JobSystem::create(num_workers);
+    if (!had_active_players)
+        StateManager::get()->resetActivePlayers();
+    history->setReplayHistory(was_replaying);
+
+    assert(checksum[0] == checksum[1]);
+    (void)checksum;
+}   // unitTesting
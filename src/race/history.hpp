@@ -22,6 +22,7 @@
 
 #include "input/input.hpp"
 #include "karts/controller/kart_control.hpp"
+#include "utils/types.hpp"
 
 #include <string>
 #include <vector>
@@ -61,14 +62,16 @@ private:
     std::vector<InputEvent> m_all_input_events;
 
     void  allocateMemory(int size=-1);
+    uint32_t getKartStateChecksum() const;
 public:
     static bool m_online_history_replay;
           History        ();
     void  initRecording  ();
     void  Save           ();
-    void  Load           ();
+    void  Load           (const std::string &filename="");
     void  updateReplay(int world_ticks);
     void  addEvent(int kart_id, PlayerAction pa, int value);
+    static void unitTesting();
 
     // -------------------I-----------------------------------------------------
     /** Returns the identifier of the n-th kart. */
@@ -369,6 +369,8 @@ void CreateServerScreen::createServer()
     clc.m_login_id = NetworkConfig::get()->getCurrentUserId();
     clc.m_token = NetworkConfig::get()->getCurrentUserToken();
     clc.m_server_ai = 0;
+    clc.m_process_type = PT_CHILD;
+    clc.m_port_offset = 0;
 
     switch (gamemode_widget->getSelection(PLAYER_ID_GAME_MASTER))
     {
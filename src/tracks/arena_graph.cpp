@@ -25,9 +25,11 @@
 #include "tracks/arena_node.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
+#include "utils/job_system.hpp"
 #include "utils/log.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include <queue>
 
 // -----------------------------------------------------------------------------
@@ -35,10 +37,12 @@ ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node)
           : Graph()
 {
     loadNavmesh(navmesh);
-    buildGraph();
-    // Compute shortest distance from all nodes
-    for (unsigned int i = 0; i < getNumNodes(); i++)
-        computeDijkstra(i);
+    createQuadGrid();
+    // Compute shortest distance from all nodes, or use the ones of the same
+    // navmesh computed before
+    m_paths = ArenaPaths::get(hashGraph(), getNumNodes(),
+        file_manager->getCachedPhysicsDir(),
+        [this](ArenaPaths* paths) { computePaths(paths); });
 
     setNearbyNodesOfAllNodes();
     if (node && RaceManager::get()->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
@@ -175,49 +179,90 @@ void ArenaGraph::loadNavmesh(const std::string &navmesh)
 }   // loadNavmesh
 
 // ----------------------------------------------------------------------------
-void ArenaGraph::buildGraph()
+/** FNV-1a hash of everything the shortest paths depend on: the centers of
+ *  all nodes and their adjacent nodes. It identifies the cache file of the
+ *  paths.
+ */
+uint64_t ArenaGraph::hashGraph() const
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto add = [&hash](uint32_t v) { hash = (hash ^ v) * 0x100000001b3ULL; };
+    add(getNumNodes());
+    for (unsigned int i = 0; i < getNumNodes(); i++)
+    {
+        ArenaNode* cur_node = getNode(i);
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            uint32_t v;
+            float f = cur_node->getCenter()[k];
+            memcpy(&v, &f, sizeof(v));
+            add(v);
+        }
+        add((uint32_t)cur_node->getAdjacentNodes().size());
+        for (const int& adjacent : cur_node->getAdjacentNodes())
+            add((uint32_t)adjacent);
+    }
+    return hash;
+}   // hashGraph
+
+// ----------------------------------------------------------------------------
+/** THIS FUNCTION IS ONLY USED FOR UNIT-TESTING. Initialises the paths with
+ *  the edges of the graph, as needed by computeFloydWarshall().
+ */
+void ArenaGraph::buildGraph(ArenaPaths* paths) const
 {
     const unsigned int n_nodes = getNumNodes();
 
-    m_distance_matrix = std::vector<std::vector<float>>
-        (n_nodes, std::vector<float>(n_nodes, 9999.9f));
     for (unsigned int i = 0; i < n_nodes; i++)
     {
+        float* distance = paths->getDistances(i);
+        std::fill(distance, distance + n_nodes, 9999.9f);
         ArenaNode* cur_node = getNode(i);
         for (const int& adjacent : cur_node->getAdjacentNodes())
         {
             Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
-            float distance = diff.length();
-            m_distance_matrix[i][adjacent] = distance;
+            distance[adjacent] = diff.length();
         }
-        m_distance_matrix[i][i] = 0.0f;
-    }
+        distance[i] = 0.0f;
 
-    // Allocate and initialise the previous node data structure:
-    m_parent_node = std::vector<std::vector<int16_t>>
-        (n_nodes, std::vector<int16_t>(n_nodes, Graph::UNKNOWN_SECTOR));
-    for (unsigned int i = 0; i < n_nodes; i++)
-    {
+        // Initialise the previous node data structure:
+        int16_t* parent = paths->getParents(i);
         for (unsigned int j = 0; j < n_nodes; j++)
         {
-            if (i == j || m_distance_matrix[i][j] >= 9899.9f)
-                m_parent_node[i][j] = -1;
+            if (i == j || distance[j] >= 9899.9f)
+                parent[j] = -1;
             else
-                m_parent_node[i][j] = i;
+                parent[j] = i;
         }   // for j
     }   // for i
 
 }   // buildGraph
 
+// ----------------------------------------------------------------------------
+/** Computes the shortest paths from all nodes, one source per job. Each job
+ *  only writes the rows of its source, so the result doesn't depend on the
+ *  number of threads.
+ */
+void ArenaGraph::computePaths(ArenaPaths* paths) const
+{
+    JobSystem::run(getNumNodes(), [this, paths](unsigned i)
+        {
+            computeDijkstra(i, paths);
+        }, "ArenaGraph::computeDijkstra");
+}   // computePaths
+
 // ----------------------------------------------------------------------------
 /** Dijkstra shortest path computation. It computes the shortest distance from
  *  the specified node 'source' to all other nodes. At the end of the
- *  computation, m_distance_matrix[i][j] stores the shortest path distance from
- *  source to j and m_parent_node[source][j] stores the last vertex visited on
- *  the shortest path from i to j before visiting j. Suppose the shortest path
- *  from i to j is i->......->k->j  then m_parent_node[i][j] = k
+ *  computation, paths->getDistance(source, j) is the shortest path distance
+ *  from source to j and paths->getParent(source, j) is the last vertex
+ *  visited on the shortest path from source to j before visiting j. Suppose
+ *  the shortest path from source to j is source->......->k->j  then
+ *  paths->getParent(source, j) = k
+ *  Only the rows of 'source' are used, so different sources can be computed
+ *  at the same time.
  */
-void ArenaGraph::computeDijkstra(int source)
+void ArenaGraph::computeDijkstra(int source, ArenaPaths* paths) const
 {
     // Stores the distance (float) to 'source' from a specified node (int)
     typedef std::pair<int, float> IndDistPair;
@@ -231,35 +276,38 @@ void ArenaGraph::computeDijkstra(int source)
         }
     };
 
-    std::priority_queue<IndDistPair, std::vector<IndDistPair>, Shortest> queue;
-    IndDistPair begin(source, 0.0f);
-    queue.push(begin);
     const unsigned int n = getNumNodes();
-    std::vector<bool> visited;
-    visited.resize(n, false);
+    float* distance = paths->getDistances(source);
+    int16_t* parent = paths->getParents(source);
+    std::fill(distance, distance + n, 9999.9f);
+    std::fill(parent, parent + n, (int16_t)-1);
+    distance[source] = 0.0f;
+
+    std::vector<IndDistPair> storage;
+    storage.reserve(n);
+    std::priority_queue<IndDistPair, std::vector<IndDistPair>, Shortest>
+        queue(Shortest(), std::move(storage));
+    queue.push(IndDistPair(source, 0.0f));
     while (!queue.empty())
     {
         // Get element with shortest path
         IndDistPair current = queue.top();
         queue.pop();
         int cur_index = current.first;
-        if (visited[cur_index]) continue;
-        visited[cur_index] = true;
+        // A shorter distance was found after this one was added
+        if (current.second > distance[cur_index]) continue;
 
-        for (const int& adjacent : getNode(cur_index)->getAdjacentNodes())
+        ArenaNode* cur_node = getNode(cur_index);
+        for (const int& adjacent : cur_node->getAdjacentNodes())
         {
-            // Distance already computed, can be ignored
-            if (visited[adjacent]) continue;
-
-            float new_dist =
-                current.second + m_distance_matrix[cur_index][adjacent];
-            if (new_dist < m_distance_matrix[source][adjacent])
+            Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
+            float new_dist = current.second + diff.length();
+            if (new_dist < distance[adjacent])
             {
-                m_distance_matrix[source][adjacent] = new_dist;
-                m_parent_node[source][adjacent] = cur_index;
+                distance[adjacent] = new_dist;
+                parent[adjacent] = cur_index;
+                queue.push(IndDistPair(adjacent, new_dist));
             }
-            IndDistPair pair(adjacent, new_dist);
-            queue.push(pair);
         }
     }
 }   // computeDijkstra
@@ -268,28 +316,30 @@ void ArenaGraph::computeDijkstra(int source)
 /** THIS FUNCTION IS ONLY USED FOR UNIT-TESTING, to verify that the new
  *  Dijkstra algorithm gives the same results.
  *  computeFloydWarshall() computes the shortest distance between any two
- *  nodes. At the end of the computation, m_distance_matrix[i][j] stores the
- *  shortest path distance from i to j and m_parent_node[i][j] stores the last
- *  vertex visited on the shortest path from i to j before visiting j. Suppose
- *  the shortest path from i to j is i->......->k->j  then
- *  m_parent_node[i][j] = k
+ *  nodes, starting with the paths set by buildGraph(). At the end of the
+ *  computation, paths->getDistance(i, j) is the shortest path distance from
+ *  i to j and paths->getParent(i, j) is the last vertex visited on the
+ *  shortest path from i to j before visiting j. Suppose the shortest path
+ *  from i to j is i->......->k->j  then paths->getParent(i, j) = k
  */
-void ArenaGraph::computeFloydWarshall()
+void ArenaGraph::computeFloydWarshall(ArenaPaths* paths) const
 {
     unsigned int n = getNumNodes();
 
     for (unsigned int k = 0; k < n; k++)
     {
+        const float* distance_k = paths->getDistances(k);
+        const int16_t* parent_k = paths->getParents(k);
         for (unsigned int i = 0; i < n; i++)
         {
+            float* distance_i = paths->getDistances(i);
+            int16_t* parent_i = paths->getParents(i);
             for (unsigned int j = 0; j < n; j++)
             {
-                if ((m_distance_matrix[i][k] + m_distance_matrix[k][j]) <
-                    m_distance_matrix[i][j])
+                if ((distance_i[k] + distance_k[j]) < distance_i[j])
                 {
-                    m_distance_matrix[i][j] =
-                        m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_node[i][j] = m_parent_node[k][j];
+                    distance_i[j] = distance_i[k] + distance_k[j];
+                    parent_i[j] = parent_k[j];
                 }
             }
         }
@@ -349,7 +399,8 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
         // Get the distance to all nodes at i
         ArenaNode* cur_node = getNode(i);
         std::vector<int> nearby_nodes;
-        std::vector<float> dist = m_distance_matrix[i];
+        const float* row = m_paths->getDistances(i);
+        std::vector<float> dist(row, row + getNumNodes());
 
         // Skip the same node
         dist[i] = 999999.0f;
@@ -371,13 +422,13 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
  *  std::vector (in reverse order). Used only for unit testing.
  */
 std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to,
-                      const std::vector< std::vector< int16_t > >& parent_node)
+                                               const ArenaPaths& paths)
 {
     std::vector<int16_t> path;
     path.push_back(to);
     while(from!=to)
     {
-        to = parent_node[from][to];
+        to = paths.getParent(from, to);
         path.push_back(to);
     }
     return path;
@@ -388,39 +439,56 @@ std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to,
  *  Instead of using hand-tuned test cases we use the tested, verified and
  *  easier to understand Floyd-Warshall algorithm to compute the distances,
  *  and check if the (significanty faster) Dijkstra algorithm gives the same
- *  results. For now we use the cave mesh as test case.
+ *  results. For now we use the cave mesh as test case. It also checks that
+ *  the paths used by the graph, which can come from the cache file, are
+ *  exactly the ones Dijkstra computes.
  */
 void ArenaGraph::unitTesting()
 {
     Track *track = track_manager->getTrack("cave");
     std::string navmesh_file_name=track->getTrackFile("navmesh.xml");
 
-    double s = StkTime::getRealTime();
     ArenaGraph* ag = new ArenaGraph(navmesh_file_name);
+    const unsigned int n = ag->getNumNodes();
+
+    // Compute the Dijkstra results
+    ArenaPaths dijkstra(n);
+    double s = StkTime::getRealTime();
+    ag->computePaths(&dijkstra);
     double e = StkTime::getRealTime();
     Log::error("Time", "Dijkstra       %lf", e-s);
 
-    // Save the Dijkstra results
-    std::vector< std::vector< float > > distance_matrix = ag->m_distance_matrix;
-    std::vector< std::vector< int16_t > > parent_node = ag->m_parent_node;
-    ag->buildGraph();
+    int error_count = 0;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (memcmp(dijkstra.getDistances(i), ag->m_paths->getDistances(i),
+                   n * sizeof(float)) != 0 ||
+            memcmp(dijkstra.getParents(i), ag->m_paths->getParents(i),
+                   n * sizeof(int16_t)) != 0)
+        {
+            Log::error("ArenaGraph", "Paths from %d differ from Dijkstra", i);
+            error_count++;
+        }
+    }
 
     // Now compute results with Floyd-Warshall
+    ArenaPaths floyd(n);
+    ag->buildGraph(&floyd);
     s = StkTime::getRealTime();
-    ag->computeFloydWarshall();
+    ag->computeFloydWarshall(&floyd);
     e = StkTime::getRealTime();
     Log::error("Time", "Floyd-Warshall %lf", e-s);
 
-    int error_count = 0;
-    for(unsigned int i=0; i<ag->m_distance_matrix.size(); i++)
+    for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<ag->m_distance_matrix[i].size(); j++)
+        for(unsigned int j=0; j<n; j++)
         {
-            if(ag->m_distance_matrix[i][j] - distance_matrix[i][j] > 0.001f)
+            if(floyd.getDistance(i, j) - dijkstra.getDistance(i, j) > 0.001f)
             {
                 Log::error("ArenaGraph",
                            "Incorrect distance %d, %d: Dijkstra: %f F.W.: %f",
-                           i, j, distance_matrix[i][j], ag->m_distance_matrix[i][j]);
+                           i, j, dijkstra.getDistance(i, j),
+                           floyd.getDistance(i, j));
                 error_count++;
             }    // if distance is too different
 
@@ -432,16 +500,16 @@ void ArenaGraph::unitTesting()
             // debugging in the feature
 #undef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
 #ifdef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
-            if(ag->m_parent_node[i][j] != parent_node[i][j])
+            if(floyd.getParent(i, j) != dijkstra.getParent(i, j))
             {
                 error_count++;
-                std::vector<int16_t> dijkstra_path = getPathFromTo(i, j, parent_node);
-                std::vector<int16_t> floyd_path = getPathFromTo(i, j, ag->m_parent_node);
+                std::vector<int16_t> dijkstra_path = getPathFromTo(i, j, dijkstra);
+                std::vector<int16_t> floyd_path = getPathFromTo(i, j, floyd);
                 if(dijkstra_path.size()!=floyd_path.size())
                 {
                     Log::error("ArenaGraph",
                                "Incorrect path length %d, %d: Dijkstra: %d F.W.: %d",
-                               i, j, parent_node[i][j], ag->m_parent_node[i][j]);
+                               i, j, dijkstra.getParent(i, j), floyd.getParent(i, j));
                     continue;
                 }
                 Log::error("ArenaGraph", "Path problems from %d to %d:",
@@ -461,7 +529,8 @@ void ArenaGraph::unitTesting()
     if (error_count > 0)
     {
        Log::error("ArenaGraph",
-                  "Found %d errors when comparing Dijkstra to Floyd-Warshall", error_count);
+                  "Found %d errors when comparing Dijkstra to Floyd-Warshall "
+                  "and to the cached paths", error_count);
     }
     delete ag;
 
@@ -19,9 +19,11 @@
 #ifndef HEADER_ARENA_GRAPH_HPP
 #define HEADER_ARENA_GRAPH_HPP
 
+#include "tracks/arena_paths.hpp"
 #include "tracks/graph.hpp"
 #include "utils/cpp2011.hpp"
 
+#include <memory>
 #include <set>
 
 class ArenaNode;
@@ -34,11 +36,9 @@ class XMLNode;
 class ArenaGraph : public Graph
 {
 private:
-    /** The actual graph data structure, it is an adjacency matrix. */
-    std::vector<std::vector<float>> m_distance_matrix;
-
-    /** The matrix that is used to store computed shortest paths. */
-    std::vector<std::vector<int16_t>> m_parent_node;
+    /** The shortest distances and paths between all nodes, shared with
+     *  other graphs of the same navmesh. */
+    std::shared_ptr<const ArenaPaths> m_paths;
 
     /** Used in soccer mode to colorize the goal lines in minimap. */
     std::set<int> m_red_node;
@@ -50,23 +50,27 @@ private:
     // ------------------------------------------------------------------------
     void loadNavmesh(const std::string &navmesh);
     // ------------------------------------------------------------------------
-    void buildGraph();
+    uint64_t hashGraph() const;
+    // ------------------------------------------------------------------------
+    void buildGraph(ArenaPaths* paths) const;
     // ------------------------------------------------------------------------
     void setNearbyNodesOfAllNodes();
     // ------------------------------------------------------------------------
-    void computeDijkstra(int n);
+    void computePaths(ArenaPaths* paths) const;
+    // ------------------------------------------------------------------------
+    void computeDijkstra(int source, ArenaPaths* paths) const;
     // ------------------------------------------------------------------------
-    void computeFloydWarshall();
+    void computeFloydWarshall(ArenaPaths* paths) const;
     // ------------------------------------------------------------------------
     static std::vector<int16_t> getPathFromTo(int from, int to,
-                     const std::vector< std::vector< int16_t > >& parent_node);
+                                              const ArenaPaths& paths);
     // ------------------------------------------------------------------------
     virtual bool hasLapLine() const OVERRIDE                  { return false; }
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const OVERRIDE;
 
 public:
-    static ArenaGraph* get()     { return dynamic_cast<ArenaGraph*>(m_graph); }
+    static ArenaGraph* get()     { return dynamic_cast<ArenaGraph*>(Graph::get()); }
     // ------------------------------------------------------------------------
     static void unitTesting();
     // ------------------------------------------------------------------------
@@ -77,14 +81,14 @@ public:
     ArenaNode* getNode(unsigned int i) const;
     // ------------------------------------------------------------------------
     /** Returns the next node on the shortest path from i to j.
-     *  Note: m_parent_node[j][i] contains the parent of i on path from j to i,
-     *  which is the next node on the path from i to j (undirected graph)
+     *  Note: the parent of i on the path from j to i is the next node on the
+     *  path from i to j (undirected graph)
      */
     int getNextNode(int i, int j) const
     {
         if (i == Graph::UNKNOWN_SECTOR || j == Graph::UNKNOWN_SECTOR)
             return Graph::UNKNOWN_SECTOR;
-        return (int)(m_parent_node[j][i]);
+        return m_paths->getParent(j, i);
     }
     // ------------------------------------------------------------------------
     /** Returns the distance between any two nodes */
@@ -92,7 +96,7 @@ public:
     {
         if (from == Graph::UNKNOWN_SECTOR || to == Graph::UNKNOWN_SECTOR)
             return 99999.0f;
-        return m_distance_matrix[from][to];
+        return m_paths->getDistance(from, to);
     }
 
 };   // ArenaGraph
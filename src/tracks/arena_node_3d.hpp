@@ -41,6 +41,16 @@ public:
     }
     // ------------------------------------------------------------------------
     virtual bool is3DQuad() const OVERRIDE                     { return true; }
+    // ------------------------------------------------------------------------
+    virtual bool getInsideBox(Vec3 *min, Vec3 *max) const OVERRIDE
+    {
+        return BoundingBox3D::getInsideBox(min, max);
+    }
+    // ------------------------------------------------------------------------
+    virtual bool pointInsideOutsideBox(const Vec3& p) const OVERRIDE
+    {
+        return BoundingBox3D::pointOnFirstPlane(p);
+    }
 
 };
 
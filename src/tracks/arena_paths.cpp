@@ -0,0 +1,197 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "tracks/arena_paths.hpp"
+
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include "LinearMath/btAlignedAllocator.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+
+namespace
+{
+    /** Header of a cache file, followed by the distance and the parent
+     *  table. */
+    struct PathsFileHeader
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_num_nodes;
+        uint32_t m_stride;
+        uint32_t m_padding;
+        uint64_t m_hash;
+    };   // PathsFileHeader
+
+    const char PATHS_FILE_MAGIC[8] = { 'S', 'T', 'K', 'P', 'A', 'T', 'H', 0 };
+    const uint32_t PATHS_FILE_VERSION = 1;
+
+    /** Size of a cache line, the alignment of the rows of both tables. */
+    const size_t LINE_SIZE = 64;
+
+    /** Size of the header in memory and in the file, so that the tables
+     *  start on a cache line. */
+    const size_t HEADER_SIZE =
+        (sizeof(PathsFileHeader) + LINE_SIZE - 1) & ~(LINE_SIZE - 1);
+
+    std::mutex g_cached_paths_mutex;
+    /** The paths currently used, so that another graph of the same navmesh
+     *  (e.g. of another lobby) shares them. */
+    std::map<uint64_t, std::weak_ptr<const ArenaPaths> > g_cached_paths;
+
+    // ------------------------------------------------------------------------
+    /** Returns the name of the cache file of a navmesh. */
+    std::string getFileName(const std::string& dir, uint64_t hash)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.paths", (unsigned long long)hash);
+        return dir + name;
+    }   // getFileName
+
+}   // namespace
+
+// ============================================================================
+/** Allocates the tables for a graph with the given number of nodes, with
+ *  all entries 0. */
+ArenaPaths::ArenaPaths(unsigned int num_nodes)
+{
+    m_num_nodes = num_nodes;
+    // 32 entries are a multiple of 64 bytes in both tables
+    m_stride = (num_nodes + 31) & ~31u;
+    const size_t table_size = (size_t)m_stride * m_num_nodes;
+    m_size = HEADER_SIZE + table_size * (sizeof(float) + sizeof(int16_t));
+    m_data = btAlignedAlloc((int)m_size, (int)LINE_SIZE);
+    // Clear everything so that the padding in the file is always the same
+    memset(m_data, 0, m_size);
+    m_distance = (float*)((char*)m_data + HEADER_SIZE);
+    m_parent = (int16_t*)(m_distance + table_size);
+}   // ArenaPaths
+
+// ----------------------------------------------------------------------------
+ArenaPaths::~ArenaPaths()
+{
+    btAlignedFree(m_data);
+}   // ~ArenaPaths
+
+// ----------------------------------------------------------------------------
+/** Reads the tables from a cache file. Returns false if the file doesn't
+ *  exist or isn't a valid file of the same graph. */
+bool ArenaPaths::load(const std::string& path, uint64_t hash)
+{
+    FILE* f = FileUtils::fopenU8Path(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long pos = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    bool read = pos == (long)m_size && fread(m_data, m_size, 1, f) == 1;
+    fclose(f);
+    if (!read)
+        return false;
+
+    const PathsFileHeader* header = (const PathsFileHeader*)m_data;
+    if (memcmp(header->m_magic, PATHS_FILE_MAGIC, 8) != 0 ||
+        header->m_version != PATHS_FILE_VERSION ||
+        header->m_num_nodes != m_num_nodes ||
+        header->m_stride != m_stride ||
+        header->m_hash != hash)
+        return false;
+
+    // The parents are used as node indices, so make sure a broken file
+    // can't lead to invalid ones
+    for (unsigned int i = 0; i < m_num_nodes; i++)
+    {
+        const int16_t* parents = getParents(i);
+        for (unsigned int j = 0; j < m_num_nodes; j++)
+        {
+            if (parents[j] < -1 || parents[j] >= (int)m_num_nodes)
+                return false;
+        }
+    }
+    return true;
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Writes the tables to a cache file. */
+bool ArenaPaths::save(const std::string& path, uint64_t hash)
+{
+    PathsFileHeader* header = (PathsFileHeader*)m_data;
+    memcpy(header->m_magic, PATHS_FILE_MAGIC, 8);
+    header->m_version = PATHS_FILE_VERSION;
+    header->m_num_nodes = m_num_nodes;
+    header->m_stride = m_stride;
+    header->m_padding = 0;
+    header->m_hash = hash;
+    return FileUtils::writeFileAtomic(path, m_data, m_size);
+}   // save
+
+// ----------------------------------------------------------------------------
+/** Returns the paths of a graph: the ones already used by a graph of the
+ *  same navmesh, or the ones in the cache file of the navmesh. Otherwise
+ *  they are computed and the cache file written.
+ *  \param hash Hash of the graph, which identifies the cache file.
+ *  \param num_nodes Number of nodes of the graph.
+ *  \param dir Directory of the cache files, empty to not use files.
+ *  \param compute Called to compute all entries of both tables.
+ */
+std::shared_ptr<const ArenaPaths> ArenaPaths::get(uint64_t hash,
+    unsigned int num_nodes, const std::string& dir,
+    const std::function<void(ArenaPaths*)>& compute)
+{
+    const uint64_t start = StkTime::getMonoTimeUs();
+
+    // Keep the lock while computing, so that lobbies loading the same arena
+    // at the same time compute the paths only once
+    std::lock_guard<std::mutex> lock(g_cached_paths_mutex);
+    auto it = g_cached_paths.find(hash);
+    if (it != g_cached_paths.end())
+    {
+        std::shared_ptr<const ArenaPaths> cached = it->second.lock();
+        if (cached && cached->getNumNodes() == num_nodes)
+            return cached;
+    }
+
+    std::shared_ptr<ArenaPaths> paths = std::make_shared<ArenaPaths>(num_nodes);
+    const std::string path = dir.empty() || num_nodes == 0 ?
+        "" : getFileName(dir, hash);
+    if (!path.empty() && paths->load(path, hash))
+    {
+        Log::info("ArenaPaths", "Loaded paths of %d nodes in %.1f ms.",
+            num_nodes, (float)(StkTime::getMonoTimeUs() - start) / 1000.0f);
+    }
+    else
+    {
+        // Clear what an invalid file might have left
+        memset(paths->m_data, 0, paths->m_size);
+        compute(paths.get());
+        if (!path.empty() && !paths->save(path, hash))
+        {
+            Log::warn("ArenaPaths", "Can not write cache file %s.",
+                path.c_str());
+        }
+        Log::info("ArenaPaths", "Computed paths of %d nodes in %.1f ms.",
+            num_nodes, (float)(StkTime::getMonoTimeUs() - start) / 1000.0f);
+    }
+    g_cached_paths[hash] = paths;
+    return paths;
+}   // get
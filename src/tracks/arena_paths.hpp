@@ -0,0 +1,113 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_ARENA_PATHS_HPP
+#define HEADER_ARENA_PATHS_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <assert.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * \brief The shortest paths between all nodes of an arena graph: for each
+ *  pair of nodes the distance, and the last node before the target on the
+ *  shortest path.
+ *  Both tables are flat arrays in one block of memory, and each row starts
+ *  on a cache line. The paths only depend on the navmesh, so they are shared
+ *  by all graphs of the same navmesh (e.g. of several lobbies playing the
+ *  same arena), and cached on disk.
+ * \ingroup tracks
+ */
+class ArenaPaths : public NoCopy
+{
+private:
+    /** Number of nodes of the graph. */
+    unsigned int m_num_nodes;
+
+    /** Number of entries from the start of one row to the next. */
+    unsigned int m_stride;
+
+    /** The memory of the cache file header and both tables. */
+    void* m_data;
+
+    /** Size of m_data in bytes. */
+    size_t m_size;
+
+    /** m_distance[from * m_stride + to] is the distance from 'from' to
+     *  'to'. */
+    float* m_distance;
+
+    /** m_parent[from * m_stride + to] is the node before 'to' on the
+     *  shortest path from 'from' to 'to', -1 if there is no path. */
+    int16_t* m_parent;
+
+    // ------------------------------------------------------------------------
+    bool load(const std::string& path, uint64_t hash);
+    // ------------------------------------------------------------------------
+    bool save(const std::string& path, uint64_t hash);
+
+public:
+    ArenaPaths(unsigned int num_nodes);
+    // ------------------------------------------------------------------------
+    ~ArenaPaths();
+    // ------------------------------------------------------------------------
+    static std::shared_ptr<const ArenaPaths> get(uint64_t hash,
+        unsigned int num_nodes, const std::string& dir,
+        const std::function<void(ArenaPaths*)>& compute);
+    // ------------------------------------------------------------------------
+    unsigned int getNumNodes() const                    { return m_num_nodes; }
+    // ------------------------------------------------------------------------
+    /** Returns the row of distances from node 'from' to all nodes. */
+    float* getDistances(int from)
+    {
+        assert(from >= 0 && (unsigned int)from < m_num_nodes);
+        return m_distance + (size_t)from * m_stride;
+    }   // getDistances
+    // ------------------------------------------------------------------------
+    const float* getDistances(int from) const
+    {
+        assert(from >= 0 && (unsigned int)from < m_num_nodes);
+        return m_distance + (size_t)from * m_stride;
+    }   // getDistances
+    // ------------------------------------------------------------------------
+    /** Returns the row of parents on the paths from 'from' to all nodes. */
+    int16_t* getParents(int from)
+    {
+        assert(from >= 0 && (unsigned int)from < m_num_nodes);
+        return m_parent + (size_t)from * m_stride;
+    }   // getParents
+    // ------------------------------------------------------------------------
+    const int16_t* getParents(int from) const
+    {
+        assert(from >= 0 && (unsigned int)from < m_num_nodes);
+        return m_parent + (size_t)from * m_stride;
+    }   // getParents
+    // ------------------------------------------------------------------------
+    float getDistance(int from, int to) const
+    {
+        return getDistances(from)[to];
+    }   // getDistance
+    // ------------------------------------------------------------------------
+    int getParent(int from, int to) const     { return getParents(from)[to]; }
+};   // ArenaPaths
+
+#endif
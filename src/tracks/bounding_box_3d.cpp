@@ -0,0 +1,176 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "tracks/bounding_box_3d.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // ------------------------------------------------------------------------
+    void cross(const double *a, const double *b, double *result)
+    {
+        result[0] = a[1] * b[2] - a[2] * b[1];
+        result[1] = a[2] * b[0] - a[0] * b[2];
+        result[2] = a[0] * b[1] - a[1] * b[0];
+    }   // cross
+
+    // ------------------------------------------------------------------------
+    double dot(const double *a, const double *b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }   // dot
+}   // anonymous namespace
+
+// ----------------------------------------------------------------------------
+/** Computes a box containing all points for which pointInside returns true.
+ *  pointInside accepts a point if it is on the same side of the planes of
+ *  all six faces. If the faces are not planar (e.g. for a twisted quad),
+ *  these points can reach beyond the corners of the box, so the region is
+ *  computed from the planes: its corners are where three planes intersect,
+ *  and it is unbounded if it extends along the intersection line of two
+ *  planes. Both the region on the inner and on the outer side of all
+ *  planes are included. Points exactly on the plane of the first face are
+ *  accepted anywhere, these are not in the box (see pointOnFirstPlane).
+ *  \param min, max Set to the corners of the box.
+ *  \return False if the region is not bounded, in which case the node must
+ *          always be tested.
+ */
+bool BoundingBox3D::getInsideBox(Vec3 *min, Vec3 *max) const
+{
+    Vec3 corner_min = m_box_faces[0][0];
+    Vec3 corner_max = m_box_faces[0][0];
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        for (unsigned int j = 0; j < 4; j++)
+        {
+            corner_min.min(m_box_faces[i][j]);
+            corner_max.max(m_box_faces[i][j]);
+        }
+    }
+    const double size = (corner_max - corner_min).length();
+
+    // The planes as n*p = d, computed in double so that only the rounding
+    // of pointInside needs to be accounted for.
+    double n[6][3], d[6], length[6];
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        double a[3], u[3], v[3];
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            a[k] = m_box_faces[i][0][k];
+            u[k] = (double)m_box_faces[i][1][k] - a[k];
+            v[k] = (double)m_box_faces[i][2][k] - a[k];
+        }
+        cross(u, v, n[i]);
+        length[i] = sqrt(dot(n[i], n[i]));
+        if (length[i] <= 1.0e-6 * size * size)
+            return false;
+        d[i] = dot(n[i], a);
+    }
+
+    bool found = false;
+    double box_min[3], box_max[3];
+    for (int side = -1; side <= 1; side += 2)
+    {
+        bool any_line = false;
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            for (unsigned int j = i + 1; j < 6; j++)
+            {
+                double line[3];
+                cross(n[i], n[j], line);
+                double line_length = sqrt(dot(line, line));
+                if (line_length == 0)
+                    continue;
+                any_line = true;
+                for (int dir = -1; dir <= 1; dir += 2)
+                {
+                    unsigned int k = 0;
+                    for (; k < 6; k++)
+                    {
+                        if (side * dir * dot(n[k], line) <
+                            -1.0e-6 * length[k] * line_length)
+                            break;
+                    }
+                    if (k == 6)
+                        return false;
+                }   // for dir
+            }   // for j
+        }   // for i
+        if (!any_line)
+            return false;
+
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            for (unsigned int j = i + 1; j < 6; j++)
+            {
+                for (unsigned int k = j + 1; k < 6; k++)
+                {
+                    double jk[3], ki[3], ij[3];
+                    cross(n[j], n[k], jk);
+                    cross(n[k], n[i], ki);
+                    cross(n[i], n[j], ij);
+                    double det = dot(n[i], jk);
+                    if (det == 0)
+                        continue;
+                    double p[3];
+                    for (unsigned int c = 0; c < 3; c++)
+                        p[c] = (d[i] * jk[c] + d[j] * ki[c] + d[k] * ij[c]) / det;
+                    double scale = size + sqrt(dot(p, p));
+                    unsigned int m = 0;
+                    for (; m < 6; m++)
+                    {
+                        if (side * (dot(n[m], p) - d[m]) <
+                            -1.0e-6 * length[m] * scale)
+                            break;
+                    }
+                    if (m < 6)
+                        continue;
+                    for (unsigned int c = 0; c < 3; c++)
+                    {
+                        box_min[c] = found ? std::min(box_min[c], p[c]) : p[c];
+                        box_max[c] = found ? std::max(box_max[c], p[c]) : p[c];
+                    }
+                    found = true;
+                }   // for k
+            }   // for j
+        }   // for i
+    }   // for side
+
+    if (!found)
+    {
+        *min = corner_min;
+        *max = corner_max;
+        return true;
+    }
+    double extent = std::max(box_max[0] - box_min[0],
+                             std::max(box_max[1] - box_min[1],
+                                      box_max[2] - box_min[2]));
+    if (extent > 100.0 * size + 100.0)
+        return false;
+
+    double pad = 0.001 + 1.0e-5 * (extent + std::max(
+        corner_max.length(), corner_min.length()));
+    *min = Vec3((float)(box_min[0] - pad), (float)(box_min[1] - pad),
+                (float)(box_min[2] - pad));
+    *max = Vec3((float)(box_max[0] + pad), (float)(box_max[1] + pad),
+                (float)(box_max[2] + pad));
+    return true;
+}   // getInsideBox
@@ -78,6 +78,17 @@ public:
         }
         return true;
     }
+    // ------------------------------------------------------------------------
+    /** Returns true if a point is exactly on the plane of the first face.
+     *  pointInside accepts such a point anywhere on the plane, since all
+     *  products with its side are 0. */
+    bool pointOnFirstPlane(const Vec3& p) const
+    {
+        return p.sideofPlane(m_box_faces[0][0], m_box_faces[0][1],
+            m_box_faces[0][2]) == 0.0f;
+    }
+    // ------------------------------------------------------------------------
+    bool getInsideBox(Vec3 *min, Vec3 *max) const;
 
 };
 
@@ -30,6 +30,7 @@
 #include "tracks/arena_node_3d.hpp"
 #include "tracks/drive_node_2d.hpp"
 #include "tracks/drive_node_3d.hpp"
+#include "tracks/quad_grid.hpp"
 #include "tracks/track.hpp"
 #include "utils/log.hpp"
 
@@ -43,7 +44,8 @@
 const int Graph::UNKNOWN_SECTOR = -1;
 const float Graph::MIN_HEIGHT_TESTING = -1.0f;
 const float Graph::MAX_HEIGHT_TESTING = 5.0f;
-Graph *Graph::m_graph = NULL;
+Graph *Graph::m_graph[PT_COUNT];
+bool Graph::m_graph_owner[PT_COUNT];
 // -----------------------------------------------------------------------------
 Graph::Graph()
 {
@@ -680,6 +682,15 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
     // the current one
     int indx       = *sector;
 
+    // Without a list of sectors to test, the grid finds the same quad as
+    // testing all of them in order.
+    if (!all_sectors && m_quad_grid)
+    {
+        int first = indx < (int)m_all_nodes.size() - 1 ? indx + 1 : 0;
+        *sector = m_quad_grid->findRoadSector(xyz, first, ignore_vertical);
+        return;
+    }
+
     // If a current sector is given, and max_lookahead is specify, only test
     // the next max_lookahead quads instead of testing the whole graph.
     // This is necessary for the AI: if the track contains a loop, e.g.:
@@ -754,10 +765,8 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
         // shortcut. If we only tested a limited number of quads to
         // improve the performance the crossing of a lap might not be
         // detected (because quad 0 is not tested, only quads on the
-        // shortcuts are tested). If this should become a performance
-        // bottleneck, we need to set up a graph of 'next' quads for each
-        // quad (similar to what the AI does), and only test the quads
-        // in this graph.
+        // shortcuts are tested). The quad grid avoids testing all quads
+        // while still finding the same quad.
         const int LIMIT = getNumNodes();
         count           = LIMIT;
         // Start 10 quads before the current quad, so the quads closest
@@ -766,6 +775,20 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
         if(current_sector<0) current_sector += getNumNodes();
     }
 
+    // Without a list of sectors to test, the grid finds the same quad as
+    // testing all of them, starting after current_sector.
+    if (!all_sectors && m_quad_grid)
+    {
+        int first = current_sector + 1 == (int)getNumNodes()
+                  ? 0 : current_sector + 1;
+        int sector = m_quad_grid->findOutOfRoadSector(xyz, first,
+                                                      ignore_vertical);
+        if (sector != UNKNOWN_SECTOR)
+            return sector;
+        Log::warn("Graph", "unknown sector found.");
+        return 0;
+    }
+
     int   min_sector = UNKNOWN_SECTOR;
     float min_dist_2 = 999999.0f*999999.0f;
 
@@ -821,6 +844,15 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
     return 0;
 }   // findOutOfRoadSector
 
+//-----------------------------------------------------------------------------
+/** Creates the grid used by findRoadSector and findOutOfRoadSector. It must
+ *  be called once all quads are created.
+ */
+void Graph::createQuadGrid()
+{
+    m_quad_grid.reset(new QuadGrid(m_all_nodes));
+}   // createQuadGrid
+
 //-----------------------------------------------------------------------------
 void Graph::loadBoundingBoxNodes()
 {
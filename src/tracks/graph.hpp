@@ -20,6 +20,7 @@
 #define HEADER_GRAPH_HPP
 
 #include "utils/no_copy.hpp"
+#include "utils/stk_process.hpp"
 #include "utils/vec3.hpp"
 
 #include <dimension2d.h>
@@ -37,6 +38,7 @@ namespace irr
 using namespace irr;
 
 class Quad;
+class QuadGrid;
 class RenderTarget;
 
 /**
@@ -52,7 +54,13 @@ class RenderTarget;
 class Graph : public NoCopy
 {
 protected:
-    static Graph* m_graph;
+    /** The graph of each process, a child process which uses a copy of the
+     *  main process track shares its graph (see shareWithChild). */
+    static Graph* m_graph[PT_COUNT];
+
+    /** True if the graph of a process was created by it (so it will delete
+     *  it), false if it is shared from the main process. */
+    static bool m_graph_owner[PT_COUNT];
 
     std::vector<Quad*> m_all_nodes;
 
@@ -66,6 +74,8 @@ protected:
     // ------------------------------------------------------------------------
     /** Map 4 bounding box points to 4 closest graph nodes. */
     void loadBoundingBoxNodes();
+    // ------------------------------------------------------------------------
+    void createQuadGrid();
 
 private:
     /** The 2d bounding box, used for hashing. */
@@ -90,6 +100,10 @@ private:
     /** The render target used for drawing the minimap. */
     std::unique_ptr<RenderTarget> m_render_target;
 
+    /** Grid over all quads, used to find the sector of a point without
+     *  testing all quads. */
+    std::unique_ptr<QuadGrid> m_quad_grid;
+
     // ------------------------------------------------------------------------
     void createMesh(bool show_invisible=true,
                     bool enable_transparency=false,
@@ -116,25 +130,44 @@ public:
     /** Returns the one instance of this object. It is possible that there
      *  is no instance created (e.g. arena without navmesh) so we don't assert
      *  that an instance exist. */
-    static Graph* get() { return m_graph; }
+    static Graph* get()         { return m_graph[STKProcess::getType()]; }
     // ------------------------------------------------------------------------
     /** Set the graph (either drive or arena graph for now). */
     static void setGraph(Graph* graph)
     {
-        assert(m_graph == NULL);
-        m_graph = graph;
+        ProcessType pt = STKProcess::getType();
+        assert(m_graph[pt] == NULL);
+        m_graph[pt] = graph;
+        m_graph_owner[pt] = true;
     }   // setGraph
     // ------------------------------------------------------------------------
+    /** Called in main process to let a child process use the same graph
+     *  read-only, when the child track is cloned from the main one. */
+    static void shareWithChild(ProcessType child)
+    {
+        assert(child != PT_MAIN);
+        m_graph[child] = m_graph[PT_MAIN];
+        m_graph_owner[child] = false;
+    }   // shareWithChild
+    // ------------------------------------------------------------------------
     /** Cleans up the graph. It is possible that this function is called even
      *  if no instance exists (e.g. arena without navmesh). So it is not an
      *  error if there is no instance. */
     static void destroy()
     {
-        if (m_graph)
+        ProcessType pt = STKProcess::getType();
+        Graph* graph = m_graph[pt];
+        if (!graph)
+            return;
+        m_graph[pt] = NULL;
+        if (!m_graph_owner[pt])
+            return;
+        for (unsigned i = 0; i < PT_COUNT; i++)
         {
-            delete m_graph;
-            m_graph = NULL;
+            if (m_graph[i] == graph)
+                m_graph[i] = NULL;
         }
+        delete graph;
     }   // destroy
     // ------------------------------------------------------------------------
     Graph();
@@ -22,6 +22,8 @@
 #include "utils/log.hpp"
 
 #include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <S3DVertex.h>
 #include <triangle3d.h>
 
@@ -141,3 +143,45 @@ bool Quad::pointInside(const Vec3& p, bool ignore_vertical) const
                p.sideOfLine2D(m_p[3], m_p[0]) >= 0.0;
     }
 }   // pointInside
+
+// ----------------------------------------------------------------------------
+/** Computes a box containing all points for which pointInside can return
+ *  true (ignoring the height test), so that a graph can find the quads a
+ *  point might be on without testing all of them. pointInside tests the
+ *  two triangles 0,1,2 and 0,2,3 in 2d. Because of float rounding a side
+ *  test can accept a point slightly outside of a triangle: the error is
+ *  at most 8*eps*w*(w+d) for a point at distance d outside of the box of
+ *  a triangle of size w and area a, while the exact value is at most
+ *  -a*d/w. So the box is enlarged by 32*eps*w^3/a, which is tiny for
+ *  any normal quad.
+ *  \param min, max Set to the corners of the box. Only X and Z bound the
+ *         points, Y is the height range of the quad.
+ *  \return False if the quad is too thin to bound the points, in which
+ *          case it must always be tested.
+ */
+bool Quad::getInsideBox(Vec3 *min, Vec3 *max) const
+{
+    *min = m_p[0];
+    *max = m_p[0];
+    for (unsigned int i = 1; i < 4; i++)
+    {
+        min->min(m_p[i]);
+        max->max(m_p[i]);
+    }
+    const double w = std::max(max->getX() - min->getX(),
+                              max->getZ() - min->getZ());
+    double pad = 0.001;
+    for (unsigned int i = 1; i < 3; i++)
+    {
+        const Vec3 &a = m_p[0], &b = m_p[i], &c = m_p[i + 1];
+        double area = 0.5 * fabs(
+            ((double)b.getX() - a.getX()) * ((double)c.getZ() - a.getZ()) -
+            ((double)b.getZ() - a.getZ()) * ((double)c.getX() - a.getX()));
+        if (area <= 32.0 * FLT_EPSILON * w * w)
+            return false;
+        pad = std::max(pad, 0.001 + 32.0 * FLT_EPSILON * w * w * w / area);
+    }
+    *min -= Vec3((float)pad, 0, (float)pad);
+    *max += Vec3((float)pad, 0, (float)pad);
+    return true;
+}   // getInsideBox
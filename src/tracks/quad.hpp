@@ -121,6 +121,12 @@ public:
      *  pointInside. */
     virtual bool is3DQuad() const                             { return false; }
     // ------------------------------------------------------------------------
+    virtual bool getInsideBox(Vec3 *min, Vec3 *max) const;
+    // ------------------------------------------------------------------------
+    /** Returns true if pointInside accepts a point although it is outside
+     *  of the box of getInsideBox, which only 3d quads do. */
+    virtual bool pointInsideOutsideBox(const Vec3& p) const  { return false; }
+    // ------------------------------------------------------------------------
     virtual float getDistance2FromPoint(const Vec3 &xyz) const
     {
         // You should not call this in a bare quad
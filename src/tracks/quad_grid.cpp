@@ -0,0 +1,544 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "tracks/quad_grid.hpp"
+
+#include "tracks/arena_node.hpp"
+#include "tracks/arena_node_3d.hpp"
+#include "tracks/graph.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+#include "utils/vec3.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    /** The initial distance of findOutOfRoadSector, quads further away than
+     *  this are never found. */
+    const float MAX_DISTANCE_2 = 999999.0f * 999999.0f;
+
+    /** A quad found close to a point by findOutOfRoadSector. */
+    struct Candidate
+    {
+        /** Position of the quad in the order the quads are tested. */
+        int   m_rank;
+        int   m_index;
+        float m_distance_2;
+        bool operator<(const Candidate &other) const
+        {
+            return m_rank < other.m_rank;
+        }
+    };   // Candidate
+
+    // ------------------------------------------------------------------------
+    /** True if findOutOfRoadSector accepts a quad in its first phase, in
+     *  which the height of the point is tested. */
+    bool isAtHeight(const Quad *q, const Vec3 &xyz, bool ignore_vertical)
+    {
+        float dist = xyz.getY() - q->getMinHeight();
+        return (dist < 5.0f && dist > -1.0f) || q->is3DQuad() ||
+               ignore_vertical;
+    }   // isAtHeight
+
+}   // anonymous namespace
+
+// ----------------------------------------------------------------------------
+/** Creates the grid for the given quads. The quads must not change as long
+ *  as the grid is used.
+ *  \param quads The quads of a graph, indexed by node index.
+ */
+QuadGrid::QuadGrid(const std::vector<Quad*> &quads) : m_quads(quads)
+{
+    m_min_x = m_min_z =  FLT_MAX;
+    m_max_x = m_max_z = -FLT_MAX;
+    m_cells_x = m_cells_z = 0;
+    m_cell_size = 1.0f;
+    m_max_coordinate = 0.0f;
+    m_cell_start.push_back(0);
+    if (quads.empty())
+        return;
+
+    // The box of each quad also contains the quad itself, since the
+    // distance of findOutOfRoadSector is measured to its center line.
+    std::vector<Vec3> box_min(quads.size()), box_max(quads.size());
+    float total_size = 0.0f;
+    for (unsigned int i = 0; i < quads.size(); i++)
+    {
+        const Quad &q = *quads[i];
+        if (!q.getInsideBox(&box_min[i], &box_max[i]))
+        {
+            m_unbounded_quads.push_back(i);
+            box_min[i] = box_max[i] = q[0];
+        }
+        else if (q.is3DQuad())
+            m_3d_quads.push_back(i);
+        for (unsigned int j = 0; j < 4; j++)
+        {
+            box_min[i].min(q[j]);
+            box_max[i].max(q[j]);
+        }
+        m_min_x = std::min(m_min_x, box_min[i].getX());
+        m_min_z = std::min(m_min_z, box_min[i].getZ());
+        m_max_x = std::max(m_max_x, box_max[i].getX());
+        m_max_z = std::max(m_max_z, box_max[i].getZ());
+        total_size += std::max(box_max[i].getX() - box_min[i].getX(),
+                               box_max[i].getZ() - box_min[i].getZ());
+    }
+    m_max_coordinate = std::max(std::max(fabsf(m_min_x), fabsf(m_max_x)),
+                                std::max(fabsf(m_min_z), fabsf(m_max_z)));
+
+    // Cells of about the size of a quad, so that only a few quads are
+    // tested, but not more than 16 cells per quad for sparse tracks.
+    const float width = m_max_x - m_min_x;
+    const float depth = m_max_z - m_min_z;
+    m_cell_size = std::max(total_size / quads.size(),
+                           sqrtf(width * depth / (16.0f * quads.size())));
+    m_cell_size = std::max(m_cell_size, std::max(width, depth) / 1024.0f);
+    if (!(m_cell_size > 0.0f))
+        m_cell_size = 1.0f;
+    m_cells_x = std::min((int)(width / m_cell_size) + 1, 1024);
+    m_cells_z = std::min((int)(depth / m_cell_size) + 1, 1024);
+
+    // Count the quads per cell, then store them sorted by cell
+    m_cell_start.resize(m_cells_x * m_cells_z + 1, 0);
+    for (unsigned int i = 0; i < quads.size(); i++)
+    {
+        for (int z = getCellZ(box_min[i].getZ());
+             z <= getCellZ(box_max[i].getZ()); z++)
+        {
+            for (int x = getCellX(box_min[i].getX());
+                 x <= getCellX(box_max[i].getX()); x++)
+                m_cell_start[z * m_cells_x + x + 1]++;
+        }
+    }
+    for (unsigned int i = 1; i < m_cell_start.size(); i++)
+        m_cell_start[i] += m_cell_start[i - 1];
+    m_cell_quads.resize(m_cell_start.back());
+    std::vector<unsigned int> next(m_cell_start.begin(),
+                                   m_cell_start.end() - 1);
+    for (unsigned int i = 0; i < quads.size(); i++)
+    {
+        for (int z = getCellZ(box_min[i].getZ());
+             z <= getCellZ(box_max[i].getZ()); z++)
+        {
+            for (int x = getCellX(box_min[i].getX());
+                 x <= getCellX(box_max[i].getX()); x++)
+                m_cell_quads[next[z * m_cells_x + x]++] = i;
+        }
+    }
+}   // QuadGrid
+
+// ----------------------------------------------------------------------------
+/** Returns the column of the cell containing x, clamped to the grid. */
+int QuadGrid::getCellX(float x) const
+{
+    float cell = (x - m_min_x) / m_cell_size;
+    if (!(cell >= 0.0f))
+        return 0;
+    return cell < (float)m_cells_x ? (int)cell : m_cells_x - 1;
+}   // getCellX
+
+// ----------------------------------------------------------------------------
+/** Returns the row of the cell containing z, clamped to the grid. */
+int QuadGrid::getCellZ(float z) const
+{
+    float cell = (z - m_min_z) / m_cell_size;
+    if (!(cell >= 0.0f))
+        return 0;
+    return cell < (float)m_cells_z ? (int)cell : m_cells_z - 1;
+}   // getCellZ
+
+// ----------------------------------------------------------------------------
+/** Returns the quad a point is on, the same one Graph::findRoadSector finds
+ *  when testing all quads: the first one in the order first, first+1, ...
+ *  (wrapping around at the end) for which pointInside is true.
+ *  \param xyz The point.
+ *  \param first Index of the first quad in the order the quads are tested.
+ *  \param ignore_vertical Passed on to Quad::pointInside.
+ *  \return The index of the quad, or Graph::UNKNOWN_SECTOR.
+ */
+int QuadGrid::findRoadSector(const Vec3 &xyz, int first,
+                             bool ignore_vertical) const
+{
+    const int n = (int)m_quads.size();
+    int sector = Graph::UNKNOWN_SECTOR;
+    int sector_rank = n;
+    const int *cell_quads[2] = { NULL, NULL };
+    unsigned int cell_size[2] = { 0, 0 };
+    if (!m_unbounded_quads.empty())
+    {
+        cell_quads[0] = &m_unbounded_quads[0];
+        cell_size[0]  = (unsigned int)m_unbounded_quads.size();
+    }
+    // A point outside of the grid is not in the box of any quad
+    if (xyz.getX() >= m_min_x && xyz.getX() <= m_max_x &&
+        xyz.getZ() >= m_min_z && xyz.getZ() <= m_max_z)
+    {
+        int cell = getCellZ(xyz.getZ()) * m_cells_x + getCellX(xyz.getX());
+        cell_size[1] = m_cell_start[cell + 1] - m_cell_start[cell];
+        if (cell_size[1] > 0)
+            cell_quads[1] = &m_cell_quads[m_cell_start[cell]];
+    }
+
+    for (unsigned int list = 0; list < 2; list++)
+    {
+        for (unsigned int i = 0; i < cell_size[list]; i++)
+        {
+            int index = cell_quads[list][i];
+            int rank = index >= first ? index - first : index - first + n;
+            if (rank < sector_rank &&
+                m_quads[index]->pointInside(xyz, ignore_vertical))
+            {
+                sector = index;
+                sector_rank = rank;
+            }
+        }
+    }
+    // Points exactly on the plane of a face of a 3d quad are accepted
+    // outside of its box, too
+    for (unsigned int i = 0; i < m_3d_quads.size(); i++)
+    {
+        int index = m_3d_quads[i];
+        int rank = index >= first ? index - first : index - first + n;
+        if (rank < sector_rank &&
+            m_quads[index]->pointInsideOutsideBox(xyz) &&
+            m_quads[index]->pointInside(xyz, ignore_vertical))
+        {
+            sector = index;
+            sector_rank = rank;
+        }
+    }
+    return sector;
+}   // findRoadSector
+
+// ----------------------------------------------------------------------------
+/** Returns the quad closest to a point, the same one
+ *  Graph::findOutOfRoadSector finds when testing all quads starting with
+ *  first. The cells are searched in rings around the point, until all quads
+ *  which are not yet found are further away than the closest quad at the
+ *  height of the point. The quads found are then tested exactly like
+ *  Graph::findOutOfRoadSector does, in the same order, so that quads with
+ *  the same distance give the same result.
+ *  \param xyz The point.
+ *  \param first Index of the first quad in the order the quads are tested.
+ *  \param ignore_vertical True if the height of the point is not tested.
+ *  \return The index of the quad, or Graph::UNKNOWN_SECTOR.
+ */
+int QuadGrid::findOutOfRoadSector(const Vec3 &xyz, int first,
+                                  bool ignore_vertical) const
+{
+    const int n = (int)m_quads.size();
+    if (n == 0)
+        return Graph::UNKNOWN_SECTOR;
+
+    const int cell_x = getCellX(xyz.getX());
+    const int cell_z = getCellZ(xyz.getZ());
+    const int max_ring = std::max(std::max(cell_x, m_cells_x - 1 - cell_x),
+                                  std::max(cell_z, m_cells_z - 1 - cell_z));
+    // The distances are computed in float, so the cells are only known to
+    // be far enough away with some tolerance.
+    const float tolerance = 0.001f + 1.0e-5f * (m_max_coordinate +
+        fabsf(xyz.getX()) + fabsf(xyz.getY()) + fabsf(xyz.getZ()));
+
+    std::vector<Candidate> candidates;
+    float closest_2 = MAX_DISTANCE_2;
+    for (int ring = 0; ring <= max_ring; ring++)
+    {
+        for (int z = cell_z - ring; z <= cell_z + ring; z++)
+        {
+            if (z < 0 || z >= m_cells_z)
+                continue;
+            // Inside of the ring only the first and last cell of a row
+            const int step = (z == cell_z - ring || z == cell_z + ring)
+                           ? 1 : 2 * ring;
+            for (int x = cell_x - ring; x <= cell_x + ring; x += step)
+            {
+                if (x < 0 || x >= m_cells_x)
+                    continue;
+                // Skip cells further away than the closest quad
+                if (closest_2 < MAX_DISTANCE_2)
+                {
+                    float dx = std::max(m_min_x + x * m_cell_size - xyz.getX(),
+                        xyz.getX() - (m_min_x + (x + 1) * m_cell_size));
+                    float dz = std::max(m_min_z + z * m_cell_size - xyz.getZ(),
+                        xyz.getZ() - (m_min_z + (z + 1) * m_cell_size));
+                    float d = std::max(dx, dz) - tolerance;
+                    if (d > 0.0f && d * d > closest_2)
+                        continue;
+                }
+                const int cell = z * m_cells_x + x;
+                for (unsigned int i = m_cell_start[cell];
+                     i < m_cell_start[cell + 1]; i++)
+                {
+                    Candidate c;
+                    c.m_index = m_cell_quads[i];
+                    c.m_rank  = c.m_index >= first ? c.m_index - first
+                                                   : c.m_index - first + n;
+                    const Quad *q = m_quads[c.m_index];
+                    if (q->isIgnored())
+                        continue;
+                    c.m_distance_2 = q->getDistance2FromPoint(xyz);
+                    // A quad further away than the closest one is never
+                    // found, as closest_2 can only become smaller.
+                    if (c.m_distance_2 > closest_2)
+                        continue;
+                    candidates.push_back(c);
+                    if (c.m_distance_2 < closest_2 &&
+                        isAtHeight(q, xyz, ignore_vertical))
+                        closest_2 = c.m_distance_2;
+                }
+            }   // for x
+        }   // for z
+
+        if (closest_2 == MAX_DISTANCE_2)
+            continue;
+        // All quads not found yet are only in cells outside of the rings
+        // searched so far, so they are at least this far away.
+        float bound = FLT_MAX;
+        if (cell_x - ring > 0)
+        {
+            bound = std::min(bound, xyz.getX() -
+                             (m_min_x + (cell_x - ring) * m_cell_size));
+        }
+        if (cell_x + ring < m_cells_x - 1)
+        {
+            bound = std::min(bound, m_min_x +
+                             (cell_x + ring + 1) * m_cell_size - xyz.getX());
+        }
+        if (cell_z - ring > 0)
+        {
+            bound = std::min(bound, xyz.getZ() -
+                             (m_min_z + (cell_z - ring) * m_cell_size));
+        }
+        if (cell_z + ring < m_cells_z - 1)
+        {
+            bound = std::min(bound, m_min_z +
+                             (cell_z + ring + 1) * m_cell_size - xyz.getZ());
+        }
+        bound -= tolerance;
+        if (bound > 0.0f && bound * bound > closest_2)
+            break;
+    }   // for ring
+
+    // Now test the quads found in the order of Graph::findOutOfRoadSector.
+    // If no quad at the height of the point was found, all quads were
+    // searched, so the second phase gives the same result, too.
+    std::sort(candidates.begin(), candidates.end());
+    int   min_sector = Graph::UNKNOWN_SECTOR;
+    float min_dist_2 = MAX_DISTANCE_2;
+    for (int phase = 0; phase < 2; phase++)
+    {
+        for (unsigned int i = 0; i < candidates.size(); i++)
+        {
+            const Candidate &c = candidates[i];
+            if (c.m_distance_2 < min_dist_2 &&
+                (phase == 1 ||
+                 isAtHeight(m_quads[c.m_index], xyz, ignore_vertical)))
+            {
+                min_dist_2 = c.m_distance_2;
+                min_sector = c.m_index;
+            }
+        }
+        if (min_sector != Graph::UNKNOWN_SECTOR)
+            return min_sector;
+    }
+    return Graph::UNKNOWN_SECTOR;
+}   // findOutOfRoadSector
+
+// ----------------------------------------------------------------------------
+/** Compares the grid with testing all quads, on a road with banked (3d)
+ *  parts, a bridge crossing it and a degenerated quad, and logs the time
+ *  of both.
+ */
+void QuadGrid::unitTesting()
+{
+    std::vector<Quad*> quads;
+    const int num_segments = 2000;
+    const float radius = 400.0f;
+    const float half_width = 6.0f;
+    // A closed road around a circle, going up and down
+    for (int i = 0; i < num_segments; i++)
+    {
+        Vec3 p[4];
+        bool banked = (i / 50) % 4 == 3;
+        for (int j = 0; j < 2; j++)
+        {
+            float angle = 2.0f * (float)M_PI * (i + j) / num_segments;
+            float bank = banked ? 0.8f : 0.0f;
+            Vec3 center(radius * cosf(angle), 10.0f * sinf(3.0f * angle),
+                        radius * sinf(angle));
+            Vec3 side(cosf(angle) * cosf(bank), sinf(bank),
+                      sinf(angle) * cosf(bank));
+            p[j * 2]     = center + side * (j == 0 ?  half_width : -half_width);
+            p[j * 2 + 1] = center + side * (j == 0 ? -half_width :  half_width);
+        }
+        Vec3 normal = (p[1] - p[0]).cross(p[2] - p[0]).normalized();
+        if (normal.getY() < 0)
+            normal = -normal;
+        Quad *q;
+        if (banked)
+            q = new ArenaNode3D(p[0], p[1], p[2], p[3], normal, i);
+        else
+            q = new ArenaNode(p[0], p[1], p[2], p[3], normal, i);
+        if (!banked && !q->pointInside(q->getCenter(), true))
+        {
+            delete q;
+            q = new ArenaNode(p[1], p[0], p[3], p[2], normal, i);
+        }
+        assert(banked || q->pointInside(q->getCenter(), true));
+        quads.push_back(q);
+    }
+    // A straight bridge crossing the road, 8 units above it
+    const int num_bridge = 100;
+    for (int i = 0; i < num_bridge; i++)
+    {
+        float x0 = -500.0f + 1000.0f * i / num_bridge;
+        float x1 = -500.0f + 1000.0f * (i + 1) / num_bridge;
+        Vec3 p0(x0, 18.0f, -half_width), p1(x0, 18.0f, half_width);
+        Vec3 p2(x1, 18.0f, half_width), p3(x1, 18.0f, -half_width);
+        Quad *q = new ArenaNode(p0, p1, p2, p3, Vec3(0, 1, 0),
+                                (int)quads.size());
+        if (!q->pointInside(q->getCenter(), true))
+        {
+            delete q;
+            q = new ArenaNode(p1, p0, p3, p2, Vec3(0, 1, 0),
+                              (int)quads.size());
+        }
+        quads.push_back(q);
+    }
+    // A degenerated quad, which must always be tested
+    quads.push_back(new ArenaNode(Vec3(0, 0, 0), Vec3(1, 0, 1),
+                                  Vec3(2, 0, 2), Vec3(3, 0, 3),
+                                  Vec3(0, 1, 0), (int)quads.size()));
+    // A 3d quad away from the road, the top face of its box is at y = 105
+    // where the side of a point is computed exactly
+    quads.push_back(new ArenaNode3D(Vec3(700, 100, 700), Vec3(700, 100, 710),
+                                    Vec3(710, 100, 710), Vec3(710, 100, 700),
+                                    Vec3(0, 1, 0), (int)quads.size()));
+
+    QuadGrid grid(quads);
+    assert(grid.m_unbounded_quads.size() == 1 &&
+           grid.m_unbounded_quads[0] == (int)quads.size() - 2);
+
+    // Points on the road, on quad corners and edges, and off the road
+    std::vector<Vec3> points;
+    srand(1234);
+    for (unsigned int i = 0; i < quads.size(); i += 7)
+    {
+        const Quad &q = *quads[i];
+        points.push_back(q.getCenter());
+        points.push_back(q[i % 4]);
+        points.push_back((q[0] + q[1]) * 0.5f);
+    }
+    for (int i = 0; i < 3000; i++)
+    {
+        float angle = (rand() % 3600) * (float)M_PI / 1800.0f;
+        float r = radius + (rand() % 600 - 300) * 0.1f;
+        points.push_back(Vec3(r * cosf(angle), (rand() % 400 - 100) * 0.1f,
+                              r * sinf(angle)));
+    }
+    for (int i = 0; i < 300; i++)
+    {
+        points.push_back(Vec3(rand() % 1200 - 600.0f, rand() % 40 - 10.0f,
+                              rand() % 1200 - 600.0f) +
+                         Vec3(rand() % 100, rand() % 100, rand() % 100) *
+                         0.01f);
+    }
+    points.push_back(Vec3(5000.0f, 0.0f, -3000.0f));
+    points.push_back(Vec3(0.0f, -500.0f, 0.0f));
+    // On the plane of the top face of the last quad, far away from it
+    points.push_back(Vec3(-300.0f, 105.0f, 200.0f));
+    points.push_back(Vec3(3000.0f, 105.0f, 3000.0f));
+
+    const int n = (int)quads.size();
+    std::vector<int> linear_road, linear_out, grid_road, grid_out;
+    uint64_t t0 = StkTime::getMonoTimeUs();
+    for (unsigned int i = 0; i < points.size(); i++)
+    {
+        const Vec3 &xyz = points[i];
+        const int first = (i * 37) % n;
+        const bool ignore_vertical = i % 5 == 0;
+        // The linear searches of Graph
+        int road = Graph::UNKNOWN_SECTOR;
+        for (int j = 0; j < n; j++)
+        {
+            int index = (first + j) % n;
+            if (quads[index]->pointInside(xyz, ignore_vertical))
+            {
+                road = index;
+                break;
+            }
+        }
+        linear_road.push_back(road);
+
+        int min_sector = Graph::UNKNOWN_SECTOR;
+        float min_dist_2 = MAX_DISTANCE_2;
+        for (int phase = 0; phase < 2; phase++)
+        {
+            for (int j = 0; j < n; j++)
+            {
+                const Quad *q = quads[(first + j) % n];
+                if (q->isIgnored())
+                    continue;
+                float dist_2 = q->getDistance2FromPoint(xyz);
+                if (dist_2 < min_dist_2 &&
+                    (phase == 1 || isAtHeight(q, xyz, ignore_vertical)))
+                {
+                    min_dist_2 = dist_2;
+                    min_sector = (first + j) % n;
+                }
+            }
+            if (min_sector != Graph::UNKNOWN_SECTOR)
+                break;
+        }
+        linear_out.push_back(min_sector);
+    }
+    uint64_t t1 = StkTime::getMonoTimeUs();
+    for (unsigned int i = 0; i < points.size(); i++)
+    {
+        const int first = (i * 37) % n;
+        const bool ignore_vertical = i % 5 == 0;
+        grid_road.push_back(grid.findRoadSector(points[i], first,
+                                                ignore_vertical));
+        grid_out.push_back(grid.findOutOfRoadSector(points[i], first,
+                                                    ignore_vertical));
+    }
+    uint64_t t2 = StkTime::getMonoTimeUs();
+
+    int on_road = 0;
+    for (unsigned int i = 0; i < points.size(); i++)
+    {
+        assert(grid_road[i] == linear_road[i]);
+        assert(grid_out[i] == linear_out[i]);
+        if (linear_road[i] != Graph::UNKNOWN_SECTOR)
+            on_road++;
+    }
+    assert(on_road > 0 && on_road < (int)points.size());
+    (void)on_road;
+
+    Log::info("QuadGrid", "%d points on %d quads: %.2f us per point with "
+        "a linear search, %.2f us with the grid.", (int)points.size(), n,
+        (float)(t1 - t0) / points.size(), (float)(t2 - t1) / points.size());
+
+    for (unsigned int i = 0; i < quads.size(); i++)
+        delete quads[i];
+}   // unitTesting
@@ -0,0 +1,92 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_QUAD_GRID_HPP
+#define HEADER_QUAD_GRID_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <vector>
+
+class Quad;
+class Vec3;
+
+/**
+ * \brief A uniform 2d grid (in X and Z) over the quads of a graph, used to
+ *  find the quad a point is on, or the closest quad, without testing all
+ *  quads.
+ *  Each quad is stored in all cells overlapped by the box of the points its
+ *  pointInside can accept (see Quad::getInsideBox), and quads for which no
+ *  such box exists are always tested. 3d quads also accept points exactly
+ *  on the plane of one face, which are checked separately. The queries return the same quad as
+ *  testing all quads in the order of the graph would, so the grid can be
+ *  used instead of the linear search of the graph.
+ * \ingroup tracks
+ */
+class QuadGrid : public NoCopy
+{
+private:
+    /** The quads of the graph, indexed by node index. */
+    const std::vector<Quad*> &m_quads;
+
+    /** The area covered by the grid in X and Z. */
+    float m_min_x, m_min_z, m_max_x, m_max_z;
+
+    /** Size of one (square) cell. */
+    float m_cell_size;
+
+    /** Number of cells in X and Z direction. */
+    int m_cells_x, m_cells_z;
+
+    /** Index into m_cell_quads of the first quad of each cell, with one more
+     *  entry at the end, so cell i contains the quads from m_cell_start[i]
+     *  to m_cell_start[i+1]. */
+    std::vector<unsigned int> m_cell_start;
+
+    /** The quads of all cells, sorted by cell. */
+    std::vector<int> m_cell_quads;
+
+    /** Quads whose points can not be bounded by a box, which are tested for
+     *  every point. */
+    std::vector<int> m_unbounded_quads;
+
+    /** The 3d quads, which pointInside also accepts anywhere on the plane
+     *  of the first face of their box, see Quad::pointInsideOutsideBox. */
+    std::vector<int> m_3d_quads;
+
+    /** Largest absolute coordinate of the grid, used for rounding errors. */
+    float m_max_coordinate;
+
+    // ------------------------------------------------------------------------
+    int getCellX(float x) const;
+    // ------------------------------------------------------------------------
+    int getCellZ(float z) const;
+
+public:
+    QuadGrid(const std::vector<Quad*> &quads);
+    // ------------------------------------------------------------------------
+    int findRoadSector(const Vec3 &xyz, int first,
+                       bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    int findOutOfRoadSector(const Vec3 &xyz, int first,
+                            bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // QuadGrid
+
+#endif
@@ -112,6 +112,7 @@ using namespace irr;
 const float Track::NOHIT               = -99999.9f;
 bool        Track::m_dont_load_navmesh = false;
 std::atomic<Track*> Track::m_current_track[PT_COUNT];
+std::mutex          Track::m_load_mutex;
 
 // ----------------------------------------------------------------------------
 Track::Track(const std::string &filename)
@@ -122,6 +123,7 @@ Track::Track(const std::string &filename)
 
     m_minimap_invert_x_z    = false;
     m_materials_loaded      = false;
+    m_lobby_copy            = false;
     m_filename              = filename;
     m_root                  =
         StringUtils::getPath(StringUtils::removeExtension(m_filename));
@@ -168,6 +170,7 @@ Track::Track(const std::string &filename)
     m_physical_object_uid   = 0;
     m_shadows               = true;
     m_sky_particles         = NULL;
+    m_sun                   = NULL;
     m_sky_dx                = 0.05f;
     m_sky_dy                = 0.0f;
     m_godrays_opacity       = 1.0f;
@@ -321,14 +324,9 @@ void Track::cleanup()
 {
     irr_driver->resetSceneComplexity();
     m_physical_object_uid = 0;
-#ifdef USE_RESIZE_CACHE
-    if (!UserConfigParams::m_high_definition_textures)
-    {
-        file_manager->popTextureSearchPath();
-    }
-#endif
-    file_manager->popTextureSearchPath();
-    file_manager->popModelSearchPath();
+    // Lobby copies removed their search paths after loading already
+    if (!m_lobby_copy)
+        popSearchPaths();
 
     Graph::destroy();
     m_item_manager = nullptr;
@@ -378,9 +376,13 @@ void Track::cleanup()
     m_object_physics_only_nodes.clear();
 
 #ifndef SERVER_ONLY
-    irr_driver->removeNode(m_sun);
-    if (CVS->isGLSL())
-        m_sun->drop();
+    if (m_sun)
+    {
+        irr_driver->removeNode(m_sun);
+        if (CVS->isGLSL())
+            m_sun->drop();
+        m_sun = NULL;
+    }
 #endif
     delete m_track_mesh;
     m_track_mesh = NULL;
@@ -517,11 +519,28 @@ void Track::cleanup()
 #endif
 
     m_meta_library.clear();
-    Scripting::ScriptEngine::getInstance()->cleanupCache();
+    // Child processes have no scripting engine
+    if (!STKProcess::isChild())
+        Scripting::ScriptEngine::getInstance()->cleanupCache();
 
-    m_current_track[PT_MAIN] = NULL;
+    m_current_track[STKProcess::getType()] = NULL;
 }   // cleanup
 
+//-----------------------------------------------------------------------------
+/** Removes the search paths of this track added in loadTrackModel.
+ */
+void Track::popSearchPaths()
+{
+#ifdef USE_RESIZE_CACHE
+    if (!UserConfigParams::m_high_definition_textures)
+    {
+        file_manager->popTextureSearchPath();
+    }
+#endif
+    file_manager->popTextureSearchPath();
+    file_manager->popModelSearchPath();
+}   // popSearchPaths
+
 //-----------------------------------------------------------------------------
 void Track::loadTrackInfo()
 {
@@ -925,13 +944,23 @@ void Track::createPhysicsModel(unsigned int main_track_count,
         uploadNodeVertexBuffer(m_all_nodes[i]);
     }
     main_loop->renderGUI(5580);
+    // The BVH of the static track meshes is cached on disk
     if (for_height_map)
-        m_track_mesh->createCollisionShape();
+    {
+        m_track_mesh->createCollisionShape(/*create_collision_object*/true,
+            /*cache_bvh*/true);
+    }
     else
-        m_track_mesh->createPhysicalBody(m_friction);
+    {
+        m_track_mesh->createPhysicalBody(m_friction,
+            (btCollisionObject::CollisionFlags)0, /*cache_bvh*/true);
+    }
     main_loop->renderGUI(5585);
     if (m_gfx_effect_mesh)
-        m_gfx_effect_mesh->createCollisionShape();
+    {
+        m_gfx_effect_mesh->createCollisionShape(
+            /*create_collision_object*/true, /*cache_bvh*/true);
+    }
     main_loop->renderGUI(5590);
 
 }   // createPhysicsModel
@@ -1349,7 +1378,8 @@ bool Track::loadMainTrack(const XMLNode &root)
     track_node->getHPR(&hpr);
     scene_node->setPosition(xyz);
     scene_node->setRotation(hpr);
-    handleAnimatedTextures(scene_node, *track_node);
+    if (!GUIEngine::isNoGraphics())
+        handleAnimatedTextures(scene_node, *track_node);
 #ifndef SERVER_ONLY
     if (!GUIEngine::isNoGraphics() &&
         GE::getDriver()->getDriverType() == video::EDT_VULKAN)
@@ -1474,7 +1504,8 @@ bool Track::loadMainTrack(const XMLNode &root)
             scene_node->setName(debug_name.c_str());
 #endif
 
-            handleAnimatedTextures(scene_node, *n);
+            if (!GUIEngine::isNoGraphics())
+                handleAnimatedTextures(scene_node, *n);
 
             // for challenge orbs, a bit more work to do
             // TODO: this is hardcoded for the overworld, convert to scripting
@@ -1579,7 +1610,8 @@ bool Track::loadMainTrack(const XMLNode &root)
         Log::fatal("track", "m_track_mesh == NULL, cannot loadMainTrack\n");
     }
 
-    m_gfx_effect_mesh->createCollisionShape();
+    m_gfx_effect_mesh->createCollisionShape(/*create_collision_object*/true,
+        /*cache_bvh*/true);
     scene_node->setMaterialFlag(video::EMF_LIGHTING, true);
     scene_node->setMaterialFlag(video::EMF_GOURAUD_SHADING, true);
     main_loop->renderGUI(4500);
@@ -1714,9 +1746,11 @@ void Track::update(int ticks)
         m_startup_run = true;
         // After onStart all track objects will be hidden as needed
         // we only copy track objects with physical body which affects network
-        if (LobbyProtocol::getByType<LobbyProtocol>(PT_CHILD))
+        if (LobbyProtocol::getByType<LobbyProtocol>(PT_CHILD) &&
+            !m_lobby_copy)
         {
             Track* child_track = clone();
+            Graph::shareWithChild(PT_CHILD);
             m_current_track[PT_CHILD] = child_track;
         }
     }
@@ -1826,7 +1860,8 @@ void Track::createWater(const XMLNode &node)
     scene_node->setPosition(xyz);
     scene_node->setRotation(hpr);
     m_all_nodes.push_back(scene_node);
-    handleAnimatedTextures(scene_node, node);
+    if (!GUIEngine::isNoGraphics())
+        handleAnimatedTextures(scene_node, node);
 
     scene_node->getMaterial(0).setFlag(video::EMF_GOURAUD_SHADING, true);
 }   // createWater
@@ -1873,7 +1908,10 @@ static void recursiveUpdatePhysics(std::vector<TrackObject*>& tos)
  */
 void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
 {
-    assert(m_current_track[PT_MAIN].load() == NULL);
+    const ProcessType pt = STKProcess::getType();
+    assert(m_current_track[pt].load() == NULL);
+    // Only the main process or a lobby with its own copy loads a track
+    assert(pt == PT_MAIN || m_lobby_copy);
 
     // Use m_filename to also get the path, not only the identifier
     STKTexManager::getInstance()
@@ -1970,8 +2008,9 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         throw std::runtime_error(msg.str());
     }
 
-    m_current_track[PT_MAIN] = this;
-    m_current_track[PT_CHILD] = NULL;
+    m_current_track[pt] = this;
+    if (pt == PT_MAIN)
+        m_current_track[PT_CHILD] = NULL;
 
     // Load the graph only now: this function is called from world, after
     // the race gui was created. The race gui is needed since it stores
@@ -2171,7 +2210,8 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     model_def_loader.cleanLibraryNodesAfterLoad();
     main_loop->renderGUI(5100);
 
-    Scripting::ScriptEngine::getInstance()->compileLoadedScripts();
+    if (pt == PT_MAIN)
+        Scripting::ScriptEngine::getInstance()->compileLoadedScripts();
     main_loop->renderGUI(5200);
 
     // Init all track objects
@@ -2227,44 +2267,49 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
 #endif
     main_loop->renderGUI(5400);
 
-    // ---- Set ambient color
-    m_ambient_color = m_default_ambient_color;
-    irr_driver->setAmbientLight(m_ambient_color,
-        m_spherical_harmonics_textures.size() != 6/*force_SH_computation*/);
-
-    // ---- Create sun (non-ambient directional light)
-    if (m_sun_position.getLengthSQ() < 0.03f)
+    // Without graphics only what the simulation needs is loaded, so there
+    // is no ambient light and no sun
+    if (!GUIEngine::isNoGraphics())
     {
-        m_sun_position = core::vector3df(500, 250, 250);
-    }
+        // ---- Set ambient color
+        m_ambient_color = m_default_ambient_color;
+        irr_driver->setAmbientLight(m_ambient_color,
+            m_spherical_harmonics_textures.size() != 6/*force_SH_computation*/);
 
-    const video::SColorf tmpf(m_sun_diffuse_color);
-    m_sun = irr_driver->addLight(m_sun_position, 0., 0., tmpf.r, tmpf.g, tmpf.b, true);
+        // ---- Create sun (non-ambient directional light)
+        if (m_sun_position.getLengthSQ() < 0.03f)
+        {
+            m_sun_position = core::vector3df(500, 250, 250);
+        }
+
+        const video::SColorf tmpf(m_sun_diffuse_color);
+        m_sun = irr_driver->addLight(m_sun_position, 0., 0., tmpf.r, tmpf.g, tmpf.b, true);
 
 #ifndef SERVER_ONLY
-    if (!CVS->isGLSL())
-    {
-        scene::ILightSceneNode *sun_ = (scene::ILightSceneNode *) m_sun;
+        if (!CVS->isGLSL())
+        {
+            scene::ILightSceneNode *sun_ = (scene::ILightSceneNode *) m_sun;
 
-        sun_->setLightType(video::ELT_DIRECTIONAL);
+            sun_->setLightType(video::ELT_DIRECTIONAL);
 
-        // The angle of the light is rather important - let the sun
-        // point towards (0,0,0).
-        if (m_sun_position.getLengthSQ() < 0.03f)
-            // Backward compatibility: if no sun is specified, use the
-            // old hardcoded default angle
-            m_sun->setRotation(core::vector3df(180, 45, 45));
-        else
-            m_sun->setRotation((-m_sun_position).getHorizontalAngle());
+            // The angle of the light is rather important - let the sun
+            // point towards (0,0,0).
+            if (m_sun_position.getLengthSQ() < 0.03f)
+                // Backward compatibility: if no sun is specified, use the
+                // old hardcoded default angle
+                m_sun->setRotation(core::vector3df(180, 45, 45));
+            else
+                m_sun->setRotation((-m_sun_position).getHorizontalAngle());
 
-        sun_->getLightData().SpecularColor = m_sun_specular_color;
-    }
-    else
-    {
-        irr_driver->createSunInterposer();
-        m_sun->grab();
-    }
+            sun_->getLightData().SpecularColor = m_sun_specular_color;
+        }
+        else
+        {
+            irr_driver->createSunInterposer();
+            m_sun->grab();
+        }
 #endif
+    }   // !isNoGraphics
     main_loop->renderGUI(5500);
 
     // Join all static physics only object to main track if possible
@@ -2391,6 +2436,10 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         m_spherical_harmonics_textures.clear();
     }
 #endif   // !SERVER_ONLY
+    // The search paths are a stack shared by all lobbies of this process,
+    // so they can't be kept until the race ends
+    if (m_lobby_copy)
+        popSearchPaths();
 }   // loadTrackModel
 
 //-----------------------------------------------------------------------------
@@ -2462,18 +2511,22 @@ void Track::loadObjects(const XMLNode* root, const std::string& path,
         }
         else if (name == "particle-emitter")
         {
-            if (UserConfigParams::m_particles_effects > 1)
+            // Emitters are only shown, they don't use a physical object id
+            if (!GUIEngine::isNoGraphics() &&
+                UserConfigParams::m_particles_effects > 1)
             {
                 m_track_object_manager->add(*node, parent, model_def_loader, parent_library);
             }
         }
         else if (name == "sky-dome" || name == "sky-box" || name == "sky-color")
         {
-            handleSky(*node, path);
+            if (!GUIEngine::isNoGraphics())
+                handleSky(*node, path);
         }
         else if (name == "end-cameras")
         {
-            CameraEnd::readEndCamera(*node);
+            if (!GUIEngine::isNoGraphics())
+                CameraEnd::readEndCamera(*node);
         }
         else if (name == "light")
         {
@@ -2487,7 +2540,7 @@ void Track::loadObjects(const XMLNode* root, const std::string& path,
             node->get("lightning", &m_weather_lightning);
             node->get("sound", &m_weather_sound);
 
-            if (weather_particles.size() > 0)
+            if (!GUIEngine::isNoGraphics() && weather_particles.size() > 0)
             {
                 m_sky_particles =
                     ParticleKindManager::get()->getParticles(weather_particles);
@@ -3063,8 +3116,10 @@ void Track::initChildTrack()
 
     // We call physics init in child process too
     Physics::get()->init(m_aabb_min, m_aabb_max);
-    m_track_mesh->createPhysicalBody(m_friction);
-    m_gfx_effect_mesh->createCollisionShape();
+    m_track_mesh->createPhysicalBody(m_friction,
+        (btCollisionObject::CollisionFlags)0, /*cache_bvh*/true);
+    m_gfx_effect_mesh->createCollisionShape(/*create_collision_object*/true,
+        /*cache_bvh*/true);
 
     // All child track objects are only cloned if they have physical objects
     for (auto* to : m_track_object_manager->getObjects().m_contents_vector)
@@ -3083,6 +3138,8 @@ void Track::cleanChildTrack()
 {
     assert(STKProcess::getType() == PT_CHILD);
     Track* child_track = m_current_track[PT_CHILD];
+    // The graph is owned by the main process track
+    Graph::destroy();
     child_track->m_item_manager = nullptr;
     delete child_track->m_check_manager;
     delete child_track->m_track_object_manager;
@@ -3092,6 +3149,20 @@ void Track::cleanChildTrack()
     m_current_track[PT_CHILD] = NULL;
 }   // cleanChildTrack
 
+//-----------------------------------------------------------------------------
+/** Cleans up and deletes the track copy loaded by a server lobby (see
+ *  cloneForLobby), called with m_load_mutex locked.
+ */
+void Track::cleanLobbyTrack()
+{
+    Track* lobby_track = getCurrentTrack();
+    if (!lobby_track)
+        return;
+    assert(lobby_track->m_lobby_copy);
+    lobby_track->cleanup();
+    delete lobby_track;
+}   // cleanLobbyTrack
+
 //-----------------------------------------------------------------------------
 video::IImage* Track::getSkyTexture(std::string path) const
 {
@@ -30,6 +30,7 @@
 #include <array>
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -190,6 +191,10 @@ private:
      *  for the overworld. */
     bool m_cache_track;
 
+    /** True if this is a copy of the track loaded by a server lobby of a
+     *  process running several lobbies, see cloneForLobby. */
+    bool m_lobby_copy;
+
 
 #ifdef DEBUG
     /** A list of textures that were cached before the track is loaded.
@@ -423,6 +428,7 @@ private:
     void handleSky(const XMLNode &root, const std::string &filename);
     void freeCachedMeshVertexBuffer();
     void copyFromMainProcess();
+    void popSearchPaths();
     video::IImage* getSkyTexture(std::string path) const;
 public:
 
@@ -441,10 +447,26 @@ public:
         return child_track;
     }
     // ------------------------------------------------------------------------
+    /** Returns a copy of this (not loaded) track, which a server lobby
+     *  loads for itself when several lobbies run in the same process. Its
+     *  materials are kept shared afterwards, and meshes are shared through
+     *  the mesh cache with other lobbies using the same track. */
+    Track* cloneForLobby()
+    {
+        Track* lobby_track = new Track(*this);
+        lobby_track->m_lobby_copy = true;
+        lobby_track->m_cache_track = true;
+        return lobby_track;
+    }
+    // ------------------------------------------------------------------------
     void initChildTrack();
     // ------------------------------------------------------------------------
     static void cleanChildTrack();
     // ------------------------------------------------------------------------
+    static void cleanLobbyTrack();
+    // ------------------------------------------------------------------------
+    bool isLobbyCopy() const                          { return m_lobby_copy; }
+    // ------------------------------------------------------------------------
     void handleAnimatedTextures(scene::ISceneNode *node, const XMLNode &xml);
 
     /** Flag to avoid loading navmeshes (useful to speedup debugging: e.g.
@@ -452,6 +474,11 @@ public:
      *  minutes(!) in debug mode to be computed. */
     static bool        m_dont_load_navmesh;
 
+    /** Serializes loading and cleaning up of tracks loaded by each server
+     *  lobby of a process, since the scene manager, the file search paths
+     *  and the material manager are shared. */
+    static std::mutex  m_load_mutex;
+
     /** Static helper function to pre-upload vertex buffer in spm. */
     static void uploadNodeVertexBuffer(scene::ISceneNode *node);
 
@@ -390,7 +390,8 @@ void TrackObject::onWorldReady()
     {
         m_initially_visible = false;
     }
-    else if (m_visibility_condition.size() > 0)
+    // Child processes have no scripting engine
+    else if (m_visibility_condition.size() > 0 && !STKProcess::isChild())
     {
         unsigned char result = -1;
         Scripting::ScriptEngine* script_engine = 
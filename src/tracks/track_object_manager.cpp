@@ -26,6 +26,7 @@
 #include "io/xml_node.hpp"
 #include "network/network_config.hpp"
 #include "physics/physical_object.hpp"
+#include "physics/physics_snapshot.hpp"
 #include "tracks/track_object.hpp"
 #include "utils/log.hpp"
 
@@ -205,6 +206,54 @@ void TrackObjectManager::resetAfterRewind()
     }
 }   // resetAfterRewind
 
+// ----------------------------------------------------------------------------
+/** Saves the bodies of all physical objects moved by 3d animation, so they
+ *  can be restored after a rewind without running the animations again
+ *  (see resetAfterRewind).
+ *  \param snapshot Where to save the bodies.
+ */
+void TrackObjectManager::saveAnimatedBodies(
+                                      std::vector<RigidBodySnapshot>* snapshot)
+{
+    snapshot->clear();
+    TrackObject* curr;
+    for_in (curr, m_all_objects)
+    {
+        if (!curr->getAnimator() || !curr->getPhysicalObject())
+            continue;
+        snapshot->emplace_back();
+        snapshot->back().save(curr->getPhysicalObject()->getBody());
+    }
+}   // saveAnimatedBodies
+
+// ----------------------------------------------------------------------------
+/** Restores the bodies saved with saveAnimatedBodies.
+ *  \param snapshot The saved bodies.
+ *  \return False if the objects changed since the bodies were saved, in
+ *          which case nothing is restored.
+ */
+bool TrackObjectManager::restoreAnimatedBodies(
+                                const std::vector<RigidBodySnapshot>& snapshot)
+{
+    unsigned count = 0;
+    TrackObject* curr;
+    for_in (curr, m_all_objects)
+    {
+        if (curr->getAnimator() && curr->getPhysicalObject())
+            count++;
+    }
+    if (count != snapshot.size())
+        return false;
+
+    count = 0;
+    for_in (curr, m_all_objects)
+    {
+        if (curr->getAnimator() && curr->getPhysicalObject())
+            snapshot[count++].restore(curr->getPhysicalObject()->getBody());
+    }
+    return true;
+}   // restoreAnimatedBodies
+
 // ----------------------------------------------------------------------------
 /** Does a raycast against all driveable objects. This way part of the track
  *  can be a physical object, and can e.g. be animated. A separate list of all
@@ -24,6 +24,7 @@
 #include "utils/ptr_vector.hpp"
 
 class Track;
+struct RigidBodySnapshot;
 class Vec3;
 class XMLNode;
 class LODNode;
@@ -62,6 +63,8 @@ public:
     void updateGraphics(float dt);
     void update(float dt);
     void resetAfterRewind();
+    void saveAnimatedBodies(std::vector<RigidBodySnapshot>* snapshot);
+    bool restoreAnimatedBodies(const std::vector<RigidBodySnapshot>& snapshot);
     void handleExplosion(const Vec3 &pos, const PhysicalObject *mp,
                          bool secondary_hits=true);
     bool castRay(const btVector3 &from,
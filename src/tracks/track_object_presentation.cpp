@@ -217,7 +217,8 @@ TrackObjectPresentationLibraryNode::TrackObjectPresentationLibraryNode(
         {
             lib_path = track->getTrackFile("library/" + name);
             libroot = file_manager->createXMLTree(local_lib_node_path);
-            if (track != NULL)
+            // Child processes have no scripting engine
+            if (track != NULL && !STKProcess::isChild())
             {
                 Scripting::ScriptEngine::getInstance()->loadScript(local_script_file_path, false);
             }
@@ -225,7 +226,7 @@ TrackObjectPresentationLibraryNode::TrackObjectPresentationLibraryNode(
         else if (file_manager->fileExists(lib_node_path))
         {
             libroot = file_manager->createXMLTree(lib_node_path);
-            if (track != NULL)
+            if (track != NULL && !STKProcess::isChild())
             {
                 Scripting::ScriptEngine::getInstance()->loadScript(lib_script_file_path, false);
             }
@@ -296,7 +297,7 @@ TrackObjectPresentationLibraryNode::TrackObjectPresentationLibraryNode(
 void TrackObjectPresentationLibraryNode::update(float dt)
 {
     // Child process currently has no scripting engine
-    if (STKProcess::getType() == PT_CHILD)
+    if (STKProcess::isChild())
         return;
 
     if (!m_start_executed)
@@ -1198,7 +1199,7 @@ TrackObjectPresentationActionTrigger::TrackObjectPresentationActionTrigger(
 void TrackObjectPresentationActionTrigger::onTriggerItemApproached(int kart_id)
 {
     if (m_reenable_timeout > StkTime::getMonoTimeMs() ||
-        STKProcess::getType() == PT_CHILD)
+        STKProcess::isChild())
     {
         return;
     }
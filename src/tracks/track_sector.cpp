@@ -20,6 +20,7 @@
 
 #include "modes/linear_world.hpp"
 #include "modes/world.hpp"
+#include "network/bit_packing.hpp"
 #include "network/network_string.hpp"
 #include "tracks/check_manager.hpp"
 #include "tracks/check_structure.hpp"
@@ -185,6 +186,13 @@ void TrackSector::saveState(BareNetworkString* buffer) const
     buffer->addFloat(m_current_track_coords.getZ());
 }   // saveState
 
+// ----------------------------------------------------------------------------
+void TrackSector::saveState(BitWriter* bw) const
+{
+    bw->addVarInt(m_current_graph_node);
+    bw->addFloat(m_current_track_coords.getZ());
+}   // saveState
+
 // ----------------------------------------------------------------------------
 void TrackSector::rewindTo(BareNetworkString* buffer)
 {
@@ -193,6 +201,13 @@ void TrackSector::rewindTo(BareNetworkString* buffer)
     m_current_track_coords.setZ(buffer->getFloat());
 }   // rewindTo
 
+// ----------------------------------------------------------------------------
+void TrackSector::rewindTo(BitReader* br)
+{
+    m_current_graph_node = br->getVarInt();
+    m_current_track_coords.setZ(br->getFloat());
+}   // rewindTo
+
 // ----------------------------------------------------------------------------
 /** Save completely for spectating in linear race
  */
@@ -22,6 +22,8 @@
 #include "utils/vec3.hpp"
 
 class BareNetworkString;
+class BitReader;
+class BitWriter;
 class Track;
 
 /** This object keeps track of which sector an object is on. A sector is
@@ -97,8 +99,12 @@ public:
     // ------------------------------------------------------------------------
     void saveState(BareNetworkString* buffer) const;
     // ------------------------------------------------------------------------
+    void saveState(BitWriter* bw) const;
+    // ------------------------------------------------------------------------
     void rewindTo(BareNetworkString* buffer);
     // ------------------------------------------------------------------------
+    void rewindTo(BitReader* br);
+    // ------------------------------------------------------------------------
     void saveCompleteState(BareNetworkString* bns);
     // ------------------------------------------------------------------------
     void restoreCompleteState(const BareNetworkString& b);
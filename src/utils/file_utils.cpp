@@ -18,6 +18,7 @@
 #include "utils/file_utils.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <stdio.h>
 #include <string>
@@ -166,3 +167,24 @@ int FileUtils::renameU8Path(const std::string& u8_path_old,
     return rename(u8_path_old.c_str(), u8_path_new.c_str());
 #endif
 }   // renameU8Path
+
+// ----------------------------------------------------------------------------
+/** Writes a file under a temporary name first and then renames it, so that
+ *  other processes never read a partially written file.
+ *  \return True if the file was written.
+ */
+bool FileUtils::writeFileAtomic(const std::string& u8_path, const void* data,
+                                size_t size)
+{
+    const std::string tmp = u8_path + ".tmp" +
+        StringUtils::toString(StkTime::getMonoTimeUs());
+    FILE* f = fopenU8Path(tmp, "wb");
+    if (!f)
+        return false;
+    bool written = fwrite(data, size, 1, f) == 1;
+    written = fclose(f) == 0 && written;
+    if (written && renameU8Path(tmp, u8_path) == 0)
+        return true;
+    remove(getPortableWritingPath(tmp).c_str());
+    return false;
+}   // writeFileAtomic
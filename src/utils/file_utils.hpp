@@ -39,6 +39,9 @@ namespace FileUtils
     int renameU8Path(const std::string& u8_path_old,
                      const std::string& u8_path_new);
     // ------------------------------------------------------------------------
+    bool writeFileAtomic(const std::string& u8_path, const void* data,
+                         size_t size);
+    // ------------------------------------------------------------------------
     /* Return a path which can be opened for writing in all systems, as long as
      * u8_path is unicode encoded. */
     inline std::string getPortableWritingPath(const std::string& u8_path)
@@ -0,0 +1,498 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/job_system.hpp"
+
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/vs.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+
+JobSystem* JobSystem::m_job_system = NULL;
+
+/** The job system of which this thread is a worker, and its index. */
+static thread_local JobSystem* g_worker_of = NULL;
+static thread_local int g_worker_index = -1;
+
+// ----------------------------------------------------------------------------
+/** Creates the job system.
+ *  \param num_workers Number of worker threads, a negative value uses one
+ *         worker less than the number of cores (at most 7), 0 runs all jobs
+ *         in the calling thread.
+ */
+void JobSystem::create(int num_workers)
+{
+    assert(m_job_system == NULL);
+    if (num_workers < 0)
+    {
+        int cores = (int)std::thread::hardware_concurrency();
+        num_workers = std::min(std::max(cores - 1, 0), 7);
+    }
+    m_job_system = new JobSystem((unsigned)num_workers);
+    Log::info("JobSystem", "Using %d worker threads.", num_workers);
+}   // create
+
+// ----------------------------------------------------------------------------
+void JobSystem::destroy()
+{
+    delete m_job_system;
+    m_job_system = NULL;
+}   // destroy
+
+// ----------------------------------------------------------------------------
+JobSystem::JobSystem(unsigned num_workers)
+{
+    m_exit = false;
+    m_queued_jobs.store(0);
+    for (unsigned i = 0; i < num_workers + 1; i++)
+        m_queues.emplace_back(new WorkQueue());
+    for (unsigned i = 0; i < num_workers; i++)
+        m_workers.emplace_back(&JobSystem::runWorker, this, i);
+}   // JobSystem
+
+// ----------------------------------------------------------------------------
+/** Runs the remaining jobs and stops the workers. */
+JobSystem::~JobSystem()
+{
+    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+    m_exit = true;
+    lock.unlock();
+    m_job_added.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+    while (runPendingJob()) {}
+}   // ~JobSystem
+
+// ----------------------------------------------------------------------------
+void JobSystem::runWorker(unsigned index)
+{
+    VS::setThreadName((std::string("JobSystem") +
+        StringUtils::toString(index)).c_str());
+    g_worker_of = this;
+    g_worker_index = (int)index;
+    Job job;
+    while (true)
+    {
+        if (popJob(index, &job))
+        {
+            job();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_job_added.wait(lock, [this]()
+            { return m_exit || m_queued_jobs.load() > 0; });
+        if (m_exit && m_queued_jobs.load() <= 0)
+            return;
+    }
+}   // runWorker
+
+// ----------------------------------------------------------------------------
+/** Takes a job from the queue own_queue, or steals one from the other
+ *  queues if it's empty.
+ *  \return False if all queues are empty.
+ */
+bool JobSystem::popJob(int own_queue, Job* job)
+{
+    const int num_queues = (int)m_queues.size();
+    for (int i = 0; i < num_queues; i++)
+    {
+        const int index = (own_queue + i) % num_queues;
+        WorkQueue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+        if (queue.m_jobs.empty())
+            continue;
+        // Workers run their newest job first (its data is still in the
+        // cache), all others are taken in the order they were added
+        if (i == 0 && index < num_queues - 1)
+        {
+            *job = std::move(queue.m_jobs.back());
+            queue.m_jobs.pop_back();
+        }
+        else
+        {
+            *job = std::move(queue.m_jobs.front());
+            queue.m_jobs.pop_front();
+        }
+        m_queued_jobs.fetch_sub(1);
+        return true;
+    }
+    return false;
+}   // popJob
+
+// ----------------------------------------------------------------------------
+/** Adds a job, which runs with the process type of this thread.
+ *  \param name Name of the job in the profiler, it must stay valid (e.g. a
+ *         string literal).
+ */
+void JobSystem::submit(const char* name, Job job)
+{
+    const ProcessType pt = STKProcess::getType();
+    Job wrapped = [pt, name, job]()
+    {
+        // A thread waiting for its own jobs can run jobs of other processes
+        const ProcessType previous = STKProcess::getType();
+        STKProcess::init(pt);
+        PROFILER_PUSH_CPU_MARKER(name, 0x60, 0x60, 0xFF);
+        job();
+        PROFILER_POP_CPU_MARKER();
+        STKProcess::init(previous);
+    };
+    const int index = g_worker_of == this ? g_worker_index
+                                          : (int)m_queues.size() - 1;
+    WorkQueue& queue = *m_queues[index];
+    std::unique_lock<std::mutex> queue_lock(queue.m_mutex);
+    queue.m_jobs.push_back(std::move(wrapped));
+    queue_lock.unlock();
+    m_queued_jobs.fetch_add(1);
+
+    // Taking the mutex makes sure that a worker which didn't see the new job
+    // is already waiting and gets woken up
+    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+    lock.unlock();
+    m_job_added.notify_one();
+}   // submit
+
+// ----------------------------------------------------------------------------
+/** Runs one queued job in this thread.
+ *  \return False if there was no job to run.
+ */
+bool JobSystem::runPendingJob()
+{
+    Job job;
+    const int own = g_worker_of == this ? g_worker_index
+                                        : (int)m_queues.size() - 1;
+    if (!popJob(own, &job))
+        return false;
+    job();
+    return true;
+}   // runPendingJob
+
+// ----------------------------------------------------------------------------
+/** Returns when count jobs have been counted as done in state, and runs
+ *  queued jobs meanwhile. It only sleeps when no job is queued, until a job
+ *  of state is done (which may have added new jobs).
+ */
+void JobSystem::waitFor(WaitState* state, unsigned count)
+{
+    while (state->m_done.load() < count)
+    {
+        if (runPendingJob())
+            continue;
+        std::unique_lock<std::mutex> lock(state->m_mutex);
+        state->m_progress.wait(lock, [this, state, count]()
+            {
+                return state->m_done.load() >= count ||
+                    m_queued_jobs.load() > 0;
+            });
+    }
+}   // waitFor
+
+// ----------------------------------------------------------------------------
+/** Calls func for each index in [0, count) and returns when all calls are
+ *  done. The indices are taken in blocks of grain indices by the workers and
+ *  this thread, so the calls must not write to any data used by the calls
+ *  for other indices; the order of the calls is undefined.
+ *  \param name Name of the jobs in the profiler.
+ *  \param grain Number of indices taken at once, larger values reduce the
+ *         overhead for very short calls.
+ */
+void JobSystem::parallelFor(unsigned count,
+                            const std::function<void(unsigned)>& func,
+                            const char* name, unsigned grain)
+{
+    if (grain == 0)
+        grain = 1;
+    const unsigned blocks = (count + grain - 1) / grain;
+    if (blocks < 2 || m_workers.empty())
+    {
+        for (unsigned i = 0; i < count; i++)
+            func(i);
+        return;
+    }
+
+    /** A job which starts after all indices were taken only sees that
+     *  nothing is left and doesn't use func. */
+    struct ForState : public WaitState
+    {
+        const std::function<void(unsigned)>* m_func;
+        unsigned m_count;
+        unsigned m_grain;
+        std::atomic<unsigned> m_next;
+        // --------------------------------------------------------------------
+        void work()
+        {
+            unsigned done = 0;
+            unsigned start;
+            while ((start = m_next.fetch_add(m_grain)) < m_count)
+            {
+                const unsigned end = std::min(start + m_grain, m_count);
+                for (unsigned i = start; i < end; i++)
+                    (*m_func)(i);
+                done += end - start;
+            }
+            if (done > 0)
+                addDone(done);
+        }   // work
+    };
+    std::shared_ptr<ForState> state = std::make_shared<ForState>();
+    state->m_func = &func;
+    state->m_count = count;
+    state->m_grain = grain;
+    state->m_next.store(0);
+
+    const unsigned jobs = std::min(blocks - 1, getNumWorkers());
+    for (unsigned i = 0; i < jobs; i++)
+        submit(name, [state]() { state->work(); });
+    state->work();
+    waitFor(state.get(), count);
+}   // parallelFor
+
+// ============================================================================
+/** Adds a task to the graph.
+ *  \param name Name of the task in the profiler, it must stay valid.
+ *  \param func The function to call.
+ *  \param dependencies Indices of the tasks which must be done before this
+ *         task starts, they must have been added before.
+ *  \return Index of the new task.
+ */
+unsigned TaskGraph::add(const char* name, std::function<void()> func,
+                        const std::vector<unsigned>& dependencies)
+{
+    const unsigned index = (unsigned)m_tasks.size();
+    Task* task = new Task();
+    task->m_name = name;
+    task->m_func = func;
+    task->m_num_dependencies = (unsigned)dependencies.size();
+    task->m_pending.store(0);
+    for (unsigned dependency : dependencies)
+    {
+        assert(dependency < index);
+        m_tasks[dependency]->m_successors.push_back(index);
+    }
+    m_tasks.emplace_back(task);
+    return index;
+}   // add
+
+// ----------------------------------------------------------------------------
+void TaskGraph::startTask(JobSystem* job_system,
+                          const std::shared_ptr<JobSystem::WaitState>& state,
+                          unsigned index)
+{
+    job_system->submit(m_tasks[index]->m_name,
+        [this, job_system, state, index]()
+        {
+            Task* task = m_tasks[index].get();
+            task->m_func();
+            for (unsigned successor : task->m_successors)
+            {
+                if (m_tasks[successor]->m_pending.fetch_sub(1) == 1)
+                    startTask(job_system, state, successor);
+            }
+            // The graph can be deleted once all tasks are counted as done
+            state->addDone(1);
+        });
+}   // startTask
+
+// ----------------------------------------------------------------------------
+/** Runs all tasks and returns when they are done.
+ *  \param job_system The job system to use, if NULL all tasks are run in
+ *         this thread in the order they were added.
+ */
+void TaskGraph::run(JobSystem* job_system)
+{
+    if (!job_system)
+    {
+        for (std::unique_ptr<Task>& task : m_tasks)
+            task->m_func();
+        return;
+    }
+    for (std::unique_ptr<Task>& task : m_tasks)
+        task->m_pending.store(task->m_num_dependencies);
+    std::shared_ptr<JobSystem::WaitState> state =
+        std::make_shared<JobSystem::WaitState>();
+    for (unsigned i = 0; i < m_tasks.size(); i++)
+    {
+        if (m_tasks[i]->m_num_dependencies == 0)
+            startTask(job_system, state, i);
+    }
+    job_system->waitFor(state.get(), (unsigned)m_tasks.size());
+}   // run
+
+// ============================================================================
+namespace JobSystemTest
+{
+    // ------------------------------------------------------------------------
+    /** Checks that parallelFor calls the function exactly once for each
+     *  index, for nested calls and for concurrent calls (several lobbies
+     *  using the job system at the same time).
+     */
+    void testParallelFor(JobSystem* js)
+    {
+        const unsigned COUNT = 1000;
+        std::vector<std::atomic<int> > calls(COUNT);
+        auto check = [&calls](unsigned count)
+        {
+            for (unsigned i = 0; i < count; i++)
+            {
+                assert(calls[i].load() == 1);
+                calls[i].store(0);
+            }
+        };
+        for (std::atomic<int>& c : calls)
+            c.store(0);
+
+        for (unsigned count : { 0u, 1u, 2u, 7u, COUNT })
+        {
+            for (unsigned grain : { 1u, 3u, 64u })
+            {
+                js->parallelFor(count,
+                    [&calls](unsigned i) { calls[i].fetch_add(1); },
+                    "Unit test", grain);
+                check(count);
+            }
+        }
+
+        // The jobs run with the process type of the caller
+        std::thread child([&calls, js]()
+            {
+                STKProcess::init(PT_CHILD);
+                js->parallelFor(COUNT, [&calls](unsigned i)
+                    {
+                        assert(STKProcess::getType() == PT_CHILD);
+                        calls[i].fetch_add(1);
+                    });
+            });
+        js->parallelFor(COUNT, [](unsigned i)
+            {
+                assert(STKProcess::getType() == PT_MAIN);
+                (void)i;
+            });
+        child.join();
+        check(COUNT);
+
+        // Nested calls don't deadlock, the waiting threads run the jobs
+        js->parallelFor(10, [&calls, js](unsigned i)
+            {
+                js->parallelFor(100, [&calls, i](unsigned j)
+                    { calls[i * 100 + j].fetch_add(1); });
+            });
+        check(COUNT);
+    }   // testParallelFor
+
+    // ------------------------------------------------------------------------
+    /** Checks that each task of a graph runs once, after its dependencies.
+     */
+    void testTaskGraph(JobSystem* js)
+    {
+        // A diamond after a chain, and a wide level which joins at the end:
+        // 0 -> 1 -> {2, 3} -> 4, 0 -> 5..24 -> 25
+        const unsigned TASKS = 26;
+        std::vector<std::atomic<int> > order(TASKS);
+        std::atomic<int> counter(0);
+        TaskGraph graph;
+        auto task = [&order, &counter](unsigned i)
+        {
+            return [&order, &counter, i]()
+                { order[i].store(counter.fetch_add(1)); };
+        };
+        std::vector<unsigned> wide;
+        graph.add("0", task(0));
+        graph.add("1", task(1), { 0 });
+        graph.add("2", task(2), { 1 });
+        graph.add("3", task(3), { 1 });
+        graph.add("4", task(4), { 2, 3 });
+        for (unsigned i = 5; i < 25; i++)
+            wide.push_back(graph.add("wide", task(i), { 0 }));
+        graph.add("25", task(25), wide);
+        assert(graph.size() == TASKS);
+
+        for (JobSystem* system : { js, (JobSystem*)NULL })
+        {
+            for (unsigned run = 0; run < 3; run++)
+            {
+                counter.store(0);
+                for (std::atomic<int>& o : order)
+                    o.store(-1);
+                graph.run(system);
+                assert(counter.load() == (int)TASKS);
+                assert(order[0].load() < order[1].load());
+                assert(order[1].load() < order[2].load());
+                assert(order[1].load() < order[3].load());
+                assert(order[2].load() < order[4].load());
+                assert(order[3].load() < order[4].load());
+                for (unsigned i = 5; i < 25; i++)
+                {
+                    assert(order[0].load() < order[i].load());
+                    assert(order[i].load() < order[25].load());
+                }
+            }
+        }
+    }   // testTaskGraph
+
+    // ------------------------------------------------------------------------
+    /** Measures the time of a CPU bound parallelFor with 1 to N threads
+     *  (the calling thread and 0 to N - 1 workers) and logs the speedup. */
+    void benchmarkScaling()
+    {
+        const unsigned COUNT = 4096;
+        std::vector<float> results(COUNT);
+        auto work = [&results](unsigned i)
+        {
+            float x = (float)i;
+            for (unsigned j = 0; j < 2000; j++)
+                x = std::sqrt(x * x + 1.0f) * 0.999f;
+            results[i] = x;
+        };
+        const unsigned cores =
+            std::max(1u, (unsigned)std::thread::hardware_concurrency());
+        double single_ms = 0.0;
+        for (unsigned threads = 1; threads <= cores; threads++)
+        {
+            JobSystem js(threads - 1);
+            // Warm up the workers
+            js.parallelFor(COUNT, work, "Benchmark", 16);
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned n = 0; n < 5; n++)
+                js.parallelFor(COUNT, work, "Benchmark", 16);
+            const double ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count() / 5.0;
+            if (threads == 1)
+                single_ms = ms;
+            Log::info("JobSystem", "%u threads: %.2f ms, speedup %.2f.",
+                threads, ms, single_ms / ms);
+        }
+    }   // benchmarkScaling
+
+    // ------------------------------------------------------------------------
+    void unitTesting()
+    {
+        for (unsigned workers : { 0u, 1u, 3u })
+        {
+            JobSystem js(workers);
+            testParallelFor(&js);
+            testTaskGraph(&js);
+        }
+        benchmarkScaling();
+    }   // unitTesting
+
+}   // namespace JobSystemTest
@@ -0,0 +1,196 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_JOB_SYSTEM_HPP
+#define HEADER_JOB_SYSTEM_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/stk_process.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** \brief A work-stealing pool of worker threads for short jobs of the game
+ *  logic, e.g. the AI of all karts (see World::update) or the computations
+ *  done when loading a track. One job system is shared by the whole
+ *  executable (all server lobbies of the child processes use the same
+ *  workers, see get()).
+ *  Each worker has its own queue: it runs the newest job of its queue
+ *  first, and steals the oldest job of another queue when its own is
+ *  empty. Jobs added by other threads go to an additional shared queue.
+ *  A thread waiting for jobs (in parallelFor or TaskGraph::run) runs queued
+ *  jobs instead of sleeping, so a job system without workers runs
+ *  everything in the waiting thread, and jobs can start and wait for other
+ *  jobs without deadlock.
+ *  Jobs run with the process type of the thread which added them, so
+ *  World::getWorld() and the other singletons of the process can be used in
+ *  them, and each job is shown with its name in the profiler, with one line
+ *  per worker.
+ *  \ingroup utils
+ */
+class JobSystem : public NoCopy
+{
+public:
+    typedef std::function<void()> Job;
+
+private:
+    static JobSystem* m_job_system;
+
+    /** The jobs of one worker, taken from the back by the worker and from
+     *  the front by thieves. */
+    struct WorkQueue
+    {
+        std::mutex m_mutex;
+        std::deque<Job> m_jobs;
+    };
+
+    /** One queue per worker, the last one is for jobs added by threads
+     *  which are not workers. */
+    std::vector<std::unique_ptr<WorkQueue> > m_queues;
+
+    std::vector<std::thread> m_workers;
+
+    /** Number of jobs in all queues, read by idle workers before sleeping. */
+    std::atomic<int> m_queued_jobs;
+
+    /** Protects m_exit and the sleeping of the idle workers. */
+    std::mutex m_sleep_mutex;
+
+    std::condition_variable m_job_added;
+
+    bool m_exit;
+
+    // ------------------------------------------------------------------------
+    void runWorker(unsigned index);
+    // ------------------------------------------------------------------------
+    bool popJob(int own_queue, Job* job);
+
+public:
+    /** Shared between a waiting thread and the jobs it waits for. */
+    class WaitState : public NoCopy
+    {
+    public:
+        std::atomic<unsigned> m_done;
+        std::mutex m_mutex;
+        std::condition_variable m_progress;
+        // --------------------------------------------------------------------
+        WaitState() { m_done.store(0); }
+        // --------------------------------------------------------------------
+        /** Called when count more jobs are done, wakes the waiting thread
+         *  which can then run jobs that were added by the finished ones. */
+        void addDone(unsigned count)
+        {
+            m_done.fetch_add(count);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_progress.notify_all();
+        }   // addDone
+    };   // class WaitState
+
+    // ------------------------------------------------------------------------
+    JobSystem(unsigned num_workers);
+    // ------------------------------------------------------------------------
+    ~JobSystem();
+    // ------------------------------------------------------------------------
+    static void create(int num_workers);
+    // ------------------------------------------------------------------------
+    static void destroy();
+    // ------------------------------------------------------------------------
+    /** Returns the job system, NULL if it was not created (e.g. in the
+     *  unit tests), in which case the caller runs the jobs itself. */
+    static JobSystem* get()                           { return m_job_system; }
+    // ------------------------------------------------------------------------
+    unsigned getNumWorkers() const     { return (unsigned)m_workers.size(); }
+    // ------------------------------------------------------------------------
+    void submit(const char* name, Job job);
+    // ------------------------------------------------------------------------
+    bool runPendingJob();
+    // ------------------------------------------------------------------------
+    void waitFor(WaitState* state, unsigned count);
+    // ------------------------------------------------------------------------
+    void parallelFor(unsigned count,
+                     const std::function<void(unsigned)>& func,
+                     const char* name = "parallelFor", unsigned grain = 1);
+    // ------------------------------------------------------------------------
+    /** Calls func for each index in [0, count) on the job system if there
+     *  is one, otherwise in this thread. */
+    static void run(unsigned count, const std::function<void(unsigned)>& func,
+                    const char* name = "parallelFor", unsigned grain = 1)
+    {
+        if (m_job_system)
+            m_job_system->parallelFor(count, func, name, grain);
+        else
+        {
+            for (unsigned i = 0; i < count; i++)
+                func(i);
+        }
+    }   // run
+
+};   // class JobSystem
+
+// ============================================================================
+/** \brief A set of tasks with dependencies between them, run on a
+ *  JobSystem: a task is started as soon as all tasks it depends on are
+ *  done, so independent tasks run in parallel. A task can only depend on
+ *  tasks added before it, so the graph has no cycles. The graph can be run
+ *  several times.
+ *  \ingroup utils
+ */
+class TaskGraph : public NoCopy
+{
+private:
+    struct Task
+    {
+        const char* m_name;
+        std::function<void()> m_func;
+        /** The tasks which depend on this task. */
+        std::vector<unsigned> m_successors;
+        unsigned m_num_dependencies;
+        /** Number of dependencies not done yet in the current run. */
+        std::atomic<unsigned> m_pending;
+    };
+
+    std::vector<std::unique_ptr<Task> > m_tasks;
+
+    // ------------------------------------------------------------------------
+    void startTask(JobSystem* job_system,
+                   const std::shared_ptr<JobSystem::WaitState>& state,
+                   unsigned index);
+
+public:
+    unsigned add(const char* name, std::function<void()> func,
+                 const std::vector<unsigned>& dependencies =
+                                                      std::vector<unsigned>());
+    // ------------------------------------------------------------------------
+    void run(JobSystem* job_system = JobSystem::get());
+    // ------------------------------------------------------------------------
+    size_t size() const                               { return m_tasks.size(); }
+
+};   // class TaskGraph
+
+namespace JobSystemTest
+{
+    void unitTesting();
+}
+
+#endif
@@ -105,7 +105,9 @@ Profiler::~Profiler()
 }   // ~Profiler
 
 thread_local int g_thread_id = -1;
-const int MAX_THREADS = 10;
+// Enough for the main, network and sound threads and the workers of the
+// JobSystem (at most 7)
+const int MAX_THREADS = 16;
 //-----------------------------------------------------------------------------
 /** It is split from the constructor so that it can be avoided allocating
  *  unnecessary memory when the profiler is never used (for example in no
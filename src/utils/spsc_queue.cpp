@@ -0,0 +1,159 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/spsc_queue.hpp"
+
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <assert.h>
+#include <thread>
+
+namespace SPSCQueueTest
+{
+    /** Number of values sent through the queues in the threaded tests. */
+    const unsigned VALUE_COUNT = 200000;
+
+    // ------------------------------------------------------------------------
+    /** Sends VALUE_COUNT increasing values from a producer thread to the
+     *  calling thread, and returns the time needed in microseconds. */
+    uint64_t runThreaded(SPSCQueue<unsigned>* queue)
+    {
+        const uint64_t start = StkTime::getMonoTimeUs();
+        std::thread producer([queue]()
+            {
+                for (unsigned i = 1; i <= VALUE_COUNT; i++)
+                    queue->push(i);
+            });
+        unsigned expected = 1;
+        while (expected <= VALUE_COUNT)
+        {
+            unsigned value;
+            if (!queue->pop(&value))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            // The order must be kept, also when the overflow list is used
+            if (value != expected)
+            {
+                Log::fatal("SPSCQueue", "Got %u instead of %u.", value,
+                    expected);
+            }
+            expected++;
+        }
+        producer.join();
+        assert(queue->empty());
+        return StkTime::getMonoTimeUs() - start;
+    }   // runThreaded
+
+    // ------------------------------------------------------------------------
+    /** The same as runThreaded with a vector protected by a mutex, which is
+     *  swapped by the consumer (like the enet commands of STKHost before
+     *  they used SPSCQueue), to compare the time needed. */
+    uint64_t runThreadedMutex()
+    {
+        std::mutex mutex;
+        std::vector<unsigned> shared;
+        const uint64_t start = StkTime::getMonoTimeUs();
+        std::thread producer([&mutex, &shared]()
+            {
+                for (unsigned i = 1; i <= VALUE_COUNT; i++)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    shared.push_back(i);
+                }
+            });
+        unsigned expected = 1;
+        std::vector<unsigned> copied;
+        while (expected <= VALUE_COUNT)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            std::swap(copied, shared);
+            lock.unlock();
+            if (copied.empty())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (unsigned value : copied)
+            {
+                if (value != expected)
+                {
+                    Log::fatal("SPSCQueue", "Got %u instead of %u.", value,
+                        expected);
+                }
+                expected++;
+            }
+            copied.clear();
+        }
+        producer.join();
+        return StkTime::getMonoTimeUs() - start;
+    }   // runThreadedMutex
+
+    // ------------------------------------------------------------------------
+    /** Tests the order of the values with and without overflow, and logs
+     *  the time to send values between two threads compared to a mutex. */
+    void unitTesting()
+    {
+        // 1) Single thread: the capacity is rounded up to a power of 2, and
+        //    the order is kept when values go to the overflow list
+        SPSCQueue<int> q(3);
+        assert(q.capacity() == 4);
+        assert(q.empty());
+        for (int i = 0; i < 10; i++)
+            q.push(i);
+        assert(!q.empty());
+        int value = -1;
+        for (int i = 0; i < 5; i++)
+        {
+            bool ok = q.pop(&value);
+            assert(ok && value == i);
+            (void)ok;
+        }
+        // The ring is free again, but the producer has to keep using the
+        // overflow list until the consumer took it
+        q.push(10);
+        for (int i = 5; i <= 10; i++)
+        {
+            bool ok = q.pop(&value);
+            assert(ok && value == i);
+            (void)ok;
+        }
+        assert(!q.pop(&value));
+        assert(q.empty());
+        q.push(11);
+        bool ok = q.pop(&value);
+        assert(ok && value == 11);
+        assert(q.empty());
+
+        // 2) Two threads, with a ring large enough and with a small ring
+        //    which overflows frequently
+        SPSCQueue<unsigned> large(1 << 16);
+        const uint64_t large_us = runThreaded(&large);
+        SPSCQueue<unsigned> small_ring(16);
+        const uint64_t small_us = runThreaded(&small_ring);
+        const uint64_t mutex_us = runThreadedMutex();
+        Log::info("SPSCQueue", "%u values between two threads: %u us with "
+            "the queue, %u us with a small ring, %u us with a mutex.",
+            VALUE_COUNT, (unsigned)large_us, (unsigned)small_us,
+            (unsigned)mutex_us);
+        (void)ok;
+    }   // unitTesting
+
+}   // namespace SPSCQueueTest
@@ -0,0 +1,172 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SPSC_QUEUE_HPP
+#define HEADER_SPSC_QUEUE_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/** \brief A queue between exactly one producer thread and one consumer
+ *  thread. Values are stored in a ring with a fixed size, so push and pop
+ *  need no lock and no memory allocation. If the ring is full (e.g. the
+ *  consumer thread is loading a track), values are added to an overflow
+ *  list protected by a mutex instead, so push never fails and the order of
+ *  the values is kept: once the ring was full, all values go to the
+ *  overflow list until the consumer has taken all of them.
+ *  A different thread can become the producer (or consumer) only if the
+ *  previous one is known to have finished using the queue (e.g. it was
+ *  joined, or the change is protected by a mutex).
+ *  \ingroup utils
+ */
+template<typename TYPE>
+class SPSCQueue : public NoCopy
+{
+private:
+    std::vector<TYPE> m_ring;
+
+    /** m_ring.size() - 1, the size is a power of 2. */
+    const size_t m_mask;
+
+    /** The indices are written by different threads, keep them in
+     *  different cache lines. */
+    char m_padding_head[64];
+
+    /** Index of the next value to pop, only written by the consumer. */
+    std::atomic<size_t> m_head;
+
+    char m_padding_tail[64];
+
+    /** Index of the next value to push, only written by the producer. */
+    std::atomic<size_t> m_tail;
+
+    char m_padding_overflow[64];
+
+    /** Set by the producer when the ring was full, cleared by the consumer
+     *  when it took the overflow list. */
+    std::atomic_bool m_overflow;
+
+    /** Protects m_overflow_list (and changes of m_overflow). */
+    std::mutex m_overflow_mutex;
+
+    std::deque<TYPE> m_overflow_list;
+
+    /** Values taken from the overflow list but not popped yet, only used by
+     *  the consumer. */
+    std::deque<TYPE> m_consumer_list;
+
+    // ------------------------------------------------------------------------
+    bool popRing(TYPE* value)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        *value = m_ring[head & m_mask];
+        m_ring[head & m_mask] = TYPE();
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }   // popRing
+    // ------------------------------------------------------------------------
+    static size_t roundCapacity(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        return size;
+    }   // roundCapacity
+
+public:
+    // ------------------------------------------------------------------------
+    /** \param capacity Number of values which can be stored without
+     *  locking, rounded up to a power of 2. */
+    SPSCQueue(size_t capacity = 1024)
+        : m_ring(roundCapacity(capacity)), m_mask(m_ring.size() - 1)
+    {
+        m_head.store(0);
+        m_tail.store(0);
+        m_overflow.store(false);
+    }   // SPSCQueue
+    // ------------------------------------------------------------------------
+    /** Producer only: adds a value to the end of the queue. */
+    void push(const TYPE& value)
+    {
+        if (!m_overflow.load(std::memory_order_acquire))
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head.load(std::memory_order_acquire) < m_ring.size())
+            {
+                m_ring[tail & m_mask] = value;
+                m_tail.store(tail + 1, std::memory_order_release);
+                return;
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        m_overflow_list.push_back(value);
+        m_overflow.store(true, std::memory_order_release);
+    }   // push
+    // ------------------------------------------------------------------------
+    /** Consumer only: removes the first value of the queue.
+     *  \param value The value removed.
+     *  \return False if the queue was empty. */
+    bool pop(TYPE* value)
+    {
+        // Values of the overflow list taken before are after the ones in
+        // the ring
+        if (m_consumer_list.empty())
+        {
+            if (popRing(value))
+                return true;
+            if (!m_overflow.load(std::memory_order_acquire))
+                return false;
+            // The producer doesn't use the ring while m_overflow is set, but
+            // it may have filled it after the test above
+            if (popRing(value))
+                return true;
+            std::lock_guard<std::mutex> lock(m_overflow_mutex);
+            std::swap(m_consumer_list, m_overflow_list);
+            m_overflow.store(false, std::memory_order_release);
+            if (m_consumer_list.empty())
+                return false;
+        }
+        *value = m_consumer_list.front();
+        m_consumer_list.pop_front();
+        return true;
+    }   // pop
+    // ------------------------------------------------------------------------
+    /** Consumer only: returns true if the queue is empty. */
+    bool empty() const
+    {
+        return m_consumer_list.empty() && !m_overflow.load() &&
+            m_head.load() == m_tail.load();
+    }   // empty
+    // ------------------------------------------------------------------------
+    /** Returns the number of values which can be added without locking. */
+    size_t capacity() const                          { return m_ring.size(); }
+
+};   // class SPSCQueue
+
+namespace SPSCQueueTest
+{
+    void unitTesting();
+}
+
+#endif
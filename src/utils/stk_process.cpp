@@ -17,7 +17,31 @@
 
 #include "utils/stk_process.hpp"
 
+#include <stdio.h>
+#ifdef __linux__
+#  include <unistd.h>
+#endif
+
 namespace STKProcess
 {
     thread_local ProcessType g_process_type = PT_MAIN;
+    // ------------------------------------------------------------------------
+    /** Returns the resident memory of the whole process (main and all
+     *  children) in KB, or 0 if it is not known on this platform. */
+    uint64_t getResidentMemoryKB()
+    {
+#ifdef __linux__
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (!f)
+            return 0;
+        unsigned long size = 0, resident = 0;
+        int read = fscanf(f, "%lu %lu", &size, &resident);
+        fclose(f);
+        if (read != 2)
+            return 0;
+        return (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE) / 1024;
+#else
+        return 0;
+#endif
+    }   // getResidentMemoryKB
 } // namespace STKProcess
@@ -19,12 +19,21 @@
 #define HEADER_STK_PROCESS_HPP
 
 #include "utils/tls.hpp"
+#include "utils/types.hpp"
+
+#include <assert.h>
+
+/** Maximum number of child processes (threads with their own set of
+ *  singletons) inside main, each one can run its own server lobby. */
+#define MAX_CHILD_PROCESSES 8
 
 enum ProcessType : unsigned int
 {
     PT_MAIN = 0, // Main process
-    PT_CHILD = 1, // Child process inside main (can be server or ai instance)
-    PT_COUNT = 2
+    PT_CHILD = 1, // First child process inside main (server of the
+                  // graphical client or ai instance), extra server lobbies
+                  // use PT_CHILD + 1 + n, so they are never mistaken for it
+    PT_COUNT = 1 + MAX_CHILD_PROCESSES
 };
 
 namespace STKProcess
@@ -35,11 +44,24 @@ namespace STKProcess
     /** Return which type (main or child) this thread belongs to. */
     inline ProcessType getType()                     { return g_process_type; }
     // ------------------------------------------------------------------------
+    /** Return true if this thread belongs to any child process. */
+    inline bool isChild()                  { return g_process_type != PT_MAIN; }
+    // ------------------------------------------------------------------------
+    /** Return the process type of the n-th extra server lobby, which starts
+     *  after PT_CHILD (the server of the graphical client). */
+    inline ProcessType getExtraLobbyType(unsigned n)
+    {
+        assert(n < MAX_CHILD_PROCESSES - 1);
+        return (ProcessType)(PT_CHILD + 1 + n);
+    }   // getExtraLobbyType
+    // ------------------------------------------------------------------------
     /** Called when any thread in main or child is created. */
     inline void init(ProcessType pt)                   { g_process_type = pt; }
     // ------------------------------------------------------------------------
     /** Reset when stk is started (for android mostly). */
     inline void reset()                           { g_process_type = PT_MAIN; }
+    // ------------------------------------------------------------------------
+    uint64_t getResidentMemoryKB();
 } // namespace STKProcess
 
 #endif
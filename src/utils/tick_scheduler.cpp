@@ -0,0 +1,302 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/tick_scheduler.hpp"
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#  include <errno.h>
+#  include <time.h>
+#endif
+
+const uint64_t TickScheduler::LIMITS[] =
+    { 50, 100, 250, 500, 1000, 2000, 4000, 8000, 16000 };
+
+/** All schedulers of this process for getAllStats, protected by
+ *  g_schedulers_mutex. */
+static std::mutex g_schedulers_mutex;
+static std::vector<TickScheduler*> g_schedulers;
+
+// ----------------------------------------------------------------------------
+/** \param name Name shown in the statistics (e.g. the lobby).
+ *  \param ticks_per_second Number of ticks per second (the physics fps).
+ */
+TickScheduler::TickScheduler(const std::string& name,
+                             unsigned ticks_per_second)
+             : m_name(name), m_ticks_per_second(ticks_per_second)
+{
+    assert(ticks_per_second > 0);
+    m_fast_mode = false;
+    m_get_time_ns = getTimeNs;
+    m_sleep_until_ns = sleepUntilNs;
+    reset();
+    for (unsigned i = 0; i < BUCKETS; i++)
+    {
+        m_tick_duration[i].store(0);
+        m_lateness[i].store(0);
+    }
+    m_overruns.store(0);
+    std::lock_guard<std::mutex> lock(g_schedulers_mutex);
+    g_schedulers.push_back(this);
+}   // TickScheduler
+
+// ----------------------------------------------------------------------------
+TickScheduler::~TickScheduler()
+{
+    std::unique_lock<std::mutex> lock(g_schedulers_mutex);
+    g_schedulers.erase(std::remove(g_schedulers.begin(), g_schedulers.end(),
+        this), g_schedulers.end());
+    lock.unlock();
+    uint32_t ticks = 0;
+    for (auto& count : m_lateness)
+        ticks += count.load();
+    if (ticks > 0)
+        Log::info("TickScheduler", "%s", getStats().c_str());
+}   // ~TickScheduler
+
+// ----------------------------------------------------------------------------
+/** Starts the schedule again with the next call to waitForTicks, e.g. after
+ *  the loop was paused. */
+void TickScheduler::reset()
+{
+    m_start_ns = 0;
+    m_next_tick = 0;
+    m_frame_start_ns = 0;
+    m_frame_ticks = 0;
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Ends the current frame and sleeps until the deadline of the next tick.
+ *  \return The number of ticks to simulate now: 1 if the loop keeps up,
+ *          more if the deadlines of several ticks passed while the last
+ *          frame was running.
+ */
+int TickScheduler::waitForTicks()
+{
+    uint64_t now = m_get_time_ns();
+    if (m_frame_ticks > 0)
+    {
+        // Count each tick of the last frame with its average duration
+        addToHistogram(m_tick_duration,
+            (now - m_frame_start_ns) / 1000 / m_frame_ticks, m_frame_ticks);
+    }
+    if (m_fast_mode)
+    {
+        m_frame_start_ns = now;
+        m_frame_ticks = 1;
+        return 1;
+    }
+    if (m_start_ns == 0)
+        m_start_ns = now;
+
+    const uint64_t deadline = getDeadline(m_next_tick);
+    if (now < deadline)
+    {
+        m_sleep_until_ns(deadline);
+        now = m_get_time_ns();
+    }
+    addToHistogram(m_lateness, now > deadline ? (now - deadline) / 1000 : 0,
+        1);
+
+    int ticks = 0;
+    while (getDeadline(m_next_tick) <= now)
+    {
+        m_next_tick++;
+        ticks++;
+    }
+    if (ticks > 1)
+        m_overruns.fetch_add(1, std::memory_order_relaxed);
+    m_frame_start_ns = now;
+    m_frame_ticks = ticks;
+    return ticks;
+}   // waitForTicks
+
+// ----------------------------------------------------------------------------
+void TickScheduler::addToHistogram(
+    std::array<std::atomic<uint32_t>, BUCKETS>& histogram, uint64_t us,
+    uint32_t count)
+{
+    unsigned bucket = 0;
+    while (bucket < BUCKETS - 1 && us >= LIMITS[bucket])
+        bucket++;
+    histogram[bucket].fetch_add(count, std::memory_order_relaxed);
+}   // addToHistogram
+
+// ----------------------------------------------------------------------------
+std::string TickScheduler::histogramToString(
+    const std::array<std::atomic<uint32_t>, BUCKETS>& histogram)
+{
+    std::ostringstream oss;
+    for (unsigned i = 0; i < BUCKETS; i++)
+    {
+        if (i > 0)
+            oss << ", ";
+        if (i < BUCKETS - 1)
+            oss << "<" << LIMITS[i] << "us: ";
+        else
+            oss << ">=" << LIMITS[i - 1] << "us: ";
+        oss << histogram[i].load(std::memory_order_relaxed);
+    }
+    return oss.str();
+}   // histogramToString
+
+// ----------------------------------------------------------------------------
+/** Returns the histograms of the tick durations and of the lateness (time
+ *  between the deadline of a tick and waking up) as text. */
+std::string TickScheduler::getStats() const
+{
+    std::ostringstream oss;
+    oss << m_name << " (" << m_ticks_per_second << " ticks per second"
+        << (m_fast_mode ? ", fast mode" : "") << ")\n"
+        << "Tick duration: " << histogramToString(m_tick_duration) << "\n"
+        << "Lateness: " << histogramToString(m_lateness) << "\n"
+        << "Frames with several ticks to catch up: "
+        << m_overruns.load(std::memory_order_relaxed);
+    return oss.str();
+}   // getStats
+
+// ----------------------------------------------------------------------------
+/** Returns the statistics of all schedulers of this process, e.g. for the
+ *  network console. */
+std::string TickScheduler::getAllStats()
+{
+    std::lock_guard<std::mutex> lock(g_schedulers_mutex);
+    if (g_schedulers.empty())
+        return "No tick scheduler is running.";
+    std::string stats;
+    for (TickScheduler* scheduler : g_schedulers)
+    {
+        if (!stats.empty())
+            stats += "\n";
+        stats += scheduler->getStats();
+    }
+    return stats;
+}   // getAllStats
+
+// ----------------------------------------------------------------------------
+/** Returns the time of the monotonic clock used for the deadlines. */
+uint64_t TickScheduler::getTimeNs()
+{
+#ifdef __linux__
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}   // getTimeNs
+
+// ----------------------------------------------------------------------------
+/** Sleeps until the monotonic clock reaches time_ns. */
+void TickScheduler::sleepUntilNs(uint64_t time_ns)
+{
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = (time_t)(time_ns / 1000000000ull);
+    ts.tv_nsec = (long)(time_ns % 1000000000ull);
+    // Sleeping until an absolute time needs no new computation when
+    // interrupted by a signal
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {}
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::nanoseconds(time_ns))));
+#endif
+}   // sleepUntilNs
+
+// ============================================================================
+namespace TickSchedulerTest
+{
+    // ------------------------------------------------------------------------
+    /** Checks the number of ticks returned in real time, after an overrun
+     *  and in fast mode, and logs the histograms. A simulated clock is used,
+     *  so that the result doesn't depend on the load of the machine. */
+    void unitTesting()
+    {
+        const unsigned TICKS_PER_SECOND = 240;
+        const unsigned FRAMES = 48;
+        const uint64_t START = 1000000000ull;
+        TickScheduler scheduler("Unit test", TICKS_PER_SECOND);
+        uint64_t now = START;
+        unsigned sleeps = 0;
+        scheduler.setClock([&now]() { return now; },
+            [&now, &sleeps](uint64_t time_ns)
+            {
+                assert(time_ns > now);
+                // Wake up a bit late, like a real sleep
+                now = time_ns + 20000;
+                sleeps++;
+            });
+        // The deadline of a tick relative to the start
+        auto deadline = [TICKS_PER_SECOND](uint64_t tick)
+            { return tick * 1000000000ull / TICKS_PER_SECOND; };
+
+        // 1) Real time: each call sleeps until the deadline of one tick
+        for (unsigned i = 0; i < FRAMES; i++)
+        {
+            // Some work in each frame, shorter than a tick
+            now += 1000000;
+            int frame_ticks = scheduler.waitForTicks();
+            assert(frame_ticks == 1);
+            (void)frame_ticks;
+        }
+        assert(sleeps == FRAMES - 1);
+        assert(now == START + 1000000 + deadline(FRAMES - 1) + 20000);
+
+        // 2) Overrun: all ticks whose deadline passed are returned at once,
+        //    here the ticks up to 100 ms after tick FRAMES - 1
+        now += 100000000;
+        int catch_up = scheduler.waitForTicks();
+        assert(catch_up == 24);
+        // And the next one is due in real time again
+        int next = scheduler.waitForTicks();
+        assert(next == 1);
+        assert(now == START + 1000000 + deadline(FRAMES + catch_up) + 20000);
+
+        // 3) Fast mode returns one tick for each call without sleeping
+        scheduler.setFastMode(true);
+        const unsigned fast_sleeps = sleeps;
+        for (unsigned i = 0; i < 10000; i++)
+        {
+            int fast_ticks = scheduler.waitForTicks();
+            assert(fast_ticks == 1);
+            (void)fast_ticks;
+        }
+        assert(sleeps == fast_sleeps);
+        scheduler.setFastMode(false);
+
+        Log::info("TickScheduler", "%d ticks after 100 ms of work.",
+            catch_up);
+        Log::info("TickScheduler", "%s", scheduler.getStats().c_str());
+        (void)next;
+        (void)fast_sleeps;
+        (void)deadline;
+    }   // unitTesting
+
+}   // namespace TickSchedulerTest
@@ -0,0 +1,143 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_TICK_SCHEDULER_HPP
+#define HEADER_TICK_SCHEDULER_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <string>
+
+/** \brief Paces the fixed ticks of a headless server loop. The deadline of
+ *  tick n is computed from the start time as start + n / ticks_per_second
+ *  (in nanoseconds with integers, so it never drifts), and the loop sleeps
+ *  until it with an absolute monotonic sleep (clock_nanosleep with
+ *  TIMER_ABSTIME on Linux) instead of sleeping 1 ms at a time. If a frame
+ *  took too long, the next call returns all ticks whose deadline passed, so
+ *  the number of ticks always matches the real time elapsed.
+ *  The duration of the ticks and the time the loop woke up after the
+ *  deadline are counted in histograms, which can be shown in the network
+ *  console (all schedulers of the process, see getAllStats).
+ *  \ingroup utils
+ */
+class TickScheduler : public NoCopy
+{
+private:
+    /** Upper limits (in microseconds) of the buckets of the histograms. */
+    static const uint64_t LIMITS[];
+
+    /** Number of buckets in the histograms, the last one counts all times
+     *  larger than the last limit. */
+    static const unsigned BUCKETS = 10;
+
+    const std::string m_name;
+
+    const uint64_t m_ticks_per_second;
+
+    /** Don't sleep, return one tick for each call (offline simulation). */
+    bool m_fast_mode;
+
+    /** Time of tick 0, 0 before the first call to waitForTicks. */
+    uint64_t m_start_ns;
+
+    /** Index of the next tick, whose deadline is not reached yet. */
+    uint64_t m_next_tick;
+
+    /** Time when the last call to waitForTicks returned. */
+    uint64_t m_frame_start_ns;
+
+    /** Number of ticks returned by the last call to waitForTicks. */
+    int m_frame_ticks;
+
+    /** Histograms written by the loop thread and read by the network
+     *  console. */
+    std::array<std::atomic<uint32_t>, BUCKETS> m_tick_duration;
+
+    std::array<std::atomic<uint32_t>, BUCKETS> m_lateness;
+
+    /** Number of calls which returned more than one tick. */
+    std::atomic<uint32_t> m_overruns;
+
+    /** The clock used for the deadlines, getTimeNs and sleepUntilNs unless
+     *  replaced with setClock. */
+    std::function<uint64_t()> m_get_time_ns;
+
+    std::function<void(uint64_t)> m_sleep_until_ns;
+
+    // ------------------------------------------------------------------------
+    uint64_t getDeadline(uint64_t tick) const
+    {
+        return m_start_ns + tick * 1000000000ull / m_ticks_per_second;
+    }   // getDeadline
+    // ------------------------------------------------------------------------
+    static void addToHistogram(
+        std::array<std::atomic<uint32_t>, BUCKETS>& histogram, uint64_t us,
+        uint32_t count);
+    // ------------------------------------------------------------------------
+    static std::string histogramToString(
+        const std::array<std::atomic<uint32_t>, BUCKETS>& histogram);
+
+public:
+    TickScheduler(const std::string& name, unsigned ticks_per_second);
+    // ------------------------------------------------------------------------
+    ~TickScheduler();
+    // ------------------------------------------------------------------------
+    int waitForTicks();
+    // ------------------------------------------------------------------------
+    void reset();
+    // ------------------------------------------------------------------------
+    std::string getStats() const;
+    // ------------------------------------------------------------------------
+    static std::string getAllStats();
+    // ------------------------------------------------------------------------
+    static uint64_t getTimeNs();
+    // ------------------------------------------------------------------------
+    static void sleepUntilNs(uint64_t time_ns);
+    // ------------------------------------------------------------------------
+    /** Replaces the clock, used for unit testing with a simulated time.
+     *  The time must not be 0. */
+    void setClock(const std::function<uint64_t()>& get_time_ns,
+                  const std::function<void(uint64_t)>& sleep_until_ns)
+    {
+        m_get_time_ns = get_time_ns;
+        m_sleep_until_ns = sleep_until_ns;
+        reset();
+    }   // setClock
+    // ------------------------------------------------------------------------
+    /** Switches the fast mode, the schedule starts again in real time
+     *  when leaving it. */
+    void setFastMode(bool fast_mode)
+    {
+        m_fast_mode = fast_mode;
+        reset();
+    }   // setFastMode
+    // ------------------------------------------------------------------------
+    bool isFastMode() const                              { return m_fast_mode; }
+
+};   // class TickScheduler
+
+namespace TickSchedulerTest
+{
+    void unitTesting();
+}
+
+#endif